@@ -23,10 +23,12 @@
 
 #define PAYMENTS_TXFEE 10000
 #define PAYMENTS_MERGEOFSET 60 // 1H extra. 
+#define PAYMENTS_ALLOCATIONSCACHESIZE 64 // snapshot plans whose allocations are kept
 extern std::vector <std::pair<CAmount, CTxDestination>> vAddressSnapshot;
 extern int32_t lastSnapShotHeight;
 
 bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &tx, uint32_t nIn);
+bool payments_allocationshare(int64_t allocation,int64_t amount,unsigned __int128 totalallocations,int64_t &share);
 
 // CCcustom
 UniValue PaymentsRelease(struct CCcontract_info *cp,char *jsonstr);
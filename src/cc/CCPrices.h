@@ -20,6 +20,8 @@
 #include "komodo_defs.h"
 #include "CCinclude.h"
 
+#include <memory>
+
 int32_t komodo_priceget(int64_t *buf64,int32_t ind,int32_t height,int32_t numblocks);
 extern void GetKomodoEarlytxidScriptPub();
 extern CScript KOMODO_EARLYTXID_SCRIPTPUB;
@@ -43,6 +45,27 @@ extern CScript KOMODO_EARLYTXID_SCRIPTPUB;
 //#define PRICES_NORMFACTOR   (int64_t)(SATOSHIDEN)
 //#define PRICES_POINTFACTOR   (int64_t)10000
 
+#define PRICES_SYNTHETICCACHESIZE 4096   // compiled bet expressions kept in memory
+
+typedef int32_t (*prices_getfn)(int64_t *buf64,int32_t ind,int32_t height,int32_t numblocks);
+
+// synthetic expression decoded once for repeated evaluation
+struct CPricesSynthetic
+{
+    struct Op {
+        uint16_t code;   // opcode & KOMODO_PRICEMASK
+        uint16_t value;  // price index or weight
+    };
+    std::vector<uint16_t> vec;  // source opcodes, evaluated with gmp if 128 bits overflow
+    std::vector<Op> ops;
+};
+
+void prices_syntheticcompile(CPricesSynthetic &synthetic, const std::vector<uint16_t> &vec);
+std::shared_ptr<const CPricesSynthetic> prices_syntheticcached(uint256 bettxid, const std::vector<uint16_t> &vec);
+int64_t prices_syntheticeval(const CPricesSynthetic &synthetic, int32_t height, prices_getfn getprice);
+int64_t prices_syntheticprice_mpz(const std::vector<uint16_t> &vec, int32_t height, prices_getfn getprice);
+int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t minmax, int16_t leverage);
+
 #define PRICES_REVSHAREDUST 10000
 #define PRICES_SUBREVSHAREFEE(amount) ((amount) * 199 / 200)    // revshare fee percentage == 0.005
 #define PRICES_MINAVAILFUNDFRACTION  0.1                             // leveraged bet limit < fund fraction
@@ -19,6 +19,52 @@
 #include "CCtokens.h"
 #include "CCassets.h"
 #include "CCTokelData.h"
+#include "CCindex.h"
+
+// order txs decoded for the orderbook, grouped by tokenid
+struct CAssetOrder
+{
+    uint8_t funcid;
+    uint256 assetid;
+    CAmount unit_price;
+    vscript_t origpubkey;
+    int32_t expiryHeight;
+    CAmount amount;     // vout.0 of the order tx: coins left for bids, tokens left for asks
+};
+
+template<class A>
+bool DecodeAssetOrder(const CTransaction &tx, int32_t vout, uint256 &assetid, CAssetOrder &order)
+{
+    uint8_t evalCode;
+
+    if (vout != ASSETS_GLOBALADDR_VOUT || tx.vout.size() < 2 || (order.funcid = A::DecodeAssetTokenOpRet(tx.vout.back().scriptPubKey, evalCode, assetid, order.unit_price, order.origpubkey, order.expiryHeight)) == 0)
+        return false;
+    order.assetid = assetid;
+    order.amount = tx.vout[ASSETS_GLOBALADDR_VOUT].nValue;
+    return true;
+}
+
+// unspent orders on the assets global addresses, the order book
+template<class A>
+CCUnspentsIndex<CAssetOrder> &AssetOrdersIndex()
+{
+    LOCK(cs_main);  // the index registers itself on first use, not while a block is being connected
+    static CCUnspentsIndex<CAssetOrder> index(DecodeAssetOrder<A>);
+    return index;
+}
+
+// bids before asks, best prices first: highest bids and lowest asks
+inline bool AssetOrderBetter(const std::pair<COutPoint, CAssetOrder> &order1, const std::pair<COutPoint, CAssetOrder> &order2)
+{
+    bool isBid1 = order1.second.funcid == 'b' || order1.second.funcid == 'B';
+    bool isBid2 = order2.second.funcid == 'b' || order2.second.funcid == 'B';
+
+    if (isBid1 != isBid2)
+        return isBid1;
+    if (order1.second.unit_price != order2.second.unit_price)
+        return isBid1 ? order1.second.unit_price > order2.second.unit_price : order1.second.unit_price < order2.second.unit_price;
+    return order1.first < order2.first;
+}
 
 template<class T, class A>
 UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &params)
@@ -52,15 +98,61 @@ UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &pa
     cpAssets = CCinit(&assetsC, A::EvalCode());
     cpTokens = CCinit(&tokensC, T::EvalCode());
 
+    auto addOrder = [&](struct CCcontract_info *cp, uint256 ordertxid, const CAssetOrder &order, int32_t height)
+    {
+		char origaddr[KOMODO_ADDRESS_BUFSIZE], origtokenaddr[KOMODO_ADDRESS_BUFSIZE];
+        UniValue item(UniValue::VOBJ);
+
+        std::string funcidstr(1, (char)order.funcid);
+        item.push_back(Pair("funcid", funcidstr));
+        item.push_back(Pair("txid", ordertxid.GetHex()));
+        if (order.funcid == 'b' || order.funcid == 'B')
+        {
+            item.push_back(Pair("bidamount", ValueFromAmount(order.amount)));
+        }
+        else if (order.funcid == 's' || order.funcid == 'S')
+        {
+            item.push_back(Pair("askamount", order.amount));
+        }
+        else
+            return;
+        if (order.origpubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE)
+        {
+            GetCCaddress(cp, origaddr, pubkey2pk(order.origpubkey), A::IsMixed());  
+            item.push_back(Pair("origaddress", origaddr));
+            GetTokensCCaddress(cpTokens, origtokenaddr, pubkey2pk(order.origpubkey), A::IsMixed());
+            item.push_back(Pair("origtokenaddress", origtokenaddr));
+        }
+        if (order.assetid != zeroid)
+            item.push_back(Pair("tokenid", order.assetid.GetHex()));
+        if (order.unit_price > 0)
+        {
+            if (order.funcid == 's' || order.funcid == 'S' /*|| funcid == 'e' || funcid == 'E' not supported */)
+            {
+                item.push_back(Pair("totalrequired", ValueFromAmount(order.unit_price * order.amount)));
+                item.push_back(Pair("price", ValueFromAmount(order.unit_price)));
+            }
+            else if (order.funcid == 'b' || order.funcid == 'B')
+            {
+                item.push_back(Pair("totalrequired", order.unit_price ? order.amount / order.unit_price : 0));
+                item.push_back(Pair("price", ValueFromAmount(order.unit_price)));
+            }
+        }
+        if (height > 0)
+            item.push_back(Pair("blockHeight", height));
+        if (order.expiryHeight > 0)
+            item.push_back(Pair("ExpiryHeight", order.expiryHeight));
+
+        if (order.amount > 0LL) // do not add totally filled orders 
+            result.push_back(item);
+        LOGSTREAM(ccassets_log, CCLOG_DEBUG1, stream << funcname << " added order funcId=" << (char)(order.funcid ? order.funcid : ' ') << " orderid=" << ordertxid.GetHex() << " tokenid=" << order.assetid.GetHex() << std::endl);
+    };
+
 	auto addOrders = [&](struct CCcontract_info *cp, uint256 ordertxid)
 	{
 		uint256 hashBlock, assetid;
-		CAmount unit_price;
-		vscript_t vorigpubkey;
 		CTransaction ordertx;
-		uint8_t funcid, evalCode;
-		char origaddr[KOMODO_ADDRESS_BUFSIZE], origtokenaddr[KOMODO_ADDRESS_BUFSIZE];
-        int32_t expiryHeight;
+        CAssetOrder order;
 
         LOGSTREAM(ccassets_log, CCLOG_DEBUG2, stream << funcname << " checking txid=" << ordertxid.GetHex() << std::endl);
         if (!myGetTransaction(ordertxid, ordertx, hashBlock)) {
@@ -68,11 +160,11 @@ UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &pa
             return;
         }
 
-        if (ordertx.vout.size() > 1 && (funcid = A::DecodeAssetTokenOpRet(ordertx.vout.back().scriptPubKey, evalCode, assetid, unit_price, vorigpubkey, expiryHeight)) != 0)
+        if (DecodeAssetOrder<A>(ordertx, ASSETS_GLOBALADDR_VOUT, assetid, order))
         {
-            LOGSTREAM(ccassets_log, CCLOG_DEBUG2, stream << funcname << " checking ordertx.vout.size()=" << ordertx.vout.size() << " funcid=" << (char)(funcid ? funcid : ' ') << " assetid=" << assetid.GetHex() << std::endl);
+            LOGSTREAM(ccassets_log, CCLOG_DEBUG2, stream << funcname << " checking ordertx.vout.size()=" << ordertx.vout.size() << " funcid=" << (char)(order.funcid ? order.funcid : ' ') << " assetid=" << assetid.GetHex() << std::endl);
 
-            if ((!checkPK.IsValid() || checkPK == pubkey2pk(vorigpubkey)) && (refassetid.IsNull() || assetid == refassetid)) 
+            if ((!checkPK.IsValid() || checkPK == pubkey2pk(order.origpubkey)) && (refassetid.IsNull() || assetid == refassetid)) 
             {
                 uint256 spenttxid;
                 uint256 init_txid = ordertxid;
@@ -94,78 +186,57 @@ UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &pa
                         LOGSTREAM(ccassets_log, CCLOG_DEBUG2, stream << funcname << " could not load order txid=" << ordertxid.GetHex() << std::endl);
                         return;
                     }
-                    if ((funcid = A::DecodeAssetTokenOpRet(ordertx.vout.back().scriptPubKey, evalCode, assetid, unit_price, vorigpubkey, expiryHeight)) == 0) {
+                    if (!DecodeAssetOrder<A>(ordertx, ASSETS_GLOBALADDR_VOUT, assetid, order)) {
                         LOGSTREAM(ccassets_log, CCLOG_DEBUG2, stream << funcname << " could not decode order txid=" << ordertxid.GetHex() << std::endl);
                         return;
                     }
                 }
 
-                if (ordertx.vout.size() < 2)  {
-                    LOGSTREAM(ccassets_log, CCLOG_DEBUG2, stream << funcname << " txid skipped " << ordertxid.GetHex() << std::endl);
-                    return;
-                }
-
-                UniValue item(UniValue::VOBJ);
-
-                std::string funcidstr(1, (char)funcid);
-                item.push_back(Pair("funcid", funcidstr));
-                item.push_back(Pair("txid", ordertxid.GetHex()));
-                if (funcid == 'b' || funcid == 'B')
-                {
-                    item.push_back(Pair("bidamount", ValueFromAmount(ordertx.vout[0].nValue)));
-                }
-                else if (funcid == 's' || funcid == 'S')
-                {
-                    item.push_back(Pair("askamount", ordertx.vout[0].nValue));
-                }
-                else
-                    return;
-                if (vorigpubkey.size() == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE)
-                {
-                    GetCCaddress(cp, origaddr, pubkey2pk(vorigpubkey), A::IsMixed());  
-                    item.push_back(Pair("origaddress", origaddr));
-                    GetTokensCCaddress(cpTokens, origtokenaddr, pubkey2pk(vorigpubkey), A::IsMixed());
-                    item.push_back(Pair("origtokenaddress", origtokenaddr));
-                }
-                if (assetid != zeroid)
-                    item.push_back(Pair("tokenid", assetid.GetHex()));
-                if (unit_price > 0)
-                {
-                    if (funcid == 's' || funcid == 'S' /*|| funcid == 'e' || funcid == 'E' not supported */)
-                    {
-                        item.push_back(Pair("totalrequired", ValueFromAmount(unit_price * ordertx.vout[0].nValue)));
-                        item.push_back(Pair("price", ValueFromAmount(unit_price)));
-                    }
-                    else if (funcid == 'b' || funcid == 'B')
-                    {
-                        item.push_back(Pair("totalrequired", unit_price ? ordertx.vout[0].nValue / unit_price : 0));
-                        item.push_back(Pair("price", ValueFromAmount(unit_price)));
-                    }
-                }
+                height = 0;
                 {
                     LOCK(cs_main);
                     CBlockIndex *pindex = komodo_getblockindex(hashBlock);
                     if (pindex)
-                        item.push_back(Pair("blockHeight", pindex->GetHeight()));
+                        height = pindex->GetHeight();
                 }
-                if (expiryHeight > 0)
-                    item.push_back(Pair("ExpiryHeight", expiryHeight));
-
-                if (ordertx.vout[0].nValue > 0LL) // do not add totally filled orders 
-                    result.push_back(item);
-                LOGSTREAM(ccassets_log, CCLOG_DEBUG1, stream << funcname << " added order funcId=" << (char)(funcid ? funcid : ' ') << " orderid=" << ordertxid.GetHex() << " tokenid=" << assetid.GetHex() << std::endl);
+                addOrder(cp, ordertxid, order, height);
             }
         }
 	};
 
+    // unspent orders from the orderbook index with the mempool laid over, in price order
+    auto addIndexedOrders = [&](const char *ordersaddr)
+    {
+        CCUnspentsIndex<CAssetOrder>::vecEntries orders;
+        CCoins coins;
+        int32_t height;
+
+        AssetOrdersIndex<A>().GetWithMempool(ordersaddr, refassetid, orders);
+        LOGSTREAMFN(ccassets_log, CCLOG_DEBUG1, stream << "ordersaddr=" << ordersaddr << " orders.size()=" << orders.size() << std::endl);
+        std::sort(orders.begin(), orders.end(), AssetOrderBetter);
+        for (const auto &order : orders)
+        {
+            height = 0;     // none yet for orders in the mempool
+            {
+                LOCK(cs_main);
+                if (pcoinsTip->GetCoins(order.first.hash, coins))
+                    height = coins.nHeight;
+            }
+            addOrder(cpAssets, order.first.hash, order.second, height);
+        }
+    };
+
     if (!checkPK.IsValid()) // get tokenorders (all orders)
     {
+        char assetsGlobalAddr[KOMODO_ADDRESS_BUFSIZE];
+        char tokensAssetsGlobalAddr[KOMODO_ADDRESS_BUFSIZE];
+        GetCCaddress(cpAssets, assetsGlobalAddr, GetUnspendable(cpAssets, NULL), A::IsMixed());
+        GetTokensCCaddress(cpAssets, tokensAssetsGlobalAddr, GetUnspendable(cpAssets, NULL), A::IsMixed());
+
         if (beginHeight > 0 || endHeight > 0)    
         {
             // tokenbids (using addressindex sorted by height):
             std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndexOutputsCoins;
-            char assetsGlobalAddr[KOMODO_ADDRESS_BUFSIZE];
-            GetCCaddress(cpAssets, assetsGlobalAddr, GetUnspendable(cpAssets, NULL), A::IsMixed());
             SetAddressIndexOutputs(addressIndexOutputsCoins, assetsGlobalAddr, CC_OUTPUTS_TRUE, beginHeight, endHeight);
             LOGSTREAMFN(ccassets_log, CCLOG_DEBUG1, stream << "SetAddressIndexOutputs addressIndexOutputsCoins.size()=" << addressIndexOutputsCoins.size() << std::endl);
             for (const auto &outputsCoins : addressIndexOutputsCoins) 
@@ -183,8 +254,6 @@ UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &pa
 
             // tokenasks (using addressindex sorted by height):
             std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndexOutputsTokens;
-            char tokensAssetsGlobalAddr[KOMODO_ADDRESS_BUFSIZE];
-            GetTokensCCaddress(cpAssets, tokensAssetsGlobalAddr, GetUnspendable(cpAssets, NULL), A::IsMixed());
             SetAddressIndexOutputs(addressIndexOutputsTokens, tokensAssetsGlobalAddr, CC_OUTPUTS_TRUE, beginHeight, endHeight);
             LOGSTREAMFN(ccassets_log, CCLOG_DEBUG1, stream << "SetAddressIndexOutputs addressIndexOutputsTokens.size()=" << addressIndexOutputsTokens.size() << std::endl);
             for (const auto &outputsTokens : addressIndexOutputsTokens) 
@@ -202,37 +271,8 @@ UniValue AssetOrders(uint256 refassetid, const CPubKey &mypk, const UniValue &pa
         }
         else
         {
-            // tokenbids:
-            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputsCoins;
-            char assetsGlobalAddr[KOMODO_ADDRESS_BUFSIZE];
-            GetCCaddress(cpAssets, assetsGlobalAddr, GetUnspendable(cpAssets, NULL), A::IsMixed());
-            SetCCunspents(unspentOutputsCoins, assetsGlobalAddr, CC_OUTPUTS_TRUE);
-            for (const auto & unspentCoins : unspentOutputsCoins)
-            {
-                bool isTxidInActiveChain = false;
-                {
-                    LOCK(cs_main);
-                    isTxidInActiveChain = IsTxidInActiveChain(unspentCoins.first.txhash);
-                }
-                if (isTxidInActiveChain)
-                    addOrders(cpAssets, unspentCoins.first.txhash);
-            }
-            
-            // tokenasks:
-            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputsTokens;
-            char tokensAssetsGlobalAddr[KOMODO_ADDRESS_BUFSIZE];
-            GetTokensCCaddress(cpAssets, tokensAssetsGlobalAddr, GetUnspendable(cpAssets, NULL), A::IsMixed());
-            SetCCunspents(unspentOutputsTokens, tokensAssetsGlobalAddr, CC_OUTPUTS_TRUE);
-            for (const auto & unspentTokens : unspentOutputsTokens)
-            {
-                bool isTxidInActiveChain = false;
-                {
-                    LOCK(cs_main);
-                    isTxidInActiveChain = IsTxidInActiveChain(unspentTokens.first.txhash);
-                }
-                if (isTxidInActiveChain)
-                    addOrders(cpAssets, unspentTokens.first.txhash);
-            }
+            addIndexedOrders(assetsGlobalAddr);         // tokenbids
+            addIndexedOrders(tokensAssetsGlobalAddr);   // tokenasks
         }
     }
     else 
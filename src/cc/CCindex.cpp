@@ -0,0 +1,40 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "CCindex.h"
+
+// the contracts register their indexes from static constructors, so the list is created on first use
+static std::vector<CCIndexBase *> &CCIndexes()
+{
+    static std::vector<CCIndexBase *> indexes;
+    return(indexes);
+}
+
+void CCIndexRegister(CCIndexBase *index)
+{
+    CCIndexes().push_back(index);
+}
+
+// called with cs_main held after a block is connected or disconnected, see GetMainSignals().ChainTip
+void CCIndexChainTip(const CBlockIndex *pindex,const CBlock *pblock,bool added)
+{
+    AssertLockHeld(cs_main);
+    BOOST_FOREACH(CCIndexBase *index,CCIndexes())
+    {
+        if ( added != 0 )
+            index->ConnectBlock(pindex,*pblock);
+        else index->DisconnectBlock(pindex,*pblock);
+    }
+}
@@ -0,0 +1,473 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CC_INDEX_H
+#define CC_INDEX_H
+
+#include "CCinclude.h"
+
+#include <deque>
+
+/*
+ In memory index of the unspent cc outputs of the addresses a contract queries, each with what the contract decodes from its tx.
+ An address is loaded on first use the way SetCCunspents and myGetTransaction find it, from then on it follows the chain
+ as blocks are connected and disconnected, so rpc calls do not rescan the address and reload every tx each time.
+ Only confirmed outputs are kept, the callers check spends in the mempool with myIsutxo_spentinmempool as before or
+ lay the mempool over them with GetWithMempool.
+ Each index keeps at most CC_INDEX_MAXADDRESSES addresses, loading one more drops the one queried longest ago, which is
+ loaded again if it is queried again.
+ The index is read and changed under cs_main, which connect and disconnect already hold. Loading an address reads its txs
+ without cs_main, the blocks connected meanwhile are then replayed on what was read, or it is read again under cs_main
+ if a block was disconnected meanwhile.
+*/
+
+#define CC_INDEX_UNDODEPTH 100  // blocks that can be disconnected before the loaded addresses are dropped
+#define CC_INDEX_MAXADDRESSES 256
+
+class CCIndexBase
+{
+public:
+    virtual ~CCIndexBase() {}
+    virtual void ConnectBlock(const CBlockIndex *pindex,const CBlock &block) = 0;
+    virtual void DisconnectBlock(const CBlockIndex *pindex,const CBlock &block) = 0;
+};
+
+void CCIndexRegister(CCIndexBase *index);
+void CCIndexChainTip(const CBlockIndex *pindex,const CBlock *pblock,bool added);
+
+template <class Entry>
+class CCUnspentsIndex : public CCIndexBase
+{
+public:
+    // returns false for outputs that are not indexed, groupid is what the lookups select on
+    typedef bool (*DecodeFunc)(const CTransaction &tx,int32_t vout,uint256 &groupid,Entry &entry);
+    typedef std::vector<std::pair<COutPoint,Entry> > vecEntries;
+
+    CCUnspentsIndex(DecodeFunc decodeIn) : decode(decodeIn), nQueries(0), nDisconnects(0) { CCIndexRegister(this); }
+
+    // appends the unspent outputs of coinaddr in group groupid, of all groups if groupid is null
+    void Get(const char *coinaddr,const uint256 &groupid,vecEntries &out)
+    {
+        typename std::map<std::string,CAddressEntries>::iterator a; mapEntries loaded; int32_t nHeight; uint64_t nDisconnectsLoad;
+        if ( KOMODO_NSPV_SUPERLITE )
+        {
+            Load(coinaddr,loaded); // no blocks are connected to keep it current
+            Select(loaded,groupid,out);
+            return;
+        }
+        {
+            LOCK(cs_main);
+            if ( (a= addresses.find(coinaddr)) != addresses.end() )
+            {
+                a->second.nLastQuery = ++nQueries;
+                Select(a->second.entries,groupid,out);
+                return;
+            }
+            nHeight = chainActive.Height();
+            nDisconnectsLoad = nDisconnects;
+        }
+        Load(coinaddr,loaded);
+        LOCK(cs_main);
+        Select(Insert(coinaddr,loaded,nHeight,nDisconnectsLoad).entries,groupid,out);
+    }
+
+    // same with the mempool laid over: outputs spent in the mempool are left out and the unspent outputs of mempool txs are added
+    void GetWithMempool(const char *coinaddr,const uint256 &groupid,vecEntries &out)
+    {
+        vecEntries confirmed; std::vector<std::pair<CMempoolAddressDeltaKey,CMempoolAddressDelta> > memOutputs; std::vector<std::pair<uint160,int> > addrs;
+        CTransaction tx; uint256 spenttxid,txgroupid; uint160 hashBytes; Entry entry; int32_t spentvini,type = 0;
+        Get(coinaddr,groupid,confirmed);
+        for (typename vecEntries::const_iterator it=confirmed.begin(); it!=confirmed.end(); it++)
+        {
+            if ( myIsutxo_spentinmempool(spenttxid,spentvini,it->first.hash,it->first.n) == 0 )
+                out.push_back(*it);
+        }
+        if ( KOMODO_NSPV_SUPERLITE || CBitcoinAddress(coinaddr).GetIndexKey(hashBytes,type,true) == 0 )
+            return;
+        addrs.push_back(std::make_pair(hashBytes,type));
+        {
+            LOCK(mempool.cs);
+            mempool.getAddressIndex(addrs,memOutputs);
+        }
+        for (std::vector<std::pair<CMempoolAddressDeltaKey,CMempoolAddressDelta> >::const_iterator mo=memOutputs.begin(); mo!=memOutputs.end(); mo++)
+        {
+            if ( mo->first.spending != 0 || mo->first.type != type || myIsutxo_spentinmempool(spenttxid,spentvini,mo->first.txhash,mo->first.index) != 0 )
+                continue;
+            if ( (tx.GetHash() == mo->first.txhash || mempool.lookup(mo->first.txhash,tx) != 0) && mo->first.index < tx.vout.size() )
+            {
+                if ( decode(tx,(int32_t)mo->first.index,txgroupid,entry) != 0 && (groupid.IsNull() || txgroupid == groupid) )
+                    out.push_back(std::make_pair(COutPoint(mo->first.txhash,mo->first.index),entry));
+            }
+        }
+    }
+
+    void ConnectBlock(const CBlockIndex *pindex,const CBlock &block)
+    {
+        std::vector<CSpentEntry> spent; typename std::map<COutPoint,std::pair<std::string,uint256> >::iterator it; char coinaddr[64]; uint256 groupid; Entry entry; int32_t i;
+        if ( addresses.empty() )
+            return;
+        BOOST_FOREACH(const CTransaction &tx,block.vtx)
+        {
+            BOOST_FOREACH(const CTxIn &vin,tx.vin)
+            {
+                if ( (it= outpoints.find(vin.prevout)) != outpoints.end() )
+                {
+                    mapEntries &entries = addresses[it->second.first].entries;
+                    typename mapEntries::iterator e = entries.find(std::make_pair(it->second.second,vin.prevout));
+                    spent.push_back(CSpentEntry(it->second.first,e->first,e->second));
+                    entries.erase(e);
+                    outpoints.erase(it);
+                }
+            }
+            for (i=0; i<tx.vout.size(); i++)
+            {
+                if ( tx.vout[i].scriptPubKey.IsPayToCryptoCondition() == 0 || Getscriptaddress(coinaddr,tx.vout[i].scriptPubKey) == 0 || addresses.count(coinaddr) == 0 )
+                    continue;
+                if ( decode(tx,i,groupid,entry) != 0 )
+                    Add(coinaddr,groupid,COutPoint(tx.GetHash(),i),entry);
+            }
+        }
+        undo[pindex->GetBlockHash()].swap(spent);
+        undoOrder.push_back(pindex->GetBlockHash());
+        while ( undoOrder.size() > CC_INDEX_UNDODEPTH )
+        {
+            undo.erase(undoOrder.front());
+            undoOrder.pop_front();
+        }
+    }
+
+    void DisconnectBlock(const CBlockIndex *pindex,const CBlock &block)
+    {
+        typename std::map<uint256,std::vector<CSpentEntry> >::iterator u; typename std::map<std::string,CAddressEntries>::iterator a; int32_t i;
+        nDisconnects++;
+        // addresses loaded with this block at the tip have no undo for it
+        for (a=addresses.begin(); a!=addresses.end(); )
+        {
+            if ( a->second.nHeight >= pindex->GetHeight() )
+                Drop(a++);
+            else a++;
+        }
+        if ( addresses.empty() )
+            return;
+        if ( (u= undo.find(pindex->GetBlockHash())) == undo.end() )
+        {
+            LogPrint("cc","dropped cc index of %d addresses at disconnect of %s\n",(int32_t)addresses.size(),pindex->GetBlockHash().GetHex().c_str());
+            addresses.clear(), outpoints.clear(), undo.clear(), undoOrder.clear();
+            return;
+        }
+        // restore first, outputs spent in the block they were created in are removed again below
+        BOOST_FOREACH(const CSpentEntry &s,u->second)
+        {
+            if ( addresses.count(s.coinaddr) != 0 )
+                Add(s.coinaddr,s.key.first,s.key.second,s.entry);
+        }
+        BOOST_FOREACH(const CTransaction &tx,block.vtx)
+        {
+            for (i=0; i<tx.vout.size(); i++)
+                Remove(COutPoint(tx.GetHash(),i));
+        }
+        undo.erase(u);
+        undoOrder.erase(std::find(undoOrder.begin(),undoOrder.end(),pindex->GetBlockHash()));
+    }
+
+private:
+    typedef std::map<std::pair<uint256,COutPoint>,Entry> mapEntries;
+    struct CAddressEntries
+    {
+        int32_t nHeight;    // tip when read from the address index
+        uint64_t nLastQuery;
+        mapEntries entries;
+    };
+    struct CSpentEntry
+    {
+        std::string coinaddr; std::pair<uint256,COutPoint> key; Entry entry;
+        CSpentEntry(const std::string &coinaddrIn,const std::pair<uint256,COutPoint> &keyIn,const Entry &entryIn) : coinaddr(coinaddrIn), key(keyIn), entry(entryIn) {}
+    };
+
+    DecodeFunc decode;
+    std::map<std::string,CAddressEntries> addresses;
+    std::map<COutPoint,std::pair<std::string,uint256> > outpoints;
+    std::map<uint256,std::vector<CSpentEntry> > undo;   // entries spent by the last connected blocks
+    std::deque<uint256> undoOrder;
+    uint64_t nQueries,nDisconnects;
+
+    void Select(const mapEntries &entries,const uint256 &groupid,vecEntries &out)
+    {
+        typename mapEntries::const_iterator it;
+        if ( groupid.IsNull() )
+            it = entries.begin();
+        else it = entries.lower_bound(std::make_pair(groupid,COutPoint(uint256(),0)));
+        for (; it!=entries.end() && (groupid.IsNull() || it->first.first == groupid); it++)
+            out.push_back(std::make_pair(it->first.second,it->second));
+    }
+
+    void Load(const char *coinaddr,mapEntries &entries)
+    {
+        std::vector<std::pair<CAddressUnspentKey,CAddressUnspentValue> > unspentOutputs; CTransaction tx; uint256 txid,hashBlock,groupid; Entry entry;
+        SetCCunspents(unspentOutputs,(char *)coinaddr,true);
+        for (std::vector<std::pair<CAddressUnspentKey,CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+        {
+            if ( it->first.txhash != txid && myGetTransaction(it->first.txhash,tx,hashBlock) == 0 )
+                continue;
+            txid = it->first.txhash;
+            if ( it->first.index < tx.vout.size() && decode(tx,(int32_t)it->first.index,groupid,entry) != 0 )
+                entries[std::make_pair(groupid,COutPoint(txid,it->first.index))] = entry;
+        }
+    }
+
+    // brings the outputs of coinaddr read at the tip of nHeight up to the current tip
+    bool Replay(const char *coinaddr,int32_t nHeight,mapEntries &entries)
+    {
+        std::map<COutPoint,uint256> groups; std::map<COutPoint,uint256>::iterator g; CBlock block; char destaddr[64]; uint256 groupid; Entry entry; int32_t h,i;
+        for (typename mapEntries::const_iterator it=entries.begin(); it!=entries.end(); it++)
+            groups[it->first.second] = it->first.first;
+        for (h=nHeight+1; h<=chainActive.Height(); h++)
+        {
+            if ( ReadBlockFromDisk(block,chainActive[h],false) == 0 )
+                return(false);
+            // what was read may already hold the block, spends and outputs are applied again the same way
+            BOOST_FOREACH(const CTransaction &tx,block.vtx)
+            {
+                BOOST_FOREACH(const CTxIn &vin,tx.vin)
+                {
+                    if ( (g= groups.find(vin.prevout)) != groups.end() )
+                    {
+                        entries.erase(std::make_pair(g->second,vin.prevout));
+                        groups.erase(g);
+                    }
+                }
+                for (i=0; i<tx.vout.size(); i++)
+                {
+                    if ( tx.vout[i].scriptPubKey.IsPayToCryptoCondition() == 0 || Getscriptaddress(destaddr,tx.vout[i].scriptPubKey) == 0 || strcmp(destaddr,coinaddr) != 0 )
+                        continue;
+                    if ( decode(tx,i,groupid,entry) != 0 )
+                    {
+                        entries[std::make_pair(groupid,COutPoint(tx.GetHash(),i))] = entry;
+                        groups[COutPoint(tx.GetHash(),i)] = groupid;
+                    }
+                }
+            }
+        }
+        return(true);
+    }
+
+    // adds coinaddr with the outputs Load read at the tip of nHeight, unless it was added meanwhile
+    CAddressEntries &Insert(const char *coinaddr,mapEntries &entries,int32_t nHeight,uint64_t nDisconnectsLoad)
+    {
+        typename std::map<std::string,CAddressEntries>::iterator a;
+        if ( (a= addresses.find(coinaddr)) != addresses.end() )
+        {
+            a->second.nLastQuery = ++nQueries;
+            return(a->second);
+        }
+        if ( nDisconnects != nDisconnectsLoad || Replay(coinaddr,nHeight,entries) == 0 )
+        {
+            entries.clear();
+            Load(coinaddr,entries);
+            nHeight = chainActive.Height();
+        }
+        while ( addresses.size() >= CC_INDEX_MAXADDRESSES )
+        {
+            typename std::map<std::string,CAddressEntries>::iterator oldest = addresses.begin();
+            for (a=addresses.begin(); a!=addresses.end(); a++)
+                if ( a->second.nLastQuery < oldest->second.nLastQuery )
+                    oldest = a;
+            Drop(oldest);
+        }
+        CAddressEntries &loaded = addresses[coinaddr];
+        loaded.nHeight = nHeight;   // the replayed blocks have no undo for it either
+        loaded.nLastQuery = ++nQueries;
+        for (typename mapEntries::const_iterator it=entries.begin(); it!=entries.end(); it++)
+            Add(coinaddr,it->first.first,it->first.second,it->second);
+        return(loaded);
+    }
+
+    void Add(const std::string &coinaddr,const uint256 &groupid,const COutPoint &outpoint,const Entry &entry)
+    {
+        addresses[coinaddr].entries[std::make_pair(groupid,outpoint)] = entry;
+        outpoints[outpoint] = std::make_pair(coinaddr,groupid);
+    }
+
+    void Remove(const COutPoint &outpoint)
+    {
+        typename std::map<COutPoint,std::pair<std::string,uint256> >::iterator it;
+        if ( (it= outpoints.find(outpoint)) == outpoints.end() )
+            return;
+        addresses[it->second.first].entries.erase(std::make_pair(it->second.second,outpoint));
+        outpoints.erase(it);
+    }
+
+    void Drop(typename std::map<std::string,CAddressEntries>::iterator a)
+    {
+        for (typename mapEntries::const_iterator it=a->second.entries.begin(); it!=a->second.entries.end(); it++)
+            outpoints.erase(it->first.second);
+        addresses.erase(a);
+    }
+};
+
+/*
+ The txs paying to an address that decode, spent or not, in the order of the height they were mined at. Used for the creation txs
+ a contract lists. These only come and go with their blocks, so a disconnect just removes the entries at its height and no undo is kept.
+*/
+template <class Entry>
+class CCTxidsIndex : public CCIndexBase
+{
+public:
+    // returns false for txs that are not indexed
+    typedef bool (*DecodeFunc)(const CTransaction &tx,Entry &entry);
+    typedef std::vector<std::pair<uint256,Entry> > vecEntries;
+
+    CCTxidsIndex(DecodeFunc decodeIn) : decode(decodeIn), nQueries(0), nDisconnects(0) { CCIndexRegister(this); }
+
+    // appends the txs paying to coinaddr mined from beginHeight to endHeight, 0 for no limit
+    void Get(const char *coinaddr,bool ccflag,int32_t beginHeight,int32_t endHeight,vecEntries &out)
+    {
+        std::pair<std::string,bool> key(coinaddr,ccflag); typename std::map<std::pair<std::string,bool>,CAddressTxids>::iterator a; mapEntries loaded; int32_t nHeight; uint64_t nDisconnectsLoad;
+        if ( KOMODO_NSPV_SUPERLITE )
+        {
+            Load(coinaddr,ccflag,loaded);
+            Select(loaded,beginHeight,endHeight,out);
+            return;
+        }
+        {
+            LOCK(cs_main);
+            if ( (a= addresses.find(key)) != addresses.end() )
+            {
+                a->second.nLastQuery = ++nQueries;
+                Select(a->second.entries,beginHeight,endHeight,out);
+                return;
+            }
+            nHeight = chainActive.Height();
+            nDisconnectsLoad = nDisconnects;
+        }
+        Load(coinaddr,ccflag,loaded);
+        LOCK(cs_main);
+        Select(Insert(key,loaded,nHeight,nDisconnectsLoad),beginHeight,endHeight,out);
+    }
+
+    void ConnectBlock(const CBlockIndex *pindex,const CBlock &block)
+    {
+        typename std::map<std::pair<std::string,bool>,CAddressTxids>::iterator a; char coinaddr[64]; Entry entry; int32_t i,decoded;
+        if ( addresses.empty() )
+            return;
+        BOOST_FOREACH(const CTransaction &tx,block.vtx)
+        {
+            for (i=decoded=0; i<tx.vout.size(); i++)
+            {
+                if ( Getscriptaddress(coinaddr,tx.vout[i].scriptPubKey) == 0 )
+                    continue;
+                if ( (a= addresses.find(std::make_pair(std::string(coinaddr),tx.vout[i].scriptPubKey.IsPayToCryptoCondition()))) == addresses.end() )
+                    continue;
+                if ( decoded == 0 )
+                    decoded = decode(tx,entry) != 0 ? 1 : -1;
+                if ( decoded > 0 )
+                    a->second.entries[std::make_pair(pindex->GetHeight(),tx.GetHash())] = entry;
+            }
+        }
+    }
+
+    void DisconnectBlock(const CBlockIndex *pindex,const CBlock &block)
+    {
+        typename std::map<std::pair<std::string,bool>,CAddressTxids>::iterator a;
+        nDisconnects++;
+        for (a=addresses.begin(); a!=addresses.end(); a++)
+            a->second.entries.erase(a->second.entries.lower_bound(std::make_pair(pindex->GetHeight(),uint256())),a->second.entries.end());
+    }
+
+private:
+    typedef std::map<std::pair<int32_t,uint256>,Entry> mapEntries;
+    struct CAddressTxids
+    {
+        uint64_t nLastQuery;
+        mapEntries entries;
+    };
+
+    DecodeFunc decode;
+    std::map<std::pair<std::string,bool>,CAddressTxids> addresses;
+    uint64_t nQueries,nDisconnects;
+
+    void Select(const mapEntries &entries,int32_t beginHeight,int32_t endHeight,vecEntries &out)
+    {
+        typename mapEntries::const_iterator it;
+        for (it=entries.lower_bound(std::make_pair(beginHeight,uint256())); it!=entries.end() && (endHeight <= 0 || it->first.first <= endHeight); it++)
+            out.push_back(std::make_pair(it->first.second,it->second));
+    }
+
+    void Load(const char *coinaddr,bool ccflag,mapEntries &entries)
+    {
+        std::vector<std::pair<CAddressIndexKey,CAmount> > addressIndex; CTransaction tx; uint256 hashBlock; Entry entry;
+        SetAddressIndexOutputs(addressIndex,(char *)coinaddr,ccflag);
+        for (std::vector<std::pair<CAddressIndexKey,CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
+        {
+            if ( it->first.spending != 0 || entries.count(std::make_pair((int32_t)it->first.blockHeight,it->first.txhash)) != 0 )
+                continue;
+            if ( myGetTransaction(it->first.txhash,tx,hashBlock) != 0 && decode(tx,entry) != 0 )
+                entries[std::make_pair((int32_t)it->first.blockHeight,it->first.txhash)] = entry;
+        }
+    }
+
+    // adds the txs paying to the address of key in the blocks connected after nHeight
+    bool Replay(const std::pair<std::string,bool> &key,int32_t nHeight,mapEntries &entries)
+    {
+        CBlock block; char destaddr[64]; Entry entry; int32_t h,i;
+        for (h=nHeight+1; h<=chainActive.Height(); h++)
+        {
+            if ( ReadBlockFromDisk(block,chainActive[h],false) == 0 )
+                return(false);
+            BOOST_FOREACH(const CTransaction &tx,block.vtx)
+            {
+                for (i=0; i<tx.vout.size(); i++)
+                {
+                    if ( Getscriptaddress(destaddr,tx.vout[i].scriptPubKey) == 0 || key.first != destaddr || tx.vout[i].scriptPubKey.IsPayToCryptoCondition() != key.second )
+                        continue;
+                    if ( decode(tx,entry) != 0 )
+                        entries[std::make_pair(h,tx.GetHash())] = entry;
+                    break;
+                }
+            }
+        }
+        return(true);
+    }
+
+    // adds the address of key with the txs Load read at the tip of nHeight, unless it was added meanwhile
+    mapEntries &Insert(const std::pair<std::string,bool> &key,mapEntries &entries,int32_t nHeight,uint64_t nDisconnectsLoad)
+    {
+        typename std::map<std::pair<std::string,bool>,CAddressTxids>::iterator a;
+        if ( (a= addresses.find(key)) != addresses.end() )
+        {
+            a->second.nLastQuery = ++nQueries;
+            return(a->second.entries);
+        }
+        if ( nDisconnects != nDisconnectsLoad || Replay(key,nHeight,entries) == 0 )
+        {
+            entries.clear();
+            Load(key.first.c_str(),key.second,entries);
+        }
+        while ( addresses.size() >= CC_INDEX_MAXADDRESSES )
+        {
+            typename std::map<std::pair<std::string,bool>,CAddressTxids>::iterator oldest = addresses.begin();
+            for (a=addresses.begin(); a!=addresses.end(); a++)
+                if ( a->second.nLastQuery < oldest->second.nLastQuery )
+                    oldest = a;
+            addresses.erase(oldest);
+        }
+        CAddressTxids &loaded = addresses[key];
+        loaded.nLastQuery = ++nQueries;
+        loaded.entries.swap(entries);
+        return(loaded.entries);
+    }
+};
+
+#endif
@@ -22,6 +22,7 @@
 
 #include "CCtokens_impl.h"
 #include "CCTokelData.h"
+#include "CCindex.h"
 
 
 thread_local uint32_t tokenValIndentSize = 0; // for debug logging
@@ -682,59 +683,110 @@ bool Tokensv2Validate(struct CCcontract_info *cp, Eval* eval, const CTransaction
 }
 
 
-UniValue TokenList()
+// token creation txs, found by their markers on the tokens global addresses
+struct CTokenCreation {
+    vscript_t origpubkey;
+    std::string origaddr;   // tokens cc address of origpubkey, for tokens v2 only
+};
+
+static bool DecodeTokenCreationV1(const CTransaction &tx, CTokenCreation &creation)
 {
-	UniValue result(UniValue::VARR);
-	std::vector<uint256> txids;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    std::string name, description;
+    std::vector<vscript_t> oprets;
 
-	struct CCcontract_info *cp, C; 
-	cp = CCinit(&C, EVAL_TOKENS);
+    creation.origaddr.clear();
+    return tx.vout.size() > 0 && DecodeTokenCreateOpRetV1(tx.vout.back().scriptPubKey, creation.origpubkey, name, description, oprets) != 0;
+}
 
-    auto addTokenId = [&](uint256 txid) {
-        CTransaction vintx; 
-        uint256 hashBlock;
-        std::vector<uint8_t> origpubkey;
-	    std::string name, description;
+static bool DecodeTokenCreationV2(const CTransaction &tx, CTokenCreation &creation)
+{
+    std::string name, description;
+    std::vector<vscript_t> oprets;
+    char origaddr[KOMODO_ADDRESS_BUFSIZE];
+
+    if (tx.vout.size() == 0 || DecodeTokenCreateOpRetV2(tx.vout.back().scriptPubKey, creation.origpubkey, name, description, oprets) == 0)
+        return false;
+    Getscriptaddress(origaddr, TokensV2::MakeCC1vout(EVAL_TOKENSV2, 0LL, pubkey2pk(creation.origpubkey)).scriptPubKey);
+    creation.origaddr = origaddr;
+    return true;
+}
 
-        if (myGetTransaction(txid, vintx, hashBlock) != false) 
-        {
-            LOCK(cs_main);
-            if (IsBlockHashInActiveChain(hashBlock))
-            {
-                std::vector<vscript_t>  oprets;
-                if (vintx.vout.size() > 0 && DecodeTokenCreateOpRetV1(vintx.vout.back().scriptPubKey, origpubkey, name, description, oprets) != 0) {
-                    result.push_back(txid.GetHex());
-                }
-                else {
-                    LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "DecodeTokenCreateOpRetV1 failed for txid=" << txid.GetHex() <<std::endl);
-                }
-            }
-        }
-    };
+static CCTxidsIndex<CTokenCreation> TokensCreations(DecodeTokenCreationV1);
+static CCTxidsIndex<CTokenCreation> TokensV2Creations(DecodeTokenCreationV2);
 
-	SetCCtxids(txids, cp->normaladdr, false, cp->evalcode, 0, zeroid, 'c');                      // find by old normal addr marker
-    LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "cp->normaladdr=" << cp->normaladdr << " SetCCtxids txids.size()=" << txids.size() << std::endl);
-   	for (std::vector<uint256>::const_iterator it = txids.begin(); it != txids.end(); it++) 	{
-        addTokenId(*it);
-	}
+// token outputs of the token addresses balances were asked for, grouped by tokenid, the creation tx outputs under its txid.
+// Only the outputs IsTokensvout accepts are kept, so a balance does not load the txs of every output each time
+template <class V>
+static bool DecodeTokenVout(const CTransaction &tx, int32_t vout, uint256 &tokenid, CAmount &nValue)
+{
+    std::vector<CPubKey> voutPubkeys;
+    std::vector<vscript_t> oprets;
+    uint8_t funcid;
+    struct CCcontract_info *cp, C;
+
+    if (tx.vout.size() == 0 || (funcid = V::DecodeTokenOpRet(tx.vout.back().scriptPubKey, tokenid, voutPubkeys, oprets)) == 0)
+        return false;
+    if (IsTokenCreateFuncid(funcid))
+        tokenid = tx.GetHash();
+    nValue = tx.vout[vout].nValue;
+    cp = CCinit(&C, V::EvalCode());
+    return nValue > 0 && IsTokensvout<V>(cp, NULL, tx, vout, tokenid) > 0;
+}
+
+static CCUnspentsIndex<CAmount> TokensVouts(DecodeTokenVout<TokensV1>);
+static CCUnspentsIndex<CAmount> TokensV2Vouts(DecodeTokenVout<TokensV2>);
 
-    SetCCunspents(unspentOutputs, cp->unspendableCCaddr, true);    // find by burnable validated cc addr marker
-    LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "cp->unspendableCCaddr=" << cp->unspendableCCaddr << " SetCCunspents unspentOutputs.size()=" << unspentOutputs.size() << std::endl);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = unspentOutputs.begin(); it != unspentOutputs.end(); it++) {
-        addTokenId(it->first.txhash);
+// sums the token outputs of tokenid on the token addresses of pk, outputs spent in the mempool are left out
+CAmount GetTokenBalanceIndexed(uint8_t evalcode, const CPubKey &pk, uint256 tokenid, bool usemempool)
+{
+    CCUnspentsIndex<CAmount> &vouts = evalcode == EVAL_TOKENSV2 ? TokensV2Vouts : TokensVouts;
+    std::vector<std::string> tokenindexkeys = evalcode == EVAL_TOKENSV2 ? GetTokenV2IndexKeys(pk) : GetTokenV1IndexKeys(pk);
+    CAmount balance = 0;
+    uint256 spenttxid;
+    int32_t spentvini;
+
+    for (const std::string &tokenindexkey : tokenindexkeys) {
+        CCUnspentsIndex<CAmount>::vecEntries outputs;
+        if (usemempool)
+            vouts.GetWithMempool(tokenindexkey.c_str(), tokenid, outputs);
+        else
+            vouts.Get(tokenindexkey.c_str(), tokenid, outputs);
+        for (const auto &o : outputs) {
+            if (usemempool || !myIsutxo_spentinmempool(spenttxid, spentvini, o.first.hash, o.first.n))
+                balance += o.second;
+        }
     }
+    return balance;
+}
+
+UniValue TokenList()
+{
+	UniValue result(UniValue::VARR);
+    CCTxidsIndex<CTokenCreation>::vecEntries creations;
+    std::set<uint256> tokenids;
+
+	struct CCcontract_info *cp, C; 
+	cp = CCinit(&C, EVAL_TOKENS);
 
+    TokensCreations.Get(cp->normaladdr, false, 0, 0, creations);            // find by old normal addr marker
+    TokensCreations.Get(cp->unspendableCCaddr, true, 0, 0, creations);      // find by burnable validated cc addr marker
+    LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "cp->normaladdr=" << cp->normaladdr << " cp->unspendableCCaddr=" << cp->unspendableCCaddr << " creations.size()=" << creations.size() << std::endl);
+    for (const auto &c : creations) {
+        if (tokenids.insert(c.first).second)
+            result.push_back(c.first.GetHex());
+    }
 	return(result);
 }
 
 UniValue TokenV2List(const UniValue &params)
 {
 	UniValue result(UniValue::VARR);
-    const bool CC_OUTPUTS_TRUE = true;
+    CCTxidsIndex<CTokenCreation>::vecEntries creations;
 
     int32_t beginHeight = 0;
     int32_t endHeight = 0;
+    int32_t skip = 0;
+    int32_t count = 0;
     CPubKey checkPK;
     std::string checkAddr;
     if (params.exists("beginHeight"))
@@ -745,99 +797,32 @@ UniValue TokenV2List(const UniValue &params)
         checkPK = pubkey2pk(ParseHex(params["pubkey"].getValStr().c_str()));
     if (params.exists("address"))
         checkAddr = params["address"].getValStr();
+    if (params.exists("skip"))
+        skip = atoi(params["skip"].getValStr().c_str());
+    if (params.exists("count"))
+        count = atoi(params["count"].getValStr().c_str());
 
 	struct CCcontract_info *cp, C; 
 	cp = CCinit(&C, EVAL_TOKENSV2);
 
-    auto addTokenId = [&](uint256 tokenid, const CScript &opreturn) {
-        vscript_t origpubkey;
-	    std::string name, description;
-        std::vector<vscript_t>  oprets;
-
-        if (DecodeTokenCreateOpRetV2(opreturn, origpubkey, name, description, oprets) != 0) {
-            if (checkPK.IsValid()) { 
-                if (checkPK == pubkey2pk(origpubkey))
-                    result.push_back(tokenid.GetHex());
-            }
-            else if (!checkAddr.empty())  {
-                char origaddr[KOMODO_ADDRESS_BUFSIZE];
-                Getscriptaddress(origaddr, TokensV2::MakeCC1vout(EVAL_TOKENSV2, 0LL, pubkey2pk(origpubkey)).scriptPubKey);
-                if (checkAddr == origaddr)
-                    result.push_back(tokenid.GetHex());
-            }
-            else 
-                result.push_back(tokenid.GetHex());
-        }
-        else {
-            LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "DecodeTokenCreateOpRetV2 failed for tokenid=" << tokenid.GetHex() << " opreturn.size=" << opreturn.size() << std::endl);
+    // the index follows the active chain so orphaned creation txs are not there
+    TokensV2Creations.Get(cp->unspendableCCaddr, true, beginHeight, endHeight, creations);    // find by burnable validated cc addr marker
+    LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << " cp->unspendableCCaddr=" << cp->unspendableCCaddr << " creations.size()=" << creations.size() << std::endl);
+    for (const auto &c : creations) {
+        if (checkPK.IsValid()) {
+            if (checkPK != pubkey2pk(c.second.origpubkey))
+                continue;
         }
-    };
-
-    if (beginHeight > 0 || endHeight > 0)    {
-        if (endHeight <= 0) {
-            LOCK(cs_main);
-            endHeight = chainActive.Height();
+        else if (!checkAddr.empty() && checkAddr != c.second.origaddr)
+            continue;
+        if (skip > 0) {
+            skip --;
+            continue;
         }
-        std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndexOutputs;
-        SetAddressIndexOutputs(addressIndexOutputs, cp->unspendableCCaddr, CC_OUTPUTS_TRUE, beginHeight, endHeight);
-        LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << "SetAddressIndexOutputs addressIndexOutputs.size()=" << addressIndexOutputs.size() << std::endl);
-            for (const auto &it : addressIndexOutputs) {
-                CTransaction creationtx;
-                uint256 hashBlock;
-                if (!it.first.spending &&
-                    myGetTransaction(it.first.txhash, creationtx, hashBlock) && creationtx.vout.size() > 0)
-                {
-                    bool isBlockHashInActiveChain = false;
-                    {
-                        LOCK(cs_main);
-                        isBlockHashInActiveChain = IsBlockHashInActiveChain(hashBlock);
-                    }
-                    if (isBlockHashInActiveChain)
-                        addTokenId(it.first.txhash, creationtx.vout.back().scriptPubKey);    
-                }
-            }
+        if (count > 0 && (int32_t)result.size() >= count)
+            break;
+        result.push_back(c.first.GetHex());
     }
-    else
-    {
-        if (fUnspentCCIndex)
-        {
-            std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > unspentOutputs;
-
-            SetCCunspentsCCIndex(unspentOutputs, cp->unspendableCCaddr, zeroid);    // find by burnable validated cc addr marker
-            LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << " cp->unspendableCCaddr=" << cp->unspendableCCaddr << " SetCCunspentsCCIndex unspentOutputs.size()=" << unspentOutputs.size() << std::endl);
-            for (const auto &it : unspentOutputs) {
-                bool isTxidInActiveChain = false;
-                {
-                    LOCK(cs_main);
-                    isTxidInActiveChain = IsTxidInActiveChain(it.first.creationid);
-                }
-                if (isTxidInActiveChain)
-                    addTokenId(it.first.creationid, it.second.opreturn);
-            }
-        }
-        else
-        {
-            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-
-            SetCCunspents(unspentOutputs, cp->unspendableCCaddr, CC_OUTPUTS_TRUE);
-            LOGSTREAMFN(cctokens_log, CCLOG_DEBUG1, stream << " cp->unspendableCCaddr=" << cp->unspendableCCaddr << " SetCCunspents unspentOutputs.size()=" << unspentOutputs.size() << std::endl);    
-            for (const auto &it : unspentOutputs) {
-                CTransaction creationtx;
-                uint256 hashBlock;
-                if (myGetTransaction(it.first.txhash, creationtx, hashBlock) && creationtx.vout.size() > 0)
-                {
-                    bool isBlockHashInActiveChain = false;
-                    {
-                        LOCK(cs_main);
-                        isBlockHashInActiveChain = IsBlockHashInActiveChain(hashBlock);
-                    }
-                    if (isBlockHashInActiveChain)
-                        addTokenId(it.first.txhash, creationtx.vout.back().scriptPubKey);    
-                }
-            }
-        }
-    }
-
 	return(result);
 }
 
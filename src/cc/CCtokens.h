@@ -281,6 +281,8 @@ CTxOut MakeTokensCCMofNDestVoutMixed(uint8_t evalcode1, uint8_t evalcode2, CAmou
 
 UniValue TokenList();
 UniValue TokenV2List(const UniValue &params);
+/// @private 
+CAmount GetTokenBalanceIndexed(uint8_t evalcode, const CPubKey &pk, uint256 tokenid, bool usemempool);
 
 /// @private 
 std::vector<std::string> GetTokenV1IndexKeys(const CPubKey &pk);
@@ -569,7 +569,6 @@ template <class V>
 CAmount GetTokenBalance(CPubKey pk, uint256 tokenid, bool usemempool)
 {
 	uint256 hashBlock;
-	CMutableTransaction mtx = CreateNewContextualCMutableTransaction(Params().GetConsensus(), komodo_nextheight());
 	CTransaction tokentx;
     uint256 tokenidInOpret;
     std::vector<CPubKey> pks;
@@ -592,9 +591,7 @@ CAmount GetTokenBalance(CPubKey pk, uint256 tokenid, bool usemempool)
         return 0;
     }
 
-	struct CCcontract_info *cp, C;
-	cp = CCinit(&C, V::EvalCode());
-	return(AddTokenCCInputs<V>(cp, mtx, pk, tokenid, 0, 0, usemempool));
+    return(GetTokenBalanceIndexed(V::EvalCode(), pk, tokenid, usemempool));
 }
 
 template <class V>
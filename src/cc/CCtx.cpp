@@ -15,6 +15,7 @@
 
 #include "CCinclude.h"
 #include "CCtokens.h"
+#include "CCindex.h"
 #include "key_io.h"
 
 std::vector<CPubKey> NULL_pubkeys;
@@ -992,53 +993,51 @@ int64_t CCfullsupplyV2(uint256 tokenid)
     return(0);
 }
 
+// token outputs of the addresses balances were asked for, grouped by tokenid, the creation tx outputs are grouped under its txid
+static bool DecodeTokenBalanceV1(const CTransaction &tx,int32_t vout,uint256 &tokenid,int64_t &nValue)
+{
+    std::vector<CPubKey> voutTokenPubkeys; std::vector<vscript_t> oprets; uint8_t funcid;
+    if ( (funcid= DecodeTokenOpRetV1(tx.vout.back().scriptPubKey,tokenid,voutTokenPubkeys,oprets)) == 0 || funcid == 'c' )
+        tokenid = tx.GetHash();
+    nValue = tx.vout[vout].nValue;
+    return(true);
+}
+
+static bool DecodeTokenBalanceV2(const CTransaction &tx,int32_t vout,uint256 &tokenid,int64_t &nValue)
+{
+    std::vector<CPubKey> voutTokenPubkeys; std::vector<vscript_t> oprets; uint8_t funcid; struct CCcontract_info *cp,C;
+    cp = CCinit(&C,EVAL_TOKENSV2);
+    if ( IsTxCCV2(cp,tx) == 0 )
+        return(false);
+    if ( (funcid= TokensV2::DecodeTokenOpRet(tx.vout.back().scriptPubKey,tokenid,voutTokenPubkeys,oprets)) == 0 || funcid == 'c' )
+        tokenid = tx.GetHash();
+    nValue = tx.vout[vout].nValue;
+    return(true);
+}
+
+static CCUnspentsIndex<int64_t> TokensBalances(DecodeTokenBalanceV1);
+static CCUnspentsIndex<int64_t> TokensV2Balances(DecodeTokenBalanceV2);
+
 // TODO: remove this func or add IsTokenVout check (in other places just AddTokenCCInputs is used instead, maybe make it to do the job here)
 int64_t CCtoken_balance(char *coinaddr,uint256 reftokenid)
 {
-    int64_t price,sum = 0; int32_t numvouts; CTransaction tx; uint256 tokenid,txid,hashBlock; 
-	std::vector<uint8_t>  vopretExtra;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
-    {
-        txid = it->first.txhash;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size()) > 0 )
-        {
-            char str[65];
-			std::vector<CPubKey> voutTokenPubkeys;
-            std::vector<vscript_t>  oprets;
-            if ( reftokenid==txid || (DecodeTokenOpRetV1(tx.vout[numvouts-1].scriptPubKey, tokenid, voutTokenPubkeys, oprets) != 0 && reftokenid == tokenid))
-            {
-                sum += it->second.satoshis;
-            }
-        }
-    }
+    int64_t sum = 0; CCUnspentsIndex<int64_t>::vecEntries outputs;
+    if ( reftokenid.IsNull() )
+        return(0);
+    TokensBalances.Get(coinaddr,reftokenid,outputs);
+    for (CCUnspentsIndex<int64_t>::vecEntries::const_iterator it=outputs.begin(); it!=outputs.end(); it++)
+        sum += it->second;
     return(sum);
 }
 
 int64_t CCtoken_balanceV2(char *coinaddr,uint256 reftokenid)
 {
-    int64_t price,sum = 0; int32_t numvouts; CTransaction tx; uint256 tokenid,txid,hashBlock; 
-	std::vector<uint8_t>  vopretExtra; std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    struct CCcontract_info *cp,C;
-
-    cp = CCinit(&C,EVAL_TOKENSV2);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
-    {
-        txid = it->first.txhash;
-        if ( myGetTransactionCCV2(cp,txid,tx,hashBlock) != 0 )
-        {
-            char str[65];
-			std::vector<CPubKey> voutTokenPubkeys;
-            std::vector<vscript_t>  oprets;
-            if ( reftokenid==txid || (TokensV2::DecodeTokenOpRet(tx.vout[tx.vout.size()-1].scriptPubKey, tokenid, voutTokenPubkeys, oprets) != 0 && reftokenid == tokenid))
-            {
-                sum += it->second.satoshis;
-            }
-        }
-    }
+    int64_t sum = 0; CCUnspentsIndex<int64_t>::vecEntries outputs;
+    if ( reftokenid.IsNull() )
+        return(0);
+    TokensV2Balances.Get(coinaddr,reftokenid,outputs);
+    for (CCUnspentsIndex<int64_t>::vecEntries::const_iterator it=outputs.begin(); it!=outputs.end(); it++)
+        sum += it->second;
     return(sum);
 }
 
@@ -1148,52 +1147,55 @@ CAmount AddNormalinputsLocal(CMutableTransaction& mtx, CPubKey mypk, CAmount tot
     const CKeyStore& keystore = *pwalletMain;
     LOCK2(cs_main, pwalletMain->cs_wallet);
     int64_t txLockTime = (int64_t)komodo_next_tx_locktime();
-    pwalletMain->AvailableCoins(vecOutputs, false, NULL, true, txLockTime);
     utxos = (struct CC_utxo*)calloc(CC_MAXVINS, sizeof(*utxos));
     if (maxinputs > CC_MAXVINS)
         maxinputs = CC_MAXVINS;
-    /*if (maxinputs > 0)
-        threshold = total / maxinputs;
-    else
-        threshold = total;*/
-
-
-    //TokelRemoveTimeLockedCoins(vecOutputs, txLockTime);
 
     sum = 0LL;
-    BOOST_FOREACH (const COutput& out, vecOutputs) {
-        if (out.fSpendable != 0 && (vecOutputs.size() < maxinputs || out.tx->vout[out.i].nValue > 0LL)) {  // threshold not used as may lead to insufficient inputs messages
-            txid = out.tx->GetHash();
-            vout = out.i;
-            if (myGetTransaction(txid, tx, hashBlock) != false && tx.vout.size() > 0 && vout < tx.vout.size() && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() == 0) 
-            {
-                {
-                    LOCK(cs_main);
-                    if (CoinbaseGetBlocksToMaturity(tx, hashBlock) > 0) {
-                        //std::cerr << __func__ << " skipping immature coinbase tx=" << txid.GetHex() << " COINBASE_MATURITY=" << COINBASE_MATURITY << std::endl;
-                        continue;
-                    }
-                }
-                //fprintf(stderr,"check %.8f to vins array.%d of %d %s/v%d\n",(double)out.tx->vout[out.i].nValue/COIN,n,maxutxos,txid.GetHex().c_str(),(int32_t)vout);
-                if (mtx.vin.size() > 0) {
-                    if (std::find_if(mtx.vin.begin(), mtx.vin.end(), [&](const CTxIn &vin){ return vin.prevout.hash == txid && vin.prevout.n == vout; }) != mtx.vin.end())  
-                        continue; //already added
-                }
-                if (n > 0) {
-                    if (std::find_if(utxos, utxos+n, [&](const CC_utxo &utxo){ return utxo.txid == txid && utxo.vout == vout; }) != utxos+n)  
-                        continue; //already added
-                }
-                if (myIsutxo_spentinmempool(ignoretxid, ignorevin, txid, vout) == 0) {
-                    up = &utxos[n++];
-                    up->txid = txid;
-                    up->nValue = out.tx->vout[out.i].nValue;
-                    up->vout = vout;
-                    sum += up->nValue;
-                    //fprintf(stderr,"add %.8f to vins array.%d of %d\n",(double)up->nValue/COIN,n,maxutxos);
-                    if (n >= maxinputs || sum >= total)
-                        break;
-                }
-            }
+    auto addutxo = [&](const COutPoint& outpoint) -> bool {
+        std::map<uint256, CWalletTx>::const_iterator mit = pwalletMain->mapWallet.find(outpoint.hash);
+        vecOutputs.clear();
+        if (mit == pwalletMain->mapWallet.end() || !pwalletMain->AddAvailableCoin(vecOutputs, &mit->second, outpoint.n, false, NULL, false, true, txLockTime))
+            return false;
+        const COutput& out = vecOutputs.back();
+        if (out.fSpendable == 0)
+            return false;
+        txid = out.tx->GetHash();
+        vout = out.i;
+        if (myGetTransaction(txid, tx, hashBlock) == false || tx.vout.size() == 0 || vout >= tx.vout.size() || tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0)
+            return false;
+        if (CoinbaseGetBlocksToMaturity(tx, hashBlock) > 0) {
+            //std::cerr << __func__ << " skipping immature coinbase tx=" << txid.GetHex() << " COINBASE_MATURITY=" << COINBASE_MATURITY << std::endl;
+            return false;
+        }
+        if (std::find_if(mtx.vin.begin(), mtx.vin.end(), [&](const CTxIn &vin){ return vin.prevout.hash == txid && vin.prevout.n == vout; }) != mtx.vin.end())
+            return false; //already added
+        if (myIsutxo_spentinmempool(ignoretxid, ignorevin, txid, vout) != 0)
+            return false;
+        up = &utxos[n++];
+        up->txid = txid;
+        up->nValue = out.tx->vout[out.i].nValue;
+        up->vout = vout;
+        sum += up->nValue;
+        //fprintf(stderr,"add %.8f to vins array.%d of %d\n",(double)up->nValue/COIN,n,maxutxos);
+        return true;
+    };
+
+    // walk the wallet coins by value instead of listing them all: the maxinputs largest ones below total
+    // first, if they do not add up drop them for the smallest one covering total alone.
+    // zero value outputs are not taken, they cannot add to totalinputs
+    const CoinsByValue& coins = pwalletMain->GetCoinsByValue();
+    CoinsByValue::const_iterator itabove = coins.lower_bound(std::make_pair(total, COutPoint(uint256(), 0)));
+    for (CoinsByValue::const_reverse_iterator it(itabove); it != coins.rend() && it->first > 0 && n < maxinputs && sum < total; ++it)
+        addutxo(it->second);
+    if (sum < total)
+    {
+        n = 0;
+        sum = 0;
+        for (CoinsByValue::const_iterator it = itabove; it != coins.end(); ++it)
+        {
+            if (addutxo(it->second))
+                break;
         }
     }
     remains = total;
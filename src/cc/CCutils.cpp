@@ -1498,9 +1498,12 @@ UniValue CCaddress(struct CCcontract_info *cp, const char *name, const std::vect
 // decode cc transaction:
 // try to find cc data in vout's opdrop or in the last vout opreturn
 // return funcid, version and creationid
+// returns false if there is no cc data or its evalcode is not known
 bool CCDecodeTxVout(const CTransaction &tx, int32_t n, uint8_t &evalcode, uint8_t &funcid, uint8_t &version, uint256 &creationId)
 {
-    if (tx.vout.size() > 0)     
+    evalcode = funcid = version = 0;
+    creationId.SetNull();
+    if (n >= 0 && n < tx.vout.size())     
     {
         // note: assumes that this is a cc vout (does not check this)
 
@@ -1522,34 +1525,37 @@ bool CCDecodeTxVout(const CTransaction &tx, int32_t n, uint8_t &evalcode, uint8_
         // get the evalcode from ccdata
         // if no cc vins found with this evalcode this is the creation tx and creationId = tx.GetHash()
         // else the creationId is after the version field: 'evalcode funcid version creationId'
-        if (vccdata.size() >= 3)  {
-            struct CCcontract_info *cp, C; 
-            cp = CCinit(&C, vccdata[0]);
-            int32_t i = 0;
-            for (; i < tx.vin.size(); i ++)
-                if (cp->ismyvin(tx.vin[i].scriptSig))
-                    break;
-            if (i == tx.vin.size()) 
-            {
-                creationId = tx.GetHash(); // tx is the creation tx
-                evalcode = vccdata[0];
-                funcid = vccdata[1];
-                version = vccdata[2];
-                LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << " evalcode=" << (int)evalcode << " funcid=" << (char)funcid << "(" << (int)funcid << "), version=" << (int)version << std::endl); 
-            }
-            else
-            {
-                uint256 encodedCrid;
-                if (vccdata.size() >= 3 + sizeof(uint256))   {  // get creationId from the ccdata
-                    bool isEof = true;
-                    if (!E_UNMARSHAL(vccdata, ss >> evalcode; ss >> funcid; ss >> version; ss >> encodedCrid; isEof = ss.eof()) && isEof) {  // E_UNMARSHAL might parse okay but return false if not EoF yet. So EoF==true means bad parse
-                        LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << "failed to decode ccdata, isEof=" << isEof << " usedOpreturn=" << usedOpreturn << " tx=" << HexStr(E_MARSHAL(ss << tx)) << std::endl);
-                        return false;
-                    }
+        if (vccdata.size() < 3)
+            return false;
+        struct CCcontract_info *cp, C; 
+        if ((cp = CCinit(&C, vccdata[0])) == 0)  {
+            LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << "unknown evalcode=" << (int)vccdata[0] << " tx=" << tx.GetHash().GetHex() << std::endl);
+            return false;
+        }
+        evalcode = vccdata[0];
+        funcid = vccdata[1];
+        version = vccdata[2];
+        int32_t i = 0;
+        for (; i < tx.vin.size(); i ++)
+            if (cp->ismyvin(tx.vin[i].scriptSig))
+                break;
+        if (i == tx.vin.size()) 
+        {
+            creationId = tx.GetHash(); // tx is the creation tx
+            LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << " evalcode=" << (int)evalcode << " funcid=" << (char)funcid << "(" << (int)funcid << "), version=" << (int)version << std::endl); 
+        }
+        else
+        {
+            uint256 encodedCrid;
+            if (vccdata.size() >= 3 + sizeof(uint256))   {  // get creationId from the ccdata
+                bool isEof = true;
+                if (!E_UNMARSHAL(vccdata, ss >> evalcode; ss >> funcid; ss >> version; ss >> encodedCrid; isEof = ss.eof()) && isEof) {  // E_UNMARSHAL might parse okay but return false if not EoF yet. So EoF==true means bad parse
+                    LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << "failed to decode ccdata, isEof=" << isEof << " usedOpreturn=" << usedOpreturn << " tx=" << HexStr(E_MARSHAL(ss << tx)) << std::endl);
+                    return false;
                 }
-                creationId = revuint256(encodedCrid);
-                LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << " evalcode=" << (int)evalcode << " funcid=" << (char)funcid << "(" << (int)funcid << "), version=" << (int)version << " in opret found creationid=" << creationId.GetHex() << std::endl);
             }
+            creationId = revuint256(encodedCrid);
+            LOGSTREAMFN("ccutils", CCLOG_DEBUG1, stream << " evalcode=" << (int)evalcode << " funcid=" << (char)funcid << "(" << (int)funcid << "), version=" << (int)version << " in opret found creationid=" << creationId.GetHex() << std::endl);
         }
         return true;
     }
@@ -16,6 +16,7 @@
 #include "CCtokens.h"
 #include "CCtokens_impl.h"
 #include "CCchannels.h"
+#include "CCindex.h"
 
 /*
  The idea here is to allow instant (mempool) payments that are secured by dPoW. In order to simplify things, channels CC will require creating reserves for each payee locked in the destination user's CC address. This will look like the payment is already made, but it is locked until further released. The dPoW protection comes from the cancel channel having a delayed effect until the next notarization. This way, if a payment release is made and the chain reorged, the same payment release will still be valid when it is re-broadcast into the mempool.
@@ -396,10 +397,68 @@ bool ChannelsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
 
 // helper functions for rpc calls in rpcwallet.cpp
 
-int64_t AddChannelsInputs(struct CCcontract_info *cp,CMutableTransaction &mtx, CTransaction openTx, uint256 &prevtxid, CPubKey mypk)
+// channel funds on the channel 1of2 CC address, grouped by channel open txid. Each open, payment and close
+// leaves a single vout.0 there, so the unspent one is the channel state
+struct CChannelState
 {
-    char coinaddr[65]; int64_t param2,totalinputs = 0,numvouts; uint256 txid=zeroid,tmp_txid,hashBlock,param3,tokenid; CTransaction tx; int32_t marker,param1;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    uint8_t funcid;
+    int32_t depth; // payments left in the hashchain, funds/payment for a close
+    int64_t nValue;
+    CPubKey srcpub,destpub;
+    bool srcmarker,destmarker; // vout.1 and vout.2 are the markers of srcpub and destpub
+};
+
+static bool DecodeChannelState(const CTransaction &tx,int32_t vout,uint256 &opentxid,CChannelState &state)
+{
+    struct CCcontract_info *cp,C; uint256 tokenid,param3; int64_t param2; int32_t numvouts;
+
+    if ( vout != 0 || (numvouts=tx.vout.size()) < 3 || (state.funcid=DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,opentxid,state.srcpub,state.destpub,state.depth,param2,param3)) == 0 )
+        return(false);
+    if ( state.funcid == 'O' )
+        opentxid = tx.GetHash();
+    cp = CCinit(&C,EVAL_CHANNELS);
+    state.nValue = IsChannelsvout(cp,tx,state.srcpub,state.destpub,0);
+    state.srcmarker = IsChannelsMarkervout(cp,tx,state.srcpub,1) > 0;
+    state.destmarker = IsChannelsMarkervout(cp,tx,state.destpub,2) > 0;
+    return(state.nValue > 0);
+}
+
+static CCUnspentsIndex<CChannelState> ChannelStates(DecodeChannelState);
+
+// channel txs on the CC addresses of its parties, where the markers go
+struct CChannelTx
+{
+    uint8_t funcid;
+    uint256 opentxid;
+    CPubKey destpub;
+    int32_t param1;
+    int64_t param2;
+    uint256 param3;
+    std::string destaddr; // payee of a payment or refund
+};
+
+static bool DecodeChannelTx(const CTransaction &tx,CChannelTx &chtx)
+{
+    CPubKey srcpub; uint256 tokenid; int32_t numvouts; char str[65];
+
+    if ( (numvouts=tx.vout.size()) < 1 || (chtx.funcid=DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,chtx.opentxid,srcpub,chtx.destpub,chtx.param1,chtx.param2,chtx.param3)) == 0 )
+        return(false);
+    if ( chtx.funcid == 'O' )
+        chtx.opentxid = tx.GetHash();
+    chtx.destaddr.clear();
+    if ( chtx.funcid == 'P' && numvouts > 4 && Getscriptaddress(str,tx.vout[3].scriptPubKey) != 0 )
+        chtx.destaddr = str;
+    else if ( chtx.funcid == 'R' && numvouts > 3 && Getscriptaddress(str,tx.vout[2].scriptPubKey) != 0 )
+        chtx.destaddr = str;
+    return(true);
+}
+
+static CCTxidsIndex<CChannelTx> ChannelTxs(DecodeChannelTx);
+
+int64_t AddChannelsInputs(struct CCcontract_info *cp,CMutableTransaction &mtx, CTransaction openTx, uint256 &prevtxid, CChannelState &prevstate, CPubKey mypk)
+{
+    char coinaddr[65]; int64_t param2; uint256 txid=zeroid,tmp_txid,param3,tokenid; int32_t marker,param1,numvouts;
+    CCUnspentsIndex<CChannelState>::vecEntries states;
     CPubKey srcpub,destpub;
     uint8_t myprivkey[32];    
 
@@ -407,7 +466,7 @@ int64_t AddChannelsInputs(struct CCcontract_info *cp,CMutableTransaction &mtx, C
     {
         if (tokenid!=zeroid) GetTokensCCaddress1of2(cp,coinaddr,srcpub,destpub);
         else GetCCaddress1of2(cp,coinaddr,srcpub,destpub);
-        SetCCunspents(unspentOutputs,coinaddr,true);
+        ChannelStates.GetWithMempool(coinaddr,openTx.GetHash(),states);
     }
     else
     {
@@ -416,37 +475,14 @@ int64_t AddChannelsInputs(struct CCcontract_info *cp,CMutableTransaction &mtx, C
     }
     if (srcpub==mypk) marker=1;
     else marker=2;
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    // the mempool can hold payments the confirmed state no longer shows as unspent, the deepest one is the latest
+    for (CCUnspentsIndex<CChannelState>::vecEntries::const_iterator it=states.begin(); it!=states.end(); it++)
     {
-        if ( (int32_t)it->first.index==0 && myGetTransaction(it->first.txhash,tx,hashBlock) != 0 && (numvouts=tx.vout.size()) > 0)
+        const CChannelState &state = it->second;
+        if (state.srcpub==srcpub && state.destpub==destpub && (marker==1?state.srcmarker:state.destmarker) && (txid==zeroid || state.depth < prevstate.depth))
         {
-            if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3)!=0 &&
-              (tmp_txid==openTx.GetHash() || tx.GetHash()==openTx.GetHash()) && IsChannelsMarkervout(cp,tx,marker==1?srcpub:destpub,marker)>0 &&
-              (totalinputs=IsChannelsvout(cp,tx,srcpub,destpub,0))>0)
-            {
-                txid = it->first.txhash;
-                break;
-            }
-        }
-    }
-    if (txid!=zeroid && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,0) != 0)
-    {
-        txid=zeroid;
-        int32_t mindepth=CHANNELS_MAXPAYMENTS;
-        std::vector<CTransaction> tmp_txs;
-        myGet_mempool_txs(tmp_txs,EVAL_CHANNELS,'P');
-        for (std::vector<CTransaction>::const_iterator it=tmp_txs.begin(); it!=tmp_txs.end(); it++)
-        {
-            const CTransaction &txmempool = *it;
-            const uint256 &hash = txmempool.GetHash();
-
-            if ((numvouts=txmempool.vout.size()) > 0 && DecodeChannelsOpRet(txmempool.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3)=='P' &&
-              tmp_txid==openTx.GetHash() && param1 < mindepth)
-            {
-                txid=hash;
-                totalinputs=txmempool.vout[0].nValue;
-                mindepth=param1;
-            }
+            txid = it->first.hash;
+            prevstate = state;
         }
     }
     if (txid != zeroid)
@@ -458,7 +494,7 @@ int64_t AddChannelsInputs(struct CCcontract_info *cp,CMutableTransaction &mtx, C
         if (tokenid!=zeroid) CCaddrTokens1of2set(cp,srcpub,destpub,myprivkey,coinaddr);
         else CCaddr1of2set(cp,srcpub,destpub,myprivkey,coinaddr);
         memset(myprivkey,0,32);
-        return totalinputs;
+        return prevstate.nValue;
     }
     else return 0;
 }
@@ -512,11 +548,11 @@ UniValue ChannelOpen(const CPubKey& pk, uint64_t txfee,CPubKey destpub,int32_t n
 UniValue ChannelPayment(const CPubKey& pk, uint64_t txfee,uint256 opentxid,int64_t amount, uint256 secret)
 {
     CMutableTransaction mtx = CreateNewContextualCMutableTransaction(Params().GetConsensus(), komodo_nextheight());
-    CPubKey mypk,srcpub,destpub; uint256 txid,hashchain,gensecret,hashblock,entropy,hentropy,prevtxid,param3,tokenid;
-    struct CCcontract_info *cp,C; int32_t i,funcid,prevdepth,numvouts,numpayments,totalnumpayments;
-    int64_t payment,change,funds,param2;
+    CPubKey mypk,srcpub,destpub; uint256 txid,hashchain,gensecret,hashblock,entropy,hentropy,prevtxid,tokenid;
+    struct CCcontract_info *cp,C; int32_t i,prevdepth,numvouts,numpayments,totalnumpayments;
+    int64_t payment,change,funds;
     uint8_t hash[32],hashdest[32];
-    CTransaction channelOpenTx,prevTx;
+    CTransaction channelOpenTx; CChannelState prevstate;
 
     cp = CCinit(&C,EVAL_CHANNELS);
     if ( txfee == 0 )
@@ -539,12 +575,11 @@ UniValue ChannelPayment(const CPubKey& pk, uint64_t txfee,uint256 opentxid,int64
     if (komodo_txnotarizedconfirmed(opentxid)==false) CCERR_RESULT("channelscc",CCLOG_INFO, stream << "channelsopen tx not yet confirmed/notarized");
     if (AddNormalinputs(mtx,mypk,txfee+CC_MARKER_VALUE,3,pk.IsValid()) > 0)
     {
-        if ((funds=AddChannelsInputs(cp,mtx,channelOpenTx,prevtxid,mypk)) !=0 && (change=funds-amount)>=0)
+        if ((funds=AddChannelsInputs(cp,mtx,channelOpenTx,prevtxid,prevstate,mypk)) !=0 && (change=funds-amount)>=0)
         {            
             numpayments=amount/payment;
-            if (myGetTransaction(prevtxid,prevTx,hashblock) != 0 && (numvouts=prevTx.vout.size()) > 0 &&
-                ((funcid = DecodeChannelsOpRet(prevTx.vout[numvouts-1].scriptPubKey, tokenid, txid, srcpub, destpub, prevdepth, param2, param3)) != 0) &&
-                (funcid == 'P' || funcid=='O'))
+            prevdepth=prevstate.depth;
+            if (prevstate.funcid == 'P' || prevstate.funcid=='O')
             {
                 if (numpayments > prevdepth)
                     CCERR_RESULT("channelscc",CCLOG_INFO, stream << "not enough funds in channel for that amount");
@@ -601,6 +636,7 @@ UniValue ChannelClose(const CPubKey& pk, uint64_t txfee,uint256 opentxid)
     uint256 hashblock,tmp_txid,prevtxid,hashchain,tokenid;
     int32_t numvouts,numpayments;
     int64_t payment,funds;
+    CChannelState prevstate;
 
     // verify this is one of our outbound channels
     cp = CCinit(&C,EVAL_CHANNELS);
@@ -617,7 +653,7 @@ UniValue ChannelClose(const CPubKey& pk, uint64_t txfee,uint256 opentxid)
         CCERR_RESULT("channelscc",CCLOG_INFO, stream << "cannot close, you are not channel owner");
     if ( AddNormalinputs(mtx,mypk,txfee+CC_MARKER_VALUE,3,pk.IsValid()) > 0 )
     {
-        if ((funds=AddChannelsInputs(cp,mtx,channelOpenTx,prevtxid,mypk)) !=0 && funds>0)
+        if ((funds=AddChannelsInputs(cp,mtx,channelOpenTx,prevtxid,prevstate,mypk)) !=0 && funds>0)
         {
             if (tokenid!=zeroid) mtx.vout.push_back(MakeTokensCC1of2vout(EVAL_CHANNELS, funds, mypk, destpub));
             else mtx.vout.push_back(MakeCC1of2vout(EVAL_CHANNELS, funds, mypk, destpub));
@@ -637,8 +673,8 @@ UniValue ChannelRefund(const CPubKey& pk, uint64_t txfee,uint256 opentxid,uint25
     CPubKey mypk; struct CCcontract_info *cp,C; int64_t funds,payment,param2;
     int32_t i,numpayments,numvouts,param1;
     uint256 hashchain,hashblock,txid,prevtxid,param3,tokenid;
-    CTransaction channelOpenTx,channelCloseTx,prevTx;
-    CPubKey srcpub,destpub;
+    CTransaction channelOpenTx,channelCloseTx;
+    CPubKey srcpub,destpub; CChannelState prevstate;
 
     // verify stoptxid and origtxid match and are mine
     cp = CCinit(&C,EVAL_CHANNELS);
@@ -663,19 +699,13 @@ UniValue ChannelRefund(const CPubKey& pk, uint64_t txfee,uint256 opentxid,uint25
         CCERR_RESULT("channelscc",CCLOG_INFO, stream << "cannot refund, you are not the channel owner");
     if ( AddNormalinputs(mtx,mypk,txfee+CC_MARKER_VALUE,3,pk.IsValid()) > 0 )
     {
-        if ((funds=AddChannelsInputs(cp,mtx,channelOpenTx,prevtxid,mypk)) !=0 && funds>0)
+        if ((funds=AddChannelsInputs(cp,mtx,channelOpenTx,prevtxid,prevstate,mypk)) !=0 && funds>0)
         {
-            if ((myGetTransaction(prevtxid,prevTx,hashblock) != 0) && (numvouts=prevTx.vout.size()) > 0 &&
-                DecodeChannelsOpRet(prevTx.vout[numvouts-1].scriptPubKey, tokenid, txid, srcpub, destpub, param1, param2, param3) != 0)
-            {
-                mtx.vout.push_back(MakeCC1vout(EVAL_CHANNELS,CC_MARKER_VALUE,mypk));
-                mtx.vout.push_back(MakeCC1vout(EVAL_CHANNELS,CC_MARKER_VALUE,destpub));
-                if (tokenid!=zeroid) mtx.vout.push_back(MakeCC1vout(EVAL_TOKENS,funds,mypk));
-                else mtx.vout.push_back(CTxOut(funds,CScript() << ParseHex(HexStr(mypk)) << OP_CHECKSIG));
-                return(FinalizeCCTx(0,cp,mtx,mypk,txfee,EncodeChannelsOpRet('R',tokenid,opentxid,mypk,destpub,funds/payment,payment,closetxid)));
-            }
-            else
-                CCERR_RESULT("channelscc",CCLOG_INFO, stream << "previous tx is invalid");
+            mtx.vout.push_back(MakeCC1vout(EVAL_CHANNELS,CC_MARKER_VALUE,mypk));
+            mtx.vout.push_back(MakeCC1vout(EVAL_CHANNELS,CC_MARKER_VALUE,destpub));
+            if (tokenid!=zeroid) mtx.vout.push_back(MakeCC1vout(EVAL_TOKENS,funds,mypk));
+            else mtx.vout.push_back(CTxOut(funds,CScript() << ParseHex(HexStr(mypk)) << OP_CHECKSIG));
+            return(FinalizeCCTx(0,cp,mtx,mypk,txfee,EncodeChannelsOpRet('R',tokenid,opentxid,mypk,destpub,funds/payment,payment,closetxid)));
         }
         else
             CCERR_RESULT("channelscc",CCLOG_INFO, stream << "error adding CC inputs");
@@ -685,26 +715,22 @@ UniValue ChannelRefund(const CPubKey& pk, uint64_t txfee,uint256 opentxid,uint25
 
 UniValue ChannelsList(const CPubKey& pk)
 {
-    UniValue result(UniValue::VOBJ); std::vector<uint256> txids; struct CCcontract_info *cp,C; uint256 txid,hashBlock,tmp_txid,param3,tokenid;
-    CTransaction tx; char myCCaddr[65],str[512],pub[34]; CPubKey mypk,srcpub,destpub; int32_t vout,numvouts,param1;
-    int64_t nValue,param2;
+    UniValue result(UniValue::VOBJ); CCTxidsIndex<CChannelTx>::vecEntries chtxs; struct CCcontract_info *cp,C;
+    char myCCaddr[65],str[512],pub[34]; CPubKey mypk;
 
     cp = CCinit(&C,EVAL_CHANNELS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
     GetCCaddress(cp,myCCaddr,mypk);
-    SetCCtxids(txids,myCCaddr,true,EVAL_CHANNELS,0,zeroid,'O');
+    ChannelTxs.Get(myCCaddr,true,0,0,chtxs);
     result.push_back(Pair("result","success"));
     result.push_back(Pair("name","Channels List"));
-    for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
+    for (CCTxidsIndex<CChannelTx>::vecEntries::const_iterator it=chtxs.begin(); it!=chtxs.end(); it++)
     {
-        txid = *it;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size()) > 0 )
-        {
-            if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3) == 'O')
-            {                
-                sprintf(str,"%lld payments of %lld satoshi to %s",(long long)param1,(long long)param2,pubkey33_str(pub,(uint8_t *)&destpub));                
-                result.push_back(Pair(txid.GetHex().data(),str));
-            }
+        const CChannelTx &chtx = it->second;
+        if (chtx.funcid == 'O')
+        {                
+            sprintf(str,"%lld payments of %lld satoshi to %s",(long long)chtx.param1,(long long)chtx.param2,pubkey33_str(pub,(uint8_t *)&chtx.destpub));                
+            result.push_back(Pair(it->first.GetHex().data(),str));
         }
     }
     return(result);
@@ -712,10 +738,10 @@ UniValue ChannelsList(const CPubKey& pk)
 
 UniValue ChannelsInfo(const CPubKey& pk,uint256 channeltxid)
 {
-    UniValue result(UniValue::VOBJ),array(UniValue::VARR); CTransaction tx,opentx; uint256 txid,tmp_txid,hashBlock,param3,opentxid,hashchain,tokenid;
-    struct CCcontract_info *cp,C; char CCaddr[65],addr[65],str[512]; int32_t vout,numvouts,param1,numpayments;
+    UniValue result(UniValue::VOBJ),array(UniValue::VARR); CTransaction tx; uint256 opentxid,hashBlock,param3,tokenid;
+    struct CCcontract_info *cp,C; char CCaddr[65],addr[65]; int32_t numvouts,param1;
     int64_t param2,payment; CPubKey srcpub,destpub,mypk;
-    std::vector<uint256> txids; std::vector<CTransaction> txs;
+    CCTxidsIndex<CChannelTx>::vecEntries chtxs; CChannelTx memchtx;
     
     cp = CCinit(&C,EVAL_CHANNELS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -723,6 +749,7 @@ UniValue ChannelsInfo(const CPubKey& pk,uint256 channeltxid)
     if (myGetTransaction(channeltxid,tx,hashBlock) != 0 && (numvouts= tx.vout.size()) > 0 &&
         (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,opentxid,srcpub,destpub,param1,param2,param3) == 'O'))
     {    
+        payment=param2;
         GetCCaddress1of2(cp,CCaddr,srcpub,destpub);
         Getscriptaddress(addr,CScript() << ParseHex(HexStr(destpub)) << OP_CHECKSIG);
         result.push_back(Pair("result","success"));
@@ -741,59 +768,44 @@ UniValue ChannelsInfo(const CPubKey& pk,uint256 channeltxid)
             result.push_back(Pair("Amount (satoshi)",i64tostr(param1*param2)));
         }
         GetCCaddress(cp,CCaddr,mypk);
-        SetCCtxids(txids,CCaddr,true,EVAL_CHANNELS,0,channeltxid,0);                      
-        for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
-        {
-            if (myGetTransaction(*it,tx,hashBlock) != 0 && (numvouts= tx.vout.size()) > 0 &&
-                DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3)!=0 && (tmp_txid==channeltxid || tx.GetHash()==channeltxid))
-                    txs.push_back(tx);               
-        }
+        ChannelTxs.Get(CCaddr,true,0,0,chtxs);
         std::vector<CTransaction> tmp_txs;
         myGet_mempool_txs(tmp_txs,EVAL_CHANNELS,'P');
         for (std::vector<CTransaction>::const_iterator it=tmp_txs.begin(); it!=tmp_txs.end(); it++)
         {
-            const CTransaction &txmempool = *it;
-
-            if ((numvouts=txmempool.vout.size()) > 0 && DecodeChannelsOpRet(txmempool.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3) == 'P' && tmp_txid==channeltxid)
-                txs.push_back(txmempool);                
+            if (DecodeChannelTx(*it,memchtx) != 0 && memchtx.funcid == 'P')
+                chtxs.push_back(std::make_pair(it->GetHash(),memchtx));
         }
-        for (std::vector<CTransaction>::const_iterator it=txs.begin(); it!=txs.end(); it++)
+        for (CCTxidsIndex<CChannelTx>::vecEntries::const_iterator it=chtxs.begin(); it!=chtxs.end(); it++)
         {
-            tx=*it;
-            if ((numvouts= tx.vout.size()) > 0 )
+            const CChannelTx &chtx = it->second;
+            if (chtx.opentxid != channeltxid)
+                continue;
+            UniValue obj(UniValue::VOBJ);               
+            if (chtx.funcid == 'O')
             {
-                UniValue obj(UniValue::VOBJ);               
-                if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,param1,param2,param3) == 'O' && tx.GetHash()==channeltxid)
-                {
-                    obj.push_back(Pair("Open",tx.GetHash().GetHex().data()));
-                }
-                else if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,opentxid,srcpub,destpub,param1,param2,param3) == 'P' && opentxid==channeltxid)
-                {
-                    if (myGetTransaction(opentxid,opentx,hashBlock) != 0 && (numvouts=opentx.vout.size()) > 0 &&
-                            DecodeChannelsOpRet(opentx.vout[numvouts-1].scriptPubKey,tokenid,tmp_txid,srcpub,destpub,numpayments,payment,hashchain) == 'O')
-                    {
-                        Getscriptaddress(str,tx.vout[3].scriptPubKey);  
-                        obj.push_back(Pair("Payment",tx.GetHash().GetHex().data()));
-                        obj.push_back(Pair("Number of payments",param2));
-                        obj.push_back(Pair("Amount",param2*payment));
-                        obj.push_back(Pair("Destination",str));
-                        obj.push_back(Pair("Secret",param3.ToString().c_str()));
-                        obj.push_back(Pair("Payments left",param1));
-                    }
-                }
-                else if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,opentxid,srcpub,destpub,param1,param2,param3) == 'C' && opentxid==channeltxid)
-                {
-                    obj.push_back(Pair("Close",tx.GetHash().GetHex().data()));
-                }
-                else if (DecodeChannelsOpRet(tx.vout[numvouts-1].scriptPubKey,tokenid,opentxid,srcpub,destpub,param1,param2,param3) == 'R' && opentxid==channeltxid)
-                {
-                    Getscriptaddress(str,tx.vout[2].scriptPubKey);                        
-                    obj.push_back(Pair("Refund",tx.GetHash().GetHex().data()));                        
-                    obj.push_back(Pair("Amount",param1*param2));
-                    obj.push_back(Pair("Destination",str));
-                }
-                array.push_back(obj);
+                obj.push_back(Pair("Open",it->first.GetHex().data()));
+            }
+            else if (chtx.funcid == 'P')
+            {
+                obj.push_back(Pair("Payment",it->first.GetHex().data()));
+                obj.push_back(Pair("Number of payments",chtx.param2));
+                obj.push_back(Pair("Amount",chtx.param2*payment));
+                obj.push_back(Pair("Destination",chtx.destaddr));
+                obj.push_back(Pair("Secret",chtx.param3.ToString().c_str()));
+                obj.push_back(Pair("Payments left",chtx.param1));
+            }
+            else if (chtx.funcid == 'C')
+            {
+                obj.push_back(Pair("Close",it->first.GetHex().data()));
+            }
+            else if (chtx.funcid == 'R')
+            {
+                obj.push_back(Pair("Refund",it->first.GetHex().data()));                        
+                obj.push_back(Pair("Amount",chtx.param1*chtx.param2));
+                obj.push_back(Pair("Destination",chtx.destaddr));
             }
+            array.push_back(obj);
         }        
         result.push_back(Pair("Transactions",array));
     }
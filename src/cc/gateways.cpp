@@ -16,6 +16,7 @@
 #include "CCtokens.h"
 #include "CCtokens_impl.h"
 #include "CCGateways.h"
+#include "CCindex.h"
 #include "key_io.h"
 
 /*
@@ -363,6 +364,58 @@ uint8_t DecodeGatewaysOpRet(const CScript &scriptPubKey)
     return(0);
 }
 
+// unspent marker of a deposit waiting for its claim or of a withdraw that is being signed or was signed
+struct CGatewaysMarker
+{
+    uint8_t funcid,K;
+    uint256 tokenid,cointxid,withdrawtxid;
+    std::string coin,hex;
+    CPubKey pubkey;     // destpub of a deposit, withdrawpub otherwise
+    int64_t amount;     // deposit amount, or what the withdraw sent to the gateways tokens address
+    bool tokensvout;    // the withdraw sent its tokens to the gateways tokens address
+};
+
+// markers are found at vout 0 of the deposit, withdraw, partial sign and complete signing txs, grouped by their bindtxid
+static bool DecodeGatewaysMarker(const CTransaction &tx,int32_t vout,uint256 &bindtxid,CGatewaysMarker &marker)
+{
+    CTransaction withdrawtx; uint256 hashBlock; std::vector<CPubKey> publishers; std::vector<uint256> txids; std::vector<uint8_t> proof;
+    std::string coin; CPubKey signerpk; int32_t height,claimvout,numvouts; char destaddr[65],tokensaddr[65]; struct CCcontract_info *cp,C;
+
+    if ( vout != 0 || (numvouts= tx.vout.size()) < 2 || tx.vout[0].nValue != CC_MARKER_VALUE )
+        return(false);
+    marker.K = 0, marker.hex.clear(), marker.tokensvout = false;
+    switch ( (marker.funcid= DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey)) )
+    {
+        case 'D':
+            return(DecodeGatewaysDepositOpRet(tx.vout[numvouts-1].scriptPubKey,bindtxid,marker.coin,publishers,txids,height,marker.cointxid,claimvout,marker.hex,proof,marker.pubkey,marker.amount) == 'D');
+        case 'W':
+            marker.withdrawtxid = tx.GetHash();
+            withdrawtx = tx;
+            break;
+        case 'P':
+            if ( DecodeGatewaysPartialOpRet(tx.vout[numvouts-1].scriptPubKey,marker.withdrawtxid,coin,marker.K,signerpk,marker.hex) != 'P' || myGetTransaction(marker.withdrawtxid,withdrawtx,hashBlock) == 0 )
+                return(false);
+            break;
+        case 'S':
+            if ( DecodeGatewaysCompleteSigningOpRet(tx.vout[numvouts-1].scriptPubKey,marker.withdrawtxid,coin,marker.K,marker.hex) != 'S' || myGetTransaction(marker.withdrawtxid,withdrawtx,hashBlock) == 0 )
+                return(false);
+            break;
+        default:
+            return(false);
+    }
+    if ( (numvouts= withdrawtx.vout.size()) < 2 || DecodeGatewaysWithdrawOpRet(withdrawtx.vout[numvouts-1].scriptPubKey,marker.tokenid,bindtxid,marker.coin,marker.pubkey,marker.amount) != 'W' )
+        return(false);
+    if ( marker.funcid == 'S' )
+        marker.coin = coin;
+    cp = CCinit(&C,EVAL_GATEWAYS);
+    GetTokensCCaddress(cp,tokensaddr,GetUnspendable(cp,0));
+    marker.tokensvout = Getscriptaddress(destaddr,withdrawtx.vout[1].scriptPubKey) != 0 && strcmp(destaddr,tokensaddr) == 0;
+    marker.amount = withdrawtx.vout[1].nValue;
+    return(true);
+}
+
+static CCUnspentsIndex<CGatewaysMarker> GatewaysMarkers(DecodeGatewaysMarker);
+
 int64_t IsGatewaysvout(struct CCcontract_info *cp,const CTransaction& tx,int32_t v)
 {
     char destaddr[64];
@@ -1022,10 +1075,10 @@ UniValue GatewaysClaim(const CPubKey& pk, uint64_t txfee,uint256 bindtxid,std::s
 UniValue GatewaysWithdraw(const CPubKey& pk, uint64_t txfee,uint256 bindtxid,std::string refcoin,CPubKey withdrawpub,int64_t amount)
 {
     CMutableTransaction mtx = CreateNewContextualCMutableTransaction(Params().GetConsensus(), komodo_nextheight());
-    CTransaction tx; CPubKey mypk,gatewayspk,signerpk; uint256 txid,tokenid,hashBlock,oracletxid,tmptokenid,tmpbindtxid,withdrawtxid; int32_t vout,numvouts;
-    int64_t nValue,totalsupply,inputs,CCchange=0,tmpamount; uint8_t funcid,K,M,N,taddr,prefix,prefix2,wiftype; std::string coin,hex;
+    CTransaction tx; CPubKey mypk,gatewayspk; uint256 tokenid,hashBlock,oracletxid; int32_t numvouts;
+    int64_t totalsupply,inputs,CCchange=0; uint8_t M,N,taddr,prefix,prefix2,wiftype; std::string coin;
     std::vector<CPubKey> pubkeys; char depositaddr[64],coinaddr[64]; struct CCcontract_info *cp,C,*cpTokens,CTokens;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    CCUnspentsIndex<CGatewaysMarker>::vecEntries markers;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     cpTokens = CCinit(&CTokens,EVAL_TOKENS);
@@ -1040,24 +1093,11 @@ UniValue GatewaysWithdraw(const CPubKey& pk, uint64_t txfee,uint256 bindtxid,std
     if (komodo_txnotarizedconfirmed(bindtxid)==false)
         CCERR_RESULT("gatewayscc",CCLOG_INFO, stream << "gatewaysbind tx not yet confirmed/notarized");
     _GetCCaddress(coinaddr,EVAL_GATEWAYS,gatewayspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    GatewaysMarkers.Get(coinaddr,bindtxid,markers);
+    for (CCUnspentsIndex<CGatewaysMarker>::vecEntries::const_iterator it=markers.begin(); it!=markers.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        K=0;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
-            (funcid=DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey))!=0 && (funcid=='W' || funcid=='P'))
-        {
-            if (funcid=='W' && DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,coin,withdrawpub,tmpamount)=='W'
-                && refcoin==coin && tmptokenid==tokenid && tmpbindtxid==bindtxid)
-                CCERR_RESULT("gatewayscc",CCLOG_INFO, stream << "unable to create withdraw, another withdraw pending");           
-            else if (funcid=='P' && DecodeGatewaysPartialOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,coin,K,signerpk,hex)=='P' &&
-                myGetTransaction(withdrawtxid,tx,hashBlock)!=0 && (numvouts=tx.vout.size())>0 && DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,coin,withdrawpub,tmpamount)=='W'
-                && refcoin==coin && tmptokenid==tokenid && tmpbindtxid==bindtxid)                    
-                CCERR_RESULT("gatewayscc",CCLOG_INFO, stream << "unable to create withdraw, another withdraw pending");
-        }
+        if ( (it->second.funcid == 'W' || it->second.funcid == 'P') && refcoin == it->second.coin && it->second.tokenid == tokenid )
+            CCERR_RESULT("gatewayscc",CCLOG_INFO, stream << "unable to create withdraw, another withdraw pending");
     }
     if( AddNormalinputs(mtx, mypk, txfee+CC_MARKER_VALUE, 2,pk.IsValid()) > 0 )
     {
@@ -1221,12 +1261,12 @@ UniValue GatewaysMarkDone(const CPubKey& pk, uint64_t txfee,uint256 completetxid
 
 UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string refcoin)
 {
-    UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx; std::string coin,hex,pub; 
-    CPubKey mypk,gatewayspk,destpub; std::vector<CPubKey> pubkeys,publishers; std::vector<uint256> txids;
-    uint256 tmpbindtxid,hashBlock,txid,tokenid,oracletxid,cointxid; uint8_t M,N,taddr,prefix,prefix2,wiftype;
-    char depositaddr[65],coinaddr[65],str[65],destaddr[65],txidaddr[65]; std::vector<uint8_t> proof;
-    int32_t numvouts,vout,claimvout,height; int64_t totalsupply,nValue,amount; struct CCcontract_info *cp,C;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx; std::string coin,pub; 
+    CPubKey mypk,gatewayspk; std::vector<CPubKey> pubkeys;
+    uint256 hashBlock,txid,tokenid,oracletxid; uint8_t M,N,taddr,prefix,prefix2,wiftype;
+    char depositaddr[65],coinaddr[65],str[65],destaddr[65],txidaddr[65];
+    int32_t numvouts,vout; int64_t totalsupply; struct CCcontract_info *cp,C;
+    CCUnspentsIndex<CGatewaysMarker>::vecEntries markers;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1244,27 +1284,25 @@ UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string
         result.push_back(Pair("error",strprintf("invalid bindtxid %s coin.%s",uint256_str(str,bindtxid),coin.c_str())));     
         return(result);
     }  
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    GatewaysMarkers.Get(coinaddr,bindtxid,markers);
+    for (CCUnspentsIndex<CGatewaysMarker>::vecEntries::const_iterator it=markers.begin(); it!=markers.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            DecodeGatewaysDepositOpRet(tx.vout[numvouts-1].scriptPubKey,tmpbindtxid,coin,publishers,txids,height,cointxid,claimvout,hex,proof,destpub,amount) == 'D'
-            && tmpbindtxid==bindtxid && refcoin == coin && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0)
+        txid = it->first.hash;
+        vout = (int32_t)it->first.n;
+        const CGatewaysMarker &marker = it->second;
+        if ( marker.funcid == 'D' && refcoin == marker.coin && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
         {   
             UniValue obj(UniValue::VOBJ);
-            obj.push_back(Pair("cointxid",uint256_str(str,cointxid)));
+            obj.push_back(Pair("cointxid",uint256_str(str,marker.cointxid)));
             obj.push_back(Pair("deposittxid",uint256_str(str,txid)));  
             CCtxidaddr(txidaddr,txid);
             obj.push_back(Pair("deposittxidaddr",txidaddr));              
-            _GetCCaddress(destaddr,EVAL_TOKENS,destpub);
+            _GetCCaddress(destaddr,EVAL_TOKENS,marker.pubkey);
             obj.push_back(Pair("depositaddr",depositaddr));
             obj.push_back(Pair("tokens_destination_address",destaddr));
-            pub=HexStr(destpub);
+            pub=HexStr(marker.pubkey);
             obj.push_back(Pair("claim_pubkey",pub));
-            obj.push_back(Pair("amount",(double)amount/COIN));
+            obj.push_back(Pair("amount",(double)marker.amount/COIN));
             obj.push_back(Pair("confirmed_or_notarized",komodo_txnotarizedconfirmed(txid)));        
             pending.push_back(obj);
         }
@@ -1276,17 +1314,16 @@ UniValue GatewaysPendingDeposits(const CPubKey& pk, uint256 bindtxid,std::string
 
 UniValue GatewaysPendingWithdraws(const CPubKey& pk, uint256 bindtxid,std::string refcoin)
 {
-    UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx; std::string coin,hex; CPubKey mypk,gatewayspk,withdrawpub,signerpk;
-    std::vector<CPubKey> msigpubkeys; uint256 hashBlock,tokenid,txid,tmpbindtxid,tmptokenid,oracletxid,withdrawtxid; uint8_t K,M,N,taddr,prefix,prefix2,wiftype;
-    char funcid,depositaddr[65],coinaddr[65],tokensaddr[65],destaddr[65],str[65],withaddr[65],numstr[32],signeraddr[65],txidaddr[65];
-    int32_t i,n,numvouts,vout,queueflag; int64_t totalsupply,amount,nValue; struct CCcontract_info *cp,C;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    UniValue result(UniValue::VOBJ),pending(UniValue::VARR); CTransaction tx; std::string coin; CPubKey mypk,gatewayspk;
+    std::vector<CPubKey> msigpubkeys; uint256 hashBlock,tokenid,txid,oracletxid; uint8_t M,N,taddr,prefix,prefix2,wiftype;
+    char depositaddr[65],coinaddr[65],str[65],withaddr[65],numstr[32],signeraddr[65],txidaddr[65];
+    int32_t i,n,numvouts,vout,queueflag; int64_t totalsupply; struct CCcontract_info *cp,C;
+    CCUnspentsIndex<CGatewaysMarker>::vecEntries markers;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
     gatewayspk = GetUnspendable(cp,0);
     _GetCCaddress(coinaddr,EVAL_GATEWAYS,gatewayspk);
-    GetTokensCCaddress(cp,tokensaddr,gatewayspk);
     if ( myGetTransaction(bindtxid,tx,hashBlock) == 0 || (numvouts= tx.vout.size()) <= 0 )
     {
         result.push_back(Pair("result","error"));
@@ -1307,39 +1344,25 @@ UniValue GatewaysPendingWithdraws(const CPubKey& pk, uint256 bindtxid,std::strin
             queueflag = 1;
             break;
         }    
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    GatewaysMarkers.Get(coinaddr,bindtxid,markers);
+    for (CCUnspentsIndex<CGatewaysMarker>::vecEntries::const_iterator it=markers.begin(); it!=markers.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        K=0;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
-            (funcid=DecodeGatewaysOpRet(tx.vout[numvouts-1].scriptPubKey))!=0 && (funcid=='W' || funcid=='P') && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0)
+        txid = it->first.hash;
+        vout = (int32_t)it->first.n;
+        const CGatewaysMarker &marker = it->second;
+        if ( (marker.funcid == 'W' || marker.funcid == 'P') && refcoin == marker.coin && marker.tokenid == tokenid && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
         {
-            if (funcid=='W')
-            {
-                if (DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,coin,withdrawpub,amount)==0 || refcoin!=coin || tmptokenid!=tokenid || tmpbindtxid!=bindtxid) continue;
-            }
-            else if (funcid=='P')
-            {
-                if (DecodeGatewaysPartialOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,coin,K,signerpk,hex)!='P' || myGetTransaction(withdrawtxid,tx,hashBlock)==0
-                    || (numvouts=tx.vout.size())<=0 || DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,tmpbindtxid,coin,withdrawpub,amount)!='W'
-                    || refcoin!=coin || tmptokenid!=tokenid || tmpbindtxid!=bindtxid)
-                    continue;                    
-            }      
-            Getscriptaddress(destaddr,tx.vout[1].scriptPubKey);
-            GetCustomscriptaddress(withaddr,CScript() << ParseHex(HexStr(withdrawpub)) << OP_CHECKSIG,taddr,prefix,prefix2);
-            if ( strcmp(destaddr,tokensaddr) == 0 )
+            GetCustomscriptaddress(withaddr,CScript() << ParseHex(HexStr(marker.pubkey)) << OP_CHECKSIG,taddr,prefix,prefix2);
+            if ( marker.tokensvout != 0 )
             {
                 UniValue obj(UniValue::VOBJ);
-                obj.push_back(Pair("withdrawtxid",uint256_str(str,tx.GetHash())));
-                CCCustomtxidaddr(txidaddr,tx.GetHash(),taddr,prefix,prefix2);
+                obj.push_back(Pair("withdrawtxid",uint256_str(str,marker.withdrawtxid)));
+                CCCustomtxidaddr(txidaddr,marker.withdrawtxid,taddr,prefix,prefix2);
                 obj.push_back(Pair("withdrawtxidaddr",txidaddr));
                 obj.push_back(Pair("withdrawaddr",withaddr));
-                sprintf(numstr,"%.8f",(double)tx.vout[1].nValue/COIN);
+                sprintf(numstr,"%.8f",(double)marker.amount/COIN);
                 obj.push_back(Pair("amount",numstr));                
-                obj.push_back(Pair("confirmed_or_notarized",komodo_txnotarizedconfirmed(tx.GetHash())));
+                obj.push_back(Pair("confirmed_or_notarized",komodo_txnotarizedconfirmed(marker.withdrawtxid)));
                 if ( queueflag != 0 )
                 {
                     obj.push_back(Pair("depositaddr",depositaddr));
@@ -1348,9 +1371,9 @@ UniValue GatewaysPendingWithdraws(const CPubKey& pk, uint256 bindtxid,std::strin
                 }
                 if (N>1)
                 {
-                    obj.push_back(Pair("number_of_signs",K));
+                    obj.push_back(Pair("number_of_signs",marker.K));
                     obj.push_back(Pair("last_txid",uint256_str(str,txid)));
-                    if (K>0) obj.push_back(Pair("hex",hex));
+                    if (marker.K>0) obj.push_back(Pair("hex",marker.hex));
                 }
                 pending.push_back(obj);
             }
@@ -1364,12 +1387,12 @@ UniValue GatewaysPendingWithdraws(const CPubKey& pk, uint256 bindtxid,std::strin
 
 UniValue GatewaysProcessedWithdraws(const CPubKey& pk, uint256 bindtxid,std::string refcoin)
 {
-    UniValue result(UniValue::VOBJ),processed(UniValue::VARR); CTransaction tx; std::string coin,hex; 
-    CPubKey mypk,gatewayspk,withdrawpub; std::vector<CPubKey> msigpubkeys;
-    uint256 withdrawtxid,hashBlock,txid,tokenid,tmptokenid,oracletxid; uint8_t K,M,N,taddr,prefix,prefix2,wiftype;
+    UniValue result(UniValue::VOBJ),processed(UniValue::VARR); CTransaction tx; std::string coin; 
+    CPubKey mypk,gatewayspk; std::vector<CPubKey> msigpubkeys;
+    uint256 hashBlock,txid,tokenid,oracletxid; uint8_t M,N,taddr,prefix,prefix2,wiftype;
     char depositaddr[65],coinaddr[65],str[65],numstr[32],withaddr[65],txidaddr[65];
-    int32_t i,n,numvouts,vout,queueflag; int64_t totalsupply,nValue,amount; struct CCcontract_info *cp,C;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    int32_t i,n,numvouts,vout,queueflag; int64_t totalsupply; struct CCcontract_info *cp,C;
+    CCUnspentsIndex<CGatewaysMarker>::vecEntries markers;
 
     cp = CCinit(&C,EVAL_GATEWAYS);
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
@@ -1395,31 +1418,26 @@ UniValue GatewaysProcessedWithdraws(const CPubKey& pk, uint256 bindtxid,std::str
             queueflag = 1;
             break;
         }    
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    GatewaysMarkers.Get(coinaddr,bindtxid,markers);
+    for (CCUnspentsIndex<CGatewaysMarker>::vecEntries::const_iterator it=markers.begin(); it!=markers.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if ( vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0 &&
-            DecodeGatewaysCompleteSigningOpRet(tx.vout[numvouts-1].scriptPubKey,withdrawtxid,coin,K,hex) == 'S' && refcoin == coin && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0)
+        txid = it->first.hash;
+        vout = (int32_t)it->first.n;
+        const CGatewaysMarker &marker = it->second;
+        if ( marker.funcid == 'S' && refcoin == marker.coin && marker.tokenid == tokenid && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
         {   
-            if (myGetTransaction(withdrawtxid,tx,hashBlock) != 0 && (numvouts= tx.vout.size())>0
-                && DecodeGatewaysWithdrawOpRet(tx.vout[numvouts-1].scriptPubKey,tmptokenid,bindtxid,coin,withdrawpub,amount) == 'W' || refcoin!=coin || tmptokenid!=tokenid)          
-            {
-                UniValue obj(UniValue::VOBJ);
-                obj.push_back(Pair("completesigningtxid",uint256_str(str,txid)));
-                obj.push_back(Pair("withdrawtxid",uint256_str(str,withdrawtxid)));  
-                CCCustomtxidaddr(txidaddr,withdrawtxid,taddr,prefix,prefix2);
-                obj.push_back(Pair("withdrawtxidaddr",txidaddr));              
-                GetCustomscriptaddress(withaddr,CScript() << ParseHex(HexStr(withdrawpub)) << OP_CHECKSIG,taddr,prefix,prefix2);
-                obj.push_back(Pair("withdrawaddr",withaddr));
-                obj.push_back(Pair("confirmed_or_notarized",komodo_txnotarizedconfirmed(txid)));
-                sprintf(numstr,"%.8f",(double)tx.vout[1].nValue/COIN);
-                obj.push_back(Pair("amount",numstr));
-                obj.push_back(Pair("hex",hex));                
-                processed.push_back(obj);            
-            }
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("completesigningtxid",uint256_str(str,txid)));
+            obj.push_back(Pair("withdrawtxid",uint256_str(str,marker.withdrawtxid)));  
+            CCCustomtxidaddr(txidaddr,marker.withdrawtxid,taddr,prefix,prefix2);
+            obj.push_back(Pair("withdrawtxidaddr",txidaddr));              
+            GetCustomscriptaddress(withaddr,CScript() << ParseHex(HexStr(marker.pubkey)) << OP_CHECKSIG,taddr,prefix,prefix2);
+            obj.push_back(Pair("withdrawaddr",withaddr));
+            obj.push_back(Pair("confirmed_or_notarized",komodo_txnotarizedconfirmed(txid)));
+            sprintf(numstr,"%.8f",(double)marker.amount/COIN);
+            obj.push_back(Pair("amount",numstr));
+            obj.push_back(Pair("hex",marker.hex));                
+            processed.push_back(obj);            
         }
     }
     result.push_back(Pair("coin",refcoin));
@@ -96,6 +96,16 @@ uint64_t mpz_get_ui2( mpz_t op )
     return ret;
 }
 
+// allocation * amount / totalallocations truncated, in 128 bits instead of gmp with the same result:
+// mpz_set_lli loads the operands as unsigned 64 bit and mpz_get_si2 reads back the top word of a wider quotient.
+// returns false if the quotient does not fit an int64_t, where the gmp code checked mpz_fits_slong_p
+bool payments_allocationshare(int64_t allocation,int64_t amount,unsigned __int128 totalallocations,int64_t &share)
+{
+    unsigned __int128 quotient = (unsigned __int128)(uint64_t)allocation * (uint64_t)amount / totalallocations;
+    share = (int64_t)(uint64_t)((quotient >> 64) != 0 ? (quotient >> 64) : quotient);
+    return(quotient <= INT64_MAX);
+}
+
 CScript EncodePaymentsTxidOpRet(int64_t allocation,std::vector<uint8_t> scriptPubKey,std::vector<uint8_t> destopret)
 {
     CScript opret; uint8_t evalcode = EVAL_PAYMENTS;
@@ -275,9 +285,38 @@ bool payments_lockedblocks(uint256 blockhash,int32_t lockedblocks,int32_t &block
     return true;
 }
 
-int32_t payments_getallocations(int32_t top, int32_t bottom, const std::vector<std::vector<uint8_t>> &excludeScriptPubKeys, mpz_t &mpzTotalAllocations, std::vector<CScript> &scriptPubKeys,  std::vector<int64_t> &allocations)
+// allocations of a snapshot plan, the same for every release until the next snapshot
+struct CPaymentsAllocations
 {
-    mpz_t mpzAllocation; int32_t i =0;
+    int32_t snapshotheight,top,bottom;
+    uint256 snapshothash;
+    std::vector<CScript> scriptPubKeys;
+    std::vector<int64_t> allocations;
+    unsigned __int128 totalallocations;
+};
+
+static CCriticalSection cs_paymentsallocations;
+static std::map<uint256,std::shared_ptr<const CPaymentsAllocations> > mapPaymentsAllocations;
+
+int32_t payments_getallocations(uint256 createtxid, int32_t top, int32_t bottom, const std::vector<std::vector<uint8_t>> &excludeScriptPubKeys, unsigned __int128 &totalallocations, std::vector<CScript> &scriptPubKeys,  std::vector<int64_t> &allocations)
+{
+    std::shared_ptr<CPaymentsAllocations> cached; int32_t i =0;
+    std::map<uint256,std::shared_ptr<const CPaymentsAllocations> >::iterator it;
+    uint256 snapshothash = chainActive[lastSnapShotHeight]->GetBlockHash();
+    {
+        LOCK(cs_paymentsallocations);
+        // a reorg of the snapshot block or a new snapshot changes the allocations
+        if ( (it= mapPaymentsAllocations.find(createtxid)) != mapPaymentsAllocations.end() && it->second->snapshotheight == lastSnapShotHeight && it->second->snapshothash == snapshothash && it->second->top == top && it->second->bottom == bottom )
+        {
+            totalallocations += it->second->totalallocations;
+            scriptPubKeys.insert(scriptPubKeys.end(),it->second->scriptPubKeys.begin(),it->second->scriptPubKeys.end());
+            allocations.insert(allocations.end(),it->second->allocations.begin(),it->second->allocations.end());
+            return(it->second->allocations.size());
+        }
+    }
+    cached = std::make_shared<CPaymentsAllocations>();
+    cached->snapshotheight = lastSnapShotHeight, cached->snapshothash = snapshothash, cached->top = top, cached->bottom = bottom;
+    cached->totalallocations = 0;
     for (int32_t j = bottom; j < vAddressSnapshot.size(); j++)
     {
         auto &address = vAddressSnapshot[j];
@@ -291,28 +330,32 @@ int32_t payments_getallocations(int32_t top, int32_t bottom, const std::vector<s
         }
         if ( !skip )
         {
-            mpz_init(mpzAllocation); 
             i++;
             //fprintf(stderr, "address: %s nValue.%li \n", CBitcoinAddress(address.second).ToString().c_str(), address.first);
-            scriptPubKeys.push_back(scriptPubKey);
-            allocations.push_back(address.first);
-            mpz_set_lli(mpzAllocation,address.first);
-            mpz_add(mpzTotalAllocations,mpzTotalAllocations,mpzAllocation); 
-            mpz_clear(mpzAllocation);
+            cached->scriptPubKeys.push_back(scriptPubKey);
+            cached->allocations.push_back(address.first);
+            cached->totalallocations += (uint64_t)address.first;
         }
         if ( i+bottom == top ) 
             break; // we reached top amount to pay, it can be less than this, if less address exist on chain, return the number we got.
     }
+    totalallocations += cached->totalallocations;
+    scriptPubKeys.insert(scriptPubKeys.end(),cached->scriptPubKeys.begin(),cached->scriptPubKeys.end());
+    allocations.insert(allocations.end(),cached->allocations.begin(),cached->allocations.end());
+    LOCK(cs_paymentsallocations);
+    if ( mapPaymentsAllocations.size() >= PAYMENTS_ALLOCATIONSCACHESIZE )
+        mapPaymentsAllocations.clear();
+    mapPaymentsAllocations[createtxid] = cached;
     return(i);
 }
 
-int32_t payments_gettokenallocations(int32_t top, int32_t bottom, const std::vector<std::vector<uint8_t>> &excludeScriptPubKeys, uint256 tokenid, mpz_t &mpzTotalAllocations, std::vector<CScript> &scriptPubKeys,  std::vector<int64_t> &allocations)
+int32_t payments_gettokenallocations(int32_t top, int32_t bottom, const std::vector<std::vector<uint8_t>> &excludeScriptPubKeys, uint256 tokenid, unsigned __int128 &totalallocations, std::vector<CScript> &scriptPubKeys,  std::vector<int64_t> &allocations)
 {
     /*
     - check tokenid exists.
     - iterate tokenid address and extract all pubkeys, add to map. 
     - rewind to last notarized height for balances? see main.cpp: line# 660.
-    - convert balances to mpz_t and add up totalallocations
+    - add up totalallocations
     - sort the map into a vector, then convert to the correct output.
     */
     return(0);
@@ -323,8 +366,7 @@ bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
     char temp[128], txidaddr[64]={0}; std::string scriptpubkey; uint256 createtxid, blockhash, tokenid; CTransaction plantx; int8_t funcid=0, fixedAmount=0;
     int32_t i,lockedblocks,minrelease,blocksleft,dust = 0, top,bottom=0,minimum=10000; int64_t change,totalallocations,actualtxfee,amountReleased=0; std::vector<uint256> txidoprets; bool fHasOpret = false,fIsMerge = false; CPubKey txidpk,Paymentspk;
     std::vector<std::vector<uint8_t>> excludeScriptPubKeys; bool fFixedAmount = false; CScript ccopret;
-    mpz_t mpzTotalAllocations,mpzAllocation,mpzCheckamount;
-    mpz_init(mpzCheckamount); mpz_init(mpzTotalAllocations);
+    unsigned __int128 totalallocations128 = 0;
     // Check change is in vout[0], and also fetch the ccopret to determine what type of tx this is. txidaddr is unknown, recheck this later.
     if ( (change= IsPaymentsvout(cp,tx,0,txidaddr,ccopret)) != 0 && ccopret.size() > 2 )
     {
@@ -335,7 +377,6 @@ bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
             return(eval->Invalid("could not decode ccopret"));
         if ( tx.vout.back().scriptPubKey.IsOpReturn() )
             fHasOpret = true;
-        mpz_set_lli(mpzCheckamount,amountReleased); 
     } else return(eval->Invalid("could not decode ccopret"));
     
     // use the createtxid to fetch the tx and all of the plans info.
@@ -401,7 +442,7 @@ bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
                     //fprintf(stderr, "totalallocations.%li checkallocations.%li\n",totalallocations, checkallocations);
                     if ( totalallocations != checkallocations )
                         return(eval->Invalid("allocation missmatch"));
-                    mpz_set_lli(mpzTotalAllocations,totalallocations);
+                    totalallocations128 = (uint64_t)totalallocations;
                 }
                 else if ( funcid == 'S' || funcid == 'O' )
                 {
@@ -422,11 +463,11 @@ bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
                         fFixedAmount = true;
                     }
                     if ( funcid == 'S' )
-                        payments_getallocations(top, bottom, excludeScriptPubKeys, mpzTotalAllocations, scriptPubKeys, allocations);
+                        payments_getallocations(createtxid, top, bottom, excludeScriptPubKeys, totalallocations128, scriptPubKeys, allocations);
                     else 
                     {
                         // token snapshot
-                        // payments_gettokenallocations(top, bottom, excludeScriptPubKeys, tokenid, mpzTotalAllocations, scriptPubKeys, allocations);
+                        // payments_gettokenallocations(top, bottom, excludeScriptPubKeys, tokenid, totalallocations128, scriptPubKeys, allocations);
                         return(eval->Invalid("tokens not yet implemented"));
                     }
                 }
@@ -454,15 +495,7 @@ bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
                         else 
                             return(eval->Invalid("top/bottom range is illegal"));
                     }
-                    else 
-                    {
-                        mpz_init(mpzAllocation); 
-                        mpz_set_lli(mpzAllocation,allocations[n]);
-                        mpz_mul(mpzAllocation,mpzAllocation,mpzCheckamount);
-                        mpz_tdiv_q(mpzAllocation,mpzAllocation,mpzTotalAllocations);
-                        test = mpz_get_si2(mpzAllocation);
-                        mpz_clear(mpzAllocation);
-                    }
+                    else payments_allocationshare(allocations[n],amountReleased,totalallocations128,test);
                     //fprintf(stderr, "vout.%i test.%lli vs nVlaue.%lli\n",i, (long long)test, (long long)tx.vout[i].nValue);
                     if ( test != tx.vout[i].nValue ) 
                     {
@@ -481,16 +514,12 @@ bool PaymentsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &
                 if ( allocations.size() > n )
                 {
                     // need to check that the next allocation was less than minimum, otherwise ppl can truncate the tx at any place not paying all elegible addresses. 
-                    mpz_init(mpzAllocation); 
-                    mpz_set_lli(mpzAllocation,allocations[n+1]);
-                    mpz_mul(mpzAllocation,mpzAllocation,mpzCheckamount);
-                    mpz_tdiv_q(mpzAllocation,mpzAllocation,mpzTotalAllocations);
-                    int64_t test = mpz_get_si2(mpzAllocation);
+                    int64_t test;
+                    payments_allocationshare(allocations[n+1],amountReleased,totalallocations128,test);
                     //fprintf(stderr, "check next vout pays under min: test.%li > minimuim.%i\n", test, minimum);
                     if ( test > minimum )
                         return(eval->Invalid("next allocation was not under minimum"));
                 }
-                mpz_clear(mpzTotalAllocations); mpz_clear(mpzCheckamount);
             }
             // Check vins
             i = 0; 
@@ -711,7 +740,7 @@ UniValue PaymentsRelease(struct CCcontract_info *cp,char *jsonstr)
     CMutableTransaction tmpmtx,mtx = CreateNewContextualCMutableTransaction(Params().GetConsensus(),komodo_nextheight()); UniValue result(UniValue::VOBJ); uint256 createtxid,hashBlock,tokenid;
     CTransaction tx,txO; CPubKey mypk,txidpk,Paymentspk; int32_t i,n,m,numoprets=0,lockedblocks,minrelease; int64_t newamount,inputsum,amount,CCchange=0,totalallocations=0,checkallocations=0,allocation; CTxOut vout; CScript onlyopret,ccopret; char txidaddr[64],destaddr[64]; std::vector<uint256> txidoprets;
     int32_t top,bottom=0,blocksleft=0,minimum=10000; std::vector<std::vector<uint8_t>> excludeScriptPubKeys; int8_t funcid,fixedAmount=0,skipminimum=0; bool fFixedAmount = false;
-    mpz_t mpzTotalAllocations, mpzAllocation; mpz_init(mpzTotalAllocations);
+    unsigned __int128 totalallocations128 = 0;
     cJSON *params = payments_reparse(&n,jsonstr);
     mypk = pubkey2pk(Mypubkey());
     Paymentspk = GetUnspendable(cp,0);
@@ -803,8 +832,8 @@ UniValue PaymentsRelease(struct CCcontract_info *cp,char *jsonstr)
                             free_json(params);
                         return(result);
                     }
-                    // set totalallocations to a mpz_t bignum, for amounts calculation later. 
-                    mpz_set_lli(mpzTotalAllocations,totalallocations);
+                    // set totalallocations to 128 bits, for amounts calculation later. 
+                    totalallocations128 = (uint64_t)totalallocations;
                 }
                 else if ( funcid == 'S' || funcid == 'O' )
                 {
@@ -846,11 +875,11 @@ UniValue PaymentsRelease(struct CCcontract_info *cp,char *jsonstr)
                     std::vector<int64_t> allocations;
                     std::vector<CScript> scriptPubKeys;
                     if ( funcid == 'S' )
-                        m = payments_getallocations(top, bottom, excludeScriptPubKeys, mpzTotalAllocations, scriptPubKeys, allocations);
+                        m = payments_getallocations(createtxid, top, bottom, excludeScriptPubKeys, totalallocations128, scriptPubKeys, allocations);
                     else 
                     {
                         // token snapshot
-                        // payments_gettokenallocations(top, bottom, excludeScriptPubKeys, tokenid, mpzTotalAllocations, scriptPubKeys, allocations);
+                        // payments_gettokenallocations(top, bottom, excludeScriptPubKeys, tokenid, totalallocations128, scriptPubKeys, allocations);
                     }
                     if ( (allocations.size() == 0 || scriptPubKeys.size() == 0 || allocations.size() != scriptPubKeys.size()) )
                     {
@@ -871,29 +900,18 @@ UniValue PaymentsRelease(struct CCcontract_info *cp,char *jsonstr)
                 }
                 newamount = amount;
                 int64_t totalamountsent = 0;
-                mpz_t mpzAmount; mpz_init(mpzAmount); mpz_set_lli(mpzAmount,amount);
                 for (i=0; i<m; i++)
                 {
-                    mpz_t mpzValue; mpz_init(mpzValue);
                     if ( fFixedAmount )
                         mtx.vout[i+1].nValue = amount / (top-bottom);
-                    else 
+                    else if ( payments_allocationshare(mtx.vout[i+1].nValue,amount,totalallocations128,mtx.vout[i+1].nValue) == 0 )
                     {
-                        mpz_set_lli(mpzValue,mtx.vout[i+1].nValue);
-                        mpz_mul(mpzValue,mpzValue,mpzAmount); 
-                        mpz_tdiv_q(mpzValue,mpzValue,mpzTotalAllocations); 
-                        if ( mpz_fits_slong_p(mpzValue) ) 
-                            mtx.vout[i+1].nValue = mpz_get_si2(mpzValue);
-                        else
-                        {
-                            result.push_back(Pair("result","error"));
-                            result.push_back(Pair("error","value too big, try releasing a smaller amount"));
-                            if ( params != 0 )
-                                free_json(params);
-                            return(result);
-                        } 
+                        result.push_back(Pair("result","error"));
+                        result.push_back(Pair("error","value too big, try releasing a smaller amount"));
+                        if ( params != 0 )
+                            free_json(params);
+                        return(result);
                     }
-                    mpz_clear(mpzValue);
                     //fprintf(stderr, "[%i] nValue.%li minimum.%i scriptpubkey.%s\n", i, mtx.vout[i+1].nValue, minimum, HexStr(mtx.vout[i+1].scriptPubKey.begin(),mtx.vout[i+1].scriptPubKey.end()).c_str());
                     if ( mtx.vout[i+1].nValue < minimum )
                     {
@@ -918,7 +936,6 @@ UniValue PaymentsRelease(struct CCcontract_info *cp,char *jsonstr)
                 if ( totalamountsent < amount ) newamount = totalamountsent;
                 //int64_t temptst = mpz_get_si2(mpzTotalAllocations);
                 //fprintf(stderr, "checkamount RPC.%li totalallocations.%li\n",totalamountsent, temptst);
-                mpz_clear(mpzAmount); mpz_clear(mpzTotalAllocations);
             }
             else
             {
@@ -17,6 +17,8 @@
 #include "CCtokens_impl.h"
 
 #include "CCPegs.h"
+#include "CCPrices.h"
+#include "CCindex.h"
 #include "../importcoin.h"
 #include "key_io.h"
 #include "komodo_defs.h"
@@ -105,7 +107,6 @@ pegs CC is able to create a coin backed (by any supported coin with gateways CC
 extern uint8_t DecodeGatewaysBindOpRet(char *depositaddr,const CScript &scriptPubKey,uint256 &tokenid,std::string &coin,int64_t &totalsupply,uint256 &oracletxid,uint8_t &M,uint8_t &N,std::vector<CPubKey> &gatewaypubkeys,uint8_t &taddr,uint8_t &prefix,uint8_t &prefix2,uint8_t &wiftype);
 extern int32_t komodo_currentheight();
 extern int32_t prices_syntheticvec(std::vector<uint16_t> &vec, std::vector<std::string> synthetic);
-extern int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t minmax, int16_t leverage);
 
 CScript EncodePegsCreateOpRet(std::vector<uint256> bindtxids)
 {
@@ -475,29 +476,61 @@ std::string PegsDecodeAccountTx(CTransaction tx,CPubKey& pk,int64_t &amount,std:
     return ("");
 }
 
+// account state of a pegs tx, its marker is vout 0 on the global pegs address and vout 1 on the 1of2 address of the owner
+struct CPegsAccount
+{
+    char funcid;
+    uint256 tokenid;
+    std::string action;
+    std::pair<int64_t,int64_t> account;
+};
+
+static bool DecodePegsAccountMarker(const CTransaction &tx,int32_t vout,uint256 &pegstxid,CPegsAccount &entry)
+{
+    CPubKey pk; int64_t amount;
+
+    if ((vout!=0 && vout!=1) || tx.vout[vout].nValue!=CC_MARKER_VALUE || (entry.funcid=DecodePegsOpRet(tx,pegstxid,entry.tokenid))==0)
+        return (false);
+    entry.account=std::make_pair(0,0);
+    entry.action=PegsDecodeAccountTx(tx,pk,amount,entry.account);
+    return (true);
+}
+
+// tokens deposited to the pegs tokens address
+struct CPegsDeposit
+{
+    uint256 tokenid;
+    int64_t nValue;
+};
+
+static bool DecodePegsDeposit(const CTransaction &tx,int32_t vout,uint256 &pegstxid,CPegsDeposit &entry)
+{
+    if (DecodePegsOpRet(tx,pegstxid,entry.tokenid)==0)
+        return (false);
+    entry.nValue=tx.vout[vout].nValue;
+    return (true);
+}
+
+static CCUnspentsIndex<CPegsAccount> PegsAccounts(DecodePegsAccountMarker);
+static CCUnspentsIndex<CPegsDeposit> PegsDeposits(DecodePegsDeposit);
+
 char PegsFindAccount(struct CCcontract_info *cp,CPubKey pk,uint256 pegstxid, uint256 tokenid, uint256 &accounttxid, std::pair<int64_t,int64_t> &account)
 {
-    char coinaddr[64]; int64_t nValue,tmpamount; uint256 txid,spenttxid,hashBlock,tmptokenid,tmppegstxid;
-    CTransaction tx,acctx; int32_t numvouts,vout,ratio; char funcid,f; CPubKey pegspk,tmppk;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    ImportProof proof; CTransaction burntx; std::vector<CTxOut> payouts;
+    char coinaddr[64]; int64_t tmpamount; uint256 spenttxid,hashBlock,tmptokenid,tmppegstxid;
+    CTransaction tx; int32_t numvouts; char funcid,f; CPubKey pegspk,tmppk;
+    CCUnspentsIndex<CPegsAccount>::vecEntries accounts;
 
     accounttxid=zeroid;
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    PegsAccounts.Get(coinaddr,pegstxid,accounts);
+    for (CCUnspentsIndex<CPegsAccount>::vecEntries::const_iterator it=accounts.begin(); it!=accounts.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << std::endl);
-        if (vout == 1 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (f=DecodePegsOpRet(tx,tmppegstxid,tmptokenid))!=0 && pegstxid==tmppegstxid && tokenid==tmptokenid)
+        if (it->first.n == 1 && it->second.tokenid == tokenid)
         {            
-            accounttxid=txid;
-            funcid=f;
-            acctx=tx;
+            accounttxid=it->first.hash;
+            funcid=it->second.funcid;
+            account=it->second.account;
         }
     }
     if (accounttxid!=zeroid && myIsutxo_spentinmempool(spenttxid,ignorevin,accounttxid,1) != 0)
@@ -508,39 +541,64 @@ char PegsFindAccount(struct CCcontract_info *cp,CPubKey pk,uint256 pegstxid, uin
         {
             funcid=f;
             accounttxid=spenttxid;
-            acctx=tx;          
+            PegsDecodeAccountTx(tx,tmppk,tmpamount,account);
         }
     }
     if (accounttxid!=zeroid)
-    {
-        PegsDecodeAccountTx(acctx,tmppk,tmpamount,account);
         return(funcid);
-    }
     else return(0);
 }
 
-int64_t PegsGetTokenPrice(uint256 tokenid)
+// name and compiled price expression of a token, the token create tx never changes so it is read once
+struct CPegsToken
 {
-    int64_t price; CTransaction tokentx; uint256 hashBlock; std::vector<uint16_t> exp;
-    std::string name,desc; std::vector<uint8_t> vorigpubkey; int32_t numvouts;
+    std::string name;
+    std::shared_ptr<CPricesSynthetic> synthetic;
+};
 
-    if (myGetTransaction(tokenid,tokentx,hashBlock)!=0 && (numvouts=tokentx.vout.size())>0 && DecodeTokenCreateOpRetV1(tokentx.vout[numvouts-1].scriptPubKey,vorigpubkey,name,desc)=='c')
+static CCriticalSection cs_pegstokens;
+static std::map<uint256,CPegsToken> pegstokens;
+
+static bool PegsGetToken(uint256 tokenid,CPegsToken &token)
+{
+    CTransaction tokentx; uint256 hashBlock; std::string desc; std::vector<uint8_t> vorigpubkey; std::vector<uint16_t> exp; int32_t numvouts;
+    std::map<uint256,CPegsToken>::iterator it;
+
+    LOCK(cs_pegstokens);
+    if ((it=pegstokens.find(tokenid))!=pegstokens.end())
+    {
+        token=it->second;
+        return (true);
+    }
+    if (myGetTransaction(tokenid,tokentx,hashBlock)==0 || (numvouts=tokentx.vout.size())<=0 || DecodeTokenCreateOpRetV1(tokentx.vout[numvouts-1].scriptPubKey,vorigpubkey,token.name,desc)!='c')
+        return (false);
+    std::vector<std::string> vexpr;
+    SplitStr(desc, vexpr);
+    if (prices_syntheticvec(exp, vexpr)>=0)
     {
-        std::vector<std::string> vexpr;
-        SplitStr(desc, vexpr);
-        if (prices_syntheticvec(exp, vexpr)>=0 && (price = prices_syntheticprice(exp, komodo_currentheight(), 0, 1))>=0)
-            return (price);
+        token.synthetic=std::make_shared<CPricesSynthetic>();
+        prices_syntheticcompile(*token.synthetic, exp);
     }
+    pegstokens[tokenid]=token;
+    return (true);
+}
+
+int64_t PegsGetTokenPrice(uint256 tokenid)
+{
+    int64_t price; CPegsToken token;
+
+    if (PegsGetToken(tokenid,token) && token.synthetic && (price = prices_syntheticeval(*token.synthetic, komodo_currentheight(), komodo_priceget))>=0)
+        return (price);
     return (0);
 }
 
 std::string PegsGetTokenName(uint256 tokenid)
 {
-    CTransaction tokentx; uint256 hashBlock; std::string name,desc; std::vector<uint8_t> vorigpubkey; int32_t numvouts;
+    CPegsToken token;
 
-    if (myGetTransaction(tokenid,tokentx,hashBlock)!=0 && (numvouts=tokentx.vout.size())>0 && DecodeTokenCreateOpRetV1(tokentx.vout[numvouts-1].scriptPubKey,vorigpubkey,name,desc)=='c')
+    if (PegsGetToken(tokenid,token))
     {
-        return (name);
+        return (token.name);
     }
     CCerror = strprintf("cant find token create or invalid tokenid %s",tokenid.GetHex());
     LOGSTREAM("pegscc",CCLOG_INFO, stream << CCerror << std::endl);
@@ -593,42 +651,27 @@ double PegsGetAccountRatio(uint256 pegstxid,uint256 tokenid,uint256 accounttxid)
 
 double PegsGetGlobalRatio(uint256 pegstxid)
 {
-    char coinaddr[64]; int64_t nValue,amount,globaldebt=0; uint256 txid,accounttxid,hashBlock,tmppegstxid,tokenid;
-    CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey mypk,pegspk,pk;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account;
+    char coinaddr[64]; int64_t globaldebt=0; CPubKey pegspk;
+    CCUnspentsIndex<CPegsAccount>::vecEntries accounts; CCUnspentsIndex<CPegsDeposit>::vecEntries deposits;
     std::map<uint256,std::pair<int64_t,int64_t>> globalaccounts;
     struct CCcontract_info *cp,C;
 
     cp = CCinit(&C,EVAL_PEGS);
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    PegsAccounts.Get(coinaddr,pegstxid,accounts);
+    for (CCUnspentsIndex<CPegsAccount>::vecEntries::const_iterator it=accounts.begin(); it!=accounts.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid && (funcid=='F' || funcid=='G' || funcid=='E'))
+        if (it->first.n == 0 && (it->second.funcid=='F' || it->second.funcid=='G' || it->second.funcid=='E'))
         {              
-            PegsDecodeAccountTx(tx,pk,amount,account);
-            globalaccounts[tokenid].first+=account.first;
-            globalaccounts[tokenid].second+=account.second;
+            globalaccounts[it->second.tokenid].first+=it->second.account.first;
+            globalaccounts[it->second.tokenid].second+=it->second.account.second;
         }
     }
-    unspentOutputs.clear();
     GetTokensCCaddress(cp,coinaddr,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
-    {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 && DecodePegsOpRet(tx,tmppegstxid,tokenid)!=0 && pegstxid==tmppegstxid)
-        {
-            globalaccounts[tokenid].first+=nValue;
-        }
-    }
+    PegsDeposits.Get(coinaddr,pegstxid,deposits);
+    for (CCUnspentsIndex<CPegsDeposit>::vecEntries::const_iterator it=deposits.begin(); it!=deposits.end(); it++)
+        globalaccounts[it->second.tokenid].first+=it->second.nValue;
     mpz_t res,globaldeposit,a,b;
     mpz_init(res);
     mpz_init(globaldeposit);
@@ -657,36 +700,31 @@ double PegsGetGlobalRatio(uint256 pegstxid)
 
 std::string PegsFindBestAccount(struct CCcontract_info *cp,uint256 pegstxid, uint256 tokenid, int64_t tokenamount,uint256 &accounttxid, std::pair<int64_t,int64_t> &account)
 {
-    char coinaddr[64]; int64_t nValue,tmpamount; uint256 txid,hashBlock,tmptokenid,tmppegstxid;
-    CTransaction tx,acctx; int32_t numvouts,vout; char funcid,f; CPubKey pegspk,tmppk;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-    ImportProof proof; CTransaction burntx; std::vector<CTxOut> payouts; double ratio,maxratio=0;
-    std::pair<int64_t,int64_t> tmpaccount;
+    char coinaddr[64]; uint256 txid; CPubKey pegspk; double ratio,maxratio=0;
+    CCUnspentsIndex<CPegsAccount>::vecEntries accounts; CCUnspentsIndex<CPegsAccount>::vecEntries::const_iterator best;
 
     accounttxid=zeroid;
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    PegsAccounts.Get(coinaddr,pegstxid,accounts);
+    for (CCUnspentsIndex<CPegsAccount>::vecEntries::const_iterator it=accounts.begin(); it!=accounts.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << std::endl);
-        if (vout == 0 && nValue == CC_MARKER_VALUE && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,0) == 0 &&
-            (ratio=PegsGetAccountRatio(pegstxid,tokenid,txid))>(ASSETCHAINS_PEGSCCPARAMS[2]?ASSETCHAINS_PEGSCCPARAMS[2]:PEGS_ACCOUNT_YELLOW_ZONE) && ratio>maxratio)
+        txid = it->first.hash;
+        if (it->first.n == 0 && it->second.tokenid == tokenid && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,0) == 0 &&
+            (ratio=PegsGetRatio(tokenid,it->second.account))>(ASSETCHAINS_PEGSCCPARAMS[2]?ASSETCHAINS_PEGSCCPARAMS[2]:PEGS_ACCOUNT_YELLOW_ZONE) && ratio>maxratio)
         {   
-            if (myGetTransaction(txid,tx,hashBlock)!=0 && !PegsDecodeAccountTx(tx,tmppk,tmpamount,tmpaccount).empty() && tmpaccount.first>=tokenamount)
+            if (!it->second.action.empty() && it->second.account.first>=tokenamount)
             {
                 accounttxid=txid;
-                acctx=tx;
+                best=it;
                 maxratio=ratio;
             }
         }
     }
     if (accounttxid!=zeroid)
     {
-        return(PegsDecodeAccountTx(acctx,tmppk,tmpamount,account));
+        account=best->second.account;
+        return(best->second.action);
     }
     else return("");
 }
@@ -1127,9 +1165,9 @@ UniValue PegsAccountHistory(const CPubKey& pk,uint256 pegstxid)
 
 UniValue PegsAccountInfo(const CPubKey& pk,uint256 pegstxid)
 {
-    char coinaddr[64]; int64_t nValue,amount; uint256 txid,accounttxid,hashBlock,tmptokenid,tmppegstxid; std::map<uint256,std::pair<int64_t,int64_t>> accounts;
-    CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey mypk,pegspk,tmppk; std::vector<uint256> bindtxids;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account; 
+    char coinaddr[64]; uint256 hashBlock; std::map<uint256,std::pair<int64_t,int64_t>> accounts;
+    CTransaction tx; int32_t numvouts; CPubKey mypk,pegspk; std::vector<uint256> bindtxids;
+    CCUnspentsIndex<CPegsAccount>::vecEntries markers;
     UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C;
 
     if (myGetTransaction(pegstxid,tx,hashBlock)==0 || (numvouts=tx.vout.size())<=0)
@@ -1142,21 +1180,11 @@ UniValue PegsAccountInfo(const CPubKey& pk,uint256 pegstxid)
     mypk = pk.IsValid()?pk:pubkey2pk(Mypubkey());
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,mypk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    PegsAccounts.Get(coinaddr,pegstxid,markers);
+    for (CCUnspentsIndex<CPegsAccount>::vecEntries::const_iterator it=markers.begin(); it!=markers.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        //LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << std::endl);
-        if (vout == 1 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tmptokenid))!=0 && pegstxid==tmppegstxid)
-        {
-            //LOGSTREAM("pegscc",CCLOG_DEBUG2, stream << "txid=" << txid.GetHex() << ", vout=" << vout << ", nValue=" << nValue << ", tokenid=" << tmptokenid.GetHex() << std::endl);
-            PegsDecodeAccountTx(tx,tmppk,amount,account);           
-            accounts[tmptokenid].first=account.first;
-            accounts[tmptokenid].second=account.second;
-        }
+        if (it->first.n == 1)
+            accounts[it->second.tokenid]=it->second.account;
     }
     for (std::map<uint256,std::pair<int64_t,int64_t>>::iterator it = accounts.begin(); it != accounts.end(); ++it)
     {
@@ -1174,10 +1202,10 @@ UniValue PegsAccountInfo(const CPubKey& pk,uint256 pegstxid)
 
 UniValue PegsWorstAccounts(uint256 pegstxid)
 {
-    char coinaddr[64]; int64_t nValue,amount; uint256 txid,accounttxid,hashBlock,tmppegstxid,tokenid,prev;
-    CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey pegspk,pk; double ratio; std::vector<uint256> bindtxids;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account;
-    UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C; std::multimap<uint256,UniValue> map;
+    char coinaddr[64]; uint256 hashBlock,tokenid;
+    CTransaction tx; int32_t numvouts; CPubKey pegspk; double ratio; std::vector<uint256> bindtxids;
+    CCUnspentsIndex<CPegsAccount>::vecEntries accounts; std::pair<int64_t,int64_t> account;
+    UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C; std::map<uint256,std::multimap<double,UniValue,std::greater<double>>> map;
 
     if (myGetTransaction(pegstxid,tx,hashBlock)==0 || (numvouts=tx.vout.size())<=0)
         CCERR_RESULT("pegscc",CCLOG_INFO, stream << "cant find pegstxid " << pegstxid.GetHex());
@@ -1188,49 +1216,42 @@ UniValue PegsWorstAccounts(uint256 pegstxid)
     cp = CCinit(&C,EVAL_PEGS);
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    PegsAccounts.Get(coinaddr,pegstxid,accounts);
+    for (CCUnspentsIndex<CPegsAccount>::vecEntries::const_iterator it=accounts.begin(); it!=accounts.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid)
+        if (it->first.n == 0)
         {               
-            PegsDecodeAccountTx(tx,pk,amount,account);
+            tokenid=it->second.tokenid;
+            account=it->second.account;
             if (account.first==0 || account.second==0 || PegsGetTokenPrice(tokenid)<=0) ratio=0;
             else ratio=PegsGetRatio(tokenid,account);
             if (ratio>PEGS_ACCOUNT_RED_ZONE)
             {
                 UniValue obj(UniValue::VOBJ);
-                obj.push_back(Pair("accounttxid",txid.GetHex()));
+                obj.push_back(Pair("accounttxid",it->first.hash.GetHex()));
                 obj.push_back(Pair("deposit",account.first));
                 obj.push_back(Pair("debt",account.second));
                 obj.push_back(Pair("ratio",strprintf("%.2f%%",ratio)));                
-                map.insert(std::pair<uint256,UniValue>(tokenid,obj));
+                map[tokenid].insert(std::make_pair(ratio,obj));
             }
         }
     }
-    std::multimap<uint256,UniValue>::iterator it = map.begin();
-    for (prev=it->first; it != map.end(); ++it)
+    // worst ratio first for each token
+    for (std::map<uint256,std::multimap<double,UniValue,std::greater<double>>>::iterator it = map.begin(); it != map.end(); ++it)
     {
-        if (it->first!=prev)
-        {
-            result.push_back(Pair(PegsGetTokenName(prev),acc));
-            acc.clear();
-            prev=it->first;
-        }
-        acc.push_back(it->second);
+        acc.clear();
+        for (std::multimap<double,UniValue,std::greater<double>>::iterator a = it->second.begin(); a != it->second.end(); ++a)
+            acc.push_back(a->second);
+        result.push_back(Pair(PegsGetTokenName(it->first),acc));
     }
-    result.push_back(Pair(PegsGetTokenName(prev),acc));
     return(result);
 }
 
 UniValue PegsInfo(uint256 pegstxid)
 {
-    char coinaddr[64]; int64_t nValue,amount; uint256 txid,accounttxid,hashBlock,tmppegstxid,tokenid;
-    CTransaction tx; int32_t numvouts,vout; char funcid; CPubKey pegspk,pk; std::vector<uint256> bindtxids;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs; std::pair<int64_t,int64_t> account;
+    char coinaddr[64]; uint256 hashBlock;
+    CTransaction tx; int32_t numvouts; CPubKey pegspk; std::vector<uint256> bindtxids;
+    CCUnspentsIndex<CPegsAccount>::vecEntries accounts; CCUnspentsIndex<CPegsDeposit>::vecEntries deposits;
     std::map<uint256,std::pair<int64_t,int64_t>> globalaccounts; double globaldeposit=0;
     UniValue result(UniValue::VOBJ),acc(UniValue::VARR); struct CCcontract_info *cp,C;
 
@@ -1243,33 +1264,19 @@ UniValue PegsInfo(uint256 pegstxid)
     cp = CCinit(&C,EVAL_PEGS);
     pegspk = GetUnspendable(cp,0);
     GetCCaddress1of2(cp,coinaddr,pegspk,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    PegsAccounts.Get(coinaddr,pegstxid,accounts);
+    for (CCUnspentsIndex<CPegsAccount>::vecEntries::const_iterator it=accounts.begin(); it!=accounts.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (vout == 0 && nValue == CC_MARKER_VALUE && myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 &&
-            (funcid=DecodePegsOpRet(tx,tmppegstxid,tokenid))!=0 && pegstxid==tmppegstxid)
+        if (it->first.n == 0)
         {               
-            PegsDecodeAccountTx(tx,pk,amount,account);
-            globalaccounts[tokenid].first+=account.first;
-            globalaccounts[tokenid].second+=account.second;
+            globalaccounts[it->second.tokenid].first+=it->second.account.first;
+            globalaccounts[it->second.tokenid].second+=it->second.account.second;
         }
     }
-    unspentOutputs.clear();
     GetTokensCCaddress(cp,coinaddr,pegspk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
-    {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        nValue = (int64_t)it->second.satoshis;
-        if (myGetTransaction(txid,tx,hashBlock) != 0 && (numvouts=tx.vout.size())>0 && DecodePegsOpRet(tx,tmppegstxid,tokenid)!=0 && pegstxid==tmppegstxid)
-        {
-            globalaccounts[tokenid].first+=nValue;
-        }
-    }
+    PegsDeposits.Get(coinaddr,pegstxid,deposits);
+    for (CCUnspentsIndex<CPegsDeposit>::vecEntries::const_iterator it=deposits.begin(); it!=deposits.end(); it++)
+        globalaccounts[it->second.tokenid].first+=it->second.nValue;
     for (std::map<uint256,std::pair<int64_t,int64_t>>::iterator it = globalaccounts.begin(); it != globalaccounts.end(); ++it)
     {
         UniValue obj(UniValue::VOBJ);
@@ -133,6 +133,7 @@ typedef struct TotalFund {
 } TotalFund;
 
 int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t height, int16_t leverage, std::vector<uint16_t> vec, int64_t positionsize, int64_t &profits, int64_t &outprice);
+int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t height, int16_t leverage, const CPricesSynthetic &synthetic, int64_t positionsize, int64_t &profits, int64_t &outprice);
 static bool prices_isacceptableamount(const std::vector<uint16_t> &vecparsed, int64_t amount, int16_t leverage);
 
 // helpers:
@@ -965,8 +966,48 @@ int32_t prices_syntheticvec(std::vector<uint16_t> &vec, std::vector<std::string>
     return(0);
 }
 
-// calculates price for synthetic expression
-int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t minmax, int16_t leverage)
+// common error reporting of the synthetic price evaluators
+static int64_t prices_syntheticresult(int32_t errcode, int32_t depth, int64_t den, int64_t priceIndex)
+{
+    if (errcode != 0) 
+        std::cerr << "prices_syntheticprice errcode in switch=" << errcode << std::endl;
+    
+    if( errcode == -1 )  {
+        std::cerr << "prices_syntheticprice error getting price (could be end of chain)" << std::endl;
+        return errcode;
+    }
+
+    if (errcode == -13) {
+        std::cerr << "prices_syntheticprice overflow in price" << std::endl;
+        return errcode;
+    }
+    if (errcode == -14) {
+        std::cerr << "prices_syntheticprice price is zero, not enough historic data yet" << std::endl;
+        return errcode;
+    }
+    if (errcode == -15) {
+        std::cerr << "prices_syntheticprice division by zero" << std::endl;
+        return errcode;
+    }
+    if (den == 0) {
+        std::cerr << "prices_syntheticprice den==0 return err=-11" << std::endl;
+        return(-11);
+    }
+    else if (depth != 0) {
+        std::cerr << "prices_syntheticprice depth!=0 err=-12" << std::endl;
+        return(-12);
+    }
+    else if (errcode != 0) {
+        std::cerr << "prices_syntheticprice err=" << errcode << std::endl;
+        return(errcode);
+    }
+//    std::cerr << "prices_syntheticprice priceIndex=totalprice/den=" << priceIndex << " den=" << den << std::endl;
+
+    return priceIndex;
+}
+
+// calculates price for synthetic expression with gmp, reference for the compiled evaluator
+int64_t prices_syntheticprice_mpz(const std::vector<uint16_t> &vec, int32_t height, prices_getfn getprice)
 {
     int32_t i, value, errcode, depth, retval = -1;
     uint16_t opcode;
@@ -999,8 +1040,12 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
         switch (opcode & KOMODO_PRICEMASK)
         {
         case 0: // indices 
+            if (depth >= 4) {
+                errcode = -12;  // the price stack holds 4 operands
+                break;
+            }
             pricestack[depth] = 0;
-            if (komodo_priceget(pricedata, value, height, 1) >= 0)
+            if (getprice(pricedata, value, height, 1) >= 0)
             {
                 //std::cerr << "prices_syntheticprice" << " pricedata[0]=" << pricedata[0] << " pricedata[1]=" << pricedata[1] << " pricedata[2]=" << pricedata[2] << std::endl;
                 // push price to the prices stack
@@ -1060,6 +1105,10 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
             if (depth >= 2) {
                 b = pricestack[--depth];
                 a = pricestack[--depth];
+                if (b == 0) {
+                    errcode = -15;
+                    break;
+                }
                 // pricestack[depth++] = (a * SATOSHIDEN) / b;
                 mpz_set_si(mpzA, a);
                 mpz_set_si(mpzB, b);
@@ -1074,6 +1123,10 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
         case PRICES_INV:    // "!"
             if (depth >= 1) {
                 a = pricestack[--depth];
+                if (a == 0) {
+                    errcode = -15;
+                    break;
+                }
                 // pricestack[depth++] = (SATOSHIDEN * SATOSHIDEN) / a;
                 mpz_set_si(mpzA, a);
                 mpz_set_ui(mpzResult, SATOSHIDEN);
@@ -1090,6 +1143,10 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
                 c = pricestack[--depth];
                 b = pricestack[--depth];
                 a = pricestack[--depth];
+                if (b == 0 || c == 0) {
+                    errcode = -15;
+                    break;
+                }
                 // pricestack[depth++] = (((a * SATOSHIDEN) / b) * SATOSHIDEN) / c;
                 mpz_set_si(mpzA, a);
                 mpz_set_si(mpzB, b);
@@ -1109,6 +1166,10 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
                 c = pricestack[--depth];
                 b = pricestack[--depth];
                 a = pricestack[--depth];
+                if (c == 0) {
+                    errcode = -15;
+                    break;
+                }
                 // pricestack[depth++] = (a * b) / c;
                 mpz_set_si(mpzA, a);
                 mpz_set_si(mpzB, b);
@@ -1145,6 +1206,10 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
                 c = pricestack[--depth];
                 b = pricestack[--depth];
                 a = pricestack[--depth];
+                if (a == 0 || b == 0 || c == 0) {
+                    errcode = -15;
+                    break;
+                }
                 //pricestack[depth++] = (((((SATOSHIDEN * SATOSHIDEN) / a) * SATOSHIDEN) / b) * SATOSHIDEN) / c;
                 mpz_set_si(mpzA, a);
                 mpz_set_si(mpzB, b);
@@ -1199,41 +1264,242 @@ int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t
     mpz_clear(mpzTotalPrice);
     mpz_clear(mpzPriceValue);
 
-    if (errcode != 0) 
-        std::cerr << "prices_syntheticprice errcode in switch=" << errcode << std::endl;
-    
-    if( errcode == -1 )  {
-        std::cerr << "prices_syntheticprice error getting price (could be end of chain)" << std::endl;
-        return errcode;
-    }
+    return prices_syntheticresult(errcode, depth, den, priceIndex);
+}
 
-    if (errcode == -13) {
-        std::cerr << "prices_syntheticprice overflow in price" << std::endl;
-        return errcode;
-    }
-    if (errcode == -14) {
-        std::cerr << "prices_syntheticprice price is zero, not enough historic data yet" << std::endl;
-        return errcode;
-    }
-    if (den == 0) {
-        std::cerr << "prices_syntheticprice den==0 return err=-11" << std::endl;
-        return(-11);
-    }
-    else if (depth != 0) {
-        std::cerr << "prices_syntheticprice depth!=0 err=-12" << std::endl;
-        return(-12);
+// decodes the opcodes once, errors are still reported by prices_syntheticeval in evaluation order
+void prices_syntheticcompile(CPricesSynthetic &synthetic, const std::vector<uint16_t> &vec)
+{
+    synthetic.vec = vec;
+    synthetic.ops.resize(vec.size());
+    for (int32_t i = 0; i < vec.size(); i++)
+    {
+        synthetic.ops[i].code = vec[i] & KOMODO_PRICEMASK;
+        synthetic.ops[i].value = vec[i] & (KOMODO_MAXPRICES - 1);
     }
-    else if (errcode != 0) {
-        std::cerr << "prices_syntheticprice err=" << errcode << std::endl;
-        return(errcode);
+}
+
+// same as mpz_get_si(): the low bits of the magnitude with the sign of x
+static int64_t prices_int128_get_si(__int128 x)
+{
+    unsigned __int128 mag = (x < 0) ? -(unsigned __int128)x : (unsigned __int128)x;
+    uint64_t low = (uint64_t)mag;
+
+    if (x > 0)
+        return (int64_t)(low & (uint64_t)std::numeric_limits<int64_t>::max());
+    else if (x < 0)
+        return -1 - (int64_t)((low - 1) & (uint64_t)std::numeric_limits<int64_t>::max());
+    return 0;
+}
+
+// calculates price for a compiled synthetic expression in 128 bit integers, results are identical to prices_syntheticprice_mpz
+int64_t prices_syntheticeval(const CPricesSynthetic &synthetic, int32_t height, prices_getfn getprice)
+{
+    const __int128 satoshiden = SATOSHIDEN;
+    int64_t pricedata[PRICES_MAXDATAPOINTS], pricestack[4], a, b, c, den = 0;
+    __int128 totalprice = 0, result;
+    int32_t depth = 0, errcode = 0;
+    bool overflow;
+
+    for (const auto &op : synthetic.ops)
+    {
+        result = 0;
+        overflow = false;
+        switch (op.code)
+        {
+        case 0: // indices 
+            if (depth >= 4) {
+                errcode = -12;
+                break;
+            }
+            pricestack[depth] = 0;
+            if (getprice(pricedata, op.value, height, 1) >= 0)
+                pricestack[depth] = pricedata[2];
+            else
+                errcode = -1;
+
+            if (pricestack[depth] == 0)
+                errcode = -14;
+
+            depth++;
+            break;
+
+        case PRICES_WEIGHT: // multiply by weight and consume top of stack by updating price
+            if (depth == 1) {
+                depth--;
+                overflow = __builtin_add_overflow(totalprice, (__int128)pricestack[0] * op.value, &totalprice);
+                den += op.value;
+            }
+            else
+                errcode = -2;
+            break;
+
+        case PRICES_MULT:   // "*"
+            if (depth >= 2) {
+                b = pricestack[--depth];
+                a = pricestack[--depth];
+                result = (__int128)a * b / satoshiden;
+                pricestack[depth++] = prices_int128_get_si(result);
+            }
+            else
+                errcode = -3;
+            break;
+
+        case PRICES_DIV:    // "/"
+            if (depth >= 2) {
+                b = pricestack[--depth];
+                a = pricestack[--depth];
+                if (b == 0) {
+                    errcode = -15;
+                    break;
+                }
+                result = a * satoshiden / b;
+                pricestack[depth++] = prices_int128_get_si(result);
+            }
+            else
+                errcode = -4;
+            break;
+
+        case PRICES_INV:    // "!"
+            if (depth >= 1) {
+                a = pricestack[--depth];
+                if (a == 0) {
+                    errcode = -15;
+                    break;
+                }
+                result = satoshiden * satoshiden / a;
+                pricestack[depth++] = prices_int128_get_si(result);
+            }
+            else
+                errcode = -5;
+            break;
+
+        case PRICES_MDD:    // "*//"
+            if (depth >= 3) {
+                c = pricestack[--depth];
+                b = pricestack[--depth];
+                a = pricestack[--depth];
+                if (b == 0 || c == 0) {
+                    errcode = -15;
+                    break;
+                }
+                result = a * satoshiden / b;
+                result = result * satoshiden / c;
+                pricestack[depth++] = prices_int128_get_si(result);
+            }
+            else
+                errcode = -6;
+            break;
+
+        case PRICES_MMD:    // "**/"
+            if (depth >= 3) {
+                c = pricestack[--depth];
+                b = pricestack[--depth];
+                a = pricestack[--depth];
+                if (c == 0) {
+                    errcode = -15;
+                    break;
+                }
+                result = (__int128)a * b / c;
+                pricestack[depth++] = prices_int128_get_si(result);
+            }
+            else
+                errcode = -7;
+            break;
+
+        case PRICES_MMM:    // "***"
+            if (depth >= 3) {
+                c = pricestack[--depth];
+                b = pricestack[--depth];
+                a = pricestack[--depth];
+                result = (__int128)a * b / satoshiden;
+                overflow = __builtin_mul_overflow(result, (__int128)c, &result);
+                result /= satoshiden;
+                pricestack[depth++] = prices_int128_get_si(result);
+            }
+            else
+                errcode = -8;
+            break;
+                
+        case PRICES_DDD:    // "///"
+            if (depth >= 3) {
+                c = pricestack[--depth];
+                b = pricestack[--depth];
+                a = pricestack[--depth];
+                if (a == 0 || b == 0 || c == 0) {
+                    errcode = -15;
+                    break;
+                }
+                result = satoshiden * satoshiden / a;
+                result = result * satoshiden / b;
+                result = result * satoshiden / c;
+                pricestack[depth++] = prices_int128_get_si(result);
+            }
+            else
+                errcode = -9;
+            break;
+
+        default:
+            errcode = -10;
+            break;
+        }
+
+        // only "***" and the weighted sum can exceed 128 bits, gmp has the exact answer for such operands
+        if (overflow)
+            return prices_syntheticprice_mpz(synthetic.vec, height, getprice);
+
+        // check overflow:
+        if (result > std::numeric_limits<int64_t>::max()) {
+            errcode = -13;
+            break;
+        }
+
+        if (errcode != 0)
+            break;
     }
-//    std::cerr << "prices_syntheticprice priceIndex=totalprice/den=" << priceIndex << " den=" << den << std::endl;
 
-    return priceIndex;
+    if (den != 0)
+        totalprice /= den;   // price / den
+
+    return prices_syntheticresult(errcode, depth, den, prices_int128_get_si(totalprice));
+}
+
+static CCriticalSection cs_pricessynthetic;
+static std::map<uint256, std::shared_ptr<const CPricesSynthetic> > mapPricesSynthetic;
+
+// the synthetic expression of a bet never changes, compile it once per bet txid
+std::shared_ptr<const CPricesSynthetic> prices_syntheticcached(uint256 bettxid, const std::vector<uint16_t> &vec)
+{
+    LOCK(cs_pricessynthetic);
+    std::map<uint256, std::shared_ptr<const CPricesSynthetic> >::iterator it = mapPricesSynthetic.find(bettxid);
+    if (it != mapPricesSynthetic.end())
+        return it->second;
+
+    if (mapPricesSynthetic.size() >= PRICES_SYNTHETICCACHESIZE)
+        mapPricesSynthetic.clear();
+    std::shared_ptr<CPricesSynthetic> synthetic = std::make_shared<CPricesSynthetic>();
+    prices_syntheticcompile(*synthetic, vec);
+    mapPricesSynthetic[bettxid] = synthetic;
+    return synthetic;
+}
+
+// calculates price for synthetic expression
+int64_t prices_syntheticprice(std::vector<uint16_t> vec, int32_t height, int32_t minmax, int16_t leverage)
+{
+    CPricesSynthetic synthetic;
+    prices_syntheticcompile(synthetic, vec);
+    return prices_syntheticeval(synthetic, height, komodo_priceget);
 }
 
 // calculates costbasis and profit/loss for the bet
 int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t height, int16_t leverage, std::vector<uint16_t> vec, int64_t positionsize,  int64_t &profits, int64_t &outprice)
+{
+    CPricesSynthetic synthetic;
+    prices_syntheticcompile(synthetic, vec);
+    return prices_syntheticprofits(costbasis, firstheight, height, leverage, synthetic, positionsize, profits, outprice);
+}
+
+int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t height, int16_t leverage, const CPricesSynthetic &synthetic, int64_t positionsize,  int64_t &profits, int64_t &outprice)
 {
     int64_t price;
 #ifndef TESTMODE
@@ -1250,7 +1516,7 @@ int32_t prices_syntheticprofits(int64_t &costbasis, int32_t firstheight, int32_t
 
     int32_t minmax = (height < firstheight + COSTBASIS_PERIOD);  // if we are within 24h then use min or max value 
 
-    if ((price = prices_syntheticprice(vec, height, minmax, leverage)) < 0)
+    if ((price = prices_syntheticeval(synthetic, height, komodo_priceget)) < 0)
     {
         fprintf(stderr, "error getting synthetic price at height.%d\n", height);
         return -1;
@@ -1600,7 +1866,7 @@ UniValue PricesAddFunding(int64_t txfee, uint256 bettxid, int64_t amount)
 }
 
 // scan chain from the initial bet's first position upto the chain tip and calculate bet's costbasises and profits, breaks if rekt detected 
-int32_t prices_scanchain(std::vector<OneBetData> &bets, int16_t leverage, std::vector<uint16_t> vec, int64_t &lastprice, int32_t &endheight) {
+int32_t prices_scanchain(std::vector<OneBetData> &bets, int16_t leverage, const CPricesSynthetic &synthetic, int64_t &lastprice, int32_t &endheight) {
 
     if (bets.size() == 0)
         return -1;
@@ -1616,7 +1882,7 @@ int32_t prices_scanchain(std::vector<OneBetData> &bets, int16_t leverage, std::v
 
             if (height > bets[i].firstheight) {
 
-                int32_t retcode = prices_syntheticprofits(bets[i].costbasis, bets[i].firstheight, height, leverage, vec, bets[i].positionsize, bets[i].profits, lastprice);
+                int32_t retcode = prices_syntheticprofits(bets[i].costbasis, bets[i].firstheight, height, leverage, synthetic, bets[i].positionsize, bets[i].profits, lastprice);
                 if (retcode < 0) {
                     std::cerr << "prices_scanchain() prices_syntheticprofits returned -1, finishing..." << std::endl;
                     stop = true;
@@ -1796,7 +2062,7 @@ int32_t prices_getbetinfo(uint256 bettxid, BetInfo &betinfo)
             }
 
 
-            if (prices_scanchain(betinfo.bets, betinfo.leverage, betinfo.vecparsed, betinfo.lastprice, betinfo.lastheight) < 0) {
+            if (prices_scanchain(betinfo.bets, betinfo.leverage, *prices_syntheticcached(bettxid, betinfo.vecparsed), betinfo.lastprice, betinfo.lastheight) < 0) {
                 return -4;
             }
 
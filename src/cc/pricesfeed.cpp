@@ -22,6 +22,7 @@
 #include <chrono>
 #include <thread>
 #include <time.h>
+#include <curl/curl.h>
 #ifndef _WIN32
 #include <dlfcn.h>
 #else
@@ -55,8 +56,37 @@ static void logJsonPath(const char *fname, T errToStream) {
 #define LOGSTREAM(name, level, streamexp) logJsonPath(NULL, [=](std::ostringstream &stream){ streamexp; })
 #define LOGSTREAMFN(name, level, streamexp) logJsonPath(__func__, [=](std::ostringstream &stream){ streamexp; })
 
-// external defs:
-cJSON *get_urljson(char *url);
+static size_t feed_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    static_cast<std::string*>(userdata)->append(ptr, size * nmemb);
+    return size * nmemb;
+}
+
+// get json from url, the whole request is limited by the feed timeout so a stalled web resource can't hold up the poll
+static cJSON *get_urljson_timeout(const std::string &url, uint32_t timeout)
+{
+    std::string response;
+    CURL *curl = curl_easy_init();
+    if (curl == NULL)
+        return NULL;
+
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "mozilla/4.0");
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);  // feeds are polled from several threads
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)timeout * 1000);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, feed_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+    CURLcode res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+
+    if (res != CURLE_OK) {
+        LOGSTREAMFN("prices", CCLOG_INFO, stream << "request failed url=" << url << " error=" << curl_easy_strerror(res) << std::endl);
+        return NULL;
+    }
+    return cJSON_Parse(response.c_str());
+}
 
 // load so libs helpers:
 static void *my_so_open(const char *unixpath)
@@ -124,7 +154,8 @@ static std::vector<CFeedConfigItem> feedconfig({
             { "BTC_EUR", "/bpi/EUR/rate_float" }
         },
         PF_DEFAULTINTERVAL, // interval
-        10000  // multiplier
+        10000,  // multiplier
+        PF_DEFAULTTIMEOUT   // timeout
     } 
 });
 
@@ -449,7 +480,24 @@ bool PricesFeedParseConfig(const cJSON *json)
         }
         LOGSTREAMFN("prices", CCLOG_INFO, stream << "config item 'interval' used value=" << citem.interval << std::endl);
 
-        feedconfig.push_back(citem);  // add new feed config item
+        citem.timeout = PF_DEFAULTTIMEOUT;
+        cJSON *jtimeout = cJSON_GetObjectItem(jitem, "timeout");
+        if (jtimeout) {
+            if (cJSON_IsNumber(jtimeout) && jtimeout->valuedouble >= 1 && jtimeout->valuedouble < citem.interval)
+                citem.timeout = jtimeout->valuedouble;
+            else {
+                LOGSTREAMFN("prices", CCLOG_INFO, stream << "config item 'timeout' value is incorrect, should be number >= 1 and less than 'interval'" << std::endl);
+                return false;
+            }
+        }
+        LOGSTREAMFN("prices", CCLOG_INFO, stream << "config item 'timeout' used value=" << citem.timeout << std::endl);
+
+        // an item with the name of an existing one replaces it, this allows to retarget the default feed
+        std::vector<CFeedConfigItem>::iterator iter = std::find_if(feedconfig.begin(), feedconfig.end(), [&](const CFeedConfigItem &c) { return c.name == citem.name; });
+        if (iter != feedconfig.end())
+            *iter = citem;
+        else
+            feedconfig.push_back(citem);  // add new feed config item
     }
 
     return true;
@@ -458,6 +506,9 @@ bool PricesFeedParseConfig(const cJSON *json)
 
 bool PricesInitStatuses()
 {
+    // must be done before feeds are polled from several threads:
+    curl_global_init(CURL_GLOBAL_ALL);
+
     // get symbols and init prices status for each symbol:
     if (!init_prices_statuses())
         return false;
@@ -486,7 +537,8 @@ void PricesAddOldForexConfig(const std::vector<std::string> &ac_forex)
     { },     // substituteResult not used
     {},      // manyResults 
     PF_DEFAULTINTERVAL, // interval
-    10000  // multiplier
+    10000,  // multiplier
+    PF_DEFAULTTIMEOUT   // timeout
     };
 
     for (const auto & name : ac_forex)
@@ -513,7 +565,8 @@ void PricesAddOldPricesConfig(const std::vector<std::string> &ac_prices)
             { "", "/price" },    // substituteResult 
             { },            // manyResults not used
             PF_DEFAULTINTERVAL, // interval
-            100000000  // multiplier
+            100000000,  // multiplier
+            PF_DEFAULTTIMEOUT   // timeout
     };
 
     for (const auto & name : ac_prices)
@@ -536,7 +589,8 @@ void PricesAddOldStocksConfig(const std::vector<std::string> &ac_stocks)
     {},            // substituteResult not used
     {},            // manyResults 
     PF_DEFAULTINTERVAL, // interval
-    100  // multiplier
+    100,  // multiplier
+    PF_DEFAULTTIMEOUT   // timeout
     };
 
     for (int i = 0; i < ac_stocks.size(); i ++)
@@ -821,7 +875,7 @@ static uint32_t poll_one_feed(const CFeedConfigItem &citem, const CPollStatus &p
             {
                 std::string url = citem.url;
                 url.replace(mpos, 2, subst);
-                cJSON *json = get_urljson((char*)url.c_str()); //poll
+                cJSON *json = get_urljson_timeout(url, citem.timeout); //poll
                 if (json != NULL)
                 {
                     std::string symbol;
@@ -873,7 +927,7 @@ static uint32_t poll_one_feed(const CFeedConfigItem &citem, const CPollStatus &p
     }
     else
     {   // many values in one json result
-        cJSON *json = get_urljson((char*)citem.url.c_str()); // poll
+        cJSON *json = get_urljson_timeout(citem.url, citem.timeout); // poll
         if (json != NULL)
         {
             bool parsed = false;
@@ -948,11 +1002,19 @@ void store_price_value(const std::string &symbol, int32_t configid, uint32_t val
     // std::cerr << __func__ << "\t" << "after feedConfigIds.size()=" << iter->feedConfigIds.size() << " averagevalue=" << iter->averageValue << std::endl;
 }
 
+// result of polling one feed in its own thread
+struct CFeedPollResult
+{
+    std::vector<uint32_t> values;
+    std::vector<std::string> symbols;
+    uint32_t numadded;
+
+    CFeedPollResult() : numadded(0) {}
+};
+
 uint32_t PricesFeedPoll(uint32_t *pricevalues, const uint32_t maxsize, uint32_t *timestamp)
 {
     uint32_t offset;
-    uint32_t currentValNumber = 0;
-    uint32_t nsymbols = 0;
     time_t now = time(NULL);
     *timestamp = (uint32_t)now;
     bool updated = false;
@@ -966,35 +1028,49 @@ uint32_t PricesFeedPoll(uint32_t *pricevalues, const uint32_t maxsize, uint32_t
     for (int32_t iconfig = 0; iconfig < feedconfig.size(); iconfig++)
     {
         uint32_t size1 = feed_config_size(feedconfig[iconfig]);
-        std::shared_ptr<uint32_t> pricesbuf1((uint32_t*)calloc(size1, sizeof(uint32_t)));
+        if (offset + size1 >= maxsize) 
+            return PF_BUFOVERFLOW;  // buffer overflow
+        offset += size1;
+    }
 
+    // poll all due feeds at once so a slow web resource delays only its own symbols,
+    // each request is limited by the feed timeout
+    std::vector<CFeedPollResult> results(feedconfig.size());
+    std::vector<std::thread> pollers;
+    for (int32_t iconfig = 0; iconfig < feedconfig.size(); iconfig++)
+    {
         if (!pollStatuses[iconfig].lasttime || now > pollStatuses[iconfig].lasttime + feedconfig[iconfig].interval)  // first time poll
         {
             //LOGSTREAMFN("prices", CCLOG_INFO, stream << "entering poll, !pollStatuses[iconfig].lasttime=" << !pollStatuses[iconfig].lasttime << std::endl);
-            std::vector<std::string> symbols;
-            // poll url and get values and symbols
-            if (poll_one_feed(feedconfig[iconfig], pollStatuses[iconfig], pricesbuf1.get(), symbols) > 0)
+            results[iconfig].values.resize(feed_config_size(feedconfig[iconfig]));
+            pollers.push_back(std::thread([&results, iconfig]() {
+                // poll url and get values and symbols
+                results[iconfig].numadded = poll_one_feed(feedconfig[iconfig], pollStatuses[iconfig], results[iconfig].values.data(), results[iconfig].symbols);
+            }));
+        }
+    }
+    for (auto &poller : pollers)
+        poller.join();
+
+    for (int32_t iconfig = 0; iconfig < feedconfig.size(); iconfig++)
+    {
+        if (results[iconfig].numadded > 0)
+        {
+            uint32_t size1 = feed_config_size(feedconfig[iconfig]);
+            if (size1 != results[iconfig].symbols.size()) {
+                LOGSTREAMFN("prices", CCLOG_INFO, stream << "internal error: incorrect returned symbol size" << std::endl);
+                return 0;
+            }
+            for (int32_t ibuf = 0; ibuf < size1; ibuf++)
             {
-                if (size1 != symbols.size()) {
-                    LOGSTREAMFN("prices", CCLOG_INFO, stream << "internal error: incorrect returned symbol size" << std::endl);
-                    return 0;
-                }
-                for (int32_t ibuf = 0; ibuf < size1; ibuf++)
-                {
-                    store_price_value(symbols[ibuf], iconfig, pricesbuf1.get()[ibuf]);
-                }
-                updated = true;
-                pollStatuses[iconfig].lasttime = now;  // TODO: may we need to get new time here as could be delays in polls?
+                store_price_value(results[iconfig].symbols[ibuf], iconfig, results[iconfig].values[ibuf]);
             }
+            updated = true;
+            pollStatuses[iconfig].lasttime = now;  // TODO: may we need to get new time here as could be delays in polls?
         }
-
-        // free(pricesbuf1); use shared_ptr
-
-        if (offset + size1 >= maxsize) 
-            return PF_BUFOVERFLOW;  // buffer overflow
-
-        offset += size1;
+        // a failed feed is polled again next time, its symbols keep the last good values until then
     }
+
     if (updated) {
         // unload price values to the output buffer
         for (int i = 1; i < pricesStatuses.size(); i++)
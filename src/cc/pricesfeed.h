@@ -28,6 +28,7 @@
 #define PF_BUFOVERFLOW 0xFFFFFFFF
 #define PF_DEFAULTINTERVAL 120
 #define PF_MININTERVAL 60
+#define PF_DEFAULTTIMEOUT 10
 
 struct CFeedConfigItem {
 
@@ -51,6 +52,7 @@ struct CFeedConfigItem {
 
     uint32_t interval;      // poll interval
     uint32_t multiplier;    // multiplier to convert price value from float to integer
+    uint32_t timeout;       // http request timeout in sec, symbols of a feed that does not answer in time keep their last values
 };
 
 
@@ -14,6 +14,7 @@
  ******************************************************************************/
 
 #include "CCrewards.h"
+#include "CCindex.h"
 
 /*
  The rewards CC contract is initially for OOT, which needs this functionality. However, many of the attributes can be parameterized to allow different rewards programs to run. Multiple rewards plans could even run on the same blockchain, though the user would need to choose which one to lock funds into.
@@ -343,148 +344,122 @@ bool RewardsValidate(struct CCcontract_info *cp,Eval* eval,const CTransaction &t
     return(true);
 }
 
-static uint64_t myIs_unlockedtx_inmempool(uint256 &txid,int32_t &vout,uint64_t refsbits,uint256 reffundingtxid,uint64_t needed)
+// unspent outputs on the rewards CC address, grouped by plan fundingtxid
+struct CRewardsOutput
 {
-    uint8_t funcid; uint64_t sbits,nValue; uint256 fundingtxid; char str[65];
-    memset(&txid,0,sizeof(txid));
-    vout = -1;
-    nValue = 0;
-    BOOST_FOREACH(const CTxMemPoolEntry &e,mempool.mapTx)
-    {
-        const CTransaction &tx = e.GetTx();
-        if ( tx.vout.size() > 0 && tx.vout[0].nValue >= needed )
-        {
-            const uint256 &hash = tx.GetHash();
-            if ( tx.vout[0].scriptPubKey.IsPayToCryptoCondition() != 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,hash,0) == 0 )
-            {
-                if ( (funcid= DecodeRewardsOpRet(hash,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid)) == 'U' && sbits == refsbits && fundingtxid == reffundingtxid )
-                {
-                    txid = hash;
-                    vout = 0;
-                    nValue = tx.vout[0].nValue;
-                    fprintf(stderr,"found 'U' %s %.8f in unspent in mempool\n",uint256_str(str,txid),(double)nValue/COIN);
-                    return(nValue);
-                }
-            }
-        }
-    }
-    return(nValue);
+    uint8_t funcid;
+    uint64_t sbits;
+    int64_t nValue;
+    CScript unlockscript; // vout.1, where a lock is paid out at unlock
+};
+
+static bool DecodeRewardsOutput(const CTransaction &tx,int32_t vout,uint256 &fundingtxid,CRewardsOutput &output)
+{
+    if ( tx.vout.size() == 0 || (output.funcid= DecodeRewardsOpRet(tx.GetHash(),tx.vout[tx.vout.size()-1].scriptPubKey,output.sbits,fundingtxid)) == 0 )
+        return(false);
+    output.nValue = tx.vout[vout].nValue;
+    output.unlockscript = tx.vout.size() > 1 ? tx.vout[1].scriptPubKey : CScript();
+    return(true);
 }
 
+static CCUnspentsIndex<CRewardsOutput> RewardsOutputs(DecodeRewardsOutput);
+
+// plan creation txs, on the rewards normal address for the list and on the CC address they fund
+struct CRewardsPlan
+{
+    uint64_t sbits,APR,minseconds,maxseconds,mindeposit;
+    std::string fundedaddr; // CC address of vout.0
+};
+
+static bool DecodeRewardsPlan(const CTransaction &tx,CRewardsPlan &plan)
+{
+    char destaddr[64];
+    if ( tx.vout.size() == 0 || DecodeRewardsFundingOpRet(tx.vout[tx.vout.size()-1].scriptPubKey,plan.sbits,plan.APR,plan.minseconds,plan.maxseconds,plan.mindeposit) != 'F' )
+        return(false);
+    if ( tx.vout[0].scriptPubKey.IsPayToCryptoCondition() != 0 && Getscriptaddress(destaddr,tx.vout[0].scriptPubKey) != 0 )
+        plan.fundedaddr = destaddr;
+    else plan.fundedaddr.clear();
+    return(true);
+}
+
+static CCTxidsIndex<CRewardsPlan> RewardsPlans(DecodeRewardsPlan);
+
 // 'L' vs 'F' and 'A'
 int64_t AddRewardsInputs(CScript &scriptPubKey,uint64_t maxseconds,struct CCcontract_info *cp,CMutableTransaction &mtx,CPubKey pk,int64_t total,int32_t maxinputs,uint64_t refsbits,uint256 reffundingtxid)
 {
-    char coinaddr[64],str[65]; uint64_t threshold,sbits,nValue,totalinputs = 0; uint256 txid,hashBlock,fundingtxid; CTransaction tx; int32_t numblocks,j,vout,n = 0; uint8_t funcid;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    char coinaddr[64]; uint64_t threshold,totalinputs = 0; uint256 txid; int32_t numblocks,j,vout,n = 0; CCUnspentsIndex<CRewardsOutput>::vecEntries outputs;
     GetCCaddress(cp,coinaddr,pk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
+    // funding can spend the outputs of unlocks still in the mempool, a lock to unlock must be confirmed
+    if ( maxseconds == 0 )
+        RewardsOutputs.GetWithMempool(coinaddr,reffundingtxid,outputs);
+    else RewardsOutputs.Get(coinaddr,reffundingtxid,outputs);
     if ( maxinputs > CC_MAXVINS )
         maxinputs = CC_MAXVINS;
     if ( maxinputs > 0 )
         threshold = total/maxinputs;
     else threshold = total;
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    for (CCUnspentsIndex<CRewardsOutput>::vecEntries::const_iterator it=outputs.begin(); it!=outputs.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        if ( it->second.satoshis < threshold )
+        const CRewardsOutput &output = it->second;
+        txid = it->first.hash;
+        vout = (int32_t)it->first.n;
+        if ( output.nValue < threshold || output.sbits != refsbits )
             continue;
-        //fprintf(stderr,"(%s) %s/v%d %.8f\n",coinaddr,uint256_str(str,txid),vout,(double)it->second.satoshis/COIN);
         for (j=0; j<mtx.vin.size(); j++)
             if ( txid == mtx.vin[j].prevout.hash && vout == mtx.vin[j].prevout.n )
                 break;
         if ( j != mtx.vin.size() )
             continue;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && tx.vout.size() > 0 && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) == 0 )
+        if ( maxseconds != 0 && myIsutxo_spentinmempool(ignoretxid,ignorevin,txid,vout) != 0 )
+            continue;
+        if ( maxseconds == 0 && output.funcid != 'F' && output.funcid != 'A' && output.funcid != 'U' )
+            continue;
+        else if ( maxseconds != 0 && output.funcid != 'L' )
         {
-            if ( (funcid= DecodeRewardsOpRet(txid,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid)) != 0 )
-            {
-                if ( sbits != refsbits || fundingtxid != reffundingtxid )
-                    continue;
-                if ( maxseconds == 0 && funcid != 'F' && funcid != 'A' && funcid != 'U' )
-                    continue;
-                else if ( maxseconds != 0 && funcid != 'L' )
-                {
-                    if ( CCduration(numblocks,txid) < maxseconds )
-                        continue;
-                }
-                fprintf(stderr,"maxseconds.%d (%c) %.8f %.8f\n",(int32_t)maxseconds,funcid,(double)tx.vout[vout].nValue/COIN,(double)it->second.satoshis/COIN);
-                if ( total != 0 && maxinputs != 0 )
-                {
-                    if ( maxseconds != 0 )
-                        scriptPubKey = tx.vout[1].scriptPubKey;
-                    mtx.vin.push_back(CTxIn(txid,vout,CScript()));
-                }
-                totalinputs += it->second.satoshis;
-                n++;
-                if ( (total > 0 && totalinputs >= total) || (maxinputs > 0 && n >= maxinputs) )
-                    break;
-            } else fprintf(stderr,"null funcid\n");
+            if ( CCduration(numblocks,txid) < maxseconds )
+                continue;
         }
-    }
-    if ( maxseconds == 0 && totalinputs < total && (maxinputs == 0 || n < maxinputs-1) )
-    {
-        fprintf(stderr,"search mempool for unlocked and unspent CC rewards output for %.8f\n",(double)(total-totalinputs)/COIN);
-        if ( (nValue= myIs_unlockedtx_inmempool(txid,vout,refsbits,reffundingtxid,total-totalinputs)) > 0 )
+        fprintf(stderr,"maxseconds.%d (%c) %.8f\n",(int32_t)maxseconds,output.funcid,(double)output.nValue/COIN);
+        if ( total != 0 && maxinputs != 0 )
         {
+            if ( maxseconds != 0 )
+                scriptPubKey = output.unlockscript;
             mtx.vin.push_back(CTxIn(txid,vout,CScript()));
-            fprintf(stderr,"added mempool vout for %.8f\n",(double)nValue/COIN);
-            totalinputs += nValue;
-            n++;
         }
+        totalinputs += output.nValue;
+        n++;
+        if ( (total > 0 && totalinputs >= total) || (maxinputs > 0 && n >= maxinputs) )
+            break;
     }
     return(totalinputs);
 }
 
 int64_t RewardsPlanFunds(uint64_t &lockedfunds,uint64_t refsbits,struct CCcontract_info *cp,CPubKey pk,uint256 reffundingtxid)
 {
-    char coinaddr[64]; uint64_t sbits; int64_t nValue,totalinputs = 0; uint256 txid,hashBlock,fundingtxid; CTransaction tx; int32_t vout; uint8_t funcid;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    char coinaddr[64]; int64_t totalinputs = 0; CCUnspentsIndex<CRewardsOutput>::vecEntries outputs;
     lockedfunds = 0;
     GetCCaddress(cp,coinaddr,pk);
-    SetCCunspents(unspentOutputs,coinaddr,true);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++)
+    RewardsOutputs.Get(coinaddr,reffundingtxid,outputs);
+    for (CCUnspentsIndex<CRewardsOutput>::vecEntries::const_iterator it=outputs.begin(); it!=outputs.end(); it++)
     {
-        txid = it->first.txhash;
-        vout = (int32_t)it->first.index;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && tx.vout[vout].scriptPubKey.IsPayToCryptoCondition() != 0 )
-        {
-            if ( (funcid= DecodeRewardsOpRet(txid,tx.vout[tx.vout.size()-1].scriptPubKey,sbits,fundingtxid)) == 'F' || funcid == 'A' || funcid == 'U' || funcid == 'L' )
-            {
-                if ( refsbits == sbits && (funcid == 'F' && reffundingtxid == txid) || reffundingtxid == fundingtxid )
-                {
-                    if ( (nValue= IsRewardsvout(cp,tx,vout,sbits,fundingtxid)) > 0 )
-                    {
-                        if ( funcid == 'L' )
-                            lockedfunds += nValue;
-                        else totalinputs += nValue;
-                    }
-                    else fprintf(stderr,"refsbits.%llx sbits.%llx nValue %.8f\n",(long long)refsbits,(long long)sbits,(double)nValue/COIN);
-                } //else fprintf(stderr,"else case\n");
-            } else fprintf(stderr,"funcid.%d %c skipped %.8f\n",funcid,funcid,(double)tx.vout[vout].nValue/COIN);
-        }
+        if ( it->second.funcid == 'L' )
+            lockedfunds += it->second.nValue;
+        else totalinputs += it->second.nValue;
     }
     return(totalinputs);
 }
 
 bool RewardsPlanExists(struct CCcontract_info *cp,uint64_t refsbits,CPubKey rewardspk,uint64_t &APR,uint64_t &minseconds,uint64_t &maxseconds,uint64_t &mindeposit)
 {
-    char CCaddr[64]; uint64_t sbits; uint256 txid,hashBlock; CTransaction tx;
-    std::vector<uint256> txids;
+    char CCaddr[64]; CCTxidsIndex<CRewardsPlan>::vecEntries plans;
     GetCCaddress(cp,CCaddr,rewardspk);
-    SetCCtxids(txids,CCaddr,true,cp->evalcode,0,zeroid,'F');
-    for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
+    RewardsPlans.Get(CCaddr,true,0,0,plans);
+    for (CCTxidsIndex<CRewardsPlan>::vecEntries::const_iterator it=plans.begin(); it!=plans.end(); it++)
     {
-        //int height = it->first.blockHeight;
-        txid = *it;
-        if ( myGetTransaction(txid,tx,hashBlock) != 0 && tx.vout.size() > 0 && ConstrainVout(tx.vout[0],1,CCaddr,0) != 0 )
+        if ( it->second.fundedaddr == CCaddr && it->second.sbits == refsbits )
         {
-            //char str[65]; fprintf(stderr,"rewards plan %s\n",uint256_str(str,txid));
-            if ( DecodeRewardsFundingOpRet(tx.vout[tx.vout.size()-1].scriptPubKey,sbits,APR,minseconds,maxseconds,mindeposit) == 'F' )
-            {
-                if ( sbits == refsbits )
-                    return(true);
-            }
+            APR = it->second.APR, minseconds = it->second.minseconds, maxseconds = it->second.maxseconds, mindeposit = it->second.mindeposit;
+            return(true);
         }
     }
     return(false);
@@ -530,20 +505,11 @@ UniValue RewardsInfo(uint256 rewardsid)
 
 UniValue RewardsList()
 {
-    UniValue result(UniValue::VARR); std::vector<uint256> txids; struct CCcontract_info *cp,C; uint256 txid,hashBlock; CTransaction vintx; uint64_t sbits,APR,minseconds,maxseconds,mindeposit; char str[65];
+    UniValue result(UniValue::VARR); CCTxidsIndex<CRewardsPlan>::vecEntries plans; struct CCcontract_info *cp,C; char str[65];
     cp = CCinit(&C,EVAL_REWARDS);
-    SetCCtxids(txids,cp->normaladdr,false,cp->evalcode,0,zeroid,'F');
-    for (std::vector<uint256>::const_iterator it=txids.begin(); it!=txids.end(); it++)
-    {
-        txid = *it;
-        if ( myGetTransaction(txid,vintx,hashBlock) != 0 )
-        {
-            if ( vintx.vout.size() > 0 && DecodeRewardsFundingOpRet(vintx.vout[vintx.vout.size()-1].scriptPubKey,sbits,APR,minseconds,maxseconds,mindeposit) != 0 )
-            {
-                result.push_back(uint256_str(str,txid));
-            }
-        }
-    }
+    RewardsPlans.Get(cp->normaladdr,false,0,0,plans);
+    for (CCTxidsIndex<CRewardsPlan>::vecEntries::const_iterator it=plans.begin(); it!=plans.end(); it++)
+        result.push_back(uint256_str(str,it->first));
     return(result);
 }
 
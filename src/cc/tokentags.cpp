@@ -16,6 +16,7 @@
 #include "CCtokentags.h"
 #include "CCtokens.h"
 #include "CCtokens_impl.h"
+#include "CCindex.h"
 
 /*
 This is an implementation of a simple linked list data storage method, similar to Oracles in functionality.
@@ -718,53 +719,123 @@ static CTxOut MakeTokensCCvoutforTag(uint256 tokenid, uint8_t evalcode, CAmount
 	return CTxOut();
 }
 
-// Finds the function id of the transaction that spent the latest baton for the specified token tag.
-// Returns 'c' if event log baton is unspent, or 0 if token tag with the specified txid couldn't be found.
-// Also returns the txid of the latest update the function found in the latesttxid variable.
-static uint8_t FindLatestTagUpdate(uint256 tokentagid, struct CCcontract_info *cp, uint256 &latesttxid)
+// Token tag txs, indexed on the global pubkey / tokenid-pubkey 1of2 CC address of their tokenid.
+struct CTokenTagEntry
+{
+	uint8_t funcid;
+	uint256 batonprev; // txid of the baton spent by vin.0, for updates
+	std::string batonaddr; // address of vout.0
+	std::vector<CKeyID> signers; // keys of the normal inputs, for tag creations
+};
+
+static bool DecodeTokenTagEntry(const CTransaction &tx, CTokenTagEntry &entry)
+{
+	char batonaddr[KOMODO_ADDRESS_BUFSIZE];
+	CTransaction vintx;
+	uint256 hashBlock;
+	std::vector<std::vector<unsigned char> > vSolutions;
+	txnouttype whichType;
+	bool iscltv;
+
+	if (tx.vout.size() == 0 || (entry.funcid = DecodeTokenTagOpRet(tx.vout.back().scriptPubKey)) == 0)
+		return false;
+	entry.batonprev = (tx.vin.size() > 0 && tx.vin[0].prevout.n == 0) ? tx.vin[0].prevout.hash : zeroid;
+	entry.batonaddr = (tx.vout[0].scriptPubKey.IsPayToCryptoCondition() != 0 && Getscriptaddress(batonaddr,tx.vout[0].scriptPubKey) != 0) ? batonaddr : "";
+	entry.signers.clear();
+	if (entry.funcid == 'c')
+	{
+		// Same inputs as TotalPubkeyNormalInputs accepts.
+		for (const auto &vin : tx.vin)
+		{
+			if (!IsCCInput(vin.scriptSig) && myGetTransaction(vin.prevout.hash, vintx, hashBlock) && vin.prevout.n < vintx.vout.size() &&
+			SolverCLTV(vintx.vout[vin.prevout.n].scriptPubKey, whichType, vSolutions, iscltv))
+			{
+				if (whichType == TX_PUBKEY)
+					entry.signers.push_back(CPubKey(vSolutions[0]).GetID());
+				else if (whichType == TX_PUBKEYHASH)
+					entry.signers.push_back(CKeyID(uint160(vSolutions[0])));
+			}
+		}
+	}
+	return true;
+}
+
+static CCTxidsIndex<CTokenTagEntry> TokenTagsIndex(DecodeTokenTagEntry);
+
+// Gets the txids of the specified token tag and of its updates in baton order, oldest first.
+// Confirmed updates come from the tag index of the tokenid, updates following them in the mempool are found by their baton spends.
+// Returns the function id of the latest transaction, or 0 if token tag with the specified txid couldn't be found.
+static uint8_t GetTokenTagUpdates(uint256 tokentagid, struct CCcontract_info *cp, std::vector<uint256> &updates)
 {
 	CTransaction sourcetx, batontx;
-	uint256 hashBlock, batontxid, refagreementtxid;
-	int32_t vini, height, retcode;
-	uint8_t funcid,version,flags;
-	char tagCCaddress[KOMODO_ADDRESS_BUFSIZE], *txidaddr;
-	CPubKey TokenTagspk,tagtxidpk,creatorpub;
+	uint256 hashBlock, batontxid, tokenid;
+	int32_t vini, height;
+	uint8_t funcid, batonfuncid, version, flags;
+	char tagCCaddress[KOMODO_ADDRESS_BUFSIZE];
+	CPubKey creatorpub;
 	int64_t tokensupply, updatesupply;
-	uint256 tokenid;
 	std::string name, data;
+	CCTxidsIndex<CTokenTagEntry>::vecEntries entries;
+	std::set<uint256> batons;
+	std::map<uint256,std::pair<uint256,uint8_t> > nextupdates;
+	std::map<uint256,std::pair<uint256,uint8_t> >::const_iterator it;
 
-	latesttxid = zeroid;
+	updates.clear();
 
 	// Get token tag creation transaction and its op_return, containing the tokenid.
-	if (myGetTransactionCCV2(cp, tokentagid, sourcetx, hashBlock) && sourcetx.vout.size() > 0 &&
-	DecodeTokenTagCreateOpRet(sourcetx.vout.back().scriptPubKey,version,creatorpub,tokenid,tokensupply,updatesupply,flags,name,data) != 0)
+	if (myGetTransactionCCV2(cp, tokentagid, sourcetx, hashBlock) == 0 || sourcetx.vout.size() == 0 ||
+	DecodeTokenTagCreateOpRet(sourcetx.vout.back().scriptPubKey,version,creatorpub,tokenid,tokensupply,updatesupply,flags,name,data) == 0)
+		return (uint8_t)0;
+
+	// A valid event baton vout for any type of event must be vout.0, and is sent to a special address created from the global CC pubkey, 
+	// and a txid-pubkey created from the tag's tokenid. All tags of the tokenid and their updates are indexed on this address.
+	GetCCaddress1of2(cp, tagCCaddress, GetUnspendable(cp, NULL), CCtxidaddr(NULL,tokenid), true);
+	TokenTagsIndex.Get(tagCCaddress, true, 0, 0, entries);
+
+	// Link each update to the valid baton it spent.
+	for (const auto &e : entries)
+		if (e.second.batonaddr == tagCCaddress)
+			batons.insert(e.first);
+	for (const auto &e : entries)
+		if (e.second.funcid != 'c' && batons.count(e.second.batonprev) != 0)
+			nextupdates[e.second.batonprev] = std::make_pair(e.first, e.second.funcid);
+
+	funcid = 'c';
+	updates.push_back(tokentagid);
+	while ((it = nextupdates.find(updates.back())) != nextupdates.end())
 	{
-		// A valid event baton vout for any type of event must be vout.0, and is sent to a special address created from the global CC pubkey, 
-		// and a txid-pubkey created from the tag's tokenid.
-		// To check if a vout is valid, we'll need to get this address first.
-		// This address can be constructed out of the Token Tags global pubkey and the tokenid-pubkey using CCtxidaddr.
-		TokenTagspk = GetUnspendable(cp, NULL);
-		tagtxidpk = CCtxidaddr(txidaddr,tokenid);
-		GetCCaddress1of2(cp, tagCCaddress, TokenTagspk, tagtxidpk, true);
-		
-		// Iterate through vout0 batons while we're finding valid token tag transactions that spent the last baton.
-		while ((IsTokenTagsvout(cp,sourcetx,0,tagCCaddress) != 0) &&
-		
-		// Check if vout0 was spent.
-		(retcode = CCgetspenttxid(batontxid, vini, height, sourcetx.GetHash(), 0)) == 0 &&
-
-		// Get spending transaction and its op_return.
-		(myGetTransactionCCV2(cp, batontxid, batontx, hashBlock)) && batontx.vout.size() > 0 && 
-		(funcid = DecodeTokenTagOpRet(batontx.vout.back().scriptPubKey)) != 0)
-		{
-			sourcetx = batontx;
-		}
+		updates.push_back(it->second.first);
+		funcid = it->second.second;
+	}
 
-		latesttxid = sourcetx.GetHash();
+	if (updates.back() != tokentagid && myGetTransactionCCV2(cp, updates.back(), sourcetx, hashBlock) == 0)
 		return funcid;
+
+	// Iterate through vout0 batons spent in the mempool.
+	while ((IsTokenTagsvout(cp,sourcetx,0,tagCCaddress) != 0) &&
+	(CCgetspenttxid(batontxid, vini, height, sourcetx.GetHash(), 0)) == 0 &&
+	(myGetTransactionCCV2(cp, batontxid, batontx, hashBlock)) && batontx.vout.size() > 0 && 
+	(batonfuncid = DecodeTokenTagOpRet(batontx.vout.back().scriptPubKey)) != 0)
+	{
+		updates.push_back(batontxid);
+		funcid = batonfuncid;
+		sourcetx = batontx;
 	}
+	return funcid;
+}
 
-	return (uint8_t)0;
+// Finds the function id of the transaction that spent the latest baton for the specified token tag.
+// Returns 'c' if event log baton is unspent, or 0 if token tag with the specified txid couldn't be found.
+// Also returns the txid of the latest update the function found in the latesttxid variable.
+static uint8_t FindLatestTagUpdate(uint256 tokentagid, struct CCcontract_info *cp, uint256 &latesttxid)
+{
+	std::vector<uint256> updates;
+	uint8_t funcid;
+
+	latesttxid = zeroid;
+	if ((funcid = GetTokenTagUpdates(tokentagid, cp, updates)) != 0)
+		latesttxid = updates.back();
+	return funcid;
 }
 
 // --- RPC implementations for transaction creation ---
@@ -1292,52 +1363,19 @@ UniValue TokenTagInfo(uint256 txid)
 UniValue TokenTagHistory(const uint256 tokentagid,int64_t samplenum,bool bReverse)
 {
 	UniValue result(UniValue::VARR);
-	CTransaction tokentagtx,batontx;
-	uint256 latesttxid,batontxid,hashBlock;
-	int64_t total = 0LL;
-	int32_t numvouts,vini,height;
-	uint8_t funcid;
+	std::vector<uint256> updates;
+	int64_t total, i;
 
 	struct CCcontract_info *cp,C;
 	cp = CCinit(&C,EVAL_TOKENTAGS);
 
-	if (myGetTransactionCCV2(cp,tokentagid,tokentagtx,hashBlock) != 0 && (numvouts = tokentagtx.vout.size()) > 0 &&
-	DecodeTokenTagOpRet(tokentagtx.vout[numvouts-1].scriptPubKey) == 'c')
+	if (GetTokenTagUpdates(tokentagid, cp, updates) != 0)
 	{
-		FindLatestTagUpdate(tokentagid, cp, latesttxid);
+		total = (samplenum > 0 && samplenum < (int64_t)updates.size()) ? samplenum : (int64_t)updates.size();
 
-		if (latesttxid != tokentagid)
-		{
-			if (bReverse) // from latest event to oldest
-				batontxid = latesttxid;
-			else
-				batontxid = tokentagid;
-			
-			// Iterate through events while we haven't reached samplenum limits yet.
-			while ((total < samplenum || samplenum == 0) &&
-			// Fetch the transaction.
-			myGetTransactionCCV2(cp,batontxid,batontx,hashBlock) != 0 && batontx.vout.size() > 0 &&
-			// Fetch function id.
-			DecodeTokenTagOpRet(batontx.vout.back().scriptPubKey) != 0)
-			{
-				result.push_back(batontxid.GetHex());
-				
-				total++;
-
-				// If bReverse = true, stop searching if we found the original token tag txid. 
-				// If bReverse = false, stop searching if we found the latest update txid. 
-				if ((!bReverse && batontxid == latesttxid) || (bReverse && batontxid == tokentagid))
-					break;
-
-				// Get previous or next update transaction.
-				if (bReverse)
-					batontxid = batontx.vin[0].prevout.hash;
-				else
-					CCgetspenttxid(batontxid,vini,height,batontx.GetHash(),0);
-			}
-		}
-		else
-			result.push_back(tokentagid.GetHex());
+		// If bReverse = true, list from latest event to oldest.
+		for (i = 0; i < total; i++)
+			result.push_back((bReverse ? updates[updates.size() - 1 - i] : updates[i]).GetHex());
 	}
 
 	return(result);
@@ -1346,13 +1384,9 @@ UniValue TokenTagHistory(const uint256 tokentagid,int64_t samplenum,bool bRevers
 UniValue TokenTagList(uint256 tokenid, CPubKey pubkey)
 {
 	UniValue result(UniValue::VARR);
-	char tagCCaddress[KOMODO_ADDRESS_BUFSIZE],*txidaddr;
-	CPubKey TokenTagspk,tagtxidpk;
-	CTransaction tx;
-	int32_t numvouts;
-	std::vector<uint256> tokentagids;
-	uint256 hashBlock;
-	uint8_t version,flags,tokensversion;
+	char tagCCaddress[KOMODO_ADDRESS_BUFSIZE];
+	CCTxidsIndex<CTokenTagEntry>::vecEntries entries;
+	uint8_t tokensversion;
 
 	struct CCcontract_info *cp,C;
 	cp = CCinit(&C,EVAL_TOKENTAGS);
@@ -1362,18 +1396,15 @@ UniValue TokenTagList(uint256 tokenid, CPubKey pubkey)
 	else if (tokensversion == 1)
 		CCERR_RESULT("tokentagscc", CCLOG_INFO, stream << "Token id in tag is version 1, which is not supported by this CC");
 
-	TokenTagspk = GetUnspendable(cp, NULL);
-	tagtxidpk = CCtxidaddr(txidaddr,tokenid);
-	GetCCaddress1of2(cp, tagCCaddress, TokenTagspk, tagtxidpk, true);
-
-	SetCCtxids(tokentagids, tagCCaddress, true, cp->evalcode, CC_MARKER_VALUE, zeroid, 'c');
+	GetCCaddress1of2(cp, tagCCaddress, GetUnspendable(cp, NULL), CCtxidaddr(NULL,tokenid), true);
+	TokenTagsIndex.Get(tagCCaddress, true, 0, 0, entries);
 
-	for (std::vector<uint256>::const_iterator it = tokentagids.begin(); it != tokentagids.end(); it++)
+	for (const auto &e : entries)
 	{
-		if (myGetTransactionCCV2(cp,*it,tx,hashBlock) != 0 && (numvouts = tx.vout.size()) > 0 &&
-		DecodeTokenTagOpRet(tx.vout[numvouts-1].scriptPubKey) == 'c' && (pubkey == CPubKey() || TotalPubkeyNormalInputs(nullptr,tx,pubkey) != 0))
+		if (e.second.funcid == 'c' && e.second.batonaddr == tagCCaddress &&
+		(pubkey == CPubKey() || std::find(e.second.signers.begin(), e.second.signers.end(), pubkey.GetID()) != e.second.signers.end()))
 		{
-			result.push_back((*it).GetHex());
+			result.push_back(e.first.GetHex());
 		}
 	}
 	return (result);
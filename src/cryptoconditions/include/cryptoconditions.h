@@ -48,6 +48,21 @@ enum CCTypeId {
 typedef int (*VerifyEval)(struct CC *cond, void *context);
 
 
+/*
+ * secp256k1 signature check gathered from a condition tree, the pointers
+ * refer to the tree and the message being verified
+ */
+typedef struct CCSigCheck {
+    const uint8_t *publicKey, *signature, *msg32;
+} CCSigCheck;
+
+
+/*
+ * Signature checks callback, sets failed to the index of a failing check
+ */
+typedef int (*VerifySigs)(const CCSigCheck *checks, size_t n, size_t *failed, void *context);
+
+
 
 /*
  * Crypto Condition
@@ -91,6 +106,10 @@ int             cc_isFulfilled(const CC *cond);
 int             cc_verify(const struct CC *cond, const uint8_t *msg, size_t msgLength,
                         int doHashMessage, const uint8_t *condBin, size_t condBinLength,
                         VerifyEval verifyEval, void *evalContext);
+int             cc_verifyWithSigs(const struct CC *cond, const uint8_t *msg, size_t msgLength,
+                        int doHashMessage, const uint8_t *condBin, size_t condBinLength,
+                        VerifyEval verifyEval, void *evalContext,
+                        VerifySigs verifySigs, void *sigContext);
 int             cc_verifyEval(const CC *cond, VerifyEval verify, void *context);
 int             cc_visit(CC *cond, struct CCVisitor visitor);
 int             cc_signTreeEd25519(CC *cond, const uint8_t *privateKey, const uint8_t *msg,
@@ -98,6 +117,8 @@ int             cc_signTreeEd25519(CC *cond, const uint8_t *privateKey, const ui
 int             cc_signTreeSecp256k1Msg32(CC *cond, const uint8_t *privateKey, const uint8_t *msg32);
 int             cc_signTreeSecp256k1HashMsg32(CC *cond, const unsigned char *privateKey, const unsigned char *msg32);
 int             cc_secp256k1VerifyTreeMsg32(const CC *cond, const uint8_t *msg32);
+int             cc_secp256k1CollectChecks(const CC *cond, const uint8_t *msg32, CCSigCheck **checks, size_t *n);
+int             cc_secp256k1VerifyChecks(const CCSigCheck *checks, size_t n, size_t *failed);
 int             cc_secp256k1HashVerifyTreeMsg32(const CC *cond, const unsigned char *msg32);
 size_t          cc_conditionBinary(const CC *cond, uint8_t *buf);
 size_t          cc_fulfillmentBinary(const CC *cond, uint8_t *buf, size_t bufLength);
@@ -108,6 +129,7 @@ struct CC*      cc_readConditionBinary(const uint8_t *cond_bin, size_t cond_bin_
 struct CC*      cc_readFulfillmentBinary(const uint8_t *ffill_bin, size_t ffill_bin_len);
 struct CC*      cc_readFulfillmentBinaryMixedMode(const uint8_t *ffill_bin, size_t ffill_bin_len);
 int             cc_readFulfillmentBinaryExt(const unsigned char *ffill_bin, size_t ffill_bin_len, CC **ppcc);
+struct CC*      cc_readFulfillmentBinaryAsn1(const uint8_t *ffill_bin, size_t ffill_bin_len, int mixedMode);
 struct CC*      cc_new(int typeId);
 struct cJSON*   cc_conditionToJSON(const CC *cond);
 char*           cc_conditionToJSONString(const CC *cond);
@@ -29,6 +29,7 @@
 #include "anon.c"
 #include "eval.c"
 #include "json_rpc.c"
+#include "der.c"
 
 struct CCType *CCTypeRegistry[] = {
     &CC_PreimageType,
@@ -224,6 +225,12 @@ CC *fulfillmentToCC(Fulfillment_t *ffill, const FulfillmentFlags flags) {
 
 
 CC *cc_readFulfillmentBinaryWithFlags(const unsigned char *ffill_bin, size_t ffill_bin_len, FulfillmentFlags flags) {
+    return derReadFulfillment(ffill_bin, ffill_bin_len, flags);
+}
+
+// The asn1c decoder, kept as the reference for the single pass one
+CC *cc_readFulfillmentBinaryAsn1(const unsigned char *ffill_bin, size_t ffill_bin_len, int mixedMode) {
+    FulfillmentFlags flags = mixedMode ? MixedMode : 0;
     CC *cond = 0;
     unsigned char *buf = calloc(1,ffill_bin_len);
     Fulfillment_t *ffill = 0;
@@ -273,6 +280,18 @@ int cc_visit(CC *cond, CCVisitor visitor) {
 int cc_verify(const struct CC *cond, const unsigned char *msg, size_t msgLength, int doHashMsg,
               const unsigned char *condBin, size_t condBinLength,
               VerifyEval verifyEval, void *evalContext) {
+    return cc_verifyWithSigs(cond, msg, msgLength, doHashMsg, condBin, condBinLength,
+                             verifyEval, evalContext, NULL, NULL);
+}
+
+/*
+ * As cc_verify, the secp256k1 and secp256k1hash signatures of the tree are
+ * handed to verifySigs in one call so the caller can share work between them
+ */
+int cc_verifyWithSigs(const struct CC *cond, const unsigned char *msg, size_t msgLength, int doHashMsg,
+              const unsigned char *condBin, size_t condBinLength,
+              VerifyEval verifyEval, void *evalContext,
+              VerifySigs verifySigs, void *sigContext) {
     unsigned char targetBinary[1000];
     //fprintf(stderr,"in cc_verify cond.%p msg.%p[%d] dohash.%d condbin.%p[%d]\n",cond,msg,(int32_t)msgLength,doHashMsg,condBin,(int32_t)condBinLength);
     const size_t binLength = cc_conditionBinary(cond, targetBinary);
@@ -294,13 +313,17 @@ int cc_verify(const struct CC *cond, const unsigned char *msg, size_t msgLength,
     //    fprintf(stderr,"%02x",msgHash[z]);
     //fprintf(stderr," msgHash msglen.%d\n",(int32_t)msgLength);
 
-    if (!cc_secp256k1VerifyTreeMsg32(cond, msgHash)) {
+    CCSigCheck *checks;
+    size_t nChecks, failed = 0;
+    if (!cc_secp256k1CollectChecks(cond, msgHash, &checks, &nChecks)) {
         fprintf(stderr," cc_verify error C (secp256k1 verify error)\n");
         return 0;
     }
-
-    if (!cc_secp256k1HashVerifyTreeMsg32(cond, msgHash)) {
-        fprintf(stderr," cc_verify error C2 (secp256k1hash verify error)\n");
+    int rc = verifySigs ? verifySigs(checks, nChecks, &failed, sigContext) :
+                          cc_secp256k1VerifyChecks(checks, nChecks, &failed);
+    free(checks);
+    if (!rc) {
+        fprintf(stderr," cc_verify error C (secp256k1 verify error in signature %d of %d)\n",(int32_t)failed+1,(int32_t)nChecks);
         return 0;
     }
 
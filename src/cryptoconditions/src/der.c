@@ -0,0 +1,365 @@
+/******************************************************************************
+ * Copyright © 2014-2019 The SuperNET Developers.                             *
+ *                                                                            *
+ * See the AUTHORS, DEVELOPER-AGREEMENT and LICENSE files at                  *
+ * the top-level directory of this distribution for the individual copyright  *
+ * holder information and the developer policies on copyright and licensing.  *
+ *                                                                            *
+ * Unless otherwise agreed in a custom licensing agreement, no part of the    *
+ * SuperNET software, including this file may be copied, modified, propagated *
+ * or distributed except according to the terms contained in the LICENSE file *
+ *                                                                            *
+ * Removal or modification of this copyright notice is prohibited.            *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Single pass decoder for DER encoded fulfillments.
+ *
+ * The asn1c path BER decodes a fulfillment, DER encodes it again to reject
+ * malleated input and then converts the asn1c structure into a CC tree. The
+ * functions below walk the input once and build the CC tree directly. They
+ * accept exactly what the asn1c path accepts and build the same tree, quirks
+ * included:
+ *
+ *  - OCTET STRINGs of fixed size in the schema are not size checked, the
+ *    conversion copies the schema size, zero filled past the input.
+ *  - INTEGERs are decoded into an unsigned long and DER encoded back from its
+ *    bit pattern, so only minimal encodings of at most sizeof(long) bytes
+ *    survive, and shorter ones may not have the sign bit set.
+ *  - The mixed mode threshold converts only the first (uint8_t) size children,
+ *    the rest are only checked to be well formed.
+ *
+ * Children that are not converted are parsed with out == NULL.
+ *
+ * ber_decode gives up once it has used ASN__DEFAULT_STACK_MAX bytes of stack,
+ * which is what bounds how deep a fulfillment can nest. Each node is charged
+ * the stack its asn1c decoder frames take on x86_64 with -O2, measured with
+ * the max_stack_size of ber_decode, so the same inputs are rejected:
+ *
+ *  - a prefix or threshold charges its children DER_STACK_PREFIX or
+ *    DER_STACK_THRESHOLD bytes
+ *  - a leaf fulfillment or a condition needs DER_STACK_LEAF more bytes
+ *  - a threshold needs DER_STACK_EMPTY bytes past its own frames even when
+ *    it has no children
+ *
+ * Where asn1c gives up moves with the compiler and its flags, from 32 to 76
+ * nested thresholds. Here the release build's numbers are fixed.
+ */
+
+#define DER_STACK_MAX       30000   // ASN__DEFAULT_STACK_MAX
+#define DER_STACK_PREFIX    304
+#define DER_STACK_THRESHOLD 416
+#define DER_STACK_LEAF      624
+#define DER_STACK_EMPTY     112
+
+
+/*
+ * Reads the header of a TLV with a single byte tag and a minimal definite
+ * length, and advances *pp past the whole TLV.
+ */
+static int derRead(const uint8_t **pp, const uint8_t *end, uint8_t *tag, const uint8_t **content, size_t *length) {
+    const uint8_t *p = *pp;
+    size_t len;
+    if (end - p < 2) return 0;
+    *tag = *p++;
+    if ((*tag & 0x1f) == 0x1f) return 0;
+    len = *p++;
+    if (len & 0x80) {
+        int n = len & 0x7f;
+        if (n == 0 || n > sizeof(size_t) || end - p < n || *p == 0) return 0;
+        for (len = 0; n > 0; n--) len = (len << 8) | *p++;
+        if (len < 0x80) return 0;
+    }
+    if ((size_t)(end - p) < len) return 0;
+    *content = p;
+    *length = len;
+    *pp = p + len;
+    return 1;
+}
+
+
+static int derExpect(const uint8_t **pp, const uint8_t *end, uint8_t tag, const uint8_t **content, size_t *length) {
+    uint8_t t;
+    if (*pp == end || **pp != tag) return 0;
+    return derRead(pp, end, &t, content, length);
+}
+
+
+/*
+ * INTEGER (0..4294967295) as asn1c round trips it through an unsigned long
+ */
+static int derUnsigned(const uint8_t *c, size_t len, unsigned long *out) {
+    unsigned long v = 0;
+    if (len == 0 || len > sizeof(unsigned long)) return 0;
+    if (len > 1 && ((c[0] == 0x00 && !(c[1] & 0x80)) || (c[0] == 0xff && (c[1] & 0x80)))) return 0;
+    if (len < sizeof(unsigned long) && (c[0] & 0x80)) return 0;
+    for (size_t i=0; i<len; i++) v = (v << 8) | c[i];
+    *out = v;
+    return 1;
+}
+
+
+/*
+ * BIT STRING: asn1c keeps the unused bits octet as is but encodes it masked
+ * with 7, and clears the unused bits of the last octet
+ */
+static int derBitString(const uint8_t *c, size_t len) {
+    if (len == 0 || c[0] > 7) return 0;
+    if (len > 1 && (c[len-1] & ~(0xff << c[0]) & 0xff)) return 0;
+    return 1;
+}
+
+
+/*
+ * Copies a fixed size field the way the fromFulfillment functions do
+ */
+static void derCopyFixed(uint8_t *out, size_t size, const uint8_t *c, size_t len) {
+    memset(out, 0, size);
+    memcpy(out, c, len < size ? len : size);
+}
+
+
+/*
+ * Counts the elements of a SET OF and checks they are in DER order, which
+ * compares encodings as memcmp over the common length, shorter first
+ */
+static int derSetOf(const uint8_t *p, const uint8_t *end, int *count) {
+    const uint8_t *prev = 0, *cur, *content;
+    size_t prevLen = 0, curLen, len;
+    uint8_t tag;
+    *count = 0;
+    while (p < end) {
+        cur = p;
+        if (!derRead(&p, end, &tag, &content, &len)) return 0;
+        curLen = p - cur;
+        if (prev) {
+            int cmp = memcmp(prev, cur, prevLen < curLen ? prevLen : curLen);
+            if (cmp > 0 || (cmp == 0 && prevLen > curLen)) return 0;
+        }
+        prev = cur;
+        prevLen = curLen;
+        (*count)++;
+    }
+    return 1;
+}
+
+
+static int derFulfillment(const uint8_t **pp, const uint8_t *end, FulfillmentFlags flags, int stack, CC **out);
+
+
+static int derCondition(const uint8_t **pp, const uint8_t *end, CC **out) {
+    const uint8_t *p, *cend, *fp, *cost, *bits;
+    size_t len, fpLen, costLen, bitsLen;
+    unsigned long costValue;
+    uint8_t tag;
+    int n, compound;
+
+    if (!derRead(pp, end, &tag, &p, &len)) return 0;
+    cend = p + len;
+    n = tag & 0x1f;
+    if ((tag & 0xe0) != 0xa0 || (n > 6 && n != 15)) return 0;
+    compound = n == 1 || n == 2;
+
+    if (!derExpect(&p, cend, 0x80, &fp, &fpLen)) return 0;
+    if (!derExpect(&p, cend, 0x81, &cost, &costLen) || !derUnsigned(cost, costLen, &costValue)) return 0;
+    if (compound) {
+        if (!derExpect(&p, cend, 0x82, &bits, &bitsLen) || !derBitString(bits, bitsLen)) return 0;
+    }
+    if (p != cend) return 0;
+    if (!out) return 1;
+
+    CCType *realType = getTypeByAsnEnum(n == 15 ? Condition_PR_evalSha256 : Condition_PR_preimageSha256 + n);
+    if (!realType) {
+        fprintf(stderr, "Unknown ASN type: %i", n);
+        return 0;
+    }
+    CC *cond = cc_new(CC_Anon);
+    cond->conditionType = realType;
+    derCopyFixed(cond->fingerprint, 32, fp, fpLen);
+    cond->cost = costValue;
+    if (compound) {
+        // asn1c leaves the subtypes of a simple condition empty
+        ConditionTypes_t types;
+        memset(&types, 0, sizeof(types));
+        types.buf = (uint8_t*) bits + 1;
+        types.size = bitsLen - 1;
+        types.bits_unused = bits[0];
+        cond->subtypes = fromAsnSubtypes(types);
+    }
+    *out = cond;
+    return 1;
+}
+
+
+static int derThreshold(const uint8_t *p, const uint8_t *end, FulfillmentFlags flags, int stack, CC **out) {
+    const uint8_t *ffills, *ffillsEnd, *conds, *condsEnd;
+    size_t len;
+    int nffills, nconds, size, i;
+    long threshold;
+    CC *cond, **subconditions;
+
+    if (stack + DER_STACK_THRESHOLD + DER_STACK_EMPTY > DER_STACK_MAX) return 0;
+    stack += DER_STACK_THRESHOLD;
+    if (!derExpect(&p, end, 0xa0, &ffills, &len)) return 0;
+    ffillsEnd = ffills + len;
+    if (!derExpect(&p, end, 0xa1, &conds, &len)) return 0;
+    condsEnd = conds + len;
+    if (p != end) return 0;
+    if (!derSetOf(ffills, ffillsEnd, &nffills) || !derSetOf(conds, condsEnd, &nconds)) return 0;
+    if (nconds > 0 && stack + DER_STACK_LEAF > DER_STACK_MAX) return 0;
+
+    if (!out) {
+        for (i=0; i<nffills; i++)
+            if (!derFulfillment(&ffills, ffillsEnd, flags, stack, NULL)) return 0;
+        for (i=0; i<nconds; i++)
+            if (!derCondition(&conds, condsEnd, NULL)) return 0;
+        return 1;
+    }
+
+    if (flags & MixedMode) {
+        // the real threshold is in the first fulfillment, a one byte preimage
+        CC *tc = 0;
+        if (nffills == 0) return 0;
+        if (!derFulfillment(&ffills, ffillsEnd, flags, stack, &tc)) return 0;
+        if (tc->type->typeId != CC_Preimage || tc->preimageLength != 1) {
+            cc_free(tc);
+            return 0;
+        }
+        threshold = tc->preimage[0];
+        cc_free(tc);
+        nffills--;
+        if (threshold > nffills + nconds) return 0;
+        size = (uint8_t) (nffills + nconds);
+    } else {
+        threshold = nffills;
+        size = nffills + nconds;
+    }
+
+    subconditions = calloc(size, sizeof(CC*));
+    for (i=0; i<nffills+nconds; i++) {
+        int ok;
+        CC **sub = (i < size) ? &subconditions[i] : NULL;
+        if (i < nffills) ok = derFulfillment(&ffills, ffillsEnd, flags, stack, sub);
+        else ok = derCondition(&conds, condsEnd, sub);
+        if (!ok) {
+            for (int j=0; j<i && j<size; j++) cc_free(subconditions[j]);
+            free(subconditions);
+            return 0;
+        }
+    }
+
+    cond = cc_new(CC_Threshold);
+    cond->threshold = threshold;
+    cond->size = size;
+    cond->subconditions = subconditions;
+    // beyond 255 children the size wraps, those past it are never looked at
+    for (i=cond->size; i<size; i++) {
+        cc_free(subconditions[i]);
+        subconditions[i] = 0;
+    }
+    *out = cond;
+    return 1;
+}
+
+
+static int derFulfillment(const uint8_t **pp, const uint8_t *end, FulfillmentFlags flags, int stack, CC **out) {
+    const uint8_t *p, *cend, *a, *b;
+    size_t len, aLen, bLen;
+    unsigned long mml;
+    uint8_t tag;
+    CC *cond;
+
+    if (!derRead(pp, end, &tag, &p, &len)) return 0;
+    cend = p + len;
+    if (tag != 0xa1 && tag != 0xa2 && stack + DER_STACK_LEAF > DER_STACK_MAX) return 0;
+
+    switch (tag) {
+    case 0xa0: // preimage
+        if (!derExpect(&p, cend, 0x80, &a, &aLen) || p != cend) return 0;
+        if (!out) return 1;
+        cond = cc_new(CC_Preimage);
+        cond->preimage = calloc(1, aLen);
+        memcpy(cond->preimage, a, aLen);
+        cond->preimageLength = aLen;
+        break;
+
+    case 0xa1: { // prefix
+        CC *sub = 0;
+        if (!derExpect(&p, cend, 0x80, &a, &aLen)) return 0;
+        if (!derExpect(&p, cend, 0x81, &b, &bLen) || !derUnsigned(b, bLen, &mml)) return 0;
+        if (!derExpect(&p, cend, 0xa2, &b, &bLen) || p != cend) return 0;
+        if (!derFulfillment(&b, b + bLen, flags, stack + DER_STACK_PREFIX, out ? &sub : NULL)) return 0;
+        if (b != p) {
+            cc_free(sub);
+            return 0;
+        }
+        if (!out) return 1;
+        cond = cc_new(CC_Prefix);
+        cond->maxMessageLength = mml;
+        cond->prefix = calloc(1, aLen);
+        memcpy(cond->prefix, a, aLen);
+        cond->prefixLength = aLen;
+        cond->subcondition = sub;
+        break;
+    }
+
+    case 0xa2: // threshold
+        return derThreshold(p, cend, flags, stack, out);
+
+    case 0xa4: // ed25519
+    case 0xa5: // secp256k1
+    case 0xa6: // secp256k1hash
+    case 0xa3: // rsa, not supported beyond parsing
+        if (!derExpect(&p, cend, 0x80, &a, &aLen)) return 0;
+        if (!derExpect(&p, cend, 0x81, &b, &bLen) || p != cend) return 0;
+        if (!out) return 1;
+        if (tag == 0xa4) {
+            cond = cc_new(CC_Ed25519);
+            cond->publicKey = calloc(1, 32);
+            derCopyFixed(cond->publicKey, 32, a, aLen);
+            cond->signature = calloc(1, 64);
+            derCopyFixed(cond->signature, 64, b, bLen);
+        } else if (tag != 0xa3) {
+            uint8_t pk[33], sig[64];
+            derCopyFixed(pk, sizeof(pk), a, aLen);
+            derCopyFixed(sig, sizeof(sig), b, bLen);
+            cond = (tag == 0xa5) ? cc_secp256k1Condition(pk, sig) : cc_secp256k1hashCondition(NULL, pk, sig);
+            if (!cond) return 0;
+        } else {
+            fprintf(stderr, "Unknown fulfillment type: %i\n", Fulfillment_PR_rsaSha256);
+            return 0;
+        }
+        break;
+
+    case 0xaf: // eval, the param is not used yet
+        if (!derExpect(&p, cend, 0x80, &a, &aLen)) return 0;
+        if (p != cend && !derExpect(&p, cend, 0x81, &b, &bLen)) return 0;
+        if (p != cend) return 0;
+        if (!out) return 1;
+        cond = cc_new(CC_Eval);
+        cond->codeLength = aLen;
+        cond->code = calloc(1, aLen);
+        memcpy(cond->code, a, aLen);
+        break;
+
+    default:
+        return 0;
+    }
+    *out = cond;
+    return 1;
+}
+
+
+static CC *derReadFulfillment(const uint8_t *bin, size_t length, FulfillmentFlags flags) {
+    const uint8_t *p = bin, *end = bin + length, *content;
+    size_t len;
+    uint8_t tag;
+    CC *cond = 0;
+
+    // trailing bytes are rejected before anything gets built
+    if (!derRead(&p, end, &tag, &content, &len) || p != end) return NULL;
+    p = bin;
+    if (!derFulfillment(&p, end, flags, 0, &cond)) return NULL;
+    return cond;
+}
@@ -136,6 +136,104 @@ int cc_secp256k1VerifyTreeMsg32(const CC *cond, const unsigned char *msg32) {
 }
 
 
+/*
+ * Signature checks gathered from a tree
+ */
+typedef struct CCSigCheckList {
+    CCSigCheck *checks;
+    size_t n, size;
+} CCSigCheckList;
+
+
+/*
+ * Visitor that gathers the signature check of secp256k1 and secp256k1hash conditions
+ */
+static int secp256k1Collect(CC *cond, CCVisitor visitor) {
+    if (cond->type->typeId != CC_Secp256k1 && cond->type->typeId != CC_Secp256k1hash) return 1;
+    if (!cond->publicKey || !cond->signature) return 0;
+    CCSigCheckList *list = (CCSigCheckList*) visitor.context;
+    if (list->n == list->size) {
+        list->size = list->size ? list->size * 2 : 8;
+        list->checks = realloc(list->checks, list->size * sizeof(CCSigCheck));
+    }
+    CCSigCheck *check = &list->checks[list->n++];
+    check->publicKey = cond->publicKey;
+    check->signature = cond->signature;
+    check->msg32 = visitor.msg;
+    return 1;
+}
+
+
+/*
+ * Gather the signature checks of a tree instead of verifying them, the caller frees checks
+ */
+int cc_secp256k1CollectChecks(const CC *cond, const unsigned char *msg32, CCSigCheck **checks, size_t *n) {
+    int subtypes = cc_typeMask(cond);
+    *checks = NULL;
+    *n = 0;
+    if (subtypes & (1 << CC_PrefixType.typeId) &&
+        subtypes & ((1 << CC_Secp256k1) | (1 << CC_Secp256k1hash))) {
+        // No support for prefix currently, see cc_secp256k1VerifyTreeMsg32
+        return 0;
+    }
+    CCSigCheckList list = {NULL, 0, 0};
+    CCVisitor visitor = {&secp256k1Collect, msg32, 0, &list};
+    if (!cc_visit((CC*) cond, visitor)) {
+        free(list.checks);
+        return 0;
+    }
+    *checks = list.checks;
+    *n = list.n;
+    return 1;
+}
+
+
+/*
+ * Verify gathered signature checks. ECDSA has no sound batch verification:
+ * the compact signature keeps only the x coordinate of R, so the equations
+ * can not be summed. What is shared is parsing each public key once and
+ * verifying a repeated check once. On failure failed is set to the index
+ * of the first check that does not verify.
+ */
+int cc_secp256k1VerifyChecks(const CCSigCheck *checks, size_t n, size_t *failed) {
+    if (n == 0) return 1;
+    initVerify();
+
+    secp256k1_pubkey *pks = malloc(n * sizeof(secp256k1_pubkey));
+    int out = 1;
+    size_t i, j;
+    for (i=0; i<n; i++) {
+        const CCSigCheck *check = &checks[i];
+        for (j=0; j<i; j++)
+            if (0 == memcmp(checks[j].publicKey, check->publicKey, SECP256K1_PK_SIZE))
+                break;
+        if (j < i) {
+            pks[i] = pks[j];
+            for (; j<i; j++)
+                if (0 == memcmp(checks[j].publicKey, check->publicKey, SECP256K1_PK_SIZE) &&
+                    0 == memcmp(checks[j].signature, check->signature, SECP256K1_SIG_SIZE) &&
+                    0 == memcmp(checks[j].msg32, check->msg32, 32))
+                    break;
+            if (j < i) continue;
+        }
+        else if (secp256k1_ec_pubkey_parse(ec_ctx_verify, &pks[i], check->publicKey, SECP256K1_PK_SIZE) != 1) {
+            out = 0;
+            break;
+        }
+
+        secp256k1_ecdsa_signature sig;
+        if (secp256k1_ecdsa_signature_parse_compact(ec_ctx_verify, &sig, check->signature) != 1 ||
+            secp256k1_ecdsa_verify(ec_ctx_verify, &sig, check->msg32, &pks[i]) != 1) {
+            out = 0;
+            break;
+        }
+    }
+    free(pks);
+    if (!out && failed) *failed = i;
+    return out;
+}
+
+
 /*
  * Signing data
  */
@@ -18,6 +18,7 @@
 #include "chainparams.h"
 #include "httpserver.h"
 #include "key_io.h"
+#include "rpc/jsonstream.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -67,12 +68,29 @@ private:
     struct event_base* base;
 };
 
+/** Spreads the calls of batch requests over the HTTP worker threads */
+class HTTPRPCWorkInterface : public RPCWorkInterface
+{
+public:
+    const char* Name()
+    {
+        return "HTTP";
+    }
+    bool QueueWork(const boost::function<void(void)>& func)
+    {
+        return QueueHTTPWork(func);
+    }
+};
+
 
 /* Pre-base64-encoded authentication token */
 static std::string strRPCUserColonPass;
 /* Stored RPC timer interface (for unregistration) */
 static HTTPRPCTimerInterface* httpRPCTimerInterface = 0;
 
+/* Stored RPC work interface (for unregistration) */
+static HTTPRPCWorkInterface* httpRPCWorkInterface = 0;
+
 static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const UniValue& id)
 {
     // Send error reply from json-rpc error object
@@ -102,6 +120,24 @@ static bool RPCAuthorized(const std::string& strAuth)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
+/**
+ * Finish a streamed reply whose method failed after part of the result was sent.
+ * The status line is gone already, so the partial result is closed and the
+ * error is reported in the reply object: clients see a non-null error.
+ */
+static bool JSONStreamErrorReply(HTTPRequest* req, JSONStreamWriter& out, const UniValue& objError, const JSONRequest& jreq)
+{
+    LogPrintf("%s: %s failed after sending part of its result\n", __func__, jreq.strMethod);
+    out.Unwind(1);
+    out.Key("error");
+    out.Value(objError);
+    out.Key("id");
+    out.Value(jreq.id);
+    out.EndObject();
+    req->WriteReplyEnd(HTTP_OK, out.Finish() + "\n");
+    return false;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -151,6 +187,44 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
                 return false;
             }
 
+            // Methods with a stream variant send their result while it is produced
+            bool fStarted = false;
+            JSONStreamWriter out([req, &fStarted](const std::string& strChunk) {
+                if (!fStarted)
+                    req->WriteHeader("Content-Type", "application/json");
+                fStarted = true;
+                req->WriteReplyChunk(HTTP_OK, strChunk);
+            });
+            out.BeginObject();
+            out.Key("result");
+            bool fStreamed;
+            try {
+                fStreamed = tableRPC.executeStream(jreq.strMethod, jreq.params, out);
+            } catch (const UniValue& objError) {
+                if (!fStarted)
+                    throw;
+                return JSONStreamErrorReply(req, out, objError, jreq);
+            } catch (const std::exception& e) {
+                if (!fStarted)
+                    throw;
+                return JSONStreamErrorReply(req, out, JSONRPCError(RPC_MISC_ERROR, e.what()), jreq);
+            } catch (...) {
+                if (!fStarted)
+                    throw;
+                return JSONStreamErrorReply(req, out, JSONRPCError(RPC_MISC_ERROR, "unknown error"), jreq);
+            }
+            if (fStreamed) {
+                out.Key("error");
+                out.Value(NullUniValue);
+                out.Key("id");
+                out.Value(jreq.id);
+                out.EndObject();
+                if (!fStarted)
+                    req->WriteHeader("Content-Type", "application/json");
+                req->WriteReplyEnd(HTTP_OK, out.Finish() + "\n");
+                return true;
+            }
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -202,6 +276,8 @@ bool StartHTTPRPC()
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
     RPCRegisterTimerInterface(httpRPCTimerInterface);
+    httpRPCWorkInterface = new HTTPRPCWorkInterface();
+    RPCSetWorkInterface(httpRPCWorkInterface);
     return true;
 }
 
@@ -219,4 +295,9 @@ void StopHTTPRPC()
         delete httpRPCTimerInterface;
         httpRPCTimerInterface = 0;
     }
+    if (httpRPCWorkInterface) {
+        RPCSetWorkInterface(NULL);
+        delete httpRPCWorkInterface;
+        httpRPCWorkInterface = 0;
+    }
 }
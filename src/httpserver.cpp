@@ -40,6 +40,8 @@
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <future>
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -60,6 +62,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item running a plain function, used for work that is not an HTTP request */
+class HTTPFunctionWorkItem : public HTTPClosure
+{
+public:
+    HTTPFunctionWorkItem(const boost::function<void(void)>& func): func(func)
+    {
+    }
+    void operator()()
+    {
+        func();
+    }
+
+private:
+    boost::function<void(void)> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -248,6 +266,22 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
     }
 }
 
+/** Re-enable reading from the socket when replying. This is the second
+ * part of the libevent workaround in http_request_cb.
+ */
+static void http_enable_read(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request* req, void* arg)
 {
@@ -520,6 +554,17 @@ void StopHTTPServer()
     LogPrint("http", "Stopped HTTP server\n");
 }
 
+bool QueueHTTPWork(const boost::function<void(void)>& func)
+{
+    if (!workQueue)
+        return false;
+    std::unique_ptr<HTTPFunctionWorkItem> item(new HTTPFunctionWorkItem(func));
+    if (!workQueue->Enqueue(item.get()))
+        return false;
+    item.release(); /* queue took ownership */
+    return true;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -552,12 +597,18 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
+                                                       replyStarted(false),
+                                                       nReplyQueued(0),
                                                        replySent(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (!replySent && replyStarted) {
+        // A chunked reply that was abandoned can not be completed any more
+        LogPrintf("%s: Unfinished reply\n", __func__);
+        WriteReplyAbort();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -610,7 +661,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !replyStarted && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -618,17 +669,118 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, (const char*)NULL, (struct evbuffer *)NULL);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        http_enable_read(req_copy);
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+/** Chunks are sent from the main http thread as well. The events are
+ * triggered in order, so they are handled in the order they were written.
+ * If the client disconnected in the meantime libevent keeps the request
+ * until the reply is ended, the chunks are then dropped.
+ */
+void HTTPRequest::WriteReplyChunk(int nStatus, const std::string& strChunk)
+{
+    assert(!replySent && req);
+    auto req_copy = req;
+    if (!replyStarted) {
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+            if (evhttp_request_get_connection(req_copy))
+                evhttp_send_reply_start(req_copy, nStatus, (const char*)NULL);
+        });
+        ev->trigger(0);
+        replyStarted = true;
+    }
+    if (strChunk.empty())
+        return;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, strChunk]{
+        struct evbuffer* evb = evbuffer_new();
+        if (evb) {
+            evbuffer_add(evb, strChunk.data(), strChunk.size());
+            evhttp_send_reply_chunk(req_copy, evb);
+            evbuffer_free(evb);
+        }
+    });
+    ev->trigger(0);
+    nReplyQueued += strChunk.size();
+    if (nReplyQueued >= HTTP_REPLY_MAX_QUEUED)
+        WaitReplyDrained();
+}
+
+/** The length of the connection output buffer is read on the main http
+ * thread, after the chunks queued before. The producer polls it until it
+ * falls below half of HTTP_REPLY_MAX_QUEUED. A closed connection reports
+ * nothing queued, and a client that takes nothing for the server timeout
+ * is given up on; libevent drops the connection then anyway.
+ */
+void HTTPRequest::WaitReplyDrained()
+{
+    auto req_copy = req;
+    int64_t nTimeout = GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT) * 1000;
+    int64_t nLastProgress = GetTimeMillis();
+    size_t nPrevQueued = nReplyQueued;
+    while (true) {
+        std::shared_ptr<std::promise<size_t> > queued = std::make_shared<std::promise<size_t> >();
+        std::future<size_t> result = queued->get_future();
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, queued]{
             evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
+            bufferevent* bev = conn ? evhttp_connection_get_bufferevent(conn) : NULL;
+            queued->set_value(bev ? evbuffer_get_length(bufferevent_get_output(bev)) : 0);
+        });
+        ev->trigger(0);
+        if (result.wait_for(std::chrono::seconds(1)) == std::future_status::ready) {
+            nReplyQueued = result.get();
+            if (nReplyQueued < HTTP_REPLY_MAX_QUEUED / 2)
+                return;
+            if (nReplyQueued < nPrevQueued)
+                nLastProgress = GetTimeMillis();
+            nPrevQueued = nReplyQueued;
+        }
+        if (GetTimeMillis() - nLastProgress > nTimeout) {
+            LogPrint("http", "%s: client is not reading, %u bytes of the reply left queued\n", __func__, nReplyQueued);
+            nReplyQueued = 0;
+            return;
         }
+        MilliSleep(10);
+    }
+}
+
+void HTTPRequest::WriteReplyEnd(int nStatus, const std::string& strReply)
+{
+    if (!replyStarted) {
+        WriteReply(nStatus, strReply);
+        return;
+    }
+    WriteReplyChunk(nStatus, strReply);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        // evhttp_send_reply_end can free the request, so do this first
+        http_enable_read(req_copy);
+        evhttp_send_reply_end(req_copy);
+    });
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::WriteReplyAbort()
+{
+    assert(!replySent && req);
+    if (!replyStarted) {
+        WriteReply(HTTP_INTERNAL);
+        return;
+    }
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        // Freeing the connection frees the request with it. Without a
+        // connection the client is gone and the reply only has to be ended.
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn)
+            evhttp_connection_free(conn);
+        else
+            evhttp_send_reply_end(req_copy);
     });
     ev->trigger(0);
     replySent = true;
@@ -17,6 +17,8 @@
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** A chunked reply waits for the client once this much is queued on its connection */
+static const size_t HTTP_REPLY_MAX_QUEUED=1024*1024;
 
 struct evhttp_request;
 struct event_base;
@@ -52,6 +54,11 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** Queue func on the HTTP worker threads.
+ * Returns false if the work queue is full or not running; func is not run in that case.
+ */
+bool QueueHTTPWork(const boost::function<void(void)>& func);
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -59,6 +66,11 @@ class HTTPRequest
 {
 private:
     struct evhttp_request* req;
+    bool replyStarted;
+    size_t nReplyQueued;
+
+    /** Wait until the client has taken most of the queued reply */
+    void WaitReplyDrained();
 
     // For test access
 protected:
@@ -118,6 +130,32 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     virtual void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write part of a chunked HTTP reply, for large replies that are produced
+     * incrementally. The first call starts the reply with status nStatus.
+     *
+     * Once HTTP_REPLY_MAX_QUEUED bytes wait for the client this blocks until
+     * the connection has sent most of them, so a slow client can not make
+     * the whole reply pile up in memory. Do not hold locks when calling it.
+     *
+     * @note Complete the reply with WriteReplyEnd, WriteReply can not be
+     * used after this was called.
+     */
+    virtual void WriteReplyChunk(int nStatus, const std::string& strChunk);
+
+    /**
+     * Complete a reply. If no chunk was written yet this is WriteReply,
+     * otherwise strReply is sent as the last part of the chunked reply.
+     */
+    virtual void WriteReplyEnd(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Give up on a chunked reply that can not be completed. The connection
+     * is closed without the terminating chunk, so the client sees a failed
+     * transfer instead of a short body with a success status.
+     */
+    virtual void WriteReplyAbort();
 };
 
 /** Event handler closure.
@@ -21,6 +21,12 @@
  _functions() assume DEX_globalmutex is locked when it is called
  functions() assume that DEX_globalmutes is not locked when it is called and must lock/unlock to call _functions()
  
+ All added datablobs are appended to the DEX.packets log in the datadir, so a restarted node reloads the last KOMODO_DEX_PURGETIME of packets instead of pulling all of them from its peers. Each record is a DEX_logrecord followed by the packet as received, padded to 8 bytes, so the file can be read sequentially or mmapped. Purged packets are dropped from the log by compaction every KOMODO_DEX_COMPACTINTERVAL, a torn record at the end of the log (crash during append) stops the load and is compacted away.
+ 
+ What each peer already has is tracked with a rolling bloom filter of datablob hashes per peerpos (peerknown), instead of a bitmask per datablob, and what was already pinged to it in peerannounced. So each packet is only included in the per second 'P' pings to a peer once, the KOMODO_DEX_POLLVIP scan re-announces everything the peer still doesnt have. A false positive means the packet is not offered to that peer by this node, it will still get it from its other peers.
+ 
+ DEX_refmutex only guards datablob refcount/linkmask so a datablob can be freed by whichever of purge or an outbound send lets go of it last. Packets are not sent while DEX_globalmutex is held, _functions() queue them into a DEX_sendqueue (taking a reference on datablobs) and the caller flushes it after unlocking, straight from the immutable datablob memory. The txpow hash of incoming quotes is also calculated before locking, so ingest, purge and relay of different peers only serialize on the actual hashtable/index updates.
+ 
  message format: <relay depth> <funcid> <timestamp> <payload>
  
  <payload> is the datablob for a 'Q' quote or <uint16_t> + n * <uint32_t> for a 'P' ping of recent shorthashes
@@ -83,6 +89,9 @@ later:
 #define SECONDS_IN_DAY (24*3600)
 #define KOMODO_DEX_PEERPERIOD KOMODO_DEX_PURGETIME // must be evenly divisible into SECONDS_IN_DAY
 #define KOMODO_DEX_PEEREPOCHS (SECONDS_IN_DAY / KOMODO_DEX_PEERPERIOD)
+#define KOMODO_DEX_PEERFILTERSIZE 10000 // most rolling bloom filter elements per peer
+#define KOMODO_DEX_PEERFILTERMIN 500 // fewest, filters hold twice the packets added in KOMODO_DEX_MAXLAG between
+#define KOMODO_DEX_PEERFILTERFP 0.0001 // a false positive only skips pushing that packet to that peer, ~10 bytes per element
 
 #define KOMODO_DEX_TAGSIZE 16   // (33 / 2) rounded down
 #define KOMODO_DEX_MAXKEYSIZE 34 // destpub 1+33, or tagAB 1+16 + 1 + 16 -> both are 34
@@ -102,8 +111,15 @@ later:
 
 #define KOMODO_DEX_FILEBUFSIZE 10000
 #define KOMODO_DEX_STREAMSIZE 100
+#define KOMODO_DEX_SYNCTHREADS 8 // subscribe decrypts and writes fragments with up to this many threads
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
 #define KOMODO_DEX_ANONSIZE 1024
 
+#define KOMODO_DEX_PACKETLOG "DEX.packets"
+#define KOMODO_DEX_COMPACTINTERVAL (KOMODO_DEX_PURGETIME / 6) // packet log is rewritten without the purged packets every 10 minutes
+
 #define _komodo_DEXquotehash(hash,len) (uint32_t)(((hash).ulongs[0] >> (KOMODO_DEX_TXPOWBITS + komodo_DEX_sizepriority(len))))
 #define komodo_DEX_id(ptr) _komodo_DEXquotehash(ptr->hash,ptr->datalen)
 
@@ -115,11 +131,10 @@ struct DEX_datablob
     UT_hash_handle hh;
     struct DEX_datablob *nexts[KOMODO_DEX_MAXINDICES],*prevs[KOMODO_DEX_MAXINDICES];
     bits256 hash;
-    uint8_t peermask[KOMOD_DEX_PEERMASKSIZE];
-    uint32_t recvtime,cancelled,lastlist,shorthash;
+    uint32_t recvtime,cancelled,lastlist,shorthash,refcount;
     int32_t datalen;
     int8_t priority,sizepriority;
-    uint8_t numsent,offset,linkmask,requested;
+    uint8_t numsent,offset,linkmask,requested,recvdepth; // recvdepth is data[0] as received, before the decrement
     uint8_t data[];
 };
 
@@ -133,6 +148,21 @@ struct DEX_index
     uint8_t key[KOMODO_DEX_MAXKEYSIZE];
 } *DEX_destpubs,*DEX_tagAs,*DEX_tagBs,*DEX_tagABs;
 
+struct DEX_sendrequest { struct DEX_datablob *ptr; int32_t datalen; uint8_t resp0; };
+
+struct DEX_sendqueue // filled while DEX_globalmutex is locked, sent after it is unlocked
+{
+    std::vector<struct DEX_sendrequest> blobs;
+    std::vector<std::vector<uint8_t> > packets;
+};
+
+struct DEX_logrecord
+{
+    bits256 hash;
+    uint32_t recvtime,shorthash,crc32;
+    int32_t datalen;
+};
+
 struct DEX_orderbookentry
 {
     bits256 hash;
@@ -151,7 +181,7 @@ static int64_t DEX_Numpending,DEX_freed,DEX_truncated;
 
 static uint32_t Got_Recent_Quote;
 bits256 DEX_pubkey,GENESIS_PUBKEY,GENESIS_PRIVKEY;
-pthread_mutex_t DEX_globalmutex;
+pthread_mutex_t DEX_globalmutex,DEX_refmutex;
 
 static struct DEX_globals
 {
@@ -163,9 +193,14 @@ static struct DEX_globals
     struct DEX_datablob *Purgelist[KOMODO_DEX_MAXPERSEC * KOMODO_DEX_MAXLAG];
     int32_t numpurges;
 #endif
-    FILE *fp;
+    CRollingBloomFilter *peerknown[KOMODO_DEX_MAXPEERID],*peerannounced[KOMODO_DEX_MAXPEERID];
+    FILE *fp,*packetfp;
+    uint32_t lastcompact,compacting,addpersec;
 } *G;
 
+int32_t _komodo_DEX_packetlogload(uint32_t now);
+int32_t komodo_DEX_packetlogcompact(uint32_t cutoff);
+
 void komodo_DEX_privkey(bits256 &privkey)
 {
     bits256 priv,hash;
@@ -206,6 +241,7 @@ void komodo_DEX_init()
         decode_hex(GENESIS_PUBKEY.bytes,sizeof(GENESIS_PUBKEY),GENESIS_PUBKEYSTR);
         decode_hex(GENESIS_PRIVKEY.bytes,sizeof(GENESIS_PRIVKEY),GENESIS_PRIVKEYSTR);
         pthread_mutex_init(&DEX_globalmutex,0);
+        pthread_mutex_init(&DEX_refmutex,0);
         komodo_DEX_pubkeyupdate();
         G = (struct DEX_globals *)calloc(1,sizeof(*G));
         if ( (G->fp= fopen((char *)"DEX.log",(char *)"wb")) == 0 )
@@ -214,6 +250,11 @@ void komodo_DEX_init()
             exit(-1);
         }
         char str[67]; fprintf(stderr,"DEX_pubkey.(01%s) sizeof DEX_globals %ld\n\n",bits256_str(str,DEX_pubkey),sizeof(*G));
+        uint32_t now = (uint32_t)time(NULL);
+        pthread_mutex_lock(&DEX_globalmutex);
+        _komodo_DEX_packetlogload(now);
+        pthread_mutex_unlock(&DEX_globalmutex);
+        komodo_DEX_packetlogcompact(now - KOMODO_DEX_PURGETIME + 6);
         onetime = 1;
     }
 }
@@ -297,11 +338,78 @@ uint8_t *komodo_DEX_decrypt(uint8_t *senderpub,uint8_t **allocatedp,uint8_t *dat
     return(data);
 }
 
+uint256 komodo_DEX_filterkey(struct DEX_datablob *ptr)
+{
+    uint256 key;
+    memcpy(key.begin(),ptr->hash.bytes,sizeof(ptr->hash));
+    return(key);
+}
+
+void _komodo_DEX_peerreset(int32_t peerpos) // the filters are made again at the next packet, sized for the traffic then
+{
+    if ( G->peerknown[peerpos] != 0 )
+    {
+        delete G->peerknown[peerpos];
+        G->peerknown[peerpos] = 0;
+    }
+    if ( G->peerannounced[peerpos] != 0 )
+    {
+        delete G->peerannounced[peerpos];
+        G->peerannounced[peerpos] = 0;
+    }
+}
+
+CRollingBloomFilter *_komodo_DEX_peerfilter()
+{
+    uint32_t n = G->addpersec * KOMODO_DEX_MAXLAG * 2;
+    if ( n < KOMODO_DEX_PEERFILTERMIN )
+        n = KOMODO_DEX_PEERFILTERMIN;
+    else if ( n > KOMODO_DEX_PEERFILTERSIZE )
+        n = KOMODO_DEX_PEERFILTERSIZE;
+    return(new CRollingBloomFilter(n,KOMODO_DEX_PEERFILTERFP));
+}
+
+void _komodo_DEX_peerrelease(uint32_t timestamp) // frees the filters of slots no peer held this epoch or the last
+{
+    int32_t i,epoch = ((timestamp % SECONDS_IN_DAY) / KOMODO_DEX_PEERPERIOD);
+    for (i=1; i<KOMODO_DEX_MAXPEERID; i++)
+    {
+        if ( G->DEX_peermaps[epoch][i] == 0 && G->DEX_peermaps[(epoch + KOMODO_DEX_PEEREPOCHS - 1) % KOMODO_DEX_PEEREPOCHS][i] == 0 )
+            _komodo_DEX_peerreset(i);
+    }
+}
+
+int32_t _komodo_DEX_peerknows(int32_t peerpos,struct DEX_datablob *ptr)
+{
+    if ( G->peerknown[peerpos] == 0 )
+        return(0);
+    return(G->peerknown[peerpos]->contains(komodo_DEX_filterkey(ptr)));
+}
+
+void _komodo_DEX_peerhas(int32_t peerpos,struct DEX_datablob *ptr)
+{
+    if ( G->peerknown[peerpos] == 0 )
+        G->peerknown[peerpos] = _komodo_DEX_peerfilter();
+    G->peerknown[peerpos]->insert(komodo_DEX_filterkey(ptr));
+}
+
+int32_t _komodo_DEX_peerannounced(int32_t peerpos,struct DEX_datablob *ptr)
+{
+    if ( G->peerannounced[peerpos] == 0 )
+        return(0);
+    return(G->peerannounced[peerpos]->contains(komodo_DEX_filterkey(ptr)));
+}
 
+void _komodo_DEX_peerannounce(int32_t peerpos,struct DEX_datablob *ptr)
+{
+    if ( G->peerannounced[peerpos] == 0 )
+        G->peerannounced[peerpos] = _komodo_DEX_peerfilter();
+    G->peerannounced[peerpos]->insert(komodo_DEX_filterkey(ptr));
+}
 
 uint16_t _komodo_DEXpeerpos(uint32_t timestamp,int32_t peerid)
 {
-    // this needs to maintain the bitposition from epoch to epoch, to preserve the accuracy of the GETBIT()
+    // peerpos can change from epoch to epoch, the peer filters are reset unless the peer had the same peerpos in the previous epoch
     int32_t epoch,*peermap; uint16_t i;
     if ( G != 0 )
     {
@@ -311,6 +419,8 @@ uint16_t _komodo_DEXpeerpos(uint32_t timestamp,int32_t peerid)
         {
             if ( peermap[i] == 0 )
             {
+                if ( G->DEX_peermaps[(epoch + KOMODO_DEX_PEEREPOCHS - 1) % KOMODO_DEX_PEEREPOCHS][i] != peerid )
+                    _komodo_DEX_peerreset(i);
                 peermap[i] = peerid;
                 //fprintf(stderr,"epoch.%d [%d] <- peerid.%d\n",epoch,i,peerid);
                 return(i);
@@ -412,6 +522,45 @@ void _komodo_DEX_enqueue(int32_t ind,struct DEX_index *index,struct DEX_datablob
     SETBIT(&ptr->linkmask,ind);
 }
 
+int32_t komodo_DEX_unlink(struct DEX_datablob *ptr,int32_t ind)
+{
+    int32_t freeflag = 0;
+    pthread_mutex_lock(&DEX_refmutex);
+    CLEARBIT(&ptr->linkmask,ind);
+    if ( ptr->linkmask == 0 && ptr->refcount == 0 )
+    {
+        freeflag = 1;
+        DEX_freed++;
+    }
+    pthread_mutex_unlock(&DEX_refmutex);
+    if ( freeflag != 0 )
+        free(ptr);
+    return(freeflag);
+}
+
+void komodo_DEX_retain(struct DEX_datablob *ptr)
+{
+    pthread_mutex_lock(&DEX_refmutex);
+    ptr->refcount++;
+    pthread_mutex_unlock(&DEX_refmutex);
+}
+
+void komodo_DEX_release(struct DEX_datablob *ptr)
+{
+    int32_t freeflag = 0;
+    pthread_mutex_lock(&DEX_refmutex);
+    if ( ptr->refcount == 0 )
+        fprintf(stderr,"DEX_release %p with refcount.0\n",ptr);
+    else if ( --ptr->refcount == 0 && ptr->linkmask == 0 )
+    {
+        freeflag = 1;
+        DEX_freed++;
+    }
+    pthread_mutex_unlock(&DEX_refmutex);
+    if ( freeflag != 0 )
+        free(ptr);
+}
+
 uint32_t _komodo_DEXtotal(int32_t *histo,int32_t &total)
 {
     struct DEX_datablob *ptr,*tmp; int32_t priority; uint32_t modval,n,hash,totalhash = 0;
@@ -435,19 +584,10 @@ uint32_t _komodo_DEXtotal(int32_t *histo,int32_t &total)
 
 uint32_t _komodo_DEX_peerclear(int32_t peerpos)
 {
-    struct DEX_datablob *ptr,*tmp; uint32_t modval,n=0,hash,totalhash = 0;
-    for (modval=0; modval<KOMODO_DEX_PURGETIME; modval++)
-    {
-        HASH_ITER(hh,G->Hashtables[modval],ptr,tmp)
-        {
-            if ( ptr->priority >= KOMODO_DEX_VIPLEVEL )
-            {
-                n++;
-                CLEARBIT(ptr->peermask,peerpos);
-            }
-        }
-    }
-    return(n);
+    if ( peerpos <= 0 || peerpos >= KOMODO_DEX_MAXPEERID )
+        return(0);
+    _komodo_DEX_peerreset(peerpos);
+    return(1);
 }
 
 int32_t _komodo_DEX_purgeindex(int32_t ind,struct DEX_index *index,uint32_t cutoff)
@@ -468,16 +608,13 @@ int32_t _komodo_DEX_purgeindex(int32_t ind,struct DEX_index *index,uint32_t cuto
                 index->tail = 0;
             DL_DELETEind(index->head,ptr,ind);
             n++;
+#if KOMODO_DEX_PURGELIST
             CLEARBIT(&ptr->linkmask,ind);
             if ( ptr->linkmask == 0 )
-            {
-#if KOMODO_DEX_PURGELIST
                 G->Purgelist[G->numpurges++] = ptr;
 #else
-                free(ptr);
-                DEX_freed++;
+            komodo_DEX_unlink(ptr,ind); // a queued outbound send keeps it alive until it is released
 #endif
-             } // else fprintf(stderr,"%p ind.%d linkmask.%x\n",ptr,ind,ptr->linkmask);
              ptr = index->head;
         }
         else
@@ -513,8 +650,12 @@ int32_t _komodo_DEXpurge(uint32_t cutoff)
             purgehash ^= ptr->shorthash;
             HASH_DELETE(hh,G->Hashtables[modval],ptr);
             ptr->datalen = 0;
-            CLEARBIT(&ptr->linkmask,KOMODO_DEX_MAXINDICES);
             DEX_truncated++;
+#if KOMODO_DEX_PURGELIST
+            CLEARBIT(&ptr->linkmask,KOMODO_DEX_MAXINDICES);
+#else
+            komodo_DEX_unlink(ptr,KOMODO_DEX_MAXINDICES);
+#endif
             n++;
         } // else fprintf(stderr,"modval.%d unexpected purge.%d t.%u vs cutoff.%u\n",modval,i,t,cutoff);
     }
@@ -533,6 +674,8 @@ int32_t _komodo_DEXpurge(uint32_t cutoff)
         fprintf(stderr,"%s %lld/sec\n",komodo_DEX_islagging()!=0?"LAG":"",cutoff>lastcutoff ? (long long)(DEX_totaladd - lastadd)/(cutoff - lastcutoff) : 0);
         if ( cutoff > lastcutoff )
         {
+            G->addpersec = (uint32_t)((DEX_totaladd - lastadd) / (cutoff - lastcutoff));
+            _komodo_DEX_peerrelease(cutoff);
             lastadd = DEX_totaladd;
             prevtotalhash = totalhash;
             lastcutoff = cutoff;
@@ -580,7 +723,7 @@ int32_t _komodo_DEX_purgeindices(uint32_t cutoff)
             iguana_rwnum(0,&ptr->data[2],sizeof(t),&t);
             if ( t <= cutoff - KOMODO_DEX_MAXLAG/2 )
             {
-                if ( ptr->linkmask == 0 )
+                if ( ptr->linkmask == 0 && ptr->refcount == 0 )
                 {
                     G->Purgelist[i] = G->Purgelist[--G->numpurges];
                     G->Purgelist[G->numpurges] = 0;
@@ -862,6 +1005,152 @@ struct DEX_datablob *_komodo_DEXfind(int32_t modval,uint32_t shorthash)
     return(ptr);
 }
 
+char *komodo_DEX_packetlogfname(char *fname,char *suffix)
+{
+    sprintf(fname,"%s/%s%s",GetDataDir().string().c_str(),KOMODO_DEX_PACKETLOG,suffix);
+    return(fname);
+}
+
+int32_t komodo_DEX_packetlogwrite(FILE *fp,struct DEX_logrecord *rec,uint8_t *msg)
+{
+    static uint8_t zeroes[8];
+    int32_t padding = (-rec->datalen) & 7;
+    if ( fwrite(rec,1,sizeof(*rec),fp) != sizeof(*rec) || fwrite(msg,1,rec->datalen,fp) != rec->datalen || (padding != 0 && fwrite(zeroes,1,padding,fp) != padding) )
+    {
+        fprintf(stderr,"error writing DEX packet log %08x datalen.%d\n",rec->shorthash,rec->datalen);
+        return(-1);
+    }
+    return(sizeof(*rec) + rec->datalen + padding);
+}
+
+uint32_t komodo_DEX_packetlogcrc(struct DEX_logrecord *rec,uint8_t *msg)
+{
+    struct DEX_logrecord hdr = *rec;
+    hdr.crc32 = 0; // the crc covers the header fields and the message
+    return(calc_crc32(calc_crc32(0,&hdr,sizeof(hdr)),msg,rec->datalen));
+}
+
+int32_t komodo_DEX_packetlogread(FILE *fp,struct DEX_logrecord *rec,uint8_t *msg)
+{
+    int32_t padding;
+    if ( fread(rec,1,sizeof(*rec),fp) != sizeof(*rec) )
+        return(0);
+    if ( rec->datalen < KOMODO_DEX_ROUTESIZE || rec->datalen > KOMODO_DEX_MAXPACKETSIZE )
+        return(-1);
+    padding = (-rec->datalen) & 7;
+    if ( fread(msg,1,rec->datalen,fp) != rec->datalen || fseek(fp,padding,SEEK_CUR) != 0 )
+        return(-1);
+    if ( komodo_DEX_packetlogcrc(rec,msg) != rec->crc32 )
+        return(-1);
+    return(sizeof(*rec) + rec->datalen + padding);
+}
+
+int32_t _komodo_DEX_packetlogappend(struct DEX_datablob *ptr,uint8_t *msg)
+{
+    struct DEX_logrecord rec;
+    if ( G->packetfp == 0 )
+        return(0);
+    memset(&rec,0,sizeof(rec));
+    rec.hash = ptr->hash;
+    rec.recvtime = ptr->recvtime;
+    rec.shorthash = ptr->shorthash;
+    rec.datalen = ptr->datalen;
+    rec.crc32 = komodo_DEX_packetlogcrc(&rec,msg);
+    return(komodo_DEX_packetlogwrite(G->packetfp,&rec,msg)); // msg[0] is the relaydepth as received
+}
+
+int32_t komodo_DEX_packetlogsnapshot(FILE *newfp,std::vector<struct DEX_datablob *> &blobs,uint8_t *msg)
+{
+    struct DEX_logrecord rec; int32_t i,n = 0;
+    for (i=0; i<blobs.size(); i++)
+    {
+        struct DEX_datablob *ptr = blobs[i];
+        memset(&rec,0,sizeof(rec));
+        rec.hash = ptr->hash;
+        rec.recvtime = ptr->recvtime;
+        rec.shorthash = ptr->shorthash;
+        rec.datalen = ptr->datalen;
+        memcpy(msg,ptr->data,ptr->datalen);
+        msg[0] = ptr->recvdepth; // the relaydepth as received, a decremented 0 and a received 0xff both read 0xff
+        rec.crc32 = komodo_DEX_packetlogcrc(&rec,msg);
+        if ( newfp != 0 && komodo_DEX_packetlogwrite(newfp,&rec,msg) > 0 )
+            n++;
+        komodo_DEX_release(ptr);
+    }
+    return(n);
+}
+
+int32_t komodo_DEX_packetlogcompact(uint32_t cutoff) // called without DEX_globalmutex, only the snapshot and the tail copy hold it
+{
+    std::vector<struct DEX_datablob *> packets,cancels; struct DEX_datablob *ptr,*tmp; FILE *fp,*newfp; char fname[512],tmpfname[512]; uint8_t *msg; struct DEX_logrecord rec; int32_t modval,retval,n,m = 0; uint32_t t; long offset = 0;
+    komodo_DEX_packetlogfname(fname,(char *)"");
+    komodo_DEX_packetlogfname(tmpfname,(char *)".tmp");
+    pthread_mutex_lock(&DEX_globalmutex);
+    if ( G->compacting != 0 )
+    {
+        pthread_mutex_unlock(&DEX_globalmutex);
+        return(0);
+    }
+    G->compacting = 1;
+    for (modval=0; modval<KOMODO_DEX_PURGETIME; modval++)
+    {
+        HASH_ITER(hh,G->Hashtables[modval],ptr,tmp)
+        {
+            iguana_rwnum(0,&ptr->data[2],sizeof(t),&t);
+            if ( t > cutoff )
+            {
+                komodo_DEX_retain(ptr);
+                if ( ptr->data[1] == 'X' ) // cancels are written after what they cancel
+                    cancels.push_back(ptr);
+                else packets.push_back(ptr);
+            }
+        }
+    }
+    if ( G->packetfp != 0 ) // records appended while the snapshot is written are copied from here
+    {
+        fflush(G->packetfp);
+        offset = ftell(G->packetfp);
+    }
+    pthread_mutex_unlock(&DEX_globalmutex);
+    if ( (newfp= fopen(tmpfname,"wb")) == 0 )
+        fprintf(stderr,"couldnt create %s, DEX packet log not compacted\n",tmpfname);
+    msg = (uint8_t *)malloc(KOMODO_DEX_MAXPACKETSIZE);
+    n = komodo_DEX_packetlogsnapshot(newfp,packets,msg);
+    n += komodo_DEX_packetlogsnapshot(newfp,cancels,msg);
+    pthread_mutex_lock(&DEX_globalmutex);
+    if ( newfp != 0 )
+    {
+        if ( G->packetfp != 0 )
+        {
+            fflush(G->packetfp);
+            if ( (fp= fopen(fname,"rb")) != 0 )
+            {
+                if ( fseek(fp,offset,SEEK_SET) == 0 )
+                {
+                    while ( (retval= komodo_DEX_packetlogread(fp,&rec,msg)) > 0 )
+                    {
+                        komodo_DEX_packetlogwrite(newfp,&rec,msg);
+                        m++;
+                    }
+                }
+                fclose(fp);
+            }
+            fclose(G->packetfp), G->packetfp = 0;
+        }
+        fclose(newfp);
+        if ( rename(tmpfname,fname) != 0 )
+            fprintf(stderr,"error renaming %s to %s\n",tmpfname,fname);
+        G->packetfp = fopen(fname,"ab");
+        G->lastcompact = cutoff;
+    }
+    G->compacting = 0;
+    pthread_mutex_unlock(&DEX_globalmutex);
+    free(msg);
+    if ( (0) )
+        fprintf(stderr,"DEX packet log compacted, wrote %d live packets and %d appended meanwhile\n",n,m);
+    return(newfp != 0 ? n + m : -1);
+}
+
 struct DEX_datablob *_komodo_DEXadd(uint32_t now,int32_t modval,bits256 hash,uint32_t shorthash,uint8_t *msg,int32_t len)
 {
     int32_t ind,offset,priority; struct DEX_datablob *ptr; struct DEX_index *tips[KOMODO_DEX_MAXINDICES]; uint64_t amountA,amountB; uint8_t tagA[KOMODO_DEX_TAGSIZE+1],tagB[KOMODO_DEX_TAGSIZE+1],destpub33[33]; int8_t lenA,lenB,plen;
@@ -893,6 +1182,7 @@ struct DEX_datablob *_komodo_DEXadd(uint32_t now,int32_t modval,bits256 hash,uin
         ptr->sizepriority = komodo_DEX_sizepriority(len);
         ptr->offset = offset + KOMODO_DEX_ROUTESIZE; // payload is after relaydepth, funcid, timestamp
         memcpy(ptr->data,msg,len);
+        ptr->recvdepth = msg[0];
         ptr->data[0] = msg[0] != 0xff ? msg[0] - 1 : msg[0];
         {
             HASH_ADD(hh,G->Hashtables[modval],shorthash,sizeof(ptr->shorthash),ptr);
@@ -900,6 +1190,7 @@ struct DEX_datablob *_komodo_DEXadd(uint32_t now,int32_t modval,bits256 hash,uin
             DEX_totaladd++;
             if ( (_DEX_updatetips(tips,priority,ptr,lenA,tagA,lenB,tagB,destpub33,plen) >> 16) != 0 )
                 fprintf(stderr,"update M.%d slot.%d [%d] with %08x error updating tips\n",modval,ind,ptr->data[0],ptr->shorthash);
+            _komodo_DEX_packetlogappend(ptr,msg);
         }
         return(ptr);
     }
@@ -984,26 +1275,51 @@ int32_t komodo_DEXgenquote(uint8_t funcid,int32_t priority,bits256 &hash,uint32_
     return(len);
 }
 
-int32_t komodo_DEXpacketsend(CNode *peer,uint8_t peerpos,struct DEX_datablob *ptr,uint8_t resp0)
+int32_t _komodo_DEX_queueblob(struct DEX_sendqueue &sendq,struct DEX_datablob *ptr,uint8_t resp0)
 {
-    std::vector<uint8_t> packet; int32_t i;
-    //fprintf(stderr,"%d packet send %p datalen.%d\n",peer->id,ptr,ptr->datalen);
+    struct DEX_sendrequest req;
+    //fprintf(stderr,"queue packet send %p datalen.%d\n",ptr,ptr->datalen);
     if ( ptr->datalen < KOMODO_DEX_ROUTESIZE || ptr->datalen > KOMODO_DEX_MAXPACKETSIZE )
     {
         fprintf(stderr,"illegal datalen.%d\n",ptr->datalen);
         return(-1);
     }
-    packet.resize(ptr->datalen);
-    memcpy(&packet[0],ptr->data,ptr->datalen);
-    packet[0] = resp0;
-    peer->PushMessage("DEX",packet);
+    komodo_DEX_retain(ptr);
+    req.ptr = ptr;
+    req.datalen = ptr->datalen; // purge truncates datalen, so it is captured while still locked
+    req.resp0 = resp0;
+    sendq.blobs.push_back(req);
     DEX_totalsent++;
-    return(ptr->datalen);
+    return(req.datalen);
 }
 
-int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
+int32_t komodo_DEXpacketsend(CNode *peer,struct DEX_datablob *ptr,int32_t datalen,uint8_t resp0)
 {
-    static uint32_t recents[16][KOMODO_DEX_MAXPERSEC],sendbuf[KOMODO_DEX_MAXPING];
+    uint64_t n = datalen;
+    // same wire format as a std::vector<uint8_t> with [0] replaced by resp0, serialized straight from the datablob
+    peer->PushMessage("DEX",COMPACTSIZE(n),resp0,CFlatData(&ptr->data[1],&ptr->data[datalen]));
+    return(datalen);
+}
+
+int32_t komodo_DEX_sendqueueflush(CNode *peer,struct DEX_sendqueue &sendq)
+{
+    int32_t i,n = 0;
+    for (i=0; i<(int32_t)sendq.packets.size(); i++)
+        peer->PushMessage("DEX",sendq.packets[i]);
+    for (i=0; i<(int32_t)sendq.blobs.size(); i++)
+    {
+        komodo_DEXpacketsend(peer,sendq.blobs[i].ptr,sendq.blobs[i].datalen,sendq.blobs[i].resp0);
+        komodo_DEX_release(sendq.blobs[i].ptr);
+        n++;
+    }
+    sendq.packets.clear();
+    sendq.blobs.clear();
+    return(n);
+}
+
+int32_t _komodo_DEXmodval(struct DEX_sendqueue &sendq,uint32_t now,const int32_t modval,CNode *peer,int32_t vipflag)
+{
+    static uint32_t recents[16][KOMODO_DEX_MAXPERSEC],sendbuf[KOMODO_DEX_MAXPING]; static struct DEX_datablob *recentptrs[16][KOMODO_DEX_MAXPERSEC];
     std::vector<uint8_t> packet; int32_t i,j,n=0,mult,p,vip=0,maxp=0,sum=0; uint16_t peerpos,num[16]; uint8_t priority,relay,funcid,*msg; uint32_t t,h; struct DEX_datablob *ptr=0,*tmp;
     if ( modval < 0 || modval >= KOMODO_DEX_PURGETIME || (peerpos= _komodo_DEXpeerpos(now,peer->id)) == 0xffff )
         return(-1);
@@ -1020,7 +1336,7 @@ int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
             iguana_rwnum(0,&msg[2],sizeof(t),&t);
             if ( now < t+KOMODO_DEX_MAXLAG || ptr->priority >= KOMODO_DEX_VIPLEVEL || ptr->requested > 0 ) //|| now < ptr->recvtime+KOMODO_DEX_MAXHOPS/2+1 )
             {
-                if ( GETBIT(ptr->peermask,peerpos) == 0 || ptr->requested > 0 )
+                if ( _komodo_DEX_peerknows(peerpos,ptr) == 0 || ptr->requested > 0 )
                 {
                     if ( (p= ptr->priority) >= 16 )
                         p = 15;
@@ -1036,15 +1352,14 @@ int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
                         fprintf(stderr,"num[%d] %d is full\n",p,num[p]);
                         continue;
                     }
-                    /*if ( GETBIT(ptr->peermask,peerpos) == 0 && ptr->priority >= KOMODO_DEX_VIPLEVEL )
+                    if ( vipflag != 0 || ptr->requested > 0 || _komodo_DEX_peerannounced(peerpos,ptr) == 0 )
                     {
-                        //fprintf(G->fp,"%08x ",ptr->shorthash);
-                        vip++;
-                    }*/
-                    recents[p][num[p]++] = h;
+                        recentptrs[p][num[p]] = ptr;
+                        recents[p][num[p]++] = h;
+                    }
                     if ( ptr->requested > 0 )
                     {
-                        //fprintf(G->fp,"%08x.R%d.%d ",ptr->shorthash,ptr->requested,GETBIT(ptr->peermask,peerpos));
+                        //fprintf(G->fp,"%08x.R%d ",ptr->shorthash,ptr->requested);
                         ptr->requested--;
                         vip++;
                     }
@@ -1054,7 +1369,7 @@ int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
                         {
                             if ( komodo_DEX_islagging() == 0 )
                             {
-                                komodo_DEXpacketsend(peer,peerpos,ptr,ptr->data[0]);
+                                _komodo_DEX_queueblob(sendq,ptr,ptr->data[0]);
                                 ptr->numsent++;
                             }
                         }
@@ -1076,15 +1391,20 @@ int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
             {
                 i = (rand() % mult);
                 for (n=0; i<num[p]; i+=mult,n++)
+                {
                     sendbuf[n] = recents[p][i];
+                    _komodo_DEX_peerannounce(peerpos,recentptrs[p][i]);
+                }
                 if ( komodo_DEXgenping('P',packet,now,modval,sendbuf,n) > 0 )
-                    peer->PushMessage("DEX",packet);
+                    sendq.packets.push_back(packet);
                 sum += n;
             }
             else
             {
                 if ( komodo_DEXgenping('P',packet,now,modval,recents[p],num[p]) > 0 )
-                    peer->PushMessage("DEX",packet);
+                    sendq.packets.push_back(packet);
+                for (i=0; i<num[p]; i++)
+                    _komodo_DEX_peerannounce(peerpos,recentptrs[p][i]);
                 sum += num[p];
             }
             if ( komodo_DEX_islagging() != 0 )
@@ -1094,6 +1414,7 @@ int32_t _komodo_DEXmodval(uint32_t now,const int32_t modval,CNode *peer)
     return(sum);
 }
 
+// caller holds DEX_globalmutex or a reference on ptr, otherwise a purge can free it while it is decrypted
 uint8_t *komodo_DEX_datablobdecrypt(bits256 *senderpub,uint8_t **allocatedp,int32_t *newlenp,struct DEX_datablob *ptr,bits256 pubkey,char *taga)
 {
     static bits256 zero;
@@ -1320,10 +1641,10 @@ int32_t _komodo_DEX_commandprocessor(struct DEX_datablob *ptr,int32_t addedflag,
     return(newlen);
 }
 
-int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
+int32_t _komodo_DEXprocess(struct DEX_sendqueue &sendq,uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len,bits256 hash,uint32_t shorthash)
 {
     static uint32_t cache[2],pongbuf[KOMODO_DEX_MAXPING];
-    int32_t i,j,ind,m,p,tmpval,haves,offset,flag,modval,lag,priority,addedflag=0; uint16_t n,peerpos; uint32_t t,h; uint8_t funcid,relay=0; bits256 hash; struct DEX_datablob *ptr;
+    int32_t i,j,ind,m,p,tmpval,haves,offset,flag,modval,lag,priority,addedflag=0; uint16_t n,peerpos; uint32_t t,h; uint8_t funcid,relay=0; struct DEX_datablob *ptr;
     peerpos = _komodo_DEXpeerpos(now,pfrom->id);
     //fprintf(stderr,"peer.%d msg[%d] %c\n",peerpos,len,msg[1]);
     if ( len > KOMODO_DEX_ROUTESIZE+sizeof(uint32_t) && peerpos != 0xffff && len < KOMODO_DEX_MAXPACKETSIZE )
@@ -1335,7 +1656,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
         lag = (now - t);
         if ( lag < 0 )
             lag = 0;
-        h = komodo_DEXquotehash(hash,msg,len);
+        h = shorthash; // calculated by the caller before locking, zero hash for non-quote funcids
         priority = komodo_DEX_priority(hash.ulongs[0],len);
         if ( t > now+KOMODO_DEX_LOCALHEARTBEAT )
         {
@@ -1403,7 +1724,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                 }
                 if ( ptr != 0 )
                 {
-                    SETBIT(ptr->peermask,peerpos);
+                    _komodo_DEX_peerhas(peerpos,ptr);
                     if ( funcid != 'Q' )
                         _komodo_DEX_commandprocessor(ptr,addedflag,peerpos);
                 }
@@ -1425,7 +1746,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                         offset += iguana_rwnum(0,&msg[offset],sizeof(h),&h);
                         if ( (ptr= _komodo_DEXfind(m,h)) != 0 )
                         {
-                            SETBIT(ptr->peermask,peerpos);
+                            _komodo_DEX_peerhas(peerpos,ptr);
                             pongbuf[haves++] = h;
                             continue;
                         }
@@ -1445,7 +1766,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                             if ( tmpval < 0 )
                                 DEX_Numpending++;
                             komodo_DEXgenget(getshorthash,now,h,m);
-                            pfrom->PushMessage("DEX",getshorthash);
+                            sendq.packets.push_back(getshorthash);
                             flag++;
                         }
                         //fprintf(G->fp,"%d/%08x ",m,h);
@@ -1461,7 +1782,7 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
                 {
                     std::vector<uint8_t> pong;
                     if ( komodo_DEXgenping('p',pong,now,m,pongbuf,haves) > 0 )
-                        pfrom->PushMessage("DEX",pong);
+                        sendq.packets.push_back(pong);
                 }
             } // else banscore this
         }
@@ -1475,9 +1796,9 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
             {
                 if ( (ptr= _komodo_DEXfind(modval,h)) != 0 )
                 {
-                    //if ( GETBIT(ptr->peermask,peerpos) == 0 ) if a node specifically requests it, send it
+                    //if ( _komodo_DEX_peerknows(peerpos,ptr) == 0 ) if a node specifically requests it, send it
                     {
-                        return(komodo_DEXpacketsend(pfrom,peerpos,ptr,0)); // squelch relaying of 'G' packets
+                        return(_komodo_DEX_queueblob(sendq,ptr,0)); // squelch relaying of 'G' packets
                     }
                 } // else fprintf(stderr,"unexpected request of %08x\n",h);
             } else fprintf(stderr,"illegal modval.%d\n",modval);
@@ -1487,6 +1808,36 @@ int32_t _komodo_DEXprocess(uint32_t now,CNode *pfrom,uint8_t *msg,int32_t len)
     return(0);
 }
 
+int32_t _komodo_DEX_packetlogload(uint32_t now)
+{
+    FILE *fp; char fname[512]; uint8_t *msg; struct DEX_logrecord rec; struct DEX_datablob *ptr; int32_t retval,modval,n=0; uint32_t t,cutoff = now - KOMODO_DEX_PURGETIME + 6;
+    komodo_DEX_packetlogfname(fname,(char *)"");
+    if ( (fp= fopen(fname,"rb")) != 0 )
+    {
+        msg = (uint8_t *)malloc(KOMODO_DEX_MAXPACKETSIZE);
+        while ( (retval= komodo_DEX_packetlogread(fp,&rec,msg)) > 0 )
+        {
+            iguana_rwnum(0,&msg[2],sizeof(t),&t);
+            if ( t <= cutoff || t > now+KOMODO_DEX_LOCALHEARTBEAT )
+                continue;
+            modval = (t % KOMODO_DEX_PURGETIME);
+            if ( _komodo_DEXfind(modval,rec.shorthash) != 0 )
+                continue;
+            if ( (ptr= _komodo_DEXadd(rec.recvtime,modval,rec.hash,rec.shorthash,msg,rec.datalen)) != 0 )
+            {
+                if ( msg[1] == 'X' ) // cancels are in the log after what they cancel
+                    _komodo_DEX_commandprocessor(ptr,1,0);
+                n++;
+            }
+        }
+        free(msg);
+        fclose(fp);
+        fprintf(stderr,"loaded %d DEX packets from %s%s\n",n,fname,retval < 0 ? " (truncated)" : "");
+    }
+    G->packetfp = fopen(fname,"ab"); // the compaction after init rewrites it from the loaded packets
+    return(n);
+}
+
 int32_t komodo_DEX_payloadstr(UniValue &item,uint8_t *data,int32_t datalen,int32_t decrypted)
 {
     char *itemstr; int32_t i,hexflag = 0;
@@ -1848,6 +2199,8 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
                     fprintf(stderr," cant issue duplicate order modval.%d t.%u %08x %016llx\n",modval,timestamp,shorthash,(long long)hash.ulongs[0]);
                 srand((int32_t)timestamp);
             }
+            if ( blastflag == 0 && ptr != 0 )
+                komodo_DEX_retain(ptr); // decrypted by dataobj after unlocking
             pthread_mutex_unlock(&DEX_globalmutex);
         }
         if ( blastflag == 0 )
@@ -1863,6 +2216,7 @@ UniValue komodo_DEXbroadcast(uint64_t *locatorp,uint8_t funcid,char *hexstr,int3
             iguana_rwnum(0,&ptr->data[2],sizeof(timestamp),&timestamp);
             *locatorp = ((uint64_t)timestamp << 32) | ptr->shorthash;
         }
+        komodo_DEX_release(ptr);
         return(result);
     } else return(0);
 }
@@ -2313,13 +2667,21 @@ UniValue komodo_DEXorderbook(int32_t revflag,int32_t maxentries,int32_t minprior
 
 bits256 komodo_DEX_filehash(FILE *fp,uint64_t offset0,uint64_t rlen,char *fname)
 {
-    bits256 filehash; uint8_t *data = (uint8_t *)calloc(1,rlen);
+    CSHA256 hasher; bits256 filehash; uint8_t buf[KOMODO_DEX_FILEBUFSIZE]; uint64_t len,n;
     fseek(fp,offset0,SEEK_SET);
     memset(filehash.bytes,0,sizeof(filehash));
-    if ( fread(data,1,rlen,fp) == rlen )
-        vcalc_sha256(0,filehash.bytes,data,rlen);
-    else fprintf(stderr," reading %lld bytes from %s.%llu\n",(long long)rlen,fname,(long long)offset0);
-    free(data);
+    for (len=0; len<rlen; len+=n) // same sha256 as over the whole file, without reading all of it into memory
+    {
+        if ( (n= rlen - len) > sizeof(buf) )
+            n = sizeof(buf);
+        if ( fread(buf,1,n,fp) != n )
+        {
+            fprintf(stderr," reading %lld bytes from %s.%llu\n",(long long)rlen,fname,(long long)offset0);
+            return(filehash);
+        }
+        hasher.Write(buf,n);
+    }
+    hasher.Finalize(filehash.bytes);
     return(filehash);
 }
 
@@ -2404,14 +2766,38 @@ int32_t komodo_DEX_request(int32_t priority,uint32_t shorthash,uint32_t timestam
     return(_komodo_DEX_locatorsextract(1,shorthash,timestamp % KOMODO_DEX_PURGETIME,priority));
 }
 
-int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,uint64_t locator,long offset,bits256 senderpub,char *tagA)
+int32_t komodo_DEX_pwrite(int32_t fd,uint8_t *buf,int32_t len,int64_t offset)
+{
+#ifdef _WIN32
+    static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER; int32_t retval = -1;
+    pthread_mutex_lock(&mutex);
+    if ( _lseeki64(fd,offset,SEEK_SET) == offset )
+        retval = _write(fd,buf,len);
+    pthread_mutex_unlock(&mutex);
+    return(retval);
+#else
+    return((int32_t)pwrite(fd,buf,len,offset));
+#endif
+}
+
+int32_t komodo_DEX_preallocate(int32_t fd,int64_t filesize)
+{
+#ifdef _WIN32
+    return(_chsize_s(fd,filesize));
+#else
+    return(ftruncate(fd,filesize));
+#endif
+}
+
+int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,int32_t fd,uint64_t locator,long offset,bits256 senderpub,char *tagA)
 {
     uint32_t t,h; struct DEX_datablob *fragptr; int32_t fraglen,errflag=0; uint8_t buf[KOMODO_DEX_FILEBUFSIZE];
     t = locator >> 32;
     h = locator & 0xffffffff;
     {
         pthread_mutex_lock(&DEX_globalmutex);
-        fragptr = _komodo_DEXfind(t % KOMODO_DEX_PURGETIME,h);
+        if ( (fragptr= _komodo_DEXfind(t % KOMODO_DEX_PURGETIME,h)) != 0 )
+            komodo_DEX_retain(fragptr); // so a purge cant free it while it is decrypted
         pthread_mutex_unlock(&DEX_globalmutex);
     }
     errflag = 0;
@@ -2419,10 +2805,9 @@ int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,ui
     {
         if ( (fraglen= komodo_DEX_decryptbuf(buf,sizeof(buf),fragptr,senderpub,(char *)tagA)) > 0 )
         {
-            fseek(fp,offset,SEEK_SET);
-            if ( fwrite(buf,1,fraglen,fp) != fraglen )
+            if ( komodo_DEX_pwrite(fd,buf,fraglen,offset) != fraglen )
             {
-                fprintf(stderr,"write error offset %ld %ld\n",offset,ftell(fp));
+                fprintf(stderr,"write error offset %ld fraglen.%d\n",offset,fraglen);
                 errflag = 1;
             }
             else
@@ -2436,6 +2821,7 @@ int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,ui
             fprintf(stderr,"error decrypting into buf for offset of %ld, fraglen.%d datalen.%d h.%u\n",offset,fraglen,fragptr->datalen,h);
             errflag = 1;
         }
+        komodo_DEX_release(fragptr);
     }
     else
     {
@@ -2446,11 +2832,34 @@ int32_t komodo_DEX_locatorsync(int32_t &needrequest,int32_t &written,FILE *fp,ui
     return(-errflag);
 }
 
+struct DEX_syncjob
+{
+    bits256 senderpub;
+    uint64_t *locators;
+    char *tagA;
+    int32_t fd,id,nthreads,num,needrequest,written,missing;
+};
+
+void komodo_DEX_syncworker(struct DEX_syncjob *job)
+{
+    int32_t i; uint64_t locator;
+    for (i=job->id; i<job->num; i+=job->nthreads)
+    {
+        if ( (locator= job->locators[i]) == 0 )
+            continue;
+        if ( komodo_DEX_locatorsync(job->needrequest,job->written,job->fd,locator,(long)i*KOMODO_DEX_FILEBUFSIZE,job->senderpub,job->tagA) < 0 )
+        {
+            job->missing++;
+            job->locators[i] = 0;
+        }
+    }
+}
+
 UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,uint32_t shorthash,char *publisher,int32_t sliceid)
 {
     static uint64_t locators[KOMODO_DEX_MAXPACKETSIZE/sizeof(uint64_t)+1],zero[4];
     static uint64_t prevlocators[KOMODO_DEX_MAXPACKETSIZE/sizeof(uint64_t)+1];
-    UniValue result(UniValue::VOBJ); FILE *fp; int32_t i,j,n,num,written=0,numprev,fraglen,errflag,modval,requestflag=0,missing=0,len=0,newlen=0; bits256 senderpub,pubkey,filehash; uint8_t tagA[KOMODO_DEX_TAGSIZE+1],tagB[KOMODO_DEX_TAGSIZE+1],pubkey33[33],*decoded,*allocated=0,hex[8]; struct DEX_datablob *fragptr,*ptr = 0; char str[67],pubkeystr[67],fname[512],tagBstr[33],fullfname[512],locatorfname[512]; bits256 checkhash; uint32_t t,h; uint64_t locator,amountA,amountB,mult,prevoffset0,offset0=0; int8_t lenA,lenB,plen;
+    UniValue result(UniValue::VOBJ); FILE *fp; struct DEX_syncjob jobs[KOMODO_DEX_SYNCTHREADS]; int32_t i,j,n,fd,nthreads,num,written=0,numprev,fraglen,errflag,modval,requestflag=0,missing=0,len=0,newlen=0; bits256 senderpub,pubkey,filehash; uint8_t tagA[KOMODO_DEX_TAGSIZE+1],tagB[KOMODO_DEX_TAGSIZE+1],pubkey33[33],*decoded,*allocated=0,hex[8]; struct DEX_datablob *fragptr,*ptr = 0; char str[67],pubkeystr[67],fname[512],tagBstr[33],fullfname[512],locatorfname[512]; bits256 checkhash; uint32_t t,h; uint64_t locator,amountA,amountB,mult,prevoffset0,offset0=0; int8_t lenA,lenB,plen;
     cmpflag = 0;
     if ( sliceid < 0 )
     {
@@ -2509,6 +2918,8 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
                     break;
             }
         }
+        if ( ptr != 0 )
+            komodo_DEX_retain(ptr); // extracted and decrypted after unlocking, a purge cant free it meanwhile
         pthread_mutex_unlock(&DEX_globalmutex);
     }
     if ( ptr == 0 )
@@ -2524,6 +2935,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
     {
         result.push_back(Pair((char *)"result",(char *)"error"));
         result.push_back(Pair((char *)"error",(char *)"couldnt extract tags"));
+        komodo_DEX_release(ptr);
         return(result);
     }
     if ( strcmp((char *)tagA,origfname) != 0 || strcmp((char *)tagB,tagBstr) != 0 )
@@ -2535,6 +2947,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
         result.push_back(Pair((char *)"tagB",(char *)tagB));
         result.push_back(Pair((char *)"tagBstr",(char *)tagBstr));
         result.push_back(Pair((char *)"sliceid",(int64_t)sliceid));
+        komodo_DEX_release(ptr);
         return(result);
     }
     memcpy(pubkey.bytes,pubkey33+1,32);
@@ -2570,24 +2983,48 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
                     }
                 } // else fprintf(stderr,"prevoffset0.%llu != offset0.%llu\n",(long long)prevoffset0,(long long)offset0);
             } else fprintf(stderr,"prevlocators read errors for %s\n",fname);
-            if ( (fp= fopen(fullfname,(char *)"rb+")) == 0 )
-                fp = fopen(fullfname,(char *)"wb");
-            if ( fp != 0 )
+            if ( (fd= open(fullfname,O_RDWR | O_CREAT | O_BINARY,0644)) >= 0 )
             {
-                for (i=0; i<(int32_t)amountB; i++)
+                if ( komodo_DEX_preallocate(fd,amountA) != 0 )
+                    fprintf(stderr,"couldnt preallocate %llu bytes for %s\n",(long long)amountA,fullfname);
+                for (i=n=0; i<(int32_t)amountB; i++)
                 {
-                    if ( (locator= locators[i]) == 0 ) // we already had it from previous rpc call
+                    if ( locators[i] != 0 ) // zero means we already had it from previous rpc call
                     {
-                        locators[i] = prevlocators[i];
-                        continue;
+                        prevlocators[i] = 0; // so a missing fragment stays zero below
+                        n++;
                     }
-                    if ( komodo_DEX_locatorsync(requestflag,written,fp,locator,i*KOMODO_DEX_FILEBUFSIZE,senderpub,(char *)tagA) < 0 )
+                }
+                if ( (nthreads= n/16 + 1) > KOMODO_DEX_SYNCTHREADS )
+                    nthreads = KOMODO_DEX_SYNCTHREADS;
+                memset(jobs,0,sizeof(jobs));
+                {
+                    boost::thread_group syncthreads;
+                    for (j=0; j<nthreads; j++)
                     {
-                        missing++;
-                        locators[i] = 0;
+                        jobs[j].senderpub = senderpub;
+                        jobs[j].locators = locators;
+                        jobs[j].tagA = (char *)tagA;
+                        jobs[j].fd = fd;
+                        jobs[j].id = j;
+                        jobs[j].nthreads = nthreads;
+                        jobs[j].num = (int32_t)amountB;
+                        if ( j < nthreads-1 )
+                            syncthreads.create_thread(boost::bind(komodo_DEX_syncworker,&jobs[j]));
                     }
+                    komodo_DEX_syncworker(&jobs[nthreads-1]);
+                    syncthreads.join_all();
                 }
-                fclose(fp), fp = 0;
+                for (j=0; j<nthreads; j++)
+                {
+                    requestflag |= jobs[j].needrequest;
+                    written += jobs[j].written;
+                    missing += jobs[j].missing;
+                }
+                for (i=0; i<(int32_t)amountB; i++)
+                    if ( locators[i] == 0 )
+                        locators[i] = prevlocators[i];
+                close(fd), fd = -1;
                 if ( (fp= fopen(fullfname,"rb")) != 0 )
                 {
                     fseek(fp,0,SEEK_END);
@@ -2656,6 +3093,7 @@ UniValue komodo_DEXsubscribe(int32_t &cmpflag,char *origfname,int32_t priority,u
         result.push_back(Pair((char *)"status","request sent to get missing blocks"));
         result.push_back(Pair((char *)"n",n));
     }
+    komodo_DEX_release(ptr);
     return(result);
 }
 
@@ -2937,24 +3375,32 @@ UniValue komodo_DEXstream(char *fname,int32_t priority)
 
 FILE *komodo_DEX_streamwrite(char *destfname,FILE *fp,uint64_t wlen,uint64_t offset0)
 {
-    uint8_t *buf;
-    buf = (uint8_t *)malloc(wlen);
+    uint8_t buf[KOMODO_DEX_FILEBUFSIZE]; uint64_t len,n; FILE *destfp;
     rewind(fp);
-    if ( fread(buf,1,wlen,fp) != wlen )
-        fprintf(stderr,"error reading %llu slice for %s\n",(long long)wlen,destfname);
-    fclose(fp);
-    if ( (fp= fopen(destfname,"rb+")) == 0 )
-        fp = fopen(destfname,"wb");
-    if ( fp != 0 )
+    if ( (destfp= fopen(destfname,"rb+")) == 0 )
+        destfp = fopen(destfname,"wb");
+    if ( destfp != 0 )
     {
-        fseek(fp,offset0,SEEK_SET);
-        if ( fwrite(buf,1,wlen,fp) != wlen )
-            fprintf(stderr,"error writing %llu slice to %s\n",(long long)wlen,destfname);
-        fclose(fp);
-        fp = 0;
+        fseek(destfp,offset0,SEEK_SET);
+        for (len=0; len<wlen; len+=n)
+        {
+            if ( (n= wlen - len) > sizeof(buf) )
+                n = sizeof(buf);
+            if ( fread(buf,1,n,fp) != n )
+            {
+                fprintf(stderr,"error reading %llu slice for %s\n",(long long)wlen,destfname);
+                break;
+            }
+            if ( fwrite(buf,1,n,destfp) != n )
+            {
+                fprintf(stderr,"error writing %llu slice to %s\n",(long long)wlen,destfname);
+                break;
+            }
+        }
+        fclose(destfp);
     }
-    free(buf);
-    return(fp);
+    fclose(fp);
+    return(0);
 }
 
 int md_unlink(char *file)
@@ -3166,21 +3612,26 @@ UniValue komodo_DEX_notarize(char *coin,int32_t prevheight)
     return(result);
 }
 
-void komodo_DEXmsg(CNode *pfrom,std::vector<uint8_t> request) // received a packet during interrupt time
+void komodo_DEXmsg(CNode *pfrom,const std::vector<uint8_t> &request) // received a packet during interrupt time
 {
-    int32_t len; std::vector<uint8_t> response; bits256 hash; uint32_t timestamp = (uint32_t)time(NULL);
+    struct DEX_sendqueue sendq; int32_t len; bits256 hash; uint32_t shorthash = 0,timestamp = (uint32_t)time(NULL); uint8_t *msg;
     if ( (len= request.size()) > 0 )
     {
+        msg = (uint8_t *)&request[0];
+        memset(hash.bytes,0,sizeof(hash));
+        if ( len > KOMODO_DEX_ROUTESIZE && (msg[1] == 'Q' || msg[1] == 'X' || msg[1] == 'R' || msg[1] == 'A') )
+            shorthash = komodo_DEXquotehash(hash,msg,len); // sha256+curve25519, dont hold the lock for it
         pthread_mutex_lock(&DEX_globalmutex);
-        _komodo_DEXprocess(timestamp,pfrom,&request[0],len);
+        _komodo_DEXprocess(sendq,timestamp,pfrom,msg,len,hash,shorthash);
         pthread_mutex_unlock(&DEX_globalmutex);
+        komodo_DEX_sendqueueflush(pfrom,sendq);
     }
 }
 
 void komodo_DEXpoll(CNode *pto) // from mainloop polling
 {
     static uint32_t purgetime;
-    std::vector<uint8_t> packet; uint32_t i,now,numiters,shorthash,len,ptime,modval,peerpos;
+    struct DEX_sendqueue sendq; std::vector<uint8_t> packet; uint32_t i,now,numiters,shorthash,len,ptime,modval,peerpos; int32_t vipflag = 0,compactflag = 0;
     now = (uint32_t)time(NULL);
     ptime = now - KOMODO_DEX_PURGETIME + 6;
     pthread_mutex_lock(&DEX_globalmutex);
@@ -3194,6 +3645,10 @@ void komodo_DEXpoll(CNode *pto) // from mainloop polling
             for (; purgetime<ptime; purgetime++)
                 _komodo_DEXpurge(purgetime);
             _komodo_DEX_purgeindices(ptime - 3); // call once at the end
+            if ( ptime >= G->lastcompact + KOMODO_DEX_COMPACTINTERVAL )
+                compactflag = 1; // rewritten after unlocking
+            else if ( G->packetfp != 0 )
+                fflush(G->packetfp);
         }
         DEX_Numpending *= 0.999; // decay pending to compensate for hashcollision remnants
     }
@@ -3202,12 +3657,13 @@ void komodo_DEXpoll(CNode *pto) // from mainloop polling
         if ( ((now + peerpos) % KOMODO_DEX_POLLVIP) == 0 ) // check the VIP packets
         {
             numiters = KOMODO_DEX_PURGETIME - KOMODO_DEX_MAXLAG;
+            vipflag = 1;
             pto->dexlastping = now;
         } else numiters = KOMODO_DEX_MAXLAG - KOMODO_DEX_MAXHOPS;
         for (i=0; i<numiters; i++)
         {
             modval = (now + 1 - i) % KOMODO_DEX_PURGETIME;
-            if ( _komodo_DEXmodval(now,modval,pto) > 0 )
+            if ( _komodo_DEXmodval(sendq,now,modval,pto,vipflag) > 0 )
                 pto->dexlastping = now;
             if ( komodo_DEX_islagging() != 0 && i > KOMODO_DEX_MAXLAG )
                 break;
@@ -3215,5 +3671,8 @@ void komodo_DEXpoll(CNode *pto) // from mainloop polling
         pto->dexlastping = now;
     }
     pthread_mutex_unlock(&DEX_globalmutex);
+    komodo_DEX_sendqueueflush(pto,sendq);
+    if ( compactflag != 0 )
+        komodo_DEX_packetlogcompact(ptime - 3);
 }
 
@@ -1672,10 +1672,10 @@ arith_uint256 komodo_PoWtarget(int32_t *percPoSp,arith_uint256 target,int32_t he
     return(bnTarget);
 }
 
-uint32_t komodo_stake(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeight,uint256 txid,int32_t vout,uint32_t blocktime,uint32_t prevtime,char *destaddr,int32_t PoSperc)
+// komodo_stake for a utxo whose block time, stake value and address are already known
+uint32_t komodo_stakeutxo(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeight,uint256 txid,int32_t vout,uint32_t txtime,uint64_t value,char *address,uint32_t blocktime,uint32_t prevtime,int32_t PoSperc)
 {
-    bool fNegative,fOverflow; uint8_t hashbuf[256]; char address[64]; bits256 addrhash; arith_uint256 hashval,mindiff,ratio,coinage256; uint256 hash,pasthash; int32_t segid,minage,iter=0; int64_t diff=0; uint32_t txtime,segid32,winner = 0 ; uint64_t value,coinage;
-    txtime = komodo_txtime2(&value,txid,vout,address);
+    bool fNegative,fOverflow; uint8_t hashbuf[256]; bits256 addrhash; arith_uint256 hashval,mindiff,ratio,coinage256; uint256 hash,pasthash; int32_t segid,minage,iter=0; int64_t diff=0; uint32_t segid32,winner = 0 ; uint64_t coinage;
     if ( validateflag == 0 )
     {
         //fprintf(stderr,"blocktime.%u -> ",blocktime);
@@ -1791,6 +1791,13 @@ uint32_t komodo_stake(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeigh
     return(blocktime * winner);
 }
 
+uint32_t komodo_stake(int32_t validateflag,arith_uint256 bnTarget,int32_t nHeight,uint256 txid,int32_t vout,uint32_t blocktime,uint32_t prevtime,char *destaddr,int32_t PoSperc)
+{
+    char address[64]; uint32_t txtime; uint64_t value;
+    txtime = komodo_txtime2(&value,txid,vout,address);
+    return(komodo_stakeutxo(validateflag,bnTarget,nHeight,txid,vout,txtime,value,address,blocktime,prevtime,PoSperc));
+}
+
 int32_t komodo_is_PoSblock(int32_t slowflag,int32_t height,CBlock *pblock,arith_uint256 bnTarget,arith_uint256 bhash)
 {
     CBlockIndex *previndex,*pindex; char voutaddr[64],destaddr[64]; uint256 txid, merkleroot; uint32_t txtime,prevtime=0; int32_t ret,vout,PoSperc,txn_count,eligible=0,isPoS = 0,segid; uint64_t value; arith_uint256 POWTarget;
@@ -2681,49 +2688,89 @@ int64_t komodo_coinsupply(int64_t *zfundsp,int64_t *sproutfundsp,int32_t height)
 }
 
 
-void komodo_addutxo(std::vector<struct komodo_staking> &array, int32_t *numkp, int32_t *maxkp, uint32_t txtime, uint64_t nValue, uint256 txid, int32_t vout, char *address, uint8_t *hashbuf, CScript pk)
+// staking utxos of the wallet, bucketed by segid32 & 0x3f and ordered by block time within a bucket
+struct komodo_stakingset
 {
-    uint256 hash; uint32_t segid32; struct komodo_staking *kp;
+    std::map<COutPoint,struct komodo_staking> utxos;
+    std::set<std::pair<uint32_t,COutPoint> > segids[64];
+    uint64_t walletupdates;     // wallet coins by value updates the utxos were synced at
+    int32_t maturityheight;     // tip height at which a skipped coinbase utxo matures
+    uint32_t lasttime;
+    komodo_stakingset() : walletupdates(0), maturityheight(0), lasttime(0) {}
+};
 
-    segid32 = komodo_stakehash(&hash,address,hashbuf,txid,vout);
-    if (*numkp >= *maxkp)
-    {
-        *maxkp += 1000;
-        array.resize(*maxkp);
-        if (array.size() != *maxkp) {
-            fprintf(stderr, "%s could not allocate memory\n", __func__);
-            return;   // prevent buf overflow, do not add utxo if no more mem allocated
+void komodo_addutxo(std::map<COutPoint,struct komodo_staking> &utxos, uint32_t txtime, uint64_t nValue, uint64_t stakevalue, uint256 txid, int32_t vout, char *address, CScript pk)
+{
+    struct komodo_staking &kp = utxos[COutPoint(txid,vout)];
+    strcpy(kp.address,address);
+    kp.txid = txid;
+    kp.vout = vout;
+    kp.txtime = txtime;
+    kp.segid32 = komodo_segid32(address);
+    kp.nValue = nValue;
+    kp.stakevalue = stakevalue;
+    kp.scriptPubKey = pk; 
+}
+
+/*
+ * Brings the staking utxos up to date with the wallet coins by value index. Utxos
+ * already known keep their address, segid and stake value, only their block time
+ * is refreshed from the wallet, so nothing is read from disk.
+ */
+void komodo_stakingsync(struct komodo_stakingset &set,int32_t nHeight)
+{
+    std::map<COutPoint,struct komodo_staking> utxos; std::map<COutPoint,struct komodo_staking>::iterator kit; std::vector<COutput> vecOutputs; CTxDestination address; CBlockIndex *pindex; int32_t blocks,i;
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pwalletMain->cs_wallet);
+    const CoinsByValue &coins = pwalletMain->GetCoinsByValue();
+    set.maturityheight = 0;
+    for (CoinsByValue::const_iterator it=coins.lower_bound(std::make_pair((CAmount)COIN,COutPoint(uint256(),0))); it!=coins.end(); ++it)
+    {
+        const COutPoint &outpoint = it->second;
+        std::map<uint256,CWalletTx>::const_iterator mit = pwalletMain->mapWallet.find(outpoint.hash);
+        if ( mit == pwalletMain->mapWallet.end() )
+            continue;
+        const CWalletTx *pcoin = &mit->second;
+        if ( pcoin->IsCoinBase() && (blocks= pcoin->GetBlocksToMaturity()) > 0 )
+        {
+            if ( set.maturityheight == 0 || nHeight-1+blocks < set.maturityheight )
+                set.maturityheight = nHeight-1+blocks;
+            continue;
+        }
+        vecOutputs.clear();
+        if ( !pwalletMain->AddAvailableCoin(vecOutputs,pcoin,outpoint.n,false,NULL,true) || vecOutputs[0].nDepth < 1 || !vecOutputs[0].fSpendable )
+            continue;
+        if ( (pindex= komodo_getblockindex(pcoin->hashBlock)) == 0 )
+            continue;
+        if ( (kit= set.utxos.find(outpoint)) != set.utxos.end() )
+        {
+            kit->second.txtime = (uint32_t)pindex->nTime;
+            utxos.insert(*kit);
+            continue;
+        }
+        const CScript &pk = pcoin->vout[outpoint.n].scriptPubKey;
+        if ( ExtractDestination(pk,address) != 0 && IsMine(*pwalletMain,address) != 0 )
+        {
+            CTransaction tx(*pcoin);
+            komodo_addutxo(utxos,(uint32_t)pindex->nTime,(uint64_t)it->first,(uint64_t)it->first * GetStakeMultiplier(tx,outpoint.n),outpoint.hash,outpoint.n,(char *)CBitcoinAddress(address).ToString().c_str(),pk);
         }
-        //fprintf(stderr,"realloc max.%d array.%p\n",*maxkp,array);
     }
-    kp = &array[(*numkp)++];
-    //fprintf(stderr,"kp.%p num.%d\n",kp,*numkp);
-
-    // not good to init c++ objects with memset, let's leave this to their constructors
-    // memset(kp,0,sizeof(*kp)); 
-    // pretty sure all members are init-ed here:
-    strcpy(kp->address,address);
-    kp->txid = txid;
-    kp->vout = vout;
-    kp->hashval = UintToArith256(hash);
-    kp->txtime = txtime;
-    kp->segid32 = segid32;
-    kp->nValue = nValue;
-    kp->scriptPubKey = pk; 
+    set.utxos.swap(utxos);
+    for (i=0; i<64; i++)
+        set.segids[i].clear();
+    for (kit=set.utxos.begin(); kit!=set.utxos.end(); ++kit)
+        set.segids[kit->second.segid32 & 0x3f].insert(std::make_pair(kit->second.txtime,kit->first));
+    set.walletupdates = pwalletMain->GetCoinsByValueUpdates();
+    set.lasttime = (uint32_t)time(NULL);
 }
 
 int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blocktimep,uint32_t *txtimep,uint256 *utxotxidp,int32_t *utxovoutp,uint64_t *utxovaluep,uint8_t *utxosig, uint256 merkleroot)
 {
-    // this malloc/free array did not free c++ objects like scriptPubKey as its destructor never called (memleak), 
-    // also this array as static could be overwritten when two stake threads are running concurrently during start/stop in GenerateBitcoins
-    // static struct komodo_staking *array; static int32_t numkp,maxkp; static uint32_t lasttime; 
-    // replaced to c++ vector and placed into TLS
-    thread_local std::vector<struct komodo_staking> array; 
-    thread_local int32_t numkp = 0, maxkp = 0; 
-    thread_local uint32_t lasttime = 0L;
+    // the staking utxos are kept per staking thread, as two stake threads can be running concurrently during start/stop in GenerateBitcoins
+    thread_local struct komodo_stakingset stakingset;
 
     int32_t PoSperc = 0, newStakerActive; 
-    set<CBitcoinAddress> setAddress; struct komodo_staking *kp; int32_t winners,segid,minage,nHeight,counter=0,i,m,siglen=0,nMinDepth = 1,nMaxDepth = 99999999; vector<COutput> vecOutputs; uint32_t block_from_future_rejecttime,besttime,eligible,earliest = 0; CScript best_scriptPubKey; arith_uint256 mindiff,ratio,bnTarget,tmpTarget; CBlockIndex *tipindex,*pindex; CTxDestination address; bool fNegative,fOverflow; uint8_t hashbuf[256]; CTransaction tx; uint256 hashBlock;
+    struct komodo_staking *kp; int32_t segid,b,minage,nHeight,i,siglen=0; uint32_t prevtime,windowend,eligible,earliest = 0; CScript best_scriptPubKey; arith_uint256 bnTarget; CBlockIndex *tipindex; bool fNegative,fOverflow; std::set<std::pair<uint32_t,COutPoint> >::const_iterator it;
     uint64_t cbPerc = *utxovaluep, tocoinbase = 0;
     if (!EnsureWalletIsAvailable(0))
         return 0;
@@ -2743,116 +2790,67 @@ int32_t komodo_staked(CMutableTransaction &txNew,uint32_t nBits,uint32_t *blockt
         minage = 6000;
     if ( *blocktimep < tipindex->nTime+60 )
         *blocktimep = tipindex->nTime+60;
-    komodo_segids(hashbuf,nHeight-101,100);
     // this was for VerusHash PoS64
     //tmpTarget = komodo_PoWtarget(&PoSperc,bnTarget,nHeight,ASSETCHAINS_STAKED);
-    bool resetstaker = false;
-    if ( array.size() != 0 )
+
+    if (!needSpecialStakeUtxo)
     {
-        LOCK(cs_main);
-        CBlockIndex* pblockindex = chainActive[tipindex->GetHeight()];
-        CBlock block; CTxDestination addressout;
-        if (needSpecialStakeUtxo)
-            resetstaker = true;
-        else if ( ReadBlockFromDisk(block, pblockindex, 1) && komodo_isPoS(&block, nHeight, &addressout) != 0 && IsMine(*pwalletMain,addressout) != 0 )
-        {
-              resetstaker = true;
-              fprintf(stderr, "[%s:%d] Reset ram staker after mining a block!\n",ASSETCHAINS_SYMBOL,nHeight);
-        }
+        // add normal staking UTXO:
+        // wallet transactions, including our own stakes, bump the wallet coins by value updates,
+        // the tip only matters for coinbase utxos becoming mature, locked coins are picked up every 600 seconds
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 > nHeight )
+            return(0);
+        if ( stakingset.walletupdates != pwalletMain->GetCoinsByValueUpdates() || (stakingset.maturityheight != 0 && nHeight-1 >= stakingset.maturityheight) || time(NULL) > stakingset.lasttime+600 )
+            komodo_stakingsync(stakingset,nHeight);
+    }
+    else  
+    {
+        // placeholder for special staking utxo cases:
     }
 
-    if ( resetstaker || array.size() == 0 || time(NULL) > lasttime+600 )
+    // a utxo takes part in the 600 seconds komodo_stake iterates from the block time on once
+    // its block time plus minage is reached, segid*2 seconds early, so each segid only needs
+    // its utxos up to windowend + segid*2 - minage
+    prevtime = (uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF;
+    for (b=i=0; b<64; b++)
     {
-        LOCK2(cs_main, pwalletMain->cs_wallet);
-        pwalletMain->AvailableCoins(vecOutputs, false, NULL, true);
-        if (array.size() != 0)
-        {
-            array.clear();
-            maxkp = numkp = 0;
-            lasttime = 0;
-        }
-        if (!needSpecialStakeUtxo)
+        segid = ((nHeight + b) & 0x3f);
+        windowend = prevtime+3;
+        if ( windowend < (uint32_t)GetTime()+30 )
+            windowend = (uint32_t)GetTime()+30;
+        windowend += 599;
+        const std::set<std::pair<uint32_t,COutPoint> > &bucket = stakingset.segids[b];
+        for (it=bucket.begin(); it!=bucket.end() && it->first+minage <= windowend+segid*2; ++it,i++)
         {
-            // add normal staking UTXO:
-            BOOST_FOREACH(const COutput& out, vecOutputs)
+            if ( fRequestShutdown || !GetBoolArg("-gen",false) )
+                return(0);
+            if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 > nHeight )
             {
-                if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 > nHeight )
-                {
-                    fprintf(stderr,"[%s:%d] chain tip changed during staking loop t.%u counter.%d\n",ASSETCHAINS_SYMBOL,nHeight,(uint32_t)time(NULL),counter);
-                    return(0);
-                }
-                counter++;
-                if ( out.nDepth < nMinDepth || out.nDepth > nMaxDepth )
-                {
-                    //fprintf(stderr,"komodo_staked invalid depth %d\n",(int32_t)out.nDepth);
-                    continue;
-                }
-                CAmount nValue = out.tx->vout[out.i].nValue;
-                if ( nValue < COIN  || !out.fSpendable )
-                    continue;
-                const CScript& pk = out.tx->vout[out.i].scriptPubKey;
-                if ( ExtractDestination(pk,address) != 0 )
-                {
-                    if ( IsMine(*pwalletMain,address) == 0 )
-                        continue;
-                    if ( myGetTransaction(out.tx->GetHash(),tx,hashBlock) != 0 && (pindex= komodo_getblockindex(hashBlock)) != 0 )
-                    {
-                        komodo_addutxo(array,&numkp,&maxkp,(uint32_t)pindex->nTime,(uint64_t)nValue,out.tx->GetHash(),out.i,(char *)CBitcoinAddress(address).ToString().c_str(),hashbuf,(CScript)pk);
-                        //fprintf(stderr,"addutxo numkp.%d vs max.%d\n",numkp,maxkp);
-                    }
-                }
+                fprintf(stderr,"[%s:%d] chain tip changed during staking loop t.%u counter.%d\n",ASSETCHAINS_SYMBOL,nHeight,(uint32_t)time(NULL),i);
+                return(0);
             }
-        }
-        else  
-        {
-            // placeholder for special staking utxo cases:
-        }
-        lasttime = (uint32_t)time(NULL);
-        //fprintf(stderr,"finished kp data of utxo for staking %u ht.%d numkp.%d maxkp.%d\n",(uint32_t)time(NULL),nHeight,numkp,maxkp);
-    }
-    block_from_future_rejecttime = (uint32_t)GetTime() + ASSETCHAINS_STAKED_BLOCK_FUTURE_MAX;    
-    for (i=winners=0; i<numkp; i++)
-    {
-        if ( fRequestShutdown || !GetBoolArg("-gen",false) )
-            return(0);
-        if ( (tipindex= chainActive.Tip()) == 0 || tipindex->GetHeight()+1 > nHeight )
-        {
-            fprintf(stderr,"[%s:%d] chain tip changed during staking loop t.%u counter.%d\n",ASSETCHAINS_SYMBOL,nHeight,(uint32_t)time(NULL),i);
-            return(0);
-        }
-        kp = &array[i];
-        eligible = komodo_stake(0,bnTarget,nHeight,kp->txid,kp->vout,0,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF,kp->address,PoSperc);
-        if ( eligible > 0 )
-        {
-            besttime = 0;
-            if ( eligible == komodo_stake(1,bnTarget,nHeight,kp->txid,kp->vout,eligible,(uint32_t)tipindex->nTime+ASSETCHAINS_STAKED_BLOCK_FUTURE_HALF,kp->address,PoSperc) )
+            kp = &stakingset.utxos[it->second];
+            eligible = komodo_stakeutxo(0,bnTarget,nHeight,kp->txid,kp->vout,kp->txtime,kp->stakevalue,kp->address,0,prevtime,PoSperc);
+            if ( eligible > 0 )
             {
-                // have elegible utxo to stake with. 
-                if ( earliest == 0 || eligible < earliest || (eligible == earliest && (*utxovaluep == 0 || kp->nValue < *utxovaluep)) )
+                if ( eligible == komodo_stake(1,bnTarget,nHeight,kp->txid,kp->vout,eligible,prevtime,kp->address,PoSperc) )
                 {
-                    // is better than the previous best, so use it instead.
-                    earliest = eligible;
-                    best_scriptPubKey = kp->scriptPubKey;
-                    *utxovaluep = (uint64_t)kp->nValue;
-                    decode_hex((uint8_t *)utxotxidp,32,(char *)kp->txid.GetHex().c_str());
-                    *utxovoutp = kp->vout;
-                    *txtimep = kp->txtime;
+                    // have elegible utxo to stake with. 
+                    if ( earliest == 0 || eligible < earliest || (eligible == earliest && (*utxovaluep == 0 || kp->nValue < *utxovaluep)) )
+                    {
+                        // is better than the previous best, so use it instead.
+                        earliest = eligible;
+                        best_scriptPubKey = kp->scriptPubKey;
+                        *utxovaluep = (uint64_t)kp->nValue;
+                        decode_hex((uint8_t *)utxotxidp,32,(char *)kp->txid.GetHex().c_str());
+                        *utxovoutp = kp->vout;
+                        *txtimep = kp->txtime;
+                    }
                 }
-                /*if ( eligible < block_from_future_rejecttime )
-                { 
-                    // better to scan all and choose earliest! 
-                    fprintf(stderr, "block_from_future_rejecttime.%u vs eligible.%u \n", block_from_future_rejecttime, eligible);
-                    break;
-                } */ 
             }
         }
     }
-    if (numkp < 500 && array.size() != 0)
-    {
-        array.clear();
-        maxkp = numkp = 0;
-        lasttime = 0;
-    }
     if ( earliest != 0 )
     {
         bool signSuccess; SignatureData sigdata; uint64_t txfee; uint8_t *ptr; uint256 revtxid,utxotxid;
@@ -700,6 +700,7 @@ uint64_t komodo_interest(int32_t txheight, uint64_t nValue, uint32_t nLockTime,
 bool komodo_dailysnapshot(int32_t height);
 void komodo_setactivation(int32_t height);
 void komodo_pricesupdate(int32_t height,CBlock *pblock);
+void komodo_pricesrebuild();
 void komodo_broadcast(CBlock *pblock,int32_t limit);
 int32_t komodo_block2pubkey33(uint8_t *pubkey33,CBlock *block);
 void komodo_event_rewind(struct komodo_state *sp,char *symbol,int32_t height);
@@ -752,13 +753,11 @@ struct komodo_staking
 {
     char address[64];
     uint256 txid;
-    arith_uint256 hashval;
-    uint64_t nValue;
+    uint64_t nValue, stakevalue;  // stakevalue includes the stake multiplier
     uint32_t segid32, txtime;
     int32_t vout;
     CScript scriptPubKey;
 };
-struct komodo_staking *komodo_addutxo(struct komodo_staking *array, int32_t *numkp, int32_t *maxkp, uint32_t txtime, uint64_t nValue, uint256 txid, int32_t vout, char *address, uint8_t *hashbuf, CScript pk);
 void komodo_createminerstransactions();
 uint32_t komodo_segid32(char *coinaddr);
 
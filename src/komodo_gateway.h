@@ -20,6 +20,12 @@
 #include "cc/CCPrices.h"
 #include "cc/pricesfeed.h"
 
+#include <atomic>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 /*#include "secp256k1/include/secp256k1.h"
 #include "secp256k1/include/secp256k1_schnorrsig.h"
 #include "secp256k1/include/secp256k1_musig.h"
@@ -1602,10 +1608,22 @@ struct komodo_extremeprice
     int16_t dir,ind;
 } ExtremePrice;
 
+#define PRICES_MAPHEIGHTS (1 << 20)  // blocks of address space reserved per mapping, doubled when exceeded
+#define PRICES_GROWHEIGHTS 4096      // blocks the file is extended by when the appender reaches its end
+
+struct komodo_pricemap
+{
+    uint8_t *base;
+    long reserved;
+    long filesize;                   // only the appender uses this
+    std::atomic<long> written;       // readers never touch base beyond this, advanced after the record is copied in
+};
+
 struct komodo_priceinfo
 {
     FILE *fp;
-    char symbol[PRICES_MAXNAMELENGTH];   // TODO: it was 64 
+    std::atomic<struct komodo_pricemap *> map;  // replaced mappings are never unmapped, a reader might still be in one
+    char symbol[PRICES_MAXNAMELENGTH];   // TODO: it was 64
 } PRICES[KOMODO_MAXPRICES];
 
 uint32_t PriceCache[KOMODO_LOCALPRICE_CACHESIZE][KOMODO_MAXPRICES];//4+sizeof(Cryptos)/sizeof(*Cryptos)+sizeof(Forex)/sizeof(*Forex)];
@@ -2555,6 +2573,148 @@ int64_t komodo_priceave(int64_t *buf,int64_t *correlated,int32_t cskip)
     return((price*7 + halfave*5 + thirdave*3 + fourthave*2 + decayprice + buf[PRICES_DAYWINDOW-1]) / 19);
 }
 
+pthread_mutex_t pricemutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t pricesupdatemutex = PTHREAD_MUTEX_INITIALIZER;
+int32_t PRICES_firstconnect; // lowest height the connect path owns, the rebuild fills in below it
+
+// PRICES file layouts
+// [0] rawprice32 / timestamp
+// [1] correlated
+// [2] 24hr ave
+// [3] to [7] reserved
+
+long komodo_pricestride(int32_t ind)
+{
+    if ( ind == 0 )
+        return(komodo_cbopretsize(ASSETCHAINS_CBOPRET));
+    return(sizeof(int64_t) * PRICES_MAXDATAPOINTS);
+}
+
+// maps PRICES[ind] with at least minsize bytes of address space, the file itself only grows in komodo_pricesextend
+int32_t komodo_pricesmap(int32_t ind,long minsize)
+{
+#ifndef _WIN32
+    struct komodo_pricemap *pm,*prev; long filesize,reserved,stride,i; void *ptr;
+    if ( PRICES[ind].fp == 0 )
+        return(-1);
+    fflush(PRICES[ind].fp);
+    fseek(PRICES[ind].fp,0,SEEK_END);
+    filesize = ftell(PRICES[ind].fp);
+    reserved = komodo_pricestride(ind) * PRICES_MAPHEIGHTS;
+    while ( reserved < minsize || reserved < filesize )
+        reserved <<= 1;
+    if ( (ptr= mmap(0,reserved,PROT_READ|PROT_WRITE,MAP_SHARED,fileno(PRICES[ind].fp),0)) == MAP_FAILED )
+    {
+        fprintf(stderr,"error mapping %s reserved.%ld\n",PRICES[ind].symbol,reserved);
+        return(-1);
+    }
+    pm = (struct komodo_pricemap *)calloc(1,sizeof(*pm));
+    pm->base = (uint8_t *)ptr;
+    pm->reserved = reserved;
+    pm->filesize = filesize;
+    if ( (prev= PRICES[ind].map) != 0 )
+        pm->written = prev->written.load();
+    else
+    {
+        // the file grows in PRICES_GROWHEIGHTS steps, the zero tail past the last record was never written
+        stride = komodo_pricestride(ind);
+        for (filesize-=filesize%stride; filesize>0; filesize-=stride)
+        {
+            for (i=0; i<stride; i++)
+                if ( pm->base[filesize-stride+i] != 0 )
+                    break;
+            if ( i < stride )
+                break;
+        }
+        pm->written = filesize;
+    }
+    PRICES[ind].map = pm;
+    return(0);
+#else
+    return(-1);
+#endif
+}
+
+// only called by the single appender, returns where len bytes at offset can be written
+uint8_t *komodo_pricesextend(int32_t ind,long offset,long len)
+{
+#ifndef _WIN32
+    struct komodo_pricemap *pm; long newsize;
+    if ( (pm= PRICES[ind].map) == 0 )
+        return(0);
+    if ( offset+len > pm->filesize )
+    {
+        newsize = offset + len + komodo_pricestride(ind) * PRICES_GROWHEIGHTS;
+        if ( newsize > pm->reserved )
+        {
+            if ( komodo_pricesmap(ind,newsize) < 0 )
+                return(0);
+            pm = PRICES[ind].map;
+        }
+        if ( ftruncate(fileno(PRICES[ind].fp),newsize) != 0 )
+        {
+            fprintf(stderr,"error extending %s to %ld\n",PRICES[ind].symbol,newsize);
+            return(0);
+        }
+        pm->filesize = newsize;
+    }
+    return(pm->base + offset);
+#else
+    return(0);
+#endif
+}
+
+// lock-free when mapped, pricemutex only serialises the stdio fallback
+int32_t komodo_pricesread(int32_t ind,void *dest,long offset,long len)
+{
+    struct komodo_pricemap *pm; int32_t retval = -1;
+    if ( offset < 0 )
+        return(-1);
+    if ( (pm= PRICES[ind].map) != 0 )
+    {
+        if ( offset+len > pm->written )
+            return(-1);
+        memcpy(dest,pm->base + offset,len);
+        return(0);
+    }
+    pthread_mutex_lock(&pricemutex);
+    if ( PRICES[ind].fp != 0 )
+    {
+        fseek(PRICES[ind].fp,offset,SEEK_SET);
+        if ( fread(dest,1,len,PRICES[ind].fp) == len )
+            retval = 0;
+    }
+    pthread_mutex_unlock(&pricemutex);
+    return(retval);
+}
+
+int32_t komodo_priceswrite(int32_t ind,const void *src,long offset,long len)
+{
+    struct komodo_pricemap *pm; uint8_t *ptr; int32_t retval = -1;
+    if ( PRICES[ind].map != 0 )
+    {
+        if ( (ptr= komodo_pricesextend(ind,offset,len)) == 0 )
+            return(-1);
+        memcpy(ptr,src,len);
+        pm = PRICES[ind].map;
+        if ( offset+len > pm->written )
+            pm->written = offset + len;
+        return(0);
+    }
+    pthread_mutex_lock(&pricemutex);
+    if ( PRICES[ind].fp != 0 )
+    {
+        fseek(PRICES[ind].fp,offset,SEEK_SET);
+        if ( fwrite(src,1,len,PRICES[ind].fp) == len )
+        {
+            fflush(PRICES[ind].fp);
+            retval = 0;
+        }
+    }
+    pthread_mutex_unlock(&pricemutex);
+    return(retval);
+}
+
 int32_t komodo_pricesinit()
 {
     static int32_t didinit;
@@ -2600,26 +2760,88 @@ int32_t komodo_pricesinit()
     {
         fprintf(stderr,"fatal error opening prices files, start shutdown\n");
         StartShutdown();
+        return(0);
     }
+    for (i=0; i<num; i++)
+        if ( komodo_pricesmap(i,0) < 0 )
+            fprintf(stderr,"%s falls back to file reads\n",PRICES[i].symbol);
     return(0);
 }
 
-pthread_mutex_t pricemutex;
+void _komodo_pricesupdate(int32_t height,CBlock *pblock);
 
-// PRICES file layouts
-// [0] rawprice32 / timestamp
-// [1] correlated
-// [2] 24hr ave
-// [3] to [7] reserved
+int32_t komodo_pricesmissing(int32_t numprices,int32_t ht)
+{
+    uint32_t timestamp;
+    return(komodo_pricesread(0,&timestamp,(long)ht * numprices * sizeof(uint32_t),sizeof(timestamp)) != 0 || timestamp == 0);
+}
+
+// a prices file that was deleted or truncated is missing the records before the tip, replay those blocks from disk
+// runs once from the updater thread, ConnectTip keeps appending meanwhile and only waits on pricesupdatemutex for one block
+// the connect path skipped the correlated and smoothed values of the 2*PRICES_DAYWINDOW heights after the gap, they are recomputed too
+void komodo_pricesrebuild()
+{
+    static int32_t didrebuild;
+    int32_t ht,limit,numprices; CBlockIndex *pindex; CBlock block;
+    if ( didrebuild != 0 || KOMODO_NSPV_FULLNODE == 0 || PRICES[0].fp == 0 )
+        return;
+    didrebuild = 1;
+    numprices = (int32_t)(komodo_cbopretsize(ASSETCHAINS_CBOPRET) / sizeof(uint32_t));
+    {
+        LOCK(cs_main);
+        pthread_mutex_lock(&pricesupdatemutex);
+        if ( PRICES_firstconnect == 0 )
+            PRICES_firstconnect = chainActive.Height() + 1;
+        limit = PRICES_firstconnect;
+        pthread_mutex_unlock(&pricesupdatemutex);
+    }
+    for (ht=limit-1; ht>0; ht--)
+    {
+        if ( komodo_pricesmissing(numprices,ht) == 0 )
+            break;
+    }
+    if ( ++ht >= limit )
+        return;
+    fprintf(stderr,"rebuilding prices from ht.%d to ht.%d\n",ht,limit-1);
+    for (; ht<limit+2*PRICES_DAYWINDOW && !ShutdownRequested(); ht++)
+    {
+        {
+            LOCK(cs_main);
+            pindex = komodo_chainactive(ht);
+        }
+        if ( pindex == 0 )
+            break; // past the tip, the connect path has the complete windows from here
+        if ( ReadBlockFromDisk(block,pindex,0) == 0 )
+        {
+            fprintf(stderr,"error reading block ht.%d for prices rebuild\n",ht);
+            break;
+        }
+        LOCK(cs_main); // same lock order as ConnectTip, and a block that was disconnected meanwhile is left alone
+        if ( komodo_chainactive(ht) != pindex )
+            continue;
+        pthread_mutex_lock(&pricesupdatemutex);
+        if ( ht >= limit || komodo_pricesmissing(numprices,ht) != 0 )
+            _komodo_pricesupdate(ht,&block);
+        pthread_mutex_unlock(&pricesupdatemutex);
+    }
+}
 
 void komodo_pricesupdate(int32_t height,CBlock *pblock)
+{
+    pthread_mutex_lock(&pricesupdatemutex);
+    if ( PRICES_firstconnect == 0 )
+        PRICES_firstconnect = height;
+    _komodo_pricesupdate(height,pblock);
+    pthread_mutex_unlock(&pricesupdatemutex);
+}
+
+void _komodo_pricesupdate(int32_t height,CBlock *pblock)
 {
     static int numprices; static uint32_t *ptr32; static int64_t *ptr64,*tmpbuf;
-    int32_t ind,offset,width; int64_t correlated,smoothed; uint64_t seed,rngval; uint32_t rawprices[KOMODO_MAXPRICES],buf[PRICES_MAXDATAPOINTS*2];
+    int32_t i,ind,offset,width; int64_t correlated,smoothed; uint64_t seed,rngval; uint32_t rawprices[KOMODO_MAXPRICES],buf[PRICES_MAXDATAPOINTS*2];
     width = PRICES_DAYWINDOW;//(2*PRICES_DAYWINDOW + PRICES_SMOOTHWIDTH);
     if ( numprices == 0 )
     {
-        pthread_mutex_init(&pricemutex,0);
         numprices = (int32_t)(komodo_cbopretsize(ASSETCHAINS_CBOPRET) / sizeof(uint32_t));
         ptr32 = (uint32_t *)calloc(sizeof(uint32_t),numprices * width);
         ptr64 = (int64_t *)calloc(sizeof(int64_t),PRICES_DAYWINDOW*PRICES_MAXDATAPOINTS);
@@ -2633,16 +2855,16 @@ void komodo_pricesupdate(int32_t height,CBlock *pblock)
         //fprintf(stderr,"numprices.%d\n",numprices);
         if ( PRICES[0].fp != 0 )
         {
-            pthread_mutex_lock(&pricemutex);
-            fseek(PRICES[0].fp,height * numprices * sizeof(uint32_t),SEEK_SET);
-            if ( fwrite(rawprices,sizeof(uint32_t),numprices,PRICES[0].fp) != numprices )
+            if ( komodo_priceswrite(0,rawprices,(long)height * numprices * sizeof(uint32_t),numprices * sizeof(uint32_t)) < 0 )
                 fprintf(stderr,"error writing rawprices for ht.%d\n",height);
-            else fflush(PRICES[0].fp);
             if ( height > PRICES_DAYWINDOW )
             {
-                fseek(PRICES[0].fp,(height-width+1) * numprices * sizeof(uint32_t),SEEK_SET);
-                if ( fread(ptr32,sizeof(uint32_t),width*numprices,PRICES[0].fp) == width*numprices )
+                if ( komodo_pricesread(0,ptr32,(long)(height-width+1) * numprices * sizeof(uint32_t),width * numprices * sizeof(uint32_t)) == 0 )
                 {
+                    // a zero timestamp was not written yet, the rebuild computes this height once it is
+                    for (i=0; i<width; i++)
+                        if ( ptr32[i*numprices] == 0 )
+                            return;
                     rngval = seed;
                     for (ind=1; ind<numprices; ind++)
                     {
@@ -2655,24 +2877,25 @@ void komodo_pricesupdate(int32_t height,CBlock *pblock)
                         rngval = (rngval*11109 + 13849);
                         if ( (correlated= komodo_pricecorrelated(rngval,ind,&ptr32[offset],-numprices,0,PRICES_SMOOTHWIDTH)) > 0 )
                         {
-                            fseek(PRICES[ind].fp,height * sizeof(int64_t) * PRICES_MAXDATAPOINTS,SEEK_SET);
                             memset(buf,0,sizeof(buf));
                             buf[0] = rawprices[ind];
                             buf[1] = rawprices[0]; // timestamp
                             memcpy(&buf[2],&correlated,sizeof(correlated));
-                            if ( fwrite(buf,1,sizeof(buf),PRICES[ind].fp) != sizeof(buf) )
+                            if ( komodo_priceswrite(ind,buf,(long)height * sizeof(int64_t) * PRICES_MAXDATAPOINTS,sizeof(buf)) < 0 )
                                 fprintf(stderr,"error fwrite buf for ht.%d ind.%d\n",height,ind);
                             else if ( height > PRICES_DAYWINDOW*2 )
                             {
-                                fseek(PRICES[ind].fp,(height-PRICES_DAYWINDOW+1) * PRICES_MAXDATAPOINTS * sizeof(int64_t),SEEK_SET);
-                                if ( fread(ptr64,sizeof(int64_t),PRICES_DAYWINDOW*PRICES_MAXDATAPOINTS,PRICES[ind].fp) == PRICES_DAYWINDOW*PRICES_MAXDATAPOINTS )
+                                if ( komodo_pricesread(ind,ptr64,(long)(height-PRICES_DAYWINDOW+1) * PRICES_MAXDATAPOINTS * sizeof(int64_t),PRICES_DAYWINDOW * PRICES_MAXDATAPOINTS * sizeof(int64_t)) == 0 )
                                 {
+                                    for (i=0; i<PRICES_DAYWINDOW; i++)
+                                        if ( ptr64[i*PRICES_MAXDATAPOINTS+1] == 0 )
+                                            break;
+                                    if ( i < PRICES_DAYWINDOW )
+                                        continue; // a correlated price in the window is missing
                                     if ( (smoothed= komodo_priceave(tmpbuf,&ptr64[(PRICES_DAYWINDOW-1)*PRICES_MAXDATAPOINTS+1],-PRICES_MAXDATAPOINTS)) > 0 )
                                     {
-                                        fseek(PRICES[ind].fp,(height * PRICES_MAXDATAPOINTS + 2) * sizeof(int64_t),SEEK_SET);
-                                        if ( fwrite(&smoothed,1,sizeof(smoothed),PRICES[ind].fp) != sizeof(smoothed) )
+                                        if ( komodo_priceswrite(ind,&smoothed,((long)height * PRICES_MAXDATAPOINTS + 2) * sizeof(int64_t),sizeof(smoothed)) < 0 )
                                             fprintf(stderr,"error fwrite smoothed for ht.%d ind.%d\n",height,ind);
-                                        else fflush(PRICES[ind].fp);
                                     } else fprintf(stderr,"error price_smoothed ht.%d ind.%d\n",height,ind);
                                 } else fprintf(stderr,"error fread ptr64 for ht.%d ind.%d\n",height,ind);
                             }
@@ -2681,23 +2904,17 @@ void komodo_pricesupdate(int32_t height,CBlock *pblock)
                     //fprintf(stderr,"height.%d\n",height);
                 } else fprintf(stderr,"error reading rawprices for ht.%d\n",height);
             } // else fprintf(stderr,"height.%d <= width.%d\n",height,width);
-            pthread_mutex_unlock(&pricemutex);
         } else fprintf(stderr,"null PRICES[0].fp\n");
     } else fprintf(stderr,"numprices mismatch, height.%d\n",height);
 }
 
 int32_t komodo_priceget(int64_t *buf64,int32_t ind,int32_t height,int32_t numblocks)
 {
-    FILE *fp; int32_t retval = PRICES_MAXDATAPOINTS;
-    pthread_mutex_lock(&pricemutex);
-    if ( ind < KOMODO_MAXPRICES && (fp= PRICES[ind].fp) != 0 )
-    {
-        fseek(fp,height * PRICES_MAXDATAPOINTS * sizeof(int64_t),SEEK_SET);
-        if ( fread(buf64,sizeof(int64_t),numblocks*PRICES_MAXDATAPOINTS,fp) != numblocks*PRICES_MAXDATAPOINTS )
-            retval = -1;
-    }
-    pthread_mutex_unlock(&pricemutex);
-    return(retval);
+    if ( ind < 0 || ind >= KOMODO_MAXPRICES || height < 0 || numblocks <= 0 )
+        return(-1);
+    if ( komodo_pricesread(ind,buf64,(long)height * PRICES_MAXDATAPOINTS * sizeof(int64_t),(long)numblocks * PRICES_MAXDATAPOINTS * sizeof(int64_t)) < 0 )
+        return(-1);
+    return(PRICES_MAXDATAPOINTS);
 }
 
 // place to add miner's created transactions
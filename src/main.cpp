@@ -2191,12 +2191,12 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 }
 
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end, int64_t skip, int64_t maxEntries)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, skip, maxEntries))
         return error("unable to get txids for address");
 
     return true;
@@ -2215,12 +2215,12 @@ bool GetAddressUnspent(uint160 addressHash, int type,
 }
 
 bool GetUnspentCCIndex(uint160 addressHash, uint256 creationId,
-                       std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs)
+                       std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs, int64_t skip)
 {
     if (!fUnspentCCIndex)
         return error("unspent cc index not enabled");
 
-    if (!pblocktree->ReadUnspentCCIndex(addressHash, creationId, unspentOutputs, beginHeight, endHeight, maxOutputs))
+    if (!pblocktree->ReadUnspentCCIndex(addressHash, creationId, unspentOutputs, beginHeight, endHeight, maxOutputs, skip))
         return error("unable to get outputs for address from unspent cc index");
 
     return true;
@@ -4327,6 +4327,8 @@ void static UpdateTip(CBlockIndex *pindexNew) {
     */
 }
 
+void CCIndexChainTip(const CBlockIndex *pindex,const CBlock *pblock,bool added);
+
 /**
  * Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and
  * mempool.removeWithoutBranchId after this, with cs_main held.
@@ -4425,6 +4427,7 @@ bool static DisconnectTip(CValidationState &state, bool fBare = false) {
     }
     // Update cached incremental witnesses
     GetMainSignals().ChainTip(pindexDelete, &block, newSproutTree, newSaplingTree, false);
+    CCIndexChainTip(pindexDelete, &block, false);
     return true;
 }
 
@@ -4667,6 +4670,7 @@ bool static ConnectTip(CValidationState &state, CBlockIndex *pindexNew, CBlock *
     }
     // Update cached incremental witnesses
     GetMainSignals().ChainTip(pindexNew, pblock, oldSproutTree, oldSaplingTree, true);
+    CCIndexChainTip(pindexNew, pblock, true);
 
     EnforceNodeDeprecation(pindexNew->GetHeight());
 
@@ -21,15 +21,20 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
+#include "notarisationdb.h"
 #include "httpserver.h"
+#include "key_io.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
 #include "utilstrencodings.h"
 #include "version.h"
+#include "cc/CCinclude.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
@@ -37,6 +42,7 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const long MAX_REST_HEADERS_RESULTS = 2000;
 
 enum RetFormat {
     RF_UNDEF,
@@ -138,7 +144,7 @@ static bool rest_headers(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "No header count specified. Use /rest/headers/<count>/<hash>.<ext>.");
 
     long count = strtol(path[0].c_str(), NULL, 10);
-    if (count < 1 || count > 2000)
+    if (count < 1 || count > MAX_REST_HEADERS_RESULTS)
         return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[0]);
 
     string hashStr = path[1];
@@ -246,10 +252,18 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        JSONStreamWriter out(boost::bind(&HTTPRequest::WriteReplyChunk, req, HTTP_OK, _1));
+        try {
+            blockToJSONStream(out, block, pblockindex, showTxDetails);
+        } catch (const std::exception& e) {
+            if (!out.Started())
+                throw;
+            LogPrintf("%s: %s\n", __func__, e.what());
+            req->WriteReplyAbort();
+            return false;
+        }
+        req->WriteReplyEnd(HTTP_OK, out.Finish() + "\n");
         return true;
     }
 
@@ -334,11 +348,18 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        JSONStreamWriter out(boost::bind(&HTTPRequest::WriteReplyChunk, req, HTTP_OK, _1));
+        try {
+            mempoolToJSONStream(out, true);
+        } catch (const std::exception& e) {
+            if (!out.Started())
+                throw;
+            LogPrintf("%s: %s\n", __func__, e.what());
+            req->WriteReplyAbort();
+            return false;
+        }
+        req->WriteReplyEnd(HTTP_OK, out.Finish() + "\n");
         return true;
     }
     default: {
@@ -599,6 +620,283 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static const long MAX_REST_PAGE_ENTRIES = 10000; //max index entries returned per request, use the offset to page
+static const long MAX_REST_PAGE_OFFSET = 1000000; //max index entries stepped over to reach a page
+static const long MAX_REST_NOTARISATIONS_BLOCKS = 2000;
+static const long MAX_REST_BLOCKRANGE = 1000;
+
+/** Parse the <count>/<offset|height>/... prefix shared by the paged endpoints */
+static bool ParsePage(HTTPRequest* req, const vector<string>& path, size_t nMinParts, long nMaxCount, const string& strUsage, long& count, long& offset)
+{
+    if (path.size() < nMinParts)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Missing parameters. Use " + strUsage + ".");
+    count = strtol(path[0].c_str(), NULL, 10);
+    if (count < 1 || count > nMaxCount)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Count out of range: " + path[0]);
+    int32_t n;
+    if (!ParseInt32(path[1], &n) || n < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid offset or height: " + path[1]);
+    offset = n;
+    return true;
+}
+
+static bool RESTBinaryReply(HTTPRequest* req, enum RetFormat rf, const CDataStream& ss)
+{
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryData = ss.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryData);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ss.begin(), ss.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+    }
+    }
+}
+
+/**
+ * Address index entries of an address, oldest first.
+ * /rest/addressdeltas/<count>/<offset>/<address>[/<startheight>/<endheight>].<bin|hex>
+ * returns vector<pair<CAddressIndexKey, CAmount>>, a short page marks the end.
+ */
+static bool rest_addressdeltas(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    long count, offset;
+    if (!ParsePage(req, path, 3, MAX_REST_PAGE_ENTRIES, "/rest/addressdeltas/<count>/<offset>/<address>[/<startheight>/<endheight>].<ext>", count, offset))
+        return false;
+    if (offset > MAX_REST_PAGE_OFFSET)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Offset out of range: " + path[1]);
+
+    CBitcoinAddress address(path[2]);
+    uint160 hashBytes;
+    int type = 0;
+    if (!address.GetIndexKey(hashBytes, type, false))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + path[2]);
+
+    int start = 0, end = 0;
+    if (path.size() == 5) {
+        start = atoi(path[3].c_str());
+        end = atoi(path[4].c_str());
+        if (start <= 0 || end < start)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height range: " + path[3] + "-" + path[4]);
+    } else if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid parameters, both startheight and endheight are needed");
+
+    // only the page is read from the index
+    std::vector<std::pair<CAddressIndexKey, CAmount> > page;
+    if (!GetAddressIndex(hashBytes, type, page, start, end, offset, count))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available for address (address index enabled?)");
+
+    CDataStream ssDeltas(SER_NETWORK, PROTOCOL_VERSION);
+    ssDeltas << page;
+    return RESTBinaryReply(req, rf, ssDeltas);
+}
+
+/**
+ * Unspent cc index entries of a contract's global address or of any cc address.
+ * /rest/ccunspents/<count>/<offset>/<evalcode|ccaddress>[/<creationid>].<bin|hex>
+ * evalcode is two hex digits, returns vector<pair<CUnspentCCIndexKey, CUnspentCCIndexValue>>.
+ */
+static bool rest_ccunspents(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    long count, offset;
+    if (!ParsePage(req, path, 3, MAX_REST_PAGE_ENTRIES, "/rest/ccunspents/<count>/<offset>/<evalcode|ccaddress>[/<creationid>].<ext>", count, offset))
+        return false;
+    if (offset > MAX_REST_PAGE_OFFSET)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Offset out of range: " + path[1]);
+    if (path.size() > 4)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Too many parameters");
+
+    std::string ccaddr = path[2];
+    if (ccaddr.size() == 2 && IsHex(ccaddr)) {
+        struct CCcontract_info *cp, C;
+        std::vector<unsigned char> evalcode = ParseHex(ccaddr);
+        if (evalcode.empty() || (cp = CCinit(&C, evalcode[0])) == 0)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Unknown evalcode: " + path[2]);
+        ccaddr = cp->unspendableCCaddr;
+    }
+    CBitcoinAddress address(ccaddr);
+    uint160 hashBytes;
+    int type = 0;
+    if (!address.GetIndexKey(hashBytes, type, true))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid evalcode or cc address: " + path[2]);
+
+    uint256 creationid;
+    if (path.size() == 4 && !ParseHashStr(path[3], creationid))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid creationid: " + path[3]);
+
+    // only the page is read from the index
+    std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > page;
+    if (!GetUnspentCCIndex(hashBytes, creationid, page, -1, -1, count, offset))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available (unspent cc index enabled?)");
+
+    CDataStream ssUnspents(SER_NETWORK, PROTOCOL_VERSION);
+    ssUnspents << page;
+    return RESTBinaryReply(req, rf, ssUnspents);
+}
+
+/** Notarisations found in one block, each NotarisationData is kept in its own serialized form */
+struct CRESTBlockNotarisations {
+    int32_t nHeight;
+    uint256 hashBlock;
+    std::vector<std::pair<uint256, std::vector<unsigned char> > > vNotarisations;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nHeight);
+        READWRITE(hashBlock);
+        READWRITE(vNotarisations);
+    }
+};
+
+/**
+ * Notarisations in the active chain blocks height .. height+count-1.
+ * /rest/notarisations/<count>/<height>.<bin|hex>
+ * returns vector<CRESTBlockNotarisations>, blocks without notarisations are skipped.
+ */
+static bool rest_notarisations(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    long count, height;
+    if (!ParsePage(req, path, 2, MAX_REST_NOTARISATIONS_BLOCKS, "/rest/notarisations/<count>/<height>.<ext>", count, height))
+        return false;
+
+    std::vector<std::pair<int32_t, uint256> > blocks;
+    {
+        LOCK(cs_main);
+        for (long h = height; h < height + count && h <= chainActive.Height(); h++)
+            blocks.push_back(std::make_pair((int32_t)h, chainActive[h]->GetBlockHash()));
+    }
+
+    std::vector<CRESTBlockNotarisations> vBlocks;
+    BOOST_FOREACH(const PAIRTYPE(int32_t, uint256)& block, blocks) {
+        NotarisationsInBlock nibs;
+        if (!GetBlockNotarisations(block.second, nibs) || nibs.empty())
+            continue;
+        CRESTBlockNotarisations entry;
+        entry.nHeight = block.first;
+        entry.hashBlock = block.second;
+        BOOST_FOREACH(const Notarisation& n, nibs) {
+            CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+            ssData << n.second;
+            entry.vNotarisations.push_back(std::make_pair(n.first, std::vector<unsigned char>(ssData.begin(), ssData.end())));
+        }
+        vBlocks.push_back(entry);
+    }
+
+    CDataStream ssNotarisations(SER_NETWORK, PROTOCOL_VERSION);
+    ssNotarisations << vBlocks;
+    return RESTBinaryReply(req, rf, ssNotarisations);
+}
+
+/** Read a block as it is stored in the block files, without deserializing it */
+static bool ReadRawBlockFromDisk(std::vector<unsigned char>& vch, const CDiskBlockPos& pos)
+{
+    if (pos.IsNull() || pos.nPos < sizeof(unsigned int))
+        return false;
+    // The block size is stored right in front of the block
+    CDiskBlockPos posSize(pos.nFile, pos.nPos - sizeof(unsigned int));
+    CAutoFile filein(OpenBlockFile(posSize, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    try {
+        unsigned int nSize;
+        filein >> nSize;
+        if (nSize == 0 || nSize > MAX_SIZE)
+            return false;
+        vch.resize(nSize);
+        filein.read((char*)&vch[0], nSize);
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Serialized active chain blocks height .. height+count-1, concatenated.
+ * /rest/blockrange/<count>/<height>.<bin|hex>
+ * Blocks are sent one by one as they are read. Reading pauses while the client
+ * has HTTP_REPLY_MAX_QUEUED bytes left to take, so long ranges use little memory.
+ */
+static bool rest_blockrange(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    long count, height;
+    if (!ParsePage(req, path, 2, MAX_REST_BLOCKRANGE, "/rest/blockrange/<count>/<height>.<ext>", count, height))
+        return false;
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    std::vector<CDiskBlockPos> vPos;
+    {
+        LOCK(cs_main);
+        if (height > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Height out of range: " + path[1]);
+        for (long h = height; h < height + count && h <= chainActive.Height(); h++) {
+            CBlockIndex* pindex = chainActive[h];
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+                return RESTERR(req, HTTP_NOT_FOUND, pindex->GetBlockHash().GetHex() + " not available (pruned data)");
+            vPos.push_back(pindex->GetBlockPos());
+        }
+    }
+
+    req->WriteHeader("Content-Type", rf == RF_BINARY ? "application/octet-stream" : "text/plain");
+    std::vector<unsigned char> vch;
+    for (size_t i = 0; i < vPos.size(); i++) {
+        if (!ReadRawBlockFromDisk(vch, vPos[i])) {
+            if (i == 0)
+                return RESTERR(req, HTTP_NOT_FOUND, "Block at height " + std::to_string(height) + " could not be read");
+            // Part of the range was sent already, end the reply there
+            LogPrintf("%s: block at height %d could not be read\n", __func__, height + i);
+            break;
+        }
+        if (rf == RF_BINARY)
+            req->WriteReplyChunk(HTTP_OK, std::string(vch.begin(), vch.end()));
+        else
+            req->WriteReplyChunk(HTTP_OK, HexStr(vch.begin(), vch.end()));
+    }
+    req->WriteReplyEnd(HTTP_OK, rf == RF_HEX ? "\n" : "");
+    return true;
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -611,6 +909,10 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/addressdeltas/", rest_addressdeltas},
+      {"/rest/ccunspents/", rest_ccunspents},
+      {"/rest/notarisations/", rest_notarisations},
+      {"/rest/blockrange/", rest_blockrange},
 };
 
 bool StartREST()
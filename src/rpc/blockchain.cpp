@@ -28,6 +28,7 @@
 #include "cc/eval.h"
 #include "main.h"
 #include "primitives/transaction.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
@@ -284,7 +285,8 @@ UniValue blockToDeltasJSON(const CBlock& block, const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+/** Fields of blockToJSON that come before "tx" */
+static UniValue blockToJSONHead(const CBlock& block, const CBlockIndex* blockindex)
 {
     UniValue result(UniValue::VOBJ);
     uint256 notarized_hash, notarized_desttxid; int32_t prevMoMheight, notarized_height;
@@ -303,19 +305,25 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
     result.push_back(Pair("segid", (int)komodo_segid(0, blockindex->GetHeight())));
     result.push_back(Pair("finalsaplingroot", block.hashFinalSaplingRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
-    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+    return result;
+}
+
+/** Entry of the "tx" array of blockToJSON */
+static UniValue blockTxToJSON(const CTransaction& tx, bool txDetails)
+{
+    if (txDetails)
     {
-        if (txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(tx, uint256(), objTx);
-            txs.push_back(objTx);
-        }
-        else
-            txs.push_back(tx.GetHash().GetHex());
+        UniValue objTx(UniValue::VOBJ);
+        TxToJSON(tx, uint256(), objTx);
+        return objTx;
     }
-    result.push_back(Pair("tx", txs));
+    return tx.GetHash().GetHex();
+}
+
+/** Fields of blockToJSON that come after "tx" */
+static UniValue blockToJSONTail(const CBlock& block, const CBlockIndex* blockindex)
+{
+    UniValue result(UniValue::VOBJ);
     result.push_back(Pair("time", block.GetBlockTime()));
     result.push_back(Pair("nonce", block.nNonce.GetHex()));
     result.push_back(Pair("solution", HexStr(block.nSolution)));
@@ -338,6 +346,46 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue result = blockToJSONHead(block, blockindex);
+    UniValue txs(UniValue::VARR);
+    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+        txs.push_back(blockTxToJSON(tx, txDetails));
+    result.push_back(Pair("tx", txs));
+    result.pushKVs(blockToJSONTail(block, blockindex));
+    return result;
+}
+
+/** cs_main is taken for each part and not held while it is written, the writer can wait for the client */
+void blockToJSONStream(JSONStreamWriter& out, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue part;
+    out.BeginObject();
+    {
+        LOCK(cs_main);
+        part = blockToJSONHead(block, blockindex);
+    }
+    out.Pairs(part);
+    out.Key("tx");
+    out.BeginArray();
+    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+    {
+        {
+            LOCK(cs_main);
+            part = blockTxToJSON(tx, txDetails);
+        }
+        out.Value(part);
+    }
+    out.EndArray();
+    {
+        LOCK(cs_main);
+        part = blockToJSONTail(block, blockindex);
+    }
+    out.Pairs(part);
+    out.EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() != 0)
@@ -447,6 +495,34 @@ bool mytxid_inmempool(uint256 txid)
     return(false);
 }
 
+/** Verbose mempoolToJSON entry, mempool.cs must be held */
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e)
+{
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.GetTxSize()));
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
+    info.push_back(Pair("time", e.GetTime()));
+    info.push_back(Pair("height", (int)e.GetHeight()));
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
+    info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends)
+    {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends));
+    return info;
+}
+
 UniValue mempoolToJSON(bool fVerbose)
 {
     if (fVerbose)
@@ -456,29 +532,7 @@ UniValue mempoolToJSON(bool fVerbose)
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
         {
             const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH(const CTxIn& txin, tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends)
-            {
-                depends.push_back(dep);
-            }
-
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
+            o.push_back(Pair(hash.ToString(), mempoolEntryToJSON(e)));
         }
         return o;
     }
@@ -495,6 +549,42 @@ UniValue mempoolToJSON(bool fVerbose)
     }
 }
 
+/** The mempool is walked from a snapshot of its txids, entries that left it meanwhile are skipped */
+void mempoolToJSONStream(JSONStreamWriter& out, bool fVerbose)
+{
+    if (fVerbose)
+    {
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        out.BeginObject();
+        BOOST_FOREACH(const uint256& hash, vtxid)
+        {
+            UniValue info;
+            {
+                LOCK2(cs_main, mempool.cs);
+                CTxMemPool::indexed_transaction_set::const_iterator it = mempool.mapTx.find(hash);
+                if (it == mempool.mapTx.end())
+                    continue;
+                info = mempoolEntryToJSON(*it);
+            }
+            out.Key(hash.ToString());
+            out.Value(info);
+        }
+        out.EndObject();
+    }
+    else
+    {
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        out.BeginArray();
+        BOOST_FOREACH(const uint256& hash, vtxid)
+            out.Value(hash.ToString());
+        out.EndArray();
+    }
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() > 1)
@@ -536,6 +626,20 @@ UniValue getrawmempool(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return mempoolToJSON(fVerbose);
 }
 
+/** getrawmempool written to a stream */
+static bool getrawmempool_stream(const UniValue& params, JSONStreamWriter& out)
+{
+    if (params.size() > 1)
+        return false;
+
+    bool fVerbose = false;
+    if (params.size() > 0)
+        fVerbose = params[0].get_bool();
+
+    mempoolToJSONStream(out, fVerbose);
+    return true;
+}
+
 UniValue getblockdeltas(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() != 1)
@@ -792,6 +896,63 @@ UniValue getblockheader(const UniValue& params, bool fHelp, const CPubKey& mypk)
     return blockheaderToJSON(pblockindex);
 }
 
+/** Parse the getblock arguments and read the block, cs_main must be held */
+static CBlockIndex* getblockParams(const UniValue& params, CBlock& block, int& verbosity)
+{
+    std::string strHash = params[0].get_str();
+
+    // If height is supplied, find the hash
+    if (strHash.size() < (2 * sizeof(uint256))) {
+        // std::stoi allows characters, whereas we want to be strict
+        regex r("[[:digit:]]+");
+        if (!regex_match(strHash, r)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
+        }
+
+        int nHeight = -1;
+        try {
+            nHeight = std::stoi(strHash);
+        }
+        catch (const std::exception &e) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
+        }
+
+        if (nHeight < 0 || nHeight > chainActive.Height()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+        }
+        strHash = chainActive[nHeight]->GetBlockHash().GetHex();
+    }
+
+    uint256 hash(uint256S(strHash));
+
+    verbosity = 1;
+    if (params.size() > 1) {
+        if (params[1].isNum()) {
+            verbosity = params[1].get_int();
+        }
+        else {
+            verbosity = params[1].get_bool() ? 1 : 0;
+        }
+    }
+
+    if (verbosity < 0 || verbosity > 2) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be in range from 0 to 2");
+    }
+
+    if (mapBlockIndex.count(hash) == 0)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+    CBlockIndex* pblockindex = mapBlockIndex[hash];
+
+    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
+    if (!ReadBlockFromDisk(block, pblockindex, 1))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+    return pblockindex;
+}
+
 UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -843,67 +1004,44 @@ UniValue getblock(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
     LOCK(cs_main);
 
-    std::string strHash = params[0].get_str();
-
-    // If height is supplied, find the hash
-    if (strHash.size() < (2 * sizeof(uint256))) {
-        // std::stoi allows characters, whereas we want to be strict
-        regex r("[[:digit:]]+");
-        if (!regex_match(strHash, r)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
-        }
-
-        int nHeight = -1;
-        try {
-            nHeight = std::stoi(strHash);
-        }
-        catch (const std::exception &e) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid block height parameter");
-        }
-
-        if (nHeight < 0 || nHeight > chainActive.Height()) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
-        }
-        strHash = chainActive[nHeight]->GetBlockHash().GetHex();
-    }
-
-    uint256 hash(uint256S(strHash));
+    CBlock block;
+    int verbosity;
+    CBlockIndex* pblockindex = getblockParams(params, block, verbosity);
 
-    int verbosity = 1;
-    if (params.size() > 1) {
-        if (params[1].isNum()) {
-            verbosity = params[1].get_int();
-        }
-        else {
-            verbosity = params[1].get_bool() ? 1 : 0;
-        }
+    if (verbosity == 0)
+    {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << block;
+        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        return strHex;
     }
 
-    if (verbosity < 0 || verbosity > 2) {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Verbosity must be in range from 0 to 2");
-    }
+    return blockToJSON(block, pblockindex, verbosity >= 2);
+}
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+/** getblock written to a stream, does not build the verbose result in memory */
+static bool getblock_stream(const UniValue& params, JSONStreamWriter& out)
+{
+    if (params.size() < 1 || params.size() > 2)
+        return false;
 
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
-
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
-
-    if (!ReadBlockFromDisk(block, pblockindex, 1))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    int verbosity;
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        pblockindex = getblockParams(params, block, verbosity);
+    }
 
     if (verbosity == 0)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
         ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        out.Value(HexStr(ssBlock.begin(), ssBlock.end()));
     }
-
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    else
+        blockToJSONStream(out, block, pblockindex, verbosity >= 2);
+    return true;
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp, const CPubKey& mypk)
@@ -1832,8 +1970,18 @@ static const CRPCCommand commands[] =
 { "hidden",             "reconsiderblock",        &reconsiderblock,        true },
 };
 
+/* Variants of the commands above that write large results to a stream */
+static const CRPCStreamCommand streamCommands[] =
+{ //  name                      actor (function)
+  //  ------------------------  -----------------------
+    { "getblock",               &getblock_stream       },
+    { "getrawmempool",          &getrawmempool_stream  },
+};
+
 void RegisterBlockchainRPCCommands(CRPCTable &tableRPC)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         tableRPC.appendCommand(commands[vcidx].name, &commands[vcidx]);
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(streamCommands); vcidx++)
+        tableRPC.appendStreamCommand(streamCommands[vcidx].name, &streamCommands[vcidx]);
 }
@@ -0,0 +1,117 @@
+// Copyright (c) 2020 The Komodo Platform developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(const Sink& sink, size_t nFlushSize) :
+    sink(sink), nFlushSize(nFlushSize), fKey(false), fStarted(false)
+{
+    buf.reserve(nFlushSize);
+}
+
+void JSONStreamWriter::Separator()
+{
+    if (fKey) {
+        fKey = false;
+        return;
+    }
+    if (vFirst.empty())
+        return;
+    if (!vFirst.back())
+        buf += ',';
+    vFirst.back() = false;
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (buf.size() < nFlushSize)
+        return;
+    sink(buf);
+    buf.clear();
+    fStarted = true;
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separator();
+    buf += '{';
+    vFirst.push_back(true);
+    strClose += '}';
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vFirst.empty() && !fKey);
+    vFirst.pop_back();
+    strClose.erase(strClose.size() - 1);
+    buf += '}';
+    Flush();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separator();
+    buf += '[';
+    vFirst.push_back(true);
+    strClose += ']';
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vFirst.empty() && !fKey);
+    vFirst.pop_back();
+    strClose.erase(strClose.size() - 1);
+    buf += ']';
+    Flush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vFirst.empty() && !fKey);
+    Separator();
+    buf += UniValue(key).write();
+    buf += ':';
+    fKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& val)
+{
+    Separator();
+    buf += val.write();
+    Flush();
+}
+
+void JSONStreamWriter::Pairs(const UniValue& obj)
+{
+    const std::vector<std::string>& keys = obj.getKeys();
+    const std::vector<UniValue>& values = obj.getValues();
+    for (size_t i = 0; i < keys.size(); i++) {
+        Key(keys[i]);
+        Value(values[i]);
+    }
+}
+
+void JSONStreamWriter::Unwind(size_t nDepth)
+{
+    while (vFirst.size() > nDepth) {
+        if (fKey)
+            Value(NullUniValue);
+        vFirst.pop_back();
+        buf += strClose[strClose.size() - 1];
+        strClose.erase(strClose.size() - 1);
+    }
+    if (fKey)
+        Value(NullUniValue);
+    Flush();
+}
+
+std::string JSONStreamWriter::Finish()
+{
+    assert(vFirst.empty() && !fKey);
+    std::string strRest;
+    strRest.swap(buf);
+    return strRest;
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2020 The Komodo Platform developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <univalue.h>
+
+/** Output is handed to the sink once this many bytes are buffered */
+static const size_t DEFAULT_JSONSTREAM_FLUSH_SIZE = 64 * 1024;
+
+/**
+ * Incremental JSON emitter for large results.
+ * Containers are opened and closed explicitly and their members are written
+ * one at a time, so a result never has to exist as a complete UniValue tree
+ * or as one string. The output is compact and identical to UniValue::write().
+ */
+class JSONStreamWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> Sink;
+
+    JSONStreamWriter(const Sink& sink, size_t nFlushSize = DEFAULT_JSONSTREAM_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** Write the key of the next member of the current object */
+    void Key(const std::string& key);
+    /** Write a complete value (an array element or the value after Key) */
+    void Value(const UniValue& val);
+    /** Write all members of obj into the current object */
+    void Pairs(const UniValue& obj);
+
+    /** True once output has been handed to the sink */
+    bool Started() const { return fStarted; }
+    /** Number of open containers */
+    size_t Depth() const { return vFirst.size(); }
+    /**
+     * Close containers until nDepth are open, a pending key gets null.
+     * For output that has to stay valid JSON after its producer failed.
+     */
+    void Unwind(size_t nDepth);
+    /**
+     * Return the output that has not been handed to the sink yet.
+     * All containers must be closed, the writer can not be used afterwards.
+     */
+    std::string Finish();
+
+private:
+    Sink sink;
+    size_t nFlushSize;
+    std::string buf;
+    std::vector<bool> vFirst; //!< per open container: no member written yet
+    std::string strClose;     //!< per open container: its closing bracket
+    bool fKey;                //!< a key was written and its value is pending
+    bool fStarted;
+
+    void Separator();
+    void Flush();
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
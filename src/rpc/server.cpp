@@ -57,6 +57,8 @@ static std::vector<RPCTimerInterface*> timerInterfaces;
 /* Map of name to timer.
  * @note Can be changed to std::unique_ptr when C++11 */
 static std::map<std::string, boost::shared_ptr<RPCTimerBase> > deadlineTimers;
+/* Runs the calls of batch requests in parallel */
+static RPCWorkInterface* workInterface = 0;
 
 static struct CRPCSignals
 {
@@ -708,6 +710,18 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool CRPCTable::appendStreamCommand(const std::string& name, const CRPCStreamCommand* pcmd)
+{
+    if (IsRPCRunning())
+        return false;
+
+    if (mapCommands.count(name) == 0 || mapStreamCommands.count(name) != 0)
+        return false;
+
+    mapStreamCommands[name] = pcmd;
+    return true;
+}
+
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
@@ -829,11 +843,88 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+/** Methods that only read state. A batch is only spread over threads when
+ * all of its calls are one of these, so batches that change state still run in order.
+ */
+static bool IsParallelBatchMethod(const std::string& strMethod)
+{
+    static const char* methods[] = {
+        "getrawtransaction", "decoderawtransaction", "decodescript", "gettxout",
+        "getblock", "getblockhash", "getblockheader", "getblockcount", "getbestblockhash",
+        "getaddressdeltas", "getaddressutxos", "getaddressbalance", "getaddresstxids", "getaddressmempool",
+        "getspentinfo", "getblockhashes", "getblockdeltas", "getsnapshot", "validateaddress",
+        "z_validateaddress", "gettransaction", "getmempoolinfo", "getrawmempool", "getinfo",
+        "getblockchaininfo", "getnetworkinfo", "getdifficulty", "notaries", "getnotarisationsforblock",
+    };
+    static const std::set<std::string> setMethods(methods, methods + sizeof(methods) / sizeof(methods[0]));
+    return setMethods.count(strMethod) != 0;
+}
+
+/** State shared by the threads working on one batch request */
+struct JSONRPCBatch
+{
+    JSONRPCBatch(const UniValue& vReq) : vReq(vReq), results(vReq.size()), nextIdx(0), nRunning(0) {}
+
+    const UniValue& vReq; //!< only accessed for claimed indices, all of those finish before JSONRPCExecBatch returns
+    std::vector<UniValue> results;
+    boost::mutex cs;
+    boost::condition_variable cond;
+    size_t nextIdx;
+    int nRunning;
+};
+
+/** Execute unclaimed calls of the batch until none are left. Helpers that start after that return immediately. */
+static void JSONRPCExecBatchWorker(boost::shared_ptr<JSONRPCBatch> batch)
+{
+    while (true) {
+        size_t reqIdx;
+        {
+            boost::unique_lock<boost::mutex> lock(batch->cs);
+            if (batch->nextIdx >= batch->results.size())
+                break;
+            reqIdx = batch->nextIdx++;
+            batch->nRunning++;
+        }
+        UniValue result = JSONRPCExecOne(batch->vReq[reqIdx]);
+        {
+            boost::unique_lock<boost::mutex> lock(batch->cs);
+            batch->results[reqIdx] = result;
+            batch->nRunning--;
+            batch->cond.notify_all();
+        }
+    }
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
     UniValue ret(UniValue::VARR);
-    for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    int nThreads = std::min((int64_t)GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), (int64_t)vReq.size());
+    bool fParallel = workInterface && nThreads > 1;
+    for (size_t reqIdx = 0; fParallel && reqIdx < vReq.size(); reqIdx++) {
+        const UniValue& method = vReq[reqIdx].isObject() ? find_value(vReq[reqIdx].get_obj(), "method") : NullUniValue;
+        if (!method.isStr() || !IsParallelBatchMethod(method.get_str()))
+            fParallel = false;
+    }
+    if (!fParallel) {
+        for (size_t reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+            ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+        return ret.write() + "\n";
+    }
+
+    // The calling worker takes part too, so the batch finishes even if none of the helpers get to run
+    boost::shared_ptr<JSONRPCBatch> batch(new JSONRPCBatch(vReq));
+    for (int i = 1; i < nThreads; i++) {
+        if (!workInterface->QueueWork(boost::bind(&JSONRPCExecBatchWorker, batch)))
+            break;
+    }
+    JSONRPCExecBatchWorker(batch);
+    {
+        boost::unique_lock<boost::mutex> lock(batch->cs);
+        while (batch->nRunning > 0)
+            batch->cond.wait(lock);
+    }
+    for (size_t reqIdx = 0; reqIdx < batch->results.size(); reqIdx++)
+        ret.push_back(batch->results[reqIdx]);
 
     return ret.write() + "\n";
 }
@@ -869,6 +960,38 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, JSONStreamWriter& out) const
+{
+    map<string, const CRPCStreamCommand*>::const_iterator it = mapStreamCommands.find(strMethod);
+    if (it == mapStreamCommands.end())
+        return false;
+
+    // Same checks as execute
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    if (!pcmd)
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        if (!it->second->actor(params, out))
+            return false;
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+    return true;
+}
+
 std::string HelpExampleCli(const std::string& methodname, const std::string& args)
 {
     if ( ASSETCHAINS_SYMBOL[0] == 0 ) {
@@ -903,6 +1026,11 @@ string experimentalDisabledHelpMsg(const string& rpc, const string& enableArg)
         + enableArg + "=1\n";
 }
 
+void RPCSetWorkInterface(RPCWorkInterface *iface)
+{
+    workInterface = iface;
+}
+
 void RPCRegisterTimerInterface(RPCTimerInterface *iface)
 {
     timerInterfaces.push_back(iface);
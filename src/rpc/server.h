@@ -42,6 +42,8 @@
 class AsyncRPCQueue;
 class CRPCCommand;
 
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+
 namespace RPCServer
 {
     void OnStarted(boost::function<void ()> slot);
@@ -130,6 +132,24 @@ void RPCRegisterTimerInterface(RPCTimerInterface *iface);
 /** Unregister factory function for timers */
 void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
 
+/**
+ * RPC work "driver", runs the calls of a batch request on other threads.
+ */
+class RPCWorkInterface
+{
+public:
+    virtual ~RPCWorkInterface() {}
+    /** Implementation name */
+    virtual const char *Name() = 0;
+    /** Queue func to run on another thread.
+     * Returns false if it could not be queued, func will not be called then.
+     */
+    virtual bool QueueWork(const boost::function<void(void)>& func) = 0;
+};
+
+/** Set the interface batch requests are spread with, NULL runs them sequentially */
+void RPCSetWorkInterface(RPCWorkInterface *iface);
+
 /**
  * Run func nSeconds from now.
  * Overrides previous timer <name> (if any).
@@ -147,6 +167,22 @@ public:
     bool okSafeMode;
 };
 
+class JSONStreamWriter;
+
+/**
+ * Writes the result of a command to a stream instead of returning it.
+ * Returns false, without writing, for calls it does not handle; the regular
+ * actor runs then. Errors must be thrown before anything is written.
+ */
+typedef bool(*rpcstreamfn_type)(const UniValue& params, JSONStreamWriter& out);
+
+class CRPCStreamCommand
+{
+public:
+    std::string name;
+    rpcstreamfn_type actor;
+};
+
 /**
  * Bitcoin RPC command dispatcher.
  */
@@ -154,6 +190,7 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, const CRPCStreamCommand*> mapStreamCommands;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -168,6 +205,14 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method, writing its result to out.
+     * @returns false if the method has no stream variant or did not handle
+     * these params, nothing was written then and execute should be used.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    bool executeStream(const std::string &method, const UniValue &params, JSONStreamWriter& out) const;
+
 
     /**
      * Appends a CRPCCommand to the dispatch table.
@@ -175,6 +220,11 @@ public:
      * Commands cannot be overwritten (returns false).
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /**
+     * Appends the stream variant of a command, same rules as appendCommand.
+     */
+    bool appendStreamCommand(const std::string& name, const CRPCStreamCommand* pcmd);
 };
 
 extern CRPCTable tableRPC;
@@ -201,6 +251,8 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 UniValue mempoolInfoToJSON();
 UniValue mempoolToJSON(bool fVerbose = false);
+void blockToJSONStream(JSONStreamWriter& out, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+void mempoolToJSONStream(JSONStreamWriter& out, bool fVerbose = false);
 void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 UniValue TxJoinSplitToJSON(const CTransaction& tx);
@@ -120,15 +120,16 @@ UniValue tokenlist(const UniValue& params, bool fHelp, const CPubKey& remotepk)
 }
 UniValue tokenv2list(const UniValue& params, bool fHelp, const CPubKey& remotepk)
 {
-    const static std::set<std::string> acceptable = { "beginHeight", "endHeight", "pubkey", "address" };
+    const static std::set<std::string> acceptable = { "beginHeight", "endHeight", "pubkey", "address", "skip", "count" };
 
     if (fHelp || params.size() > 1)
         throw runtime_error("tokenv2list [json-params]\n"
                             "json-params optional params as a json object, limiting tokenv2list output:\n"
-                            "  { \"beginHeight\": number \"endHeight\": number, \"pubkey\": hexstring, \"address\": string }\n"
+                            "  { \"beginHeight\": number \"endHeight\": number, \"pubkey\": hexstring, \"address\": string, \"skip\": number, \"count\": number }\n"
                             "  \"beginHeight\", \"endHeight\" - height interval where to search tokenv2create transactions, if beginHeight omitted the first block used, if endHeight omitted the chain tip used"
                             "  \"pubkey\" - search tokens created by a specific pubkey\n"
-                            "  \"address\" - search created on a specific cc address\n");
+                            "  \"address\" - search created on a specific cc address\n"
+                            "  \"skip\", \"count\" - page through the tokens found, ordered by creation height: skip that many tokens and return at most count tokens\n");
 
     if (ensure_CCrequirements(EVAL_TOKENSV2, remotepk.IsValid()) < 0)
         throw runtime_error(CC_REQUIREMENTS_MSG);
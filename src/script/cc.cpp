@@ -231,7 +231,8 @@ struct CC* cc_readConditionBinaryMaybeMixed(const uint8_t *condBin, size_t condB
 
 
 int cc_verifyMaybeMixed(const struct CC *cond, const uint256 sigHash,
-        const uint8_t *condBin, size_t condBinLength, VerifyEval verifyEval, void *evalContext)
+        const uint8_t *condBin, size_t condBinLength, VerifyEval verifyEval, void *evalContext,
+        VerifySigs verifySigs, void *sigContext)
 {
     if (condBinLength == 0) return 0;
     uint8_t condBuf[1000];
@@ -242,7 +243,7 @@ int cc_verifyMaybeMixed(const struct CC *cond, const uint256 sigHash,
         condBin = condBuf;
         cc_free(condMixed);
     }
-    return cc_verify(cond, sigHash.begin(), 32, 0, condBin, condBinLength, verifyEval, evalContext);
+    return cc_verifyWithSigs(cond, sigHash.begin(), 32, 0, condBin, condBinLength, verifyEval, evalContext, verifySigs, sigContext);
 }
 
 CC_SUBVER CC_MixedModeSubVersion(int c) 
@@ -132,6 +132,7 @@ struct CC* cc_readConditionBinaryMaybeMixed(const uint8_t *condBin, size_t condB
  * Perform a mixed mode verification (where the condition binary might have a Mixed Mode fulfillment)
  */
 int cc_verifyMaybeMixed(const struct CC *cond, const uint256 sigHash,
-        const uint8_t *condBin, size_t condBinLength, VerifyEval verifyEval, void *evalContext);
+        const uint8_t *condBin, size_t condBinLength, VerifyEval verifyEval, void *evalContext,
+        VerifySigs verifySigs = NULL, void *sigContext = NULL);
 
 #endif /* SCRIPT_CC_H */
@@ -1390,9 +1390,13 @@ int TransactionSignatureChecker::CheckCryptoCondition(
         return ((TransactionSignatureChecker*)checker)->CheckEvalCondition(cond);
     };
 
+    VerifySigs sigs = [] (const CCSigCheck *checks, size_t n, size_t *failed, void *checker) {
+        return ((TransactionSignatureChecker*)checker)->CheckCCSignatures(checks, n, failed);
+    };
+
     //fprintf(stderr,"%s non-checker path\n", __func__);
     int out = cc_verifyMaybeMixed(
-            cond, sighash, condBin.data(), condBin.size(), eval, (void*)this);
+            cond, sighash, condBin.data(), condBin.size(), eval, (void*)this, sigs, (void*)this);
     //fprintf(stderr,"%s out.%d from cc_verify\n", __func__, (int32_t)out);
     cc_free(cond);
     return out;
@@ -1406,6 +1410,12 @@ int TransactionSignatureChecker::CheckEvalCondition(const CC *cond) const
 }
 
 
+int TransactionSignatureChecker::CheckCCSignatures(const CCSigCheck *checks, size_t n, size_t *failed) const
+{
+    return cc_secp256k1VerifyChecks(checks, n, failed);
+}
+
+
 bool TransactionSignatureChecker::CheckLockTime(const CScriptNum& nLockTime) const
 {
     // There are two times of nLockTime: lock-by-blockheight
@@ -179,6 +179,7 @@ public:
         const CScript& scriptCode,
         uint32_t consensusBranchId) const;
     virtual int CheckEvalCondition(const CC *cond) const;
+    virtual int CheckCCSignatures(const CCSigCheck *checks, size_t n, size_t *failed) const;
 };
 
 class MutableTransactionSignatureChecker : public TransactionSignatureChecker
@@ -107,6 +107,45 @@ bool ServerTransactionSignatureChecker::VerifySignature(const std::vector<unsign
     return true;
 }
 
+/*
+ * Signatures of crypto-conditions are cached apart from the script ones,
+ * which are DER encoded, so both caches are kept to their own kind.
+ * Only the checks missing from the cache are verified.
+ */
+int ServerTransactionSignatureChecker::CheckCCSignatures(const CCSigCheck *checks, size_t n, size_t *failed) const
+{
+    static CSignatureCache ccSignatureCache;
+
+    std::vector<CCSigCheck> vUncached;
+    std::vector<size_t> vIndex;
+    for (size_t i = 0; i < n; i++)
+    {
+        std::vector<unsigned char> vchSig(checks[i].signature, checks[i].signature + 64);
+        CPubKey pubkey(checks[i].publicKey, checks[i].publicKey + CPubKey::COMPRESSED_PUBLIC_KEY_SIZE);
+        if (!ccSignatureCache.Get(uint256(std::vector<unsigned char>(checks[i].msg32, checks[i].msg32 + 32)), vchSig, pubkey))
+        {
+            vUncached.push_back(checks[i]);
+            vIndex.push_back(i);
+        }
+    }
+    if (vUncached.empty())
+        return true;
+
+    size_t nFailed = 0;
+    if (!TransactionSignatureChecker::CheckCCSignatures(vUncached.data(), vUncached.size(), &nFailed))
+    {
+        if (failed) *failed = vIndex[nFailed];
+        return false;
+    }
+
+    if (store)
+        for (const CCSigCheck& check : vUncached)
+            ccSignatureCache.Set(uint256(std::vector<unsigned char>(check.msg32, check.msg32 + 32)),
+                                 std::vector<unsigned char>(check.signature, check.signature + 64),
+                                 CPubKey(check.publicKey, check.publicKey + CPubKey::COMPRESSED_PUBLIC_KEY_SIZE));
+    return true;
+}
+
 /*
  * The reason that these functions are here is that the what used to be the
  * CachingTransactionSignatureChecker, now the ServerTransactionSignatureChecker,
@@ -42,6 +42,7 @@ public:
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
     int CheckEvalCondition(const CC *cond) const;
+    int CheckCCSignatures(const CCSigCheck *checks, size_t n, size_t *failed) const;
     int CheckCryptoConditionSpk(const std::vector<unsigned char> &condBin, ScriptError *serror) const;
 };
 
@@ -0,0 +1,280 @@
+#include <gtest/gtest.h>
+
+#include "cc/CCindex.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "txmempool.h"
+
+#include "testutils.h"
+
+#include <list>
+
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+
+
+namespace TestCCIndex {
+
+    static int32_t nDecoded;
+
+    // every cc output is indexed with its value, grouped by size
+    static bool DecodeTestOutput(const CTransaction &tx, int32_t vout, uint256 &groupid, CAmount &entry)
+    {
+        nDecoded++;
+        if (!tx.vout[vout].scriptPubKey.IsPayToCryptoCondition())
+            return false;
+        groupid = tx.vout[vout].nValue >= 100000 ? uint256S("0x01") : uint256S("0x02");
+        entry = tx.vout[vout].nValue;
+        return true;
+    }
+
+    // registered for good like the contract indexes, so it lives as long as the program
+    static CCUnspentsIndex<CAmount> TestOutputs(DecodeTestOutput);
+
+    // a block given straight to the index, outside the active chain
+    struct CTestBlock
+    {
+        uint256 hash;
+        CBlockIndex index;
+        CTestBlock(int32_t height) : hash(GetRandHash())
+        {
+            index.phashBlock = &hash;
+            index.SetHeight(height);
+        }
+    };
+
+    static std::string CCAddress(const CPubKey &pk)
+    {
+        char coinaddr[64];
+        Getscriptaddress(coinaddr, MakeCC1vout(EVAL_ASSETS, 0, pk).scriptPubKey);
+        return coinaddr;
+    }
+
+    static CPubKey NewPubKey()
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        return key.GetPubKey();
+    }
+
+    // spends a fresh coinbase into vouts, the tx is left in the mempool
+    static CTransaction PayTo(const std::vector<CTxOut> &vouts)
+    {
+        CBlock block;
+        generateBlock(&block);
+        CTransaction coinbase = block.vtx[0];
+        CMutableTransaction mtx = spendTx(coinbase);
+        mtx.vout[0].nValue -= 100000;
+        mtx.vout[0].scriptPubKey = CScript() << ParseHex(notaryPubkey) << OP_CHECKSIG;
+        for (const CTxOut &vout : vouts) {
+            mtx.vout[0].nValue -= vout.nValue;
+            mtx.vout.push_back(vout);
+        }
+        mtx.vin[0].scriptSig << getSig(mtx, coinbase.vout[0].scriptPubKey);
+        CValidationState state;
+        EXPECT_TRUE(acceptTx(mtx, state)) << state.GetRejectReason();
+        return CTransaction(mtx);
+    }
+
+    static CCUnspentsIndex<CAmount>::vecEntries GetOutputs(const std::string &coinaddr, const uint256 &groupid = uint256())
+    {
+        CCUnspentsIndex<CAmount>::vecEntries outputs;
+        TestOutputs.Get(coinaddr.c_str(), groupid, outputs);
+        return outputs;
+    }
+
+    class TestCCIndex : public ::testing::Test {
+    public:
+        static void SetUpTestCase()
+        {
+            ASSETCHAINS_CC = 1;
+            mapArgs["-addressindex"] = "1";
+            mapArgs["-spentindex"] = "1";
+            setupChain();
+        }
+        static void TearDownTestCase()
+        {
+            // drops every address, the blocks of the suites after are not followed
+            CTestBlock first(0);
+            {
+                LOCK(cs_main);
+                TestOutputs.DisconnectBlock(&first.index, CBlock());
+            }
+            mapArgs.erase("-addressindex");
+            mapArgs.erase("-spentindex");
+            fAddressIndex = fSpentIndex = false;
+            ASSETCHAINS_CC = 0;
+        }
+    };
+
+    TEST_F(TestCCIndex, connect_spend_disconnect)
+    {
+        CPubKey pk = NewPubKey();
+        std::string coinaddr = CCAddress(pk);
+        CTransaction tx = PayTo({ MakeCC1vout(EVAL_ASSETS, 200000, pk), MakeCC1vout(EVAL_ASSETS, 20000, pk) });
+        generateBlock();
+
+        // loaded from the address index on first use
+        EXPECT_EQ(2, GetOutputs(coinaddr).size());
+        ASSERT_EQ(1, GetOutputs(coinaddr, uint256S("0x01")).size());
+        EXPECT_EQ(COutPoint(tx.GetHash(), 1), GetOutputs(coinaddr, uint256S("0x01"))[0].first);
+        EXPECT_EQ(200000, GetOutputs(coinaddr, uint256S("0x01"))[0].second);
+
+        // then followed as blocks connect, only the new output is decoded
+        CTransaction tx2 = PayTo({ MakeCC1vout(EVAL_ASSETS, 30000, pk) });
+        int32_t decoded = nDecoded;
+        generateBlock();
+        EXPECT_EQ(3, GetOutputs(coinaddr).size());
+        EXPECT_EQ(decoded + 1, nDecoded);
+
+        // a block spending two of them, with an output spent again in the same block
+        CMutableTransaction mtxSpend;
+        mtxSpend.vin.push_back(CTxIn(tx.GetHash(), 1));
+        mtxSpend.vin.push_back(CTxIn(tx2.GetHash(), 1));
+        mtxSpend.vout.push_back(MakeCC1vout(EVAL_ASSETS, 40000, pk));
+        CMutableTransaction mtxSpend2;
+        mtxSpend2.vin.push_back(CTxIn(mtxSpend.GetHash(), 0));
+        mtxSpend2.vout.push_back(MakeCC1vout(EVAL_ASSETS, 40000, NewPubKey()));
+        CBlock block;
+        block.vtx.push_back(mtxSpend);
+        block.vtx.push_back(mtxSpend2);
+        CTestBlock spendBlock(chainActive.Height() + 1);
+        {
+            LOCK(cs_main);
+            TestOutputs.ConnectBlock(&spendBlock.index, block);
+        }
+        CCUnspentsIndex<CAmount>::vecEntries outputs = GetOutputs(coinaddr);
+        ASSERT_EQ(1, outputs.size());
+        EXPECT_EQ(COutPoint(tx.GetHash(), 2), outputs[0].first);
+
+        // disconnecting it brings the spent outputs back from the undo, without a reload
+        decoded = nDecoded;
+        {
+            LOCK(cs_main);
+            TestOutputs.DisconnectBlock(&spendBlock.index, block);
+        }
+        outputs = GetOutputs(coinaddr);
+        ASSERT_EQ(3, outputs.size());
+        EXPECT_EQ(decoded, nDecoded);
+        for (const auto &output : outputs)
+            EXPECT_NE(mtxSpend.GetHash(), output.first.hash);
+    }
+
+    TEST_F(TestCCIndex, disconnect_past_undodepth)
+    {
+        CPubKey pk = NewPubKey();
+        std::string coinaddr = CCAddress(pk);
+        PayTo({ MakeCC1vout(EVAL_ASSETS, 20000, pk) });
+        generateBlock();
+        EXPECT_EQ(1, GetOutputs(coinaddr).size());
+
+        std::list<CTestBlock> blocks;
+        int32_t height = chainActive.Height();
+        LOCK(cs_main);
+        for (int32_t i = 0; i <= CC_INDEX_UNDODEPTH; i++) {
+            blocks.emplace_back(height + 1 + i);
+            TestOutputs.ConnectBlock(&blocks.back().index, CBlock());
+        }
+
+        // the last CC_INDEX_UNDODEPTH blocks are undone in place
+        int32_t decoded = nDecoded;
+        TestOutputs.DisconnectBlock(&blocks.back().index, CBlock());
+        EXPECT_EQ(1, GetOutputs(coinaddr).size());
+        EXPECT_EQ(decoded, nDecoded);
+
+        // the first has no undo anymore, everything is dropped and loaded again when queried
+        TestOutputs.DisconnectBlock(&blocks.front().index, CBlock());
+        EXPECT_EQ(1, GetOutputs(coinaddr).size());
+        EXPECT_EQ(decoded + 1, nDecoded);
+    }
+
+    TEST_F(TestCCIndex, disconnect_loaded_at_tip)
+    {
+        CPubKey pk = NewPubKey();
+        std::string coinaddr = CCAddress(pk);
+        PayTo({ MakeCC1vout(EVAL_ASSETS, 20000, pk) });
+        generateBlock();
+        PayTo({ MakeCC1vout(EVAL_ASSETS, 30000, pk) });
+        CBlock block;
+        generateBlock(&block);
+
+        // loaded with the block at the tip, so there is no undo of it for this address
+        EXPECT_EQ(2, GetOutputs(coinaddr).size());
+        int32_t decoded = nDecoded;
+        {
+            LOCK(cs_main);
+            TestOutputs.DisconnectBlock(chainActive.Tip(), block);
+        }
+        // dropped: queried again it is reloaded, here from the unchanged address index
+        EXPECT_EQ(2, GetOutputs(coinaddr).size());
+        EXPECT_EQ(decoded + 2, nDecoded);
+    }
+
+    TEST_F(TestCCIndex, lru_eviction)
+    {
+        std::vector<CPubKey> pks;
+        std::vector<CTxOut> vouts;
+        for (int32_t i = 0; i <= CC_INDEX_MAXADDRESSES; i++) {
+            pks.push_back(NewPubKey());
+            vouts.push_back(MakeCC1vout(EVAL_ASSETS, 10000, pks.back()));
+        }
+        PayTo(vouts);
+        generateBlock();
+
+        // fills the index, any address loaded before is evicted
+        for (int32_t i = 0; i < CC_INDEX_MAXADDRESSES; i++)
+            ASSERT_EQ(1, GetOutputs(CCAddress(pks[i])).size());
+        int32_t decoded = nDecoded;
+        EXPECT_EQ(1, GetOutputs(CCAddress(pks[0])).size());
+        EXPECT_EQ(decoded, nDecoded);
+
+        // one more evicts the one queried longest ago, now pks[1]
+        EXPECT_EQ(1, GetOutputs(CCAddress(pks[CC_INDEX_MAXADDRESSES])).size());
+        EXPECT_EQ(decoded + 1, nDecoded);
+        EXPECT_EQ(1, GetOutputs(CCAddress(pks[0])).size());
+        EXPECT_EQ(decoded + 1, nDecoded);
+        EXPECT_EQ(1, GetOutputs(CCAddress(pks[1])).size());
+        EXPECT_EQ(decoded + 2, nDecoded);
+    }
+
+    TEST_F(TestCCIndex, get_with_mempool)
+    {
+        CPubKey pk = NewPubKey();
+        std::string coinaddr = CCAddress(pk);
+        CTransaction tx = PayTo({ MakeCC1vout(EVAL_ASSETS, 200000, pk), MakeCC1vout(EVAL_ASSETS, 20000, pk) });
+        generateBlock();
+        CTransaction txMempool = PayTo({ MakeCC1vout(EVAL_ASSETS, 30000, pk) });
+
+        // the contract would refuse the spend, it is put in the pool as is
+        CMutableTransaction mtxSpend;
+        mtxSpend.vin.push_back(CTxIn(tx.GetHash(), 1));
+        mtxSpend.vout.push_back(CTxOut(190000, CScript() << ParseHex(notaryPubkey) << OP_CHECKSIG));
+        CTransaction txSpend(mtxSpend);
+        {
+            LOCK2(cs_main, mempool.cs);
+            CCoinsViewCache view(pcoinsTip);
+            CTxMemPoolEntry entry(txSpend, 10000, GetTime(), 0, chainActive.Height(), true, false, 0);
+            mempool.addUnchecked(txSpend.GetHash(), entry);
+            mempool.addSpentIndex(entry, view);
+        }
+
+        // the confirmed outputs only
+        EXPECT_EQ(2, GetOutputs(coinaddr).size());
+
+        CCUnspentsIndex<CAmount>::vecEntries outputs;
+        TestOutputs.GetWithMempool(coinaddr.c_str(), uint256(), outputs);
+        ASSERT_EQ(2, outputs.size());
+        EXPECT_EQ(COutPoint(tx.GetHash(), 2), outputs[0].first);
+        EXPECT_EQ(COutPoint(txMempool.GetHash(), 1), outputs[1].first);
+        EXPECT_EQ(30000, outputs[1].second);
+
+        outputs.clear();
+        TestOutputs.GetWithMempool(coinaddr.c_str(), uint256S("0x01"), outputs);
+        EXPECT_EQ(0, outputs.size());
+
+        std::list<CTransaction> removed;
+        mempool.remove(txSpend, removed, true);
+        mempool.remove(txMempool, removed, true);
+    }
+
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "cc/CCinclude.h"
+#include "primitives/transaction.h"
+
+#include "testutils.h"
+
+
+namespace TestCCUtils {
+
+    static CTransaction CCTx(const vscript_t &vccdata)
+    {
+        CMutableTransaction mtx;
+        mtx.vin.push_back(CTxIn(uint256S("0x01"), 0));
+        mtx.vout.push_back(MakeCC1vout(EVAL_ASSETS, 10000, notaryKey.GetPubKey()));
+        mtx.vout.push_back(CTxOut(5000, CScript() << ParseHex(notaryPubkey) << OP_CHECKSIG));
+        if (!vccdata.empty())
+            mtx.vout.push_back(CTxOut(0, CScript() << OP_RETURN << vccdata));
+        return CTransaction(mtx);
+    }
+
+    TEST(TestCCUtils, decode_txvout)
+    {
+        uint8_t evalcode = 1, funcid = 1, version = 1;
+        uint256 creationId = uint256S("0x02");
+
+        // creation tx, no cc vins
+        CTransaction tx = CCTx({ EVAL_ASSETS, 'c', 1 });
+        ASSERT_TRUE(CCDecodeTxVout(tx, 0, evalcode, funcid, version, creationId));
+        EXPECT_EQ(evalcode, EVAL_ASSETS);
+        EXPECT_EQ(funcid, 'c');
+        EXPECT_EQ(version, 1);
+        EXPECT_EQ(creationId, tx.GetHash());
+        EXPECT_FALSE(CCDecodeTxVout(tx, tx.vout.size(), evalcode, funcid, version, creationId));
+    }
+
+    TEST(TestCCUtils, decode_txvout_no_ccdata)
+    {
+        uint8_t evalcode = 1, funcid = 1, version = 1;
+        uint256 creationId = uint256S("0x02");
+
+        EXPECT_FALSE(CCDecodeTxVout(CCTx(vscript_t()), 0, evalcode, funcid, version, creationId));
+        EXPECT_EQ(evalcode, 0);
+        EXPECT_EQ(funcid, 0);
+        EXPECT_EQ(version, 0);
+        EXPECT_TRUE(creationId.IsNull());
+        EXPECT_FALSE(CCDecodeTxVout(CCTx({ EVAL_ASSETS, 'c' }), 0, evalcode, funcid, version, creationId));
+    }
+
+    TEST(TestCCUtils, decode_txvout_unknown_evalcode)
+    {
+        // no contract registers these, CCinit falls back to the cclib init
+        // which may refuse them: either way the outputs must be defined
+        for (uint8_t code : { 0x00, 0x0f, 0xff }) {
+            uint8_t evalcode = 1, funcid = 1, version = 1;
+            uint256 creationId = uint256S("0x02");
+            CTransaction tx = CCTx({ code, 'c', 1 });
+            if (CCDecodeTxVout(tx, 0, evalcode, funcid, version, creationId)) {
+                EXPECT_EQ(evalcode, code);
+                EXPECT_EQ(funcid, 'c');
+                EXPECT_EQ(creationId, tx.GetHash());
+            } else {
+                EXPECT_EQ(evalcode, 0);
+                EXPECT_TRUE(creationId.IsNull());
+            }
+        }
+    }
+
+}
@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include "cc/CCinclude.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "wallet/wallet.h"
+
+#include "testutils.h"
+
+
+namespace TestCoinsByValue {
+
+    class TestCoinsWallet : public CWallet
+    {
+    public:
+        using CWallet::UpdateCoinsByValue;
+    };
+
+    // as a transaction relayed or mined while the node runs
+    static void AddTx(TestCoinsWallet& wallet, const CWalletTx& wtx)
+    {
+        wallet.AddToWallet(wtx, true, NULL);
+        LOCK(cs_main);
+        wallet.UpdateCoinsByValue(wallet.mapWallet[wtx.GetHash()]);
+    }
+
+    TEST(TestCoinsByValue, index)
+    {
+        TestCoinsWallet wallet;
+        CKey key;
+        key.MakeNewKey(true);
+        wallet.AddKeyPubKey(key, key.GetPubKey());
+        CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+        CBlockIndex* pindexOld = chainActive.Tip();
+
+        CMutableTransaction mtx;
+        mtx.vout.push_back(CTxOut(3 * COIN, scriptPubKey));
+        mtx.vout.push_back(CTxOut(1 * COIN, scriptPubKey));
+        mtx.vout.push_back(CTxOut(2 * COIN, CScript() << OP_TRUE));
+        CWalletTx wtx {&wallet, mtx};
+        AddTx(wallet, wtx);
+
+        // Only the outputs paying to us are indexed, smallest first
+        {
+            LOCK(wallet.cs_wallet);
+            const CoinsByValue& coins = wallet.GetCoinsByValue();
+            ASSERT_EQ(2, coins.size());
+            EXPECT_EQ(std::make_pair(1 * COIN, COutPoint(wtx.GetHash(), 1)), *coins.begin());
+            EXPECT_EQ(std::make_pair(3 * COIN, COutPoint(wtx.GetHash(), 0)), *coins.rbegin());
+        }
+
+        // A pending spend keeps the output indexed, it leaves once the spend is in a block
+        CMutableTransaction mtxSpend;
+        mtxSpend.vin.push_back(CTxIn(COutPoint(wtx.GetHash(), 0)));
+        mtxSpend.vout.push_back(CTxOut(3 * COIN, CScript() << OP_TRUE));
+        CWalletTx wtxSpend {&wallet, mtxSpend};
+        AddTx(wallet, wtxSpend);
+        {
+            LOCK(wallet.cs_wallet);
+            EXPECT_EQ(2, wallet.GetCoinsByValue().size());
+        }
+
+        CBlock block;
+        block.vtx.push_back(wtxSpend);
+        block.hashMerkleRoot = block.BuildMerkleTree();
+        auto blockHash = block.GetHash();
+        CBlockIndex index(block);
+        index.SetHeight(1);
+        mapBlockIndex.insert(std::make_pair(blockHash, &index));
+        chainActive.SetTip(&index);
+        wtxSpend.SetMerkleBranch(block);
+        AddTx(wallet, wtxSpend);
+        {
+            LOCK(wallet.cs_wallet);
+            ASSERT_EQ(1, wallet.GetCoinsByValue().size());
+            EXPECT_EQ(COutPoint(wtx.GetHash(), 1), wallet.GetCoinsByValue().begin()->second);
+        }
+
+        // Disconnecting the block puts the output back
+        SproutMerkleTree sproutTree;
+        SaplingMerkleTree saplingTree;
+        {
+            LOCK(cs_main);
+            wallet.ChainTip(&index, &block, sproutTree, saplingTree, true);
+            wallet.ChainTip(&index, &block, sproutTree, saplingTree, true);
+            chainActive.SetTip(NULL);
+            wallet.ChainTip(&index, &block, sproutTree, saplingTree, false);
+        }
+        {
+            LOCK(wallet.cs_wallet);
+            EXPECT_EQ(2, wallet.GetCoinsByValue().size());
+        }
+
+        // After a reorg the funding transaction is mined again but the spend is not.
+        // The spend still claims its old block, which must not hide the output.
+        CBlock block2;
+        block2.vtx.push_back(wtx);
+        block2.hashMerkleRoot = block2.BuildMerkleTree();
+        auto blockHash2 = block2.GetHash();
+        CBlockIndex index2(block2);
+        index2.SetHeight(0);
+        mapBlockIndex.insert(std::make_pair(blockHash2, &index2));
+        chainActive.SetTip(&index2);
+        wtx.SetMerkleBranch(block2);
+        AddTx(wallet, wtx);
+        {
+            LOCK(wallet.cs_wallet);
+            EXPECT_EQ(2, wallet.GetCoinsByValue().size());
+        }
+
+        // The same after the index is rebuilt, as LoadWallet does
+        wallet.RebuildCoinsByValue();
+        {
+            LOCK(wallet.cs_wallet);
+            EXPECT_EQ(2, wallet.GetCoinsByValue().size());
+        }
+
+        // Tear down
+        chainActive.SetTip(pindexOld);
+        mapBlockIndex.erase(blockHash);
+        mapBlockIndex.erase(blockHash2);
+    }
+
+    TEST(TestCoinsByValue, normalinputs_maxinputs)
+    {
+        setupChain();
+        CBlock block;
+        generateBlock(&block);
+        CTransaction coinbase = block.vtx[0];
+
+        // 5000 and 6000 sat below the total, 1 COIN above it
+        CScript scriptMine = GetScriptForDestination(notaryKey.GetPubKey().GetID());
+        CKey other;
+        other.MakeNewKey(true);
+        CMutableTransaction mtx = spendTx(coinbase);
+        mtx.vout[0].nValue -= 5000 + 6000 + COIN;
+        mtx.vout[0].scriptPubKey = GetScriptForDestination(other.GetPubKey().GetID());
+        mtx.vout.push_back(CTxOut(5000, scriptMine));
+        mtx.vout.push_back(CTxOut(6000, scriptMine));
+        mtx.vout.push_back(CTxOut(COIN, scriptMine));
+        mtx.vin[0].scriptSig << getSig(mtx, coinbase.vout[0].scriptPubKey);
+        acceptTxFail(mtx);
+        CTransaction tx(mtx);
+
+        TestCoinsWallet wallet;
+        wallet.AddKeyPubKey(notaryKey, notaryKey.GetPubKey());
+        CWalletTx wtx {&wallet, tx};
+        wallet.AddToWallet(wtx, true, NULL);
+        wallet.RebuildCoinsByValue();
+        CWallet* pwalletOld = pwalletMain;
+        pwalletMain = &wallet;
+
+        // one input: the small coins cannot reach the total, the large one alone does
+        CMutableTransaction mtxSpend;
+        EXPECT_EQ(COIN, AddNormalinputsLocal(mtxSpend, notaryKey.GetPubKey(), 10000, 1));
+        ASSERT_EQ(1, mtxSpend.vin.size());
+        EXPECT_EQ(COutPoint(tx.GetHash(), 3), mtxSpend.vin[0].prevout);
+
+        // two inputs: the small coins add up
+        mtxSpend = CMutableTransaction();
+        EXPECT_EQ(11000, AddNormalinputsLocal(mtxSpend, notaryKey.GetPubKey(), 10000, 2));
+        EXPECT_EQ(2, mtxSpend.vin.size());
+
+        // not enough in the wallet: nothing is added
+        mtxSpend = CMutableTransaction();
+        EXPECT_EQ(0, AddNormalinputsLocal(mtxSpend, notaryKey.GetPubKey(), 2 * COIN, 3));
+        EXPECT_EQ(0, mtxSpend.vin.size());
+
+        pwalletMain = pwalletOld;
+    }
+
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cryptoconditions.h>
 #include <gtest/gtest.h>
 
@@ -6,8 +7,10 @@
 #include "script/cc.h"
 #include "cc/eval.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "script/interpreter.h"
 #include "script/serverchecker.h"
+#include "utilstrencodings.h"
 
 #include "testutils.h"
 
@@ -198,3 +201,289 @@ TEST_F(CCTest, testLargeCondition)
     EXPECT_EQ(1744, CCSig(cond).size());
     ASSERT_TRUE(CCVerify(mtxTo, cond));
 }
+
+
+static CC* RandomCondition(int depth)
+{
+    switch (insecure_rand() % (depth > 0 ? 5 : 4)) {
+        case 0: return CCNewSecp256k1(notaryKey.GetPubKey());
+        case 1: return CCNewSecp256k1Hash(notaryKey.GetPubKey().GetID());
+        case 2: return CCNewEval(std::vector<unsigned char>(1 + insecure_rand() % 40, insecure_rand() & 0xff));
+        case 3: return CCNewPreimage(std::vector<unsigned char>(insecure_rand() % 40, insecure_rand() & 0xff));
+    }
+    std::vector<CC*> v;
+    int n = 1 + insecure_rand() % 5;
+    for (int i = 0; i < n; i++)
+        v.push_back(RandomCondition(depth - 1));
+    return CCNewThreshold(1 + insecure_rand() % n, v);
+}
+
+
+static std::string DescribeCC(CC *cond, bool fMixed)
+{
+    if (!cond) return "NULL";
+    unsigned char buf[10000];
+    size_t len = cc_conditionBinary(cond, buf);
+    std::string s(buf, buf + len);
+    len = fMixed ? cc_fulfillmentBinaryMixedMode(cond, buf, sizeof(buf)) : cc_fulfillmentBinary(cond, buf, sizeof(buf));
+    s += "|" + std::string(buf, buf + len) + "|" + std::to_string(cc_typeMask(cond));
+    cc_free(cond);
+    return s;
+}
+
+
+/*
+ * The single pass decoder must accept exactly what the asn1c one accepts and build
+ * the same tree. Mutated inputs can carry fixed size fields shorter than the schema,
+ * asn1c copies whatever follows them so only acceptance is compared for those.
+ */
+TEST_F(CCTest, testReadFulfillmentMatchesAsn1)
+{
+    for (int i = 0; i < 2000; i++) {
+        CC *cond = RandomCondition(3);
+        uint256 msg = GetRandHash();
+        cc_signTreeSecp256k1Msg32(cond, notaryKey.begin(), msg.begin());
+        bool fMixed = i % 2;
+        unsigned char buf[10000];
+        size_t len = fMixed ? cc_fulfillmentBinaryMixedMode(cond, buf, sizeof(buf)) : cc_fulfillmentBinary(cond, buf, sizeof(buf));
+        cc_free(cond);
+        if (len == 0)
+            continue;
+        std::vector<unsigned char> ffill(buf, buf + len);
+        CC *a = cc_readFulfillmentBinaryAsn1(ffill.data(), ffill.size(), fMixed);
+        CC *b = fMixed ? cc_readFulfillmentBinaryMixedMode(ffill.data(), ffill.size()) : cc_readFulfillmentBinary(ffill.data(), ffill.size());
+        ASSERT_EQ(DescribeCC(a, fMixed), DescribeCC(b, fMixed));
+
+        for (int j = 0; j < 20; j++) {
+            std::vector<unsigned char> m = ffill;
+            size_t pos = insecure_rand() % m.size();
+            switch (insecure_rand() % 4) {
+                case 0: m[pos] ^= 1 << (insecure_rand() % 8); break;
+                case 1: m.insert(m.begin() + pos, insecure_rand() & 0xff); break;
+                case 2: m.erase(m.begin() + pos); break;
+                case 3: m.resize(pos); break;
+            }
+            a = cc_readFulfillmentBinaryAsn1(m.data(), m.size(), fMixed);
+            b = fMixed ? cc_readFulfillmentBinaryMixedMode(m.data(), m.size()) : cc_readFulfillmentBinary(m.data(), m.size());
+            ASSERT_EQ(a == NULL, b == NULL) << HexStr(m);
+            if (a) cc_free(a);
+            if (b) cc_free(b);
+        }
+    }
+}
+
+
+static std::vector<unsigned char> DerTLV(unsigned char tag, const std::vector<unsigned char> &content)
+{
+    std::vector<unsigned char> out(1, tag), len;
+    if (content.size() < 0x80)
+        out.push_back(content.size());
+    else {
+        for (size_t n = content.size(); n > 0; n >>= 8)
+            len.insert(len.begin(), n & 0xff);
+        out.push_back(0x80 | len.size());
+        out.insert(out.end(), len.begin(), len.end());
+    }
+    out.insert(out.end(), content.begin(), content.end());
+    return out;
+}
+
+
+static std::vector<unsigned char> DerSetOf(std::vector<std::vector<unsigned char>> elements)
+{
+    std::vector<unsigned char> out;
+    std::sort(elements.begin(), elements.end());
+    for (auto &e : elements)
+        out.insert(out.end(), e.begin(), e.end());
+    return out;
+}
+
+
+static std::vector<unsigned char> DerPreimage(unsigned char b)
+{
+    return DerTLV(0xa0, DerTLV(0x80, std::vector<unsigned char>(1, b)));
+}
+
+
+static std::vector<unsigned char> DerCondition(unsigned char b)
+{
+    std::vector<unsigned char> content = DerTLV(0x80, std::vector<unsigned char>(32, b)), cost = DerTLV(0x81, {1});
+    content.insert(content.end(), cost.begin(), cost.end());
+    return DerTLV(0xa0, content);
+}
+
+
+static std::vector<unsigned char> DerThreshold(const std::vector<std::vector<unsigned char>> &ffills,
+                                               const std::vector<std::vector<unsigned char>> &conds)
+{
+    std::vector<unsigned char> content = DerTLV(0xa0, DerSetOf(ffills)), c = DerTLV(0xa1, DerSetOf(conds));
+    content.insert(content.end(), c.begin(), c.end());
+    return DerTLV(0xa2, content);
+}
+
+
+/*
+ * Wraps a fulfillment in prefixes ('P') and single child thresholds ('T'),
+ * listed from the outside in
+ */
+static std::vector<unsigned char> DerNested(const std::string &shape, std::vector<unsigned char> ffill)
+{
+    for (int i = shape.size() - 1; i >= 0; i--) {
+        if (shape[i] == 'T') {
+            ffill = DerThreshold({ffill}, {});
+        } else {
+            std::vector<unsigned char> content = DerTLV(0x80, {}), mml = DerTLV(0x81, {0}), sub = DerTLV(0xa2, ffill);
+            content.insert(content.end(), mml.begin(), mml.end());
+            content.insert(content.end(), sub.begin(), sub.end());
+            ffill = DerTLV(0xa1, content);
+        }
+    }
+    return ffill;
+}
+
+
+/*
+ * Decodes with the single pass decoder, and if asked with asn1c as well expecting
+ * the same tree
+ */
+static bool ReadFulfillment(const std::vector<unsigned char> &ffill, bool fMixed, bool fCompare=true)
+{
+    CC *b = fMixed ? cc_readFulfillmentBinaryMixedMode(ffill.data(), ffill.size()) : cc_readFulfillmentBinary(ffill.data(), ffill.size());
+    bool fAccepted = b != NULL;
+    if (fCompare) {
+        CC *a = cc_readFulfillmentBinaryAsn1(ffill.data(), ffill.size(), fMixed);
+        EXPECT_EQ(DescribeCC(a, fMixed), DescribeCC(b, fMixed)) << HexStr(ffill);
+    } else if (b)
+        cc_free(b);
+    return fAccepted;
+}
+
+
+/*
+ * asn1c stops decoding once ber_decode has used 30000 bytes of stack. In a -O2
+ * build a prefix takes 304 bytes of it, a threshold 416 and the innermost
+ * fulfillment 624, and the single pass decoder counts the same. Other builds
+ * give up anywhere from 32 to 76 thresholds deep, there asn1c is only compared
+ * well inside the limit. Re-encoding in the asn1c path doubles with every
+ * prefix, so it is never given more than a few.
+ */
+TEST_F(CCTest, testReadFulfillmentNesting)
+{
+    std::vector<unsigned char> leaf = DerPreimage(1), condition = DerCondition(7);
+    std::vector<unsigned char> t70 = DerNested(std::string(70, 'T'), leaf), t71 = DerNested(std::string(71, 'T'), leaf);
+    CC *a70 = cc_readFulfillmentBinaryAsn1(t70.data(), t70.size(), 0), *a71 = cc_readFulfillmentBinaryAsn1(t71.data(), t71.size(), 0);
+    bool fExact = a70 && !a71;
+    if (a70) cc_free(a70);
+    if (a71) cc_free(a71);
+
+    EXPECT_TRUE(ReadFulfillment(DerNested(std::string(20, 'T'), leaf), false));
+    EXPECT_TRUE(ReadFulfillment(DerNested("PPPTTTTTTTTTTPPP", leaf), false));
+    EXPECT_TRUE(ReadFulfillment(DerNested(std::string(70, 'T'), leaf), false, fExact));
+    EXPECT_FALSE(ReadFulfillment(DerNested(std::string(71, 'T'), leaf), false, fExact));
+    EXPECT_TRUE(ReadFulfillment(DerNested(std::string(70, 'T'), DerThreshold({}, {})), false, fExact));
+    EXPECT_FALSE(ReadFulfillment(DerNested(std::string(71, 'T'), DerThreshold({}, {})), false, fExact));
+    EXPECT_TRUE(ReadFulfillment(DerNested(std::string(69, 'T'), DerThreshold({}, {condition})), false, fExact));
+    EXPECT_FALSE(ReadFulfillment(DerNested(std::string(70, 'T'), DerThreshold({}, {condition})), false, fExact));
+    EXPECT_TRUE(ReadFulfillment(DerNested(std::string(96, 'P'), leaf), false, false));
+    EXPECT_FALSE(ReadFulfillment(DerNested(std::string(97, 'P'), leaf), false, false));
+
+    for (int p = 0; p <= 6; p++) {
+        int t = (30000 - 624 - 304 * p) / 416;
+        EXPECT_TRUE(ReadFulfillment(DerNested(std::string(p, 'P') + std::string(t, 'T'), leaf), false, fExact)) << p;
+        EXPECT_FALSE(ReadFulfillment(DerNested(std::string(p, 'P') + std::string(t + 1, 'T'), leaf), false, fExact)) << p;
+        EXPECT_TRUE(ReadFulfillment(DerNested(std::string(t, 'T') + std::string(p, 'P'), leaf), false, fExact)) << p;
+        EXPECT_FALSE(ReadFulfillment(DerNested(std::string(t + 1, 'T') + std::string(p, 'P'), leaf), false, fExact)) << p;
+    }
+
+    // the deepest branch counts, here the prefixed threshold beside the chain
+    std::vector<unsigned char> ffill = leaf;
+    for (int i = 0; i < 70; i++) {
+        ffill = DerThreshold({ffill, DerPreimage(2 + i % 3), DerPreimage(5), DerNested("PT", leaf)}, {condition});
+        EXPECT_EQ(i < 68, ReadFulfillment(ffill, false, fExact || i < 15)) << i;
+    }
+}
+
+
+/*
+ * Wide thresholds. Past 255 children the size wraps in mixed mode. A threshold
+ * above the wrapped size, or more children than fit the fingerprint buffer, has
+ * no usable fingerprint so those are left out.
+ */
+TEST_F(CCTest, testReadFulfillmentWideThresholds)
+{
+    std::vector<std::vector<unsigned char>> ffills, conds;
+    for (int i = 0; i < 300; i++)
+        ffills.push_back(DerTLV(0xa0, DerTLV(0x80, {(unsigned char)(i >> 8), (unsigned char)i})));
+    for (int i = 0; i < 30; i++)
+        conds.push_back(DerCondition(i));
+
+    std::vector<std::vector<unsigned char>> some(ffills.begin(), ffills.begin() + 60);
+    EXPECT_TRUE(ReadFulfillment(DerThreshold(some, {}), false));
+    EXPECT_TRUE(ReadFulfillment(DerThreshold(some, conds), false));
+    EXPECT_FALSE(ReadFulfillment(DerThreshold(ffills, {}), true));
+    ffills.push_back(DerPreimage(5));
+    EXPECT_TRUE(ReadFulfillment(DerThreshold(ffills, {}), true));
+    EXPECT_TRUE(ReadFulfillment(DerThreshold(ffills, std::vector<std::vector<unsigned char>>(conds.begin(), conds.begin() + 20)), true));
+
+    std::vector<std::vector<unsigned char>> outer, outerMixed;
+    for (int i = 0; i < 30; i++) {
+        std::vector<std::vector<unsigned char>> inner(ffills.begin() + i * 9, ffills.begin() + i * 9 + 30);
+        outer.push_back(DerThreshold(inner, {conds[i]}));
+        inner.push_back(DerPreimage(1 + i));
+        outerMixed.push_back(DerThreshold(inner, {conds[i]}));
+    }
+    EXPECT_TRUE(ReadFulfillment(DerThreshold(outer, {}), false));
+    outerMixed.push_back(DerPreimage(20));
+    EXPECT_TRUE(ReadFulfillment(DerThreshold(outerMixed, {}), true));
+}
+
+
+TEST_F(CCTest, testCCSignatureChecks)
+{
+    std::vector<CKey> keys(18);
+    std::vector<CC*> ccs;
+    for (CKey &key : keys) {
+        key.MakeNewKey(true);
+        ccs.push_back(CCNewSecp256k1(key.GetPubKey()));
+    }
+    CC *cond = CCNewThreshold(16, ccs);
+
+    CMutableTransaction mtxTo;
+    mtxTo.vin.resize(1);
+    PrecomputedTransactionData txdata(mtxTo);
+    uint256 sighash = SignatureHash(CCPubKey(cond), mtxTo, 0, SIGHASH_ALL, 0, 0, &txdata);
+    for (CKey &key : keys)
+        ASSERT_EQ(1, cc_signTreeSecp256k1Msg32(cond, key.begin(), sighash.begin()));
+    mtxTo.vin[0].scriptSig = CCSig(cond);
+    ASSERT_TRUE(CCVerify(mtxTo, cond));
+
+    CCSigCheck *checks;
+    size_t n, failed = 0;
+    ASSERT_TRUE(cc_secp256k1CollectChecks(cond, sighash.begin(), &checks, &n));
+    ASSERT_EQ(18, n);
+    ASSERT_TRUE(cc_secp256k1VerifyChecks(checks, n, &failed));
+    free(checks);
+
+    // a bad signature is reported by its place in the tree
+    cond->subconditions[11]->signature[5] ^= 1;
+    ASSERT_TRUE(cc_secp256k1CollectChecks(cond, sighash.begin(), &checks, &n));
+    ASSERT_FALSE(cc_secp256k1VerifyChecks(checks, n, &failed));
+    ASSERT_EQ(11, failed);
+    free(checks);
+    cond->subconditions[11]->signature[5] ^= 1;
+
+    // verified with the store flag the signatures are cached, the one bad check
+    // left to verify is still reported by its place in the tree
+    CTransaction txTo(mtxTo);
+    PrecomputedTransactionData txdataTo(txTo);
+    ScriptError error;
+    auto checker = ServerTransactionSignatureChecker(&txTo, 0, 0, true, 0, 1, NULL, txdataTo);
+    ASSERT_TRUE(VerifyScript(CCSig(cond), CCPubKey(cond), 0, checker, 0, &error));
+    ASSERT_TRUE(VerifyScript(CCSig(cond), CCPubKey(cond), 0, checker, 0, &error));
+    ASSERT_TRUE(cc_secp256k1CollectChecks(cond, sighash.begin(), &checks, &n));
+    cond->subconditions[11]->signature[5] ^= 1;
+    ASSERT_FALSE(checker.CheckCCSignatures(checks, n, &failed));
+    ASSERT_EQ(11, failed);
+    free(checks);
+    cc_free(cond);
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "rpc/jsonstream.h"
+#include "rpc/protocol.h"
+
+#include <boost/bind.hpp>
+#include <stdexcept>
+
+namespace TestJSONStream {
+
+    static void AppendChunk(std::string* pstr, std::vector<size_t>* psizes, const std::string& strChunk)
+    {
+        pstr->append(strChunk);
+        psizes->push_back(strChunk.size());
+    }
+
+    TEST(TestJSONStream, matches_univalue)
+    {
+        UniValue inner(UniValue::VOBJ);
+        inner.push_back(Pair("size", 250));
+        inner.push_back(Pair("fee", 0.0001));
+        inner.push_back(Pair("note", "quote \" and \\ backslash\n"));
+        UniValue depends(UniValue::VARR);
+        inner.push_back(Pair("depends", depends));
+
+        UniValue expected(UniValue::VOBJ);
+        expected.push_back(Pair("hash", "00ff"));
+        UniValue txs(UniValue::VARR);
+        for (int i = 0; i < 3; i++)
+            txs.push_back(inner);
+        expected.push_back(Pair("tx", txs));
+        expected.push_back(Pair("empty", UniValue(UniValue::VOBJ)));
+        expected.push_back(Pair("next", NullUniValue));
+
+        std::string strOut;
+        std::vector<size_t> vSizes;
+        JSONStreamWriter out(boost::bind(&AppendChunk, &strOut, &vSizes, _1), 16);
+        out.BeginObject();
+        out.Key("hash");
+        out.Value("00ff");
+        out.Key("tx");
+        out.BeginArray();
+        for (int i = 0; i < 3; i++)
+            out.Value(inner);
+        out.EndArray();
+        out.Key("empty");
+        out.BeginObject();
+        out.EndObject();
+        out.Pairs(UniValue(UniValue::VOBJ));
+        UniValue tail(UniValue::VOBJ);
+        tail.push_back(Pair("next", NullUniValue));
+        out.Pairs(tail);
+        out.EndObject();
+        EXPECT_TRUE(out.Started());
+        strOut += out.Finish();
+
+        EXPECT_EQ(strOut, expected.write());
+        EXPECT_GT(vSizes.size(), 1);
+    }
+
+    TEST(TestJSONStream, buffers_small_output)
+    {
+        std::string strOut;
+        std::vector<size_t> vSizes;
+        JSONStreamWriter out(boost::bind(&AppendChunk, &strOut, &vSizes, _1));
+        out.BeginArray();
+        out.Value("a");
+        out.Value(1);
+        out.EndArray();
+        EXPECT_FALSE(out.Started());
+        EXPECT_EQ(out.Finish(), "[\"a\",1]");
+        EXPECT_TRUE(vSizes.empty());
+    }
+
+    // A producer that fails after part of the reply went out, as the rpc
+    // server finishes it: what the client gets must parse and carry the error
+    static void FailingResult(JSONStreamWriter& out, bool fPendingKey)
+    {
+        out.BeginArray();
+        for (int i = 0; i < 20; i++)
+            out.Value(i);
+        out.BeginObject();
+        out.Key("txid");
+        out.Value("00ff");
+        out.Key("vout");
+        if (!fPendingKey)
+            out.BeginArray();
+        throw std::runtime_error("read failed");
+    }
+
+    TEST(TestJSONStream, error_after_first_chunk)
+    {
+        for (int pending = 0; pending < 2; pending++) {
+            std::string strOut;
+            std::vector<size_t> vSizes;
+            JSONStreamWriter out(boost::bind(&AppendChunk, &strOut, &vSizes, _1), 16);
+            out.BeginObject();
+            out.Key("result");
+            try {
+                FailingResult(out, pending);
+                FAIL() << "no exception";
+            } catch (const std::exception& e) {
+                ASSERT_TRUE(out.Started());
+                out.Unwind(1);
+                EXPECT_EQ(out.Depth(), 1);
+                out.Key("error");
+                out.Value(JSONRPCError(RPC_MISC_ERROR, e.what()));
+                out.Key("id");
+                out.Value(1);
+                out.EndObject();
+            }
+            strOut += out.Finish();
+
+            UniValue reply;
+            ASSERT_TRUE(reply.read(strOut)) << strOut;
+            EXPECT_EQ(reply["result"].size(), 21);
+            EXPECT_TRUE(reply["result"][20]["vout"].isNull() == (bool)pending);
+            EXPECT_EQ(reply["error"]["code"].get_int(), RPC_MISC_ERROR);
+            EXPECT_EQ(reply["error"]["message"].get_str(), "read failed");
+            EXPECT_EQ(reply["id"].get_int(), 1);
+        }
+    }
+
+    TEST(TestJSONStream, unwind_to_top)
+    {
+        std::string strOut;
+        std::vector<size_t> vSizes;
+        JSONStreamWriter out(boost::bind(&AppendChunk, &strOut, &vSizes, _1));
+        out.BeginArray();
+        out.BeginObject();
+        out.Key("a");
+        out.BeginArray();
+        out.Value(1);
+        out.Unwind(0);
+        EXPECT_EQ(out.Depth(), 0);
+        EXPECT_EQ(strOut + out.Finish(), "[{\"a\":[1]}]");
+    }
+
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include "uint256.h"
+#include "zcash/IncrementalMerkleTree.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace TestMerkleTree {
+
+    TEST(TestMerkleTree, appendBatch)
+    {
+        SaplingTestingMerkleTree tree;
+        std::vector<SaplingTestingWitness> sequential, batched;
+        uint64_t n = 0;
+
+        // Blocks of varying size, with a new witness after most of them
+        const size_t blockSizes[] = {1, 3, 2, 4, 1, 3};
+        for (size_t block = 0; block < 6; block++) {
+            std::vector<libzcash::PedersenHash> commitments;
+            for (size_t i = 0; i < blockSizes[block]; i++) {
+                commitments.push_back(libzcash::PedersenHash(uint256S(std::to_string(++n))));
+            }
+
+            std::vector<SaplingTestingWitness*> witnesses;
+            for (auto& witness : batched) {
+                witnesses.push_back(&witness);
+            }
+            SaplingTestingWitness::append_batch(witnesses, tree.size(), commitments);
+
+            for (const auto& commitment : commitments) {
+                tree.append(commitment);
+                for (auto& witness : sequential) {
+                    witness.append(commitment);
+                }
+            }
+
+            ASSERT_EQ(sequential.size(), batched.size());
+            for (size_t i = 0; i < sequential.size(); i++) {
+                ASSERT_TRUE(sequential[i] == batched[i]);
+                ASSERT_EQ(sequential[i].root(), tree.root());
+                ASSERT_EQ(batched[i].root(), tree.root());
+            }
+
+            if (block % 3 != 2) {
+                sequential.push_back(tree.witness());
+                batched.push_back(tree.witness());
+            }
+        }
+    }
+
+    TEST(TestMerkleTree, appendBatchStaleWitness)
+    {
+        SaplingTestingMerkleTree tree;
+        for (int i = 1; i <= 3; i++) {
+            tree.append(libzcash::PedersenHash(uint256S(std::to_string(i))));
+        }
+        SaplingTestingWitness current = tree.witness();
+
+        // A witness cached ahead of the tree, as left behind by a crash before
+        // the block index was flushed, is appended to on its own
+        SaplingTestingMerkleTree ahead = tree;
+        ahead.append(libzcash::PedersenHash(uint256S("4")));
+        SaplingTestingWitness stale = ahead.witness();
+        SaplingTestingWitness expected = stale;
+
+        std::vector<libzcash::PedersenHash> commitments;
+        commitments.push_back(libzcash::PedersenHash(uint256S("5")));
+        commitments.push_back(libzcash::PedersenHash(uint256S("6")));
+        std::vector<SaplingTestingWitness*> witnesses;
+        witnesses.push_back(&current);
+        witnesses.push_back(&stale);
+        ASSERT_NO_THROW(SaplingTestingWitness::append_batch(witnesses, tree.size(), commitments));
+
+        for (const auto& commitment : commitments) {
+            tree.append(commitment);
+            expected.append(commitment);
+        }
+        ASSERT_EQ(current.root(), tree.root());
+        ASSERT_TRUE(stale == expected);
+    }
+
+}
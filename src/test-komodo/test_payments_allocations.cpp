@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "cc/CCPayments.h"
+#include "random.h"
+
+extern void mpz_set_lli(mpz_t rop, long long op);
+
+
+namespace TestPaymentsAllocations {
+
+    static void AllocationsTotalMpz(const std::vector<int64_t>& allocations, mpz_t total)
+    {
+        mpz_t tmp;
+        mpz_init(tmp);
+        mpz_set_si(total, 0);
+        for (int64_t a : allocations) {
+            mpz_set_lli(tmp, a);
+            mpz_add(total, total, tmp);
+        }
+        mpz_clear(tmp);
+    }
+
+    // the gmp computation payments used before, mpz_get_si2 kept the first (top) word of the quotient
+    static bool AllocationShareMpz(int64_t allocation, int64_t amount, const mpz_t total, int64_t& share)
+    {
+        mpz_t value, tmp;
+        uint64_t words[2] = {0, 0};
+        mpz_init(value);
+        mpz_init(tmp);
+        mpz_set_lli(value, allocation);
+        mpz_set_lli(tmp, amount);
+        mpz_mul(value, value, tmp);
+        mpz_tdiv_q(value, value, total);
+        bool fits = mpz_fits_slong_p(value);
+        mpz_export(words, NULL, 1, sizeof(words[0]), 0, 0, value);
+        share = (int64_t)words[0];
+        mpz_clear(value);
+        mpz_clear(tmp);
+        return fits;
+    }
+
+    static int64_t RandomAmount()
+    {
+        switch (insecure_rand() % 4)
+        {
+        case 0:
+            return insecure_rand() % 100000;
+        case 1:
+            return (int64_t)(insecure_rand() % 10000000) * COIN;
+        case 2:
+            return -(int64_t)(insecure_rand() % 1000);       // read as unsigned by mpz_set_lli
+        default:
+            return (int64_t)(((uint64_t)insecure_rand() << 32) | insecure_rand());
+        }
+    }
+
+    TEST(TestPaymentsAllocations, allocationshare_matches_gmp)
+    {
+        int32_t nTooBig = 0;
+        mpz_t mpzTotal;
+        mpz_init(mpzTotal);
+        for (int i = 0; i < 20000; i++)
+        {
+            std::vector<int64_t> allocations;
+            unsigned __int128 total = 0;
+            int32_t n = (insecure_rand() % 50) + 1;
+            while (allocations.size() < n) {
+                int64_t allocation = RandomAmount();
+                if (allocation == 0)
+                    continue;
+                allocations.push_back(allocation);
+                total += (uint64_t)allocation;
+            }
+            int64_t amount = RandomAmount(), share, expected;
+            int64_t allocation = allocations[insecure_rand() % n];
+            bool fits = payments_allocationshare(allocation, amount, total, share);
+            AllocationsTotalMpz(allocations, mpzTotal);
+            EXPECT_EQ(fits, AllocationShareMpz(allocation, amount, mpzTotal, expected));
+            EXPECT_EQ(share, expected);
+            if (!fits)
+                nTooBig++;
+        }
+        mpz_clear(mpzTotal);
+        EXPECT_TRUE(nTooBig > 0);
+    }
+
+    TEST(TestPaymentsAllocations, allocationshare_large_release)
+    {
+        std::vector<int64_t> allocations;
+        unsigned __int128 total = 0;
+        while (allocations.size() < 3999) {
+            allocations.push_back((int64_t)(insecure_rand() % 1000000) * COIN + 1);
+            total += (uint64_t)allocations.back();
+        }
+        int64_t amount = 12345 * COIN, nSum = 0, share, expected;
+        mpz_t mpzTotal;
+        mpz_init(mpzTotal);
+        AllocationsTotalMpz(allocations, mpzTotal);
+        for (size_t i = 0; i < allocations.size(); i++) {
+            EXPECT_TRUE(payments_allocationshare(allocations[i], amount, total, share));
+            AllocationShareMpz(allocations[i], amount, mpzTotal, expected);
+            EXPECT_EQ(share, expected);
+            nSum += share;
+        }
+        mpz_clear(mpzTotal);
+        // each share is rounded down, by less than a satoshi
+        EXPECT_TRUE(nSum <= amount);
+        EXPECT_TRUE(amount - nSum < (int64_t)allocations.size());
+    }
+
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include "arith_uint256.h"
+#include "cc/CCPrices.h"
+#include "random.h"
+
+
+namespace TestPricesSynthetic {
+
+    // index 1 is missing, index 2 has no history yet, others have prices spread over many magnitudes, up to 2^62 for index 7
+    static int32_t FakePriceGet(int64_t *buf64, int32_t ind, int32_t height, int32_t numblocks)
+    {
+        if (ind == 1)
+            return -1;
+        memset(buf64, 0, sizeof(*buf64) * PRICES_MAXDATAPOINTS * numblocks);
+        if (ind != 2) {
+            uint64_t x = (uint64_t)(ind * 2654435761u) ^ ((uint64_t)height * 40503u);
+            buf64[2] = (int64_t)((x % 1000003) + 1) << (ind == 7 ? (ind * 7 + height) % 43 : (ind + height) % 24);
+            if (ind == 3)
+                buf64[2] = -buf64[2];   // negative prices must truncate the same way gmp does
+        }
+        return PRICES_MAXDATAPOINTS;
+    }
+
+    static uint16_t RandomOpcode(bool fValidOnly)
+    {
+        static const uint16_t ops[] = { PRICES_MULT, PRICES_DIV, PRICES_INV, PRICES_MDD, PRICES_MMD, PRICES_MMM, PRICES_DDD };
+        switch (insecure_rand() % (fValidOnly ? 3 : 4))
+        {
+        case 0:
+            return (insecure_rand() % 8) + (fValidOnly ? 4 : 0);       // price index
+        case 1:
+            return PRICES_WEIGHT | ((insecure_rand() % (KOMODO_MAXPRICES - 1)) + 1);
+        case 2:
+            return ops[insecure_rand() % (sizeof(ops) / sizeof(ops[0]))];
+        default:
+            return insecure_rand() & 0xffff;
+        }
+    }
+
+    // random expression following the rules of prices_syntheticvec, or random opcodes
+    static std::vector<uint16_t> RandomSynthetic(bool fValidOnly)
+    {
+        std::vector<uint16_t> vec;
+        int32_t depth = 0, len = (insecure_rand() % 12) + 1;
+        while (vec.size() < len)
+        {
+            uint16_t opcode = RandomOpcode(fValidOnly);
+            if (fValidOnly) {
+                int32_t need = 0, push = 1;
+                switch (opcode & KOMODO_PRICEMASK) {
+                    case 0: break;
+                    case PRICES_WEIGHT: need = 1, push = 0; break;
+                    case PRICES_INV: need = 1; break;
+                    case PRICES_MULT: case PRICES_DIV: need = 2; break;
+                    default: need = 3; break;
+                }
+                if (depth < need || depth - need + push > 3 || ((opcode & KOMODO_PRICEMASK) == PRICES_WEIGHT && depth != 1))
+                    continue;
+                depth += push - need;
+            }
+            vec.push_back(opcode);
+        }
+        if (fValidOnly) {
+            for (; depth > 1; depth--)
+                vec.push_back(PRICES_MULT);
+            if (depth == 1)
+                vec.push_back(PRICES_WEIGHT | ((insecure_rand() % 100) + 1));
+        }
+        return vec;
+    }
+
+    // every price is 1 satoshi, a product of two of them truncates to zero
+    static int32_t TinyPriceGet(int64_t *buf64, int32_t ind, int32_t height, int32_t numblocks)
+    {
+        memset(buf64, 0, sizeof(*buf64) * PRICES_MAXDATAPOINTS * numblocks);
+        buf64[2] = 1;
+        return PRICES_MAXDATAPOINTS;
+    }
+
+    TEST(TestPricesSynthetic, compiled_matches_gmp)
+    {
+        int32_t nValid = 0;
+        for (int i = 0; i < 5000; i++)
+        {
+            std::vector<uint16_t> vec = RandomSynthetic(i % 2 == 0);
+            CPricesSynthetic synthetic;
+            prices_syntheticcompile(synthetic, vec);
+            int32_t height = insecure_rand() % 100000;
+            int64_t expected = prices_syntheticprice_mpz(vec, height, FakePriceGet);
+            EXPECT_EQ(prices_syntheticeval(synthetic, height, FakePriceGet), expected);
+            if (expected > 0)
+                nValid++;
+        }
+        EXPECT_GT(nValid, 500);
+    }
+
+    TEST(TestPricesSynthetic, overflow_and_errors)
+    {
+        CPricesSynthetic synthetic;
+        // at height 36 index 7 is above 2^61, a * b / SATOSHIDEN * c exceeds 128 bits and falls back to gmp
+        std::vector<uint16_t> vec = { 7, 7, 7, PRICES_MMM, PRICES_WEIGHT | 1 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 36, FakePriceGet), -13);
+        EXPECT_EQ(prices_syntheticprice_mpz(vec, 36, FakePriceGet), -13);
+
+        // a missing price leaves zero on the stack, so like no history yet it is reported as -14
+        vec = { 1, PRICES_WEIGHT | 1 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, FakePriceGet), -14);
+
+        vec = { 2, PRICES_WEIGHT | 1 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, FakePriceGet), -14);
+
+        // a fifth operand stops the evaluation with -12, earlier errors and a zero weight still take precedence
+        vec = { 4, PRICES_WEIGHT | 1, 4, 5, 6, 7, 0 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, FakePriceGet), -12);
+        EXPECT_EQ(prices_syntheticprice_mpz(vec, 10, FakePriceGet), -12);
+
+        vec = { 4, 5, 6, 7, 0 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, FakePriceGet), -11);
+        EXPECT_EQ(prices_syntheticprice_mpz(vec, 10, FakePriceGet), -11);
+
+        vec = { 4, PRICES_WEIGHT | 1, 4, 5, 2, 7, 0 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, FakePriceGet), -14);
+        EXPECT_EQ(prices_syntheticprice_mpz(vec, 10, FakePriceGet), -14);
+    }
+
+    TEST(TestPricesSynthetic, division_by_zero)
+    {
+        CPricesSynthetic synthetic;
+        std::vector<uint16_t> vec = { 4, 4, 5, PRICES_MULT, PRICES_DIV, PRICES_WEIGHT | 1 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, TinyPriceGet), -15);
+        EXPECT_EQ(prices_syntheticprice_mpz(vec, 10, TinyPriceGet), -15);
+
+        vec = { 4, 5, PRICES_MULT, PRICES_INV, PRICES_WEIGHT | 1 };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, TinyPriceGet), -15);
+        EXPECT_EQ(prices_syntheticprice_mpz(vec, 10, TinyPriceGet), -15);
+
+        // a fifth operand stops the evaluation, the division by zero after it is not reached
+        vec = { 4, PRICES_WEIGHT | 1, 4, 4, 5, 6, 7, PRICES_MULT, PRICES_DIV };
+        prices_syntheticcompile(synthetic, vec);
+        EXPECT_EQ(prices_syntheticeval(synthetic, 10, TinyPriceGet), -12);
+        EXPECT_EQ(prices_syntheticprice_mpz(vec, 10, TinyPriceGet), -12);
+    }
+
+    TEST(TestPricesSynthetic, cache_cleared_when_full)
+    {
+        std::vector<uint16_t> vec = { 4, 5, PRICES_DIV, PRICES_WEIGHT | 1 };
+        std::shared_ptr<const CPricesSynthetic> first = prices_syntheticcached(ArithToUint256(arith_uint256(1)), vec);
+        EXPECT_EQ(first->vec, vec);
+        EXPECT_EQ(prices_syntheticeval(*first, 10, FakePriceGet), prices_syntheticprice_mpz(vec, 10, FakePriceGet));
+        for (int i = 2; i <= PRICES_SYNTHETICCACHESIZE; i++)
+            prices_syntheticcached(ArithToUint256(arith_uint256(i)), vec);
+        // full but not over, the first bet is still compiled once
+        EXPECT_EQ(prices_syntheticcached(ArithToUint256(arith_uint256(1)), vec).get(), first.get());
+
+        // one more bet clears the cache, the first bet is compiled again
+        prices_syntheticcached(ArithToUint256(arith_uint256(PRICES_SYNTHETICCACHESIZE + 1)), vec);
+        std::shared_ptr<const CPricesSynthetic> again = prices_syntheticcached(ArithToUint256(arith_uint256(1)), vec);
+        EXPECT_NE(again.get(), first.get());
+        EXPECT_EQ(again->vec, vec);
+    }
+
+}
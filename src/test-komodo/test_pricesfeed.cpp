@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include "cc/pricesfeed.h"
+#include "support/events.h"
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <event2/buffer.h>
+#include <event2/http.h>
+#include <event2/thread.h>
+
+
+namespace TestPricesFeed {
+
+    /**
+     * In-process stand-in for the price web resources, every path is answered
+     * with a fixed json body. Replies of the paths in a group are held until
+     * all of them were requested, so a group is only answered when its feeds
+     * are polled at the same time. Paths with an empty group are never answered.
+     */
+    class FakeFeedServer
+    {
+    public:
+        struct Route {
+            std::string strGroup;
+            std::string strBody;
+        };
+
+        FakeFeedServer(const std::map<std::string, Route>& routes) : routes(routes), port(0)
+        {
+            evthread_use_pthreads();
+            base = obtain_event_base();
+            http = obtain_evhttp(base.get());
+            evhttp_set_gencb(http.get(), OnRequest, this);
+            evhttp_bound_socket* sock = evhttp_bind_socket_with_handle(http.get(), "127.0.0.1", 0);
+            if (sock != NULL) {
+                struct sockaddr_in addr;
+                socklen_t addrlen = sizeof(addr);
+                if (getsockname(evhttp_bound_socket_get_fd(sock), (struct sockaddr*)&addr, &addrlen) == 0)
+                    port = ntohs(addr.sin_port);
+            }
+            thread = std::thread([this]() { event_base_dispatch(base.get()); });
+        }
+
+        ~FakeFeedServer()
+        {
+            event_base_loopbreak(base.get());
+            thread.join();
+        }
+
+        bool Bound() const { return port != 0; }
+
+        std::string GetURL(const std::string& path) const
+        {
+            return "http://127.0.0.1:" + std::to_string(port) + path;
+        }
+
+    private:
+        std::map<std::string, Route> routes;
+        std::map<std::string, std::vector<std::pair<struct evhttp_request*, std::string> > > held;
+        raii_event_base base;
+        raii_evhttp http;
+        std::thread thread;
+        uint16_t port;
+
+        static void OnRequest(struct evhttp_request* req, void* arg)
+        {
+            FakeFeedServer* server = static_cast<FakeFeedServer*>(arg);
+            std::map<std::string, Route>::const_iterator it = server->routes.find(evhttp_request_get_uri(req));
+            if (it == server->routes.end()) {
+                evhttp_send_error(req, HTTP_NOTFOUND, NULL);
+                return;
+            }
+            if (it->second.strGroup.empty())
+                return; // stalled, libevent drops the request once the client gives up
+
+            size_t nGroup = 0;
+            for (const auto& route : server->routes)
+                if (route.second.strGroup == it->second.strGroup)
+                    nGroup++;
+            std::vector<std::pair<struct evhttp_request*, std::string> >& pending = server->held[it->second.strGroup];
+            pending.push_back(std::make_pair(req, it->second.strBody));
+            if (pending.size() < nGroup)
+                return;
+            for (const auto& reply : pending) {
+                evbuffer_add(evhttp_request_get_output_buffer(reply.first), reply.second.data(), reply.second.size());
+                evhttp_send_reply(reply.first, HTTP_OK, "OK", NULL);
+            }
+            pending.clear();
+        }
+    };
+
+    static std::string FeedConfig(const std::string& name, const std::string& url, const std::string& symbol, const std::string& valuepath, const std::string& extra = "")
+    {
+        return "{\"name\":\"" + name + "\",\"url\":\"" + url + "\",\"results\":[{\"symbol\":\"" + symbol + "\",\"valuepath\":\"" + valuepath + "\"}],\"multiplier\":100" + extra + "}";
+    }
+
+    TEST(TestPricesFeed, concurrent_poll)
+    {
+        // bbb and ccc are answered only while both are requested, a feed
+        // polled after the other would time out and miss its price
+        std::map<std::string, FakeFeedServer::Route> routes;
+        routes["/aaa"] = {"a", "{\"price\":1.5}"};
+        routes["/bbb"] = {"bc", "{\"price\":2.5}"};
+        routes["/ccc"] = {"bc", "{\"data\":{\"price\":3.5}}"};
+        routes["/stalled"] = {"", "{\"price\":9.5}"};
+        FakeFeedServer server(routes);
+        ASSERT_TRUE(server.Bound());
+
+        // "basic" replaces the built-in feed so nothing leaves the host
+        std::string strConfig = "[" +
+            FeedConfig("basic", server.GetURL("/aaa"), "AAA_USD", "/price") + "," +
+            FeedConfig("b", server.GetURL("/bbb"), "BBB_USD", "/price", ",\"timeout\":5") + "," +
+            FeedConfig("c", server.GetURL("/ccc"), "CCC_USD", "/data/price", ",\"timeout\":5") + "," +
+            FeedConfig("stalled", server.GetURL("/stalled"), "AAA_USD", "/price", ",\"timeout\":1") + "]";
+        cJSON* json = cJSON_Parse(strConfig.c_str());
+        ASSERT_TRUE(json != NULL);
+        EXPECT_TRUE(PricesFeedParseConfig(json));
+        cJSON_Delete(json);
+        ASSERT_TRUE(PricesInitStatuses());
+        EXPECT_EQ(PricesFeedSymbolsCount(), 4);
+
+        uint32_t prices[64], timestamp;
+        uint32_t count = PricesFeedPoll(prices, sizeof(prices) / sizeof(prices[0]), &timestamp);
+
+        EXPECT_EQ(count, 4);
+        EXPECT_EQ(prices[0], timestamp);
+        // the stalled feed timed out, the shared symbol keeps the value of the feed that answered
+        EXPECT_EQ(prices[1], 150);
+        EXPECT_EQ(prices[2], 250);
+        EXPECT_EQ(prices[3], 350);
+    }
+
+}
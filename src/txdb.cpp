@@ -396,9 +396,10 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end, int64_t skip, int64_t maxEntries) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    int64_t n = 0;
 
     if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
@@ -406,7 +407,7 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
-    while (pcursor->Valid()) {
+    while (pcursor->Valid() && (maxEntries <= 0 || (int64_t)addressIndex.size() < maxEntries)) {
         boost::this_thread::interruption_point();
         try {
             pair<char, CAddressIndexKey> keyObj;
@@ -418,6 +419,10 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                 if (end > 0 && indexKey.blockHeight > end) {
                     break;
                 }
+                if (n++ < skip) {
+                    pcursor->Next();
+                    continue;
+                }
                 try {
                     CAmount nValue;
                     pcursor->GetValue(nValue);
@@ -763,7 +768,7 @@ bool CBlockTreeDB::UpdateUnspentCCIndex(const std::vector<std::pair<CUnspentCCIn
 
 // read unspent cc index by address or address+creationid key
 bool CBlockTreeDB::ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
-                                           std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs) {
+                                           std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &unspentOutputs, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs, int64_t skip) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
@@ -772,7 +777,8 @@ bool CBlockTreeDB::ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
     else
         pcursor->Seek(make_pair(DB_ADDRESSUNSPENT_CC_INDEX, CUnspentCCIndexKeyCreationId(addressHash, creationid)));  // search first address+creationId
 
-    int64_t n = 0;
+    int64_t n = 0, nSkipped = 0;
+    bool fHeights = beginHeight >= 0 || endHeight >= 0;
     while (pcursor->Valid() && (maxOutputs <= 0 || n < maxOutputs)) {
         boost::this_thread::interruption_point();
         try {
@@ -783,12 +789,22 @@ bool CBlockTreeDB::ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
             CUnspentCCIndexKey indexKey = keyObj.second;
 
             if (chType == DB_ADDRESSUNSPENT_CC_INDEX && indexKey.hashBytes == addressHash && (creationid.IsNull() || indexKey.creationid == creationid)) {
+                // without a height range skipped entries are stepped over by key
+                if (!fHeights && nSkipped < skip) {
+                    nSkipped++;
+                    pcursor->Next();
+                    continue;
+                }
                 try {
                     CUnspentCCIndexValue ccValue;
                     pcursor->GetValue(ccValue);
                     if ((beginHeight < 0 || ccValue.blockHeight >= beginHeight) && (endHeight < 0 || ccValue.blockHeight <= endHeight))   { 
-                        unspentOutputs.push_back(make_pair(indexKey, ccValue));
-                        n ++;
+                        if (nSkipped < skip)
+                            nSkipped++;
+                        else {
+                            unspentOutputs.push_back(make_pair(indexKey, ccValue));
+                            n ++;
+                        }
                     }
                     pcursor->Next();
                 } catch (const std::exception& e) {
@@ -107,7 +107,7 @@ public:
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0, int64_t skip = 0, int64_t maxEntries = 0);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
@@ -121,7 +121,7 @@ public:
 
     bool UpdateUnspentCCIndex(const std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue > >&vect);
     bool ReadUnspentCCIndex(uint160 addressHash, uint256 creationid,
-                                 std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &vect, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs);
+                                 std::vector<std::pair<CUnspentCCIndexKey, CUnspentCCIndexValue> > &vect, int32_t beginHeight, int32_t endHeight, int64_t maxOutputs, int64_t skip = 0);
 };
 
 #endif // BITCOIN_TXDB_H
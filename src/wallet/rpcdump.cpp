@@ -232,6 +232,8 @@ UniValue importprivkey(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
         if (!pwalletMain->AddKeyPubKey(key, pubkey))
             throw JSONRPCError(RPC_WALLET_ERROR, "Error adding key to wallet");
+        // Wallet transactions outside the rescan may already pay to the key
+        pwalletMain->RebuildCoinsByValue();
 
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
@@ -341,6 +343,7 @@ UniValue importaddress(const UniValue& params, bool fHelp, const CPubKey& mypk)
 
         if (!pwalletMain->AddWatchOnly(script))
             throw JSONRPCError(RPC_WALLET_ERROR, "Error adding address to wallet");
+        pwalletMain->RebuildCoinsByValue();
 
         if (fRescan)
         {
@@ -489,6 +492,7 @@ UniValue importwallet_impl(const UniValue& params, bool fHelp, bool fImportZKeys
     }
     file.close();
     pwalletMain->ShowProgress("", 100); // hide progress dialog in GUI
+    pwalletMain->RebuildCoinsByValue();
 
     CBlockIndex *pindex = chainActive.LastTip();
     while (pindex && pindex->pprev && pindex->GetBlockTime() > nTimeBegin - 7200)
@@ -3400,7 +3400,12 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
             sample_times.push_back(benchmark_large_tx(nInputs));
         } else if (benchmarktype == "trydecryptnotes") {
             int nAddrs = params[2].get_int();
-            sample_times.push_back(benchmark_try_decrypt_notes(nAddrs));
+            if (params.size() < 4) {
+                sample_times.push_back(benchmark_try_decrypt_notes(nAddrs));
+            } else {
+                int nThreads = params[3].get_int();
+                sample_times.push_back(benchmark_try_decrypt_sapling_notes(nAddrs, nThreads));
+            }
         } else if (benchmarktype == "incnotewitnesses") {
             int nTxs = params[2].get_int();
             sample_times.push_back(benchmark_increment_note_witnesses(nTxs));
@@ -3430,6 +3435,30 @@ UniValue zc_benchmark(const UniValue& params, bool fHelp, const CPubKey& mypk)
             sample_times.push_back(benchmark_verify_sapling_spend());
         } else if (benchmarktype == "verifysaplingoutput") {
             sample_times.push_back(benchmark_verify_sapling_output());
+        } else if (benchmarktype == "syntheticprices" || benchmarktype == "syntheticpricesgmp") {
+            int nExprs = 1000;
+            if (params.size() >= 3) {
+                nExprs = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_synthetic_prices(nExprs, benchmarktype == "syntheticprices"));
+        } else if (benchmarktype == "fulfillmentdecode" || benchmarktype == "fulfillmentdecodeasn1") {
+            int nInputs = 1000;
+            if (params.size() >= 3) {
+                nInputs = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_fulfillment_decode(nInputs, benchmarktype == "fulfillmentdecodeasn1"));
+        } else if (benchmarktype == "ccsignatures" || benchmarktype == "ccsignaturescached") {
+            int nVerifies = 100;
+            if (params.size() >= 3) {
+                nVerifies = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_cc_signatures(nVerifies, benchmarktype == "ccsignaturescached"));
+        } else if (benchmarktype == "paymentsallocations" || benchmarktype == "paymentsallocationsgmp") {
+            int nAllocations = 3999;
+            if (params.size() >= 3) {
+                nAllocations = params[2].get_int();
+            }
+            sample_times.push_back(benchmark_payments_allocations(nAllocations, benchmarktype == "paymentsallocationsgmp"));
         } else {
             throw JSONRPCError(RPC_TYPE_ERROR, "Invalid benchmarktype");
         }
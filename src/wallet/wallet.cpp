@@ -43,6 +43,8 @@
 #include "cc/CCinclude.h"
 
 #include <assert.h>
+#include <atomic>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -583,6 +585,15 @@ void CWallet::ChainTip(const CBlockIndex *pindex,
         IncrementNoteWitnesses(pindex, pblock, sproutTree, saplingTree);
     } else {
         DecrementNoteWitnesses(pindex);
+        // Outputs spent in the disconnected block may be spendable again
+        LOCK(cs_wallet);
+        for (size_t i = 0; pblock && i < pblock->vtx.size(); i++) {
+            const CTransaction& tx = pblock->vtx[i];
+            if (!tx.IsCoinBase() && mapWallet.count(tx.GetHash())) {
+                for (const CTxIn& txin : tx.vin)
+                    UpdateCoinByValue(txin.prevout);
+            }
+        }
     }
     UpdateSaplingNullifierNoteMapForBlock(pblock);
 }
@@ -956,6 +967,63 @@ void CWallet::AddToSpends(const uint256& wtxid)
     }
 }
 
+/**
+ * Puts an output in setCoinsByValue if it pays to us and no wallet transaction
+ * in the active chain spends it, otherwise takes it out. A disconnected spend
+ * keeps its hashBlock, so its depth is checked rather than the hash.
+ */
+void CWallet::UpdateCoinByValue(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    nCoinsByValueUpdates++;
+    std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+    if (mit == mapWallet.end() || outpoint.n >= mit->second.vout.size())
+        return;
+
+    const CTxOut& txout = mit->second.vout[outpoint.n];
+    bool fIndexed = IsMine(txout) != ISMINE_NO;
+    if (fIndexed) {
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+        for (TxSpends::const_iterator it = range.first; it != range.second && fIndexed; ++it) {
+            std::map<uint256, CWalletTx>::const_iterator sit = mapWallet.find(it->second);
+            if (sit != mapWallet.end() && sit->second.GetDepthInMainChain() > 0)
+                fIndexed = false;
+        }
+    }
+
+    if (fIndexed)
+        setCoinsByValue.insert(make_pair(txout.nValue, outpoint));
+    else
+        setCoinsByValue.erase(make_pair(txout.nValue, outpoint));
+}
+
+/**
+ * Refreshes the index entries of a wallet transaction's outputs and of the
+ * outputs it spends.
+ */
+void CWallet::UpdateCoinsByValue(const CWalletTx& wtx)
+{
+    LOCK(cs_wallet);
+    for (unsigned int i = 0; i < wtx.vout.size(); i++)
+        UpdateCoinByValue(COutPoint(wtx.GetHash(), i));
+    if (!wtx.IsCoinBase()) {
+        for (const CTxIn& txin : wtx.vin)
+            UpdateCoinByValue(txin.prevout);
+    }
+}
+
+void CWallet::RebuildCoinsByValue()
+{
+    LOCK2(cs_main, cs_wallet);
+    nCoinsByValueUpdates++;
+    setCoinsByValue.clear();
+    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+        for (unsigned int i = 0; i < it->second.vout.size(); i++)
+            UpdateCoinByValue(COutPoint(it->first, i));
+    }
+}
+
 void CWallet::ClearNoteWitnessCache()
 {
     LOCK(cs_wallet);
@@ -1014,6 +1082,23 @@ void AppendNoteCommitment(NoteDataMap& noteDataMap, int indexHeight, int64_t nWi
     }
 }
 
+template<typename NoteDataMap, typename Witness>
+void CollectNoteWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize,
+                          const std::set<typename NoteDataMap::key_type>& notesInBlock, std::vector<Witness*>& witnesses)
+{
+    for (auto& item : noteDataMap) {
+        auto* nd = &(item.second);
+        // A note of this block with cached witnesses is left to WitnessNoteIfMine,
+        // which logs the inconsistent cache and starts the witnesses over
+        if (nd->witnessHeight < indexHeight && nd->witnesses.size() > 0 && !notesInBlock.count(item.first)) {
+            // Check the validity of the cache
+            // See comment in CopyPreviousWitnesses about validity.
+            assert(nWitnessCacheSize >= nd->witnesses.size());
+            witnesses.push_back(&nd->witnesses.front());
+        }
+    }
+}
+
 template<typename OutPoint, typename NoteData, typename Witness>
 void WitnessNoteIfMine(std::map<OutPoint, NoteData>& noteDataMap, int indexHeight, int64_t nWitnessCacheSize, const OutPoint& key, const Witness& witness)
 {
@@ -1081,6 +1166,9 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         pblock = &block;
     }
 
+    std::vector<libzcash::PedersenHash> saplingCommitments;
+    std::vector<std::pair<SaplingOutPoint, size_t>> mySaplingOutputs;
+
     for (const CTransaction& tx : pblock->vtx) {
         auto hash = tx.GetHash();
         bool txIsOurs = mapWallet.count(hash);
@@ -1105,22 +1193,50 @@ void CWallet::IncrementNoteWitnesses(const CBlockIndex* pindex,
         }
         // Sapling
         for (uint32_t i = 0; i < tx.vShieldedOutput.size(); i++) {
-            const uint256& note_commitment = tx.vShieldedOutput[i].cm;
-            saplingTree.append(note_commitment);
-
-            // Increment existing witnesses
-            for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
-                ::AppendNoteCommitment(wtxItem.second.mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, note_commitment);
+            SaplingOutPoint outPoint {hash, i};
+            if (txIsOurs && mapWallet[hash].mapSaplingNoteData.count(outPoint)) {
+                mySaplingOutputs.push_back(std::make_pair(outPoint, saplingCommitments.size()));
             }
+            saplingCommitments.push_back(tx.vShieldedOutput[i].cm);
+        }
+    }
 
-            // If this is our note, witness it
-            if (txIsOurs) {
-                SaplingOutPoint outPoint {hash, i};
-                ::WitnessNoteIfMine(mapWallet[hash].mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, outPoint, saplingTree.witness());
-            }
+    // Sapling witnesses all receive the same run of commitments, so they are
+    // appended in batches that hash each shared subtree only once
+    std::vector<SaplingWitness*> saplingWitnesses;
+    std::set<SaplingOutPoint> mySaplingOutPoints;
+    for (const std::pair<SaplingOutPoint, size_t>& item : mySaplingOutputs) {
+        mySaplingOutPoints.insert(item.first);
+    }
+    for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
+        ::CollectNoteWitnesses(wtxItem.second.mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, mySaplingOutPoints, saplingWitnesses);
+    }
+
+    // Our notes in this block start new witnesses, which join the batch
+    // for the commitments that follow them
+    std::vector<std::pair<SaplingOutPoint, SaplingWitness>> newSaplingWitnesses;
+    newSaplingWitnesses.reserve(mySaplingOutputs.size());
+    size_t nAppended = 0;
+    for (size_t i = 0; i <= mySaplingOutputs.size(); i++) {
+        size_t nEnd = i < mySaplingOutputs.size() ? mySaplingOutputs[i].second + 1 : saplingCommitments.size();
+        std::vector<libzcash::PedersenHash> commitments(saplingCommitments.begin() + nAppended, saplingCommitments.begin() + nEnd);
+        SaplingWitness::append_batch(saplingWitnesses, saplingTree.size(), commitments);
+        for (const libzcash::PedersenHash& note_commitment : commitments) {
+            saplingTree.append(note_commitment);
+        }
+        nAppended = nEnd;
+
+        if (i < mySaplingOutputs.size()) {
+            newSaplingWitnesses.push_back(std::make_pair(mySaplingOutputs[i].first, saplingTree.witness()));
+            saplingWitnesses.push_back(&newSaplingWitnesses.back().second);
         }
     }
 
+    // If these are our notes, witness them
+    for (const std::pair<SaplingOutPoint, SaplingWitness>& item : newSaplingWitnesses) {
+        ::WitnessNoteIfMine(mapWallet[item.first.hash].mapSaplingNoteData, pindex->GetHeight(), nWitnessCacheSize, item.first, item.second);
+    }
+
     // Update witness heights
     for (std::pair<const uint256, CWalletTx>& wtxItem : mapWallet) {
         ::UpdateWitnessHeights(wtxItem.second.mapSproutNoteData, pindex->GetHeight(), nWitnessCacheSize);
@@ -1592,6 +1708,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         mapWallet[hash].BindWallet(this);
         UpdateNullifierNoteMapWithTx(mapWallet[hash]);
         AddToSpends(hash);
+        // setCoinsByValue needs cs_main for the spend depths, LoadWallet
+        // rebuilds it once the keys and all transactions are read
     }
     else
     {
@@ -1680,6 +1798,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
             }
         }
 
+        UpdateCoinsByValue(wtx);
+
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -1749,7 +1869,7 @@ bool CWallet::UpdatedNoteData(const CWalletTx& wtxIn, CWalletTx& wtx)
  * pblock is optional, but should be provided if the transaction is known to be in a block.
  * If fUpdate is true, existing transactions will be updated.
  */
-bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate)
+bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate, const SaplingTrialDecryptions* pdecrypted)
 {
     {
         AssertLockHeld(cs_wallet);
@@ -1758,7 +1878,7 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
         bool fExisted = mapWallet.count(tx.GetHash()) != 0;
         if (fExisted && !fUpdate) return false;
         auto sproutNoteData = FindMySproutNotes(tx);
-        auto saplingNoteDataAndAddressesToAdd = FindMySaplingNotes(tx);
+        auto saplingNoteDataAndAddressesToAdd = FindMySaplingNotes(tx, pdecrypted);
         auto saplingNoteData = saplingNoteDataAndAddressesToAdd.first;
         auto addressesToAdd = saplingNoteDataAndAddressesToAdd.second;
         for (const auto &addressToAdd : addressesToAdd) {
@@ -1877,8 +1997,20 @@ void CWallet::EraseFromWallet(const uint256 &hash)
         return;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        std::map<uint256, CWalletTx>::iterator it = mapWallet.find(hash);
+        if (it != mapWallet.end())
+        {
+            CWalletTx wtx = it->second;
+            mapWallet.erase(it);
+            nCoinsByValueUpdates++;
+            for (unsigned int i = 0; i < wtx.vout.size(); i++)
+                setCoinsByValue.erase(make_pair(wtx.vout[i].nValue, COutPoint(hash, i)));
+            if (!wtx.IsCoinBase()) {
+                for (const CTxIn& txin : wtx.vin)
+                    UpdateCoinByValue(txin.prevout);
+            }
             CWalletDB(strWalletFile).EraseTx(hash);
+        }
     }
     return;
 }
@@ -1979,55 +2111,110 @@ mapSproutNoteData_t CWallet::FindMySproutNotes(const CTransaction &tx) const
  * the result of FindMySaplingNotes (for the addresses available at the time) will
  * already have been cached in CWalletTx.mapSaplingNoteData.
  */
-std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> CWallet::FindMySaplingNotes(const CTransaction &tx) const
+std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> CWallet::FindMySaplingNotes(const CTransaction &tx, const SaplingTrialDecryptions* pdecrypted) const
 {
-    LOCK(cs_SpendingKeyStore);
     uint256 hash = tx.GetHash();
 
     mapSaplingNoteData_t noteData;
     SaplingIncomingViewingKeyMap viewingKeysToAdd;
 
-    // Protocol Spec: 4.19 Block Chain Scanning (Sapling)
-    for (uint32_t i = 0; i < tx.vShieldedOutput.size(); ++i) {
-        const OutputDescription output = tx.vShieldedOutput[i];
-        bool found = false;
+    SaplingTrialDecryptions decrypted;
+    if (pdecrypted == NULL) {
+        decrypted = TrialDecryptSaplingOutputs(std::vector<const CTransaction*>(1, &tx));
+        pdecrypted = &decrypted;
+    }
+
+    LOCK(cs_SpendingKeyStore);
+    for (auto it = pdecrypted->lower_bound(SaplingOutPoint(hash, 0)); it != pdecrypted->end() && it->first.hash == hash; ++it) {
+        // Earlier transactions of a batch may already have added the address
+        if (it->second.address && mapSaplingIncomingViewingKeys.count(it->second.address.get()) == 0) {
+            viewingKeysToAdd[it->second.address.get()] = it->second.ivk;
+        }
+        // We don't cache the nullifier here as computing it requires knowledge of the note position
+        // in the commitment tree, which can only be determined when the transaction has been mined.
+        SaplingNoteData nd;
+        nd.ivk = it->second.ivk;
+        noteData.insert(std::make_pair(it->first, nd));
+    }
+
+    return std::make_pair(noteData, viewingKeysToAdd);
+}
+
+/**
+ * Tries every Sapling output of the given transactions against the wallet's
+ * incoming viewing keys, spreading the outputs over nThreads workers.
+ *
+ * Keys of full viewing keys are tried first, then the remaining incoming
+ * viewing keys, so each output resolves to the same key as a sequential scan.
+ */
+SaplingTrialDecryptions CWallet::TrialDecryptSaplingOutputs(const std::vector<const CTransaction*>& vtx, int nThreads) const
+{
+    SaplingTrialDecryptions decrypted;
+
+    std::vector<std::pair<const CTransaction*, uint32_t>> outputs;
+    for (const CTransaction* ptx : vtx) {
+        for (uint32_t i = 0; i < ptx->vShieldedOutput.size(); ++i) {
+            outputs.push_back(std::make_pair(ptx, i));
+        }
+    }
+    if (outputs.empty()) {
+        return decrypted;
+    }
+
+    std::vector<SaplingIncomingViewingKey> fullIvks, ivks;
+    {
+        LOCK(cs_SpendingKeyStore);
         for (auto it = mapSaplingFullViewingKeys.begin(); it != mapSaplingFullViewingKeys.end(); ++it) {
-            SaplingIncomingViewingKey ivk = it->first;
-            auto result = SaplingNotePlaintext::decrypt(output.encCiphertext, ivk, output.ephemeralKey, output.cm);
-            if (result) {
-                auto address = ivk.address(result.get().d);
-                if (address && mapSaplingIncomingViewingKeys.count(address.get()) == 0) {
-                    viewingKeysToAdd[address.get()] = ivk;
-                }
-                // We don't cache the nullifier here as computing it requires knowledge of the note position
-                // in the commitment tree, which can only be determined when the transaction has been mined.
-                SaplingOutPoint op {hash, i};
-                SaplingNoteData nd;
-                nd.ivk = ivk;
-                noteData.insert(std::make_pair(op, nd));
-                found = true;
-                break;
-            }
+            fullIvks.push_back(it->first);
         }
-        if (!found) {
-            for (auto it = mapSaplingIncomingViewingKeys.begin(); it != mapSaplingIncomingViewingKeys.end(); ++it) {
-                SaplingIncomingViewingKey ivk = it-> second;
+        for (auto it = mapSaplingIncomingViewingKeys.begin(); it != mapSaplingIncomingViewingKeys.end(); ++it) {
+            ivks.push_back(it->second);
+        }
+    }
+    if (fullIvks.empty() && ivks.empty()) {
+        return decrypted;
+    }
+
+    // Protocol Spec: 4.19 Block Chain Scanning (Sapling)
+    std::vector<boost::optional<SaplingTrialDecryption>> results(outputs.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t n = next++; n < outputs.size(); n = next++) {
+            const OutputDescription& output = outputs[n].first->vShieldedOutput[outputs[n].second];
+            for (const SaplingIncomingViewingKey& ivk : fullIvks) {
                 auto result = SaplingNotePlaintext::decrypt(output.encCiphertext, ivk, output.ephemeralKey, output.cm);
-                if (!result) {
-                    continue;
+                if (result) {
+                    results[n] = SaplingTrialDecryption {ivk, ivk.address(result.get().d)};
+                    break;
+                }
+            }
+            if (results[n]) {
+                continue;
+            }
+            for (const SaplingIncomingViewingKey& ivk : ivks) {
+                if (SaplingNotePlaintext::decrypt(output.encCiphertext, ivk, output.ephemeralKey, output.cm)) {
+                    results[n] = SaplingTrialDecryption {ivk, boost::none};
+                    break;
                 }
-                // We don't cache the nullifier here as computing it requires knowledge of the note position
-                // in the commitment tree, which can only be determined when the transaction has been mined.
-                SaplingOutPoint op {hash, i};
-                SaplingNoteData nd;
-                nd.ivk = ivk;
-                noteData.insert(std::make_pair(op, nd));
-                break;
             }
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads && i < (int)outputs.size(); i++) {
+        threads.push_back(std::thread(worker));
+    }
+    worker();
+    for (std::thread& t : threads) {
+        t.join();
     }
 
-    return std::make_pair(noteData, viewingKeysToAdd);
+    for (size_t n = 0; n < outputs.size(); n++) {
+        if (results[n]) {
+            decrypted.insert(std::make_pair(SaplingOutPoint(outputs[n].first->GetHash(), outputs[n].second), results[n].get()));
+        }
+    }
+    return decrypted;
 }
 
 bool CWallet::IsSproutNullifierFromMe(const uint256& nullifier) const
@@ -2894,38 +3081,58 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.LastTip(), false);
+        int nThreads = std::max(1, GetNumCores());
         while (pindex)
         {
-            if (pindex->GetHeight() % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+            // Read a batch of blocks ahead so trial decryption of their Sapling outputs
+            // can be spread over all cores, then add the transactions in chain order
+            std::vector<CBlockIndex*> vIndex;
+            std::vector<CBlock> vBlocks;
+            std::vector<const CTransaction*> vtx;
+            for (CBlockIndex* pnext = pindex; pnext && vIndex.size() < WALLET_RESCAN_BATCH_BLOCKS; pnext = chainActive.Next(pnext)) {
+                vIndex.push_back(pnext);
+            }
+            vBlocks.resize(vIndex.size());
+            for (size_t i = 0; i < vIndex.size(); i++) {
+                ReadBlockFromDisk(vBlocks[i], vIndex[i],1);
+                BOOST_FOREACH(const CTransaction& tx, vBlocks[i].vtx)
+                    vtx.push_back(&tx);
+            }
+            SaplingTrialDecryptions decrypted = TrialDecryptSaplingOutputs(vtx, nThreads);
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex,1);
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+            for (size_t i = 0; i < vIndex.size(); i++)
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate)) {
-                    myTxHashes.push_back(tx.GetHash());
-                    ret++;
+                pindex = vIndex[i];
+                const CBlock& block = vBlocks[i];
+                if (pindex->GetHeight() % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+                BOOST_FOREACH(const CTransaction& tx, block.vtx)
+                {
+                    if (AddToWalletIfInvolvingMe(tx, &block, fUpdate, &decrypted)) {
+                        myTxHashes.push_back(tx.GetHash());
+                        ret++;
+                    }
                 }
-            }
 
-            SproutMerkleTree sproutTree;
-            SaplingMerkleTree saplingTree;
-            // This should never fail: we should always be able to get the tree
-            // state on the path to the tip of our chain
-            assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, sproutTree));
-            if (pindex->pprev) {
-                if (NetworkUpgradeActive(pindex->pprev->GetHeight(), Params().GetConsensus(), Consensus::UPGRADE_SAPLING)) {
-                    assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingTree));
+                SproutMerkleTree sproutTree;
+                SaplingMerkleTree saplingTree;
+                // This should never fail: we should always be able to get the tree
+                // state on the path to the tip of our chain
+                assert(pcoinsTip->GetSproutAnchorAt(pindex->hashSproutAnchor, sproutTree));
+                if (pindex->pprev) {
+                    if (NetworkUpgradeActive(pindex->pprev->GetHeight(), Params().GetConsensus(), Consensus::UPGRADE_SAPLING)) {
+                        assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingTree));
+                    }
                 }
-            }
-            // Increment note witness caches
-            ChainTip(pindex, &block, sproutTree, saplingTree, true);
+                // Increment note witness caches
+                ChainTip(pindex, &block, sproutTree, saplingTree, true);
 
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->GetHeight(), Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                pindex = chainActive.Next(pindex);
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->GetHeight(), Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                }
             }
         }
 
@@ -3388,92 +3595,151 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
  */
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, bool fIncludeCoinBase, int64_t txLockTime) const
 {
-    uint64_t interest,*ptr;
     vCoins.clear();
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        // Only outputs that pay to us and are not spent in a block can be available
+        for (CoinsByValue::const_iterator it = setCoinsByValue.begin(); it != setCoinsByValue.end(); ++it)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second.hash);
+            if (mit != mapWallet.end())
+                AddAvailableCoin(vCoins, &mit->second, it->second.n, fOnlyConfirmed, coinControl, fIncludeZeroValue, fIncludeCoinBase, txLockTime);
+        }
+    }
+}
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+/**
+ * Appends output i of pcoin to vCoins if AvailableCoins would return it.
+ */
+bool CWallet::AddAvailableCoin(vector<COutput>& vCoins, const CWalletTx* pcoin, unsigned int i, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, bool fIncludeCoinBase, int64_t txLockTime) const
+{
+    uint64_t interest,*ptr;
+    const uint256& wtxid = pcoin->GetHash();
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
 
-            if (pcoin->IsCoinBase() && !fIncludeCoinBase)
-                continue;
+    if (!CheckFinalTx(*pcoin))
+        return false;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+    if (fOnlyConfirmed && !pcoin->IsTrusted())
+        return false;
 
-            int nDepth = pcoin->GetDepthInMainChain();
-            if (nDepth < 0)
-                continue;
+    if (pcoin->IsCoinBase() && !fIncludeCoinBase)
+        return false;
 
-            for (int i = 0; i < pcoin->vout.size(); i++)
-            {
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    !IsLockedCoin((*it).first, i) && (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->IsSelected((*it).first, i)))
-                {
-                    if ( KOMODO_EXCHANGEWALLET == 0 )
-                    {
-                        uint32_t locktime; int32_t txheight; CBlockIndex *tipindex;
-                        if ( ASSETCHAINS_SYMBOL[0] == 0 && chainActive.LastTip() != 0 && chainActive.LastTip()->GetHeight() >= 60000 )
-                        {
-                            if ( pcoin->vout[i].nValue >= 10*COIN )
-                            {
-                                if ( (tipindex= chainActive.LastTip()) != 0 )
-                                {
-                                    komodo_accrued_interest(&txheight,&locktime,wtxid,i,0,pcoin->vout[i].nValue,(int32_t)tipindex->GetHeight());
-                                    interest = komodo_interestnew(txheight,pcoin->vout[i].nValue,locktime,tipindex->nTime);
-                                } else interest = 0;
-                                //interest = komodo_interestnew(chainActive.LastTip()->GetHeight()+1,pcoin->vout[i].nValue,pcoin->nLockTime,chainActive.LastTip()->nTime);
-                                if ( interest != 0 )
-                                {
-                                    //printf("wallet nValueRet %.8f += interest %.8f ht.%d lock.%u/%u tip.%u\n",(double)pcoin->vout[i].nValue/COIN,(double)interest/COIN,txheight,locktime,pcoin->nLockTime,tipindex->nTime);
-                                    //fprintf(stderr,"wallet nValueRet %.8f += interest %.8f ht.%d lock.%u tip.%u\n",(double)pcoin->vout[i].nValue/COIN,(double)interest/COIN,chainActive.LastTip()->GetHeight()+1,pcoin->nLockTime,chainActive.LastTip()->nTime);
-                                    //ptr = (uint64_t *)&pcoin->vout[i].nValue;
-                                    //(*ptr) += interest;
-                                    ptr = (uint64_t *)&pcoin->vout[i].interest;
-                                    (*ptr) = interest;
-                                    //pcoin->vout[i].nValue += interest;
-                                }
-                                else
-                                {
-                                    ptr = (uint64_t *)&pcoin->vout[i].interest;
-                                    (*ptr) = 0;
-                                }
-                            }
-                            else
-                            {
-                                ptr = (uint64_t *)&pcoin->vout[i].interest;
-                                (*ptr) = 0;
-                            }
-                        }
-                        else
-                        {
-                            ptr = (uint64_t *)&pcoin->vout[i].interest;
-                            (*ptr) = 0;
-                        }
-                    }
+    if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+        return false;
 
-                    bool bStillTimeLocked = false;
-                    {
-                        int64_t nLockTime;
-                        if(pcoin->vout[i].scriptPubKey.IsCheckLockTimeVerify(&nLockTime))
-                            bStillTimeLocked = !TokelCheckLockTimeHelper(nLockTime, txLockTime);
-                    }
+    int nDepth = pcoin->GetDepthInMainChain();
+    if (nDepth < 0)
+        return false;
 
-                    vCoins.push_back(COutput(pcoin, i, nDepth, (mine & ISMINE_SPENDABLE) != ISMINE_NO && !bStillTimeLocked));
+    if (i >= pcoin->vout.size())
+        return false;
+
+    isminetype mine = IsMine(pcoin->vout[i]);
+    if (IsSpent(wtxid, i) || mine == ISMINE_NO || IsLockedCoin(wtxid, i) ||
+        (pcoin->vout[i].nValue <= 0 && !fIncludeZeroValue) ||
+        (coinControl && coinControl->HasSelected() && !coinControl->IsSelected(wtxid, i)))
+        return false;
+
+    if ( KOMODO_EXCHANGEWALLET == 0 )
+    {
+        uint32_t locktime; int32_t txheight; CBlockIndex *tipindex;
+        if ( ASSETCHAINS_SYMBOL[0] == 0 && chainActive.LastTip() != 0 && chainActive.LastTip()->GetHeight() >= 60000 )
+        {
+            if ( pcoin->vout[i].nValue >= 10*COIN )
+            {
+                if ( (tipindex= chainActive.LastTip()) != 0 )
+                {
+                    komodo_accrued_interest(&txheight,&locktime,wtxid,i,0,pcoin->vout[i].nValue,(int32_t)tipindex->GetHeight());
+                    interest = komodo_interestnew(txheight,pcoin->vout[i].nValue,locktime,tipindex->nTime);
+                } else interest = 0;
+                //interest = komodo_interestnew(chainActive.LastTip()->GetHeight()+1,pcoin->vout[i].nValue,pcoin->nLockTime,chainActive.LastTip()->nTime);
+                if ( interest != 0 )
+                {
+                    //printf("wallet nValueRet %.8f += interest %.8f ht.%d lock.%u/%u tip.%u\n",(double)pcoin->vout[i].nValue/COIN,(double)interest/COIN,txheight,locktime,pcoin->nLockTime,tipindex->nTime);
+                    //fprintf(stderr,"wallet nValueRet %.8f += interest %.8f ht.%d lock.%u tip.%u\n",(double)pcoin->vout[i].nValue/COIN,(double)interest/COIN,chainActive.LastTip()->GetHeight()+1,pcoin->nLockTime,chainActive.LastTip()->nTime);
+                    //ptr = (uint64_t *)&pcoin->vout[i].nValue;
+                    //(*ptr) += interest;
+                    ptr = (uint64_t *)&pcoin->vout[i].interest;
+                    (*ptr) = interest;
+                    //pcoin->vout[i].nValue += interest;
+                }
+                else
+                {
+                    ptr = (uint64_t *)&pcoin->vout[i].interest;
+                    (*ptr) = 0;
                 }
             }
+            else
+            {
+                ptr = (uint64_t *)&pcoin->vout[i].interest;
+                (*ptr) = 0;
+            }
+        }
+        else
+        {
+            ptr = (uint64_t *)&pcoin->vout[i].interest;
+            (*ptr) = 0;
+        }
+    }
+
+    bool bStillTimeLocked = false;
+    {
+        int64_t nLockTime;
+        if(pcoin->vout[i].scriptPubKey.IsCheckLockTimeVerify(&nLockTime))
+            bStillTimeLocked = !TokelCheckLockTimeHelper(nLockTime, txLockTime);
+    }
+
+    vCoins.push_back(COutput(pcoin, i, nDepth, (mine & ISMINE_SPENDABLE) != ISMINE_NO && !bStillTimeLocked));
+    return true;
+}
+
+/**
+ * Collects the coins SelectCoinsMinConf can make use of for nTargetValue from
+ * setCoinsByValue: a coin of exactly that value if there is one, otherwise the
+ * smallest coin of at least nTargetValue + CENT and the largest coins below it,
+ * up to the total at which SelectCoinsMinConf stops adding smaller coins.
+ * Coins with fewer confirmations than SelectCoinsMinConf asks for are skipped.
+ */
+void CWallet::AvailableCoinsNearValue(vector<COutput>& vCoins, const CAmount& nTargetValue, int nConfMine, int nConfTheirs, bool fIncludeCoinBase, int64_t txLockTime) const
+{
+    vCoins.clear();
+
+    LOCK2(cs_main, cs_wallet);
+    auto addSelectable = [&](const COutPoint& outpoint) -> bool {
+        map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(outpoint.hash);
+        if (mit == mapWallet.end() || !AddAvailableCoin(vCoins, &mit->second, outpoint.n, true, NULL, false, fIncludeCoinBase, txLockTime))
+            return false;
+        const COutput& output = vCoins.back();
+        if (!output.fSpendable || output.nDepth < (output.tx->IsFromMe(ISMINE_ALL) ? nConfMine : nConfTheirs)) {
+            vCoins.pop_back();
+            return false;
         }
+        return true;
+    };
+
+    CoinsByValue::const_iterator it = setCoinsByValue.lower_bound(make_pair(nTargetValue, COutPoint(uint256(), 0)));
+    for (; it != setCoinsByValue.end() && it->first == nTargetValue; ++it) {
+        if (addSelectable(it->second))
+            return;
+    }
+
+    CoinsByValue::const_iterator itLarger = setCoinsByValue.lower_bound(make_pair(nTargetValue + CENT, COutPoint(uint256(), 0)));
+    for (it = itLarger; it != setCoinsByValue.end(); ++it) {
+        if (addSelectable(it->second))
+            break;
+    }
+
+    CAmount nTotalLower = 0;
+    for (CoinsByValue::const_reverse_iterator rit(itLarger); rit != setCoinsByValue.rend() && rit->first > 0; ++rit) {
+        if (nTotalLower > 4*nTargetValue + CENT)
+            break;
+        if (addSelectable(rit->second))
+            nTotalLower += rit->first;
     }
 }
 
@@ -3654,6 +3920,24 @@ bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*
     //    interestp = &tmp;
     //    *interestp = 0;
     //}
+
+    // Without preset inputs only the coins around the target value need to be looked at.
+    // If they do not make it, the full scan below runs and also tells about coinbase coins.
+    if (!coinControl || !coinControl->HasSelected())
+    {
+        const int confs[3][2] = { {1, 6}, {1, 1}, {0, 1} };
+        bool fIncludeCoinBase = !Params().GetConsensus().fCoinbaseMustBeProtected;
+        for (int i = 0; i < (bSpendZeroConfChange ? 3 : 2); i++)
+        {
+            vector<COutput> vCoins;
+            AvailableCoinsNearValue(vCoins, nTargetValue, confs[i][0], confs[i][1], fIncludeCoinBase, txLockTime);
+            if (SelectCoinsMinConf(nTargetValue, confs[i][0], confs[i][1], vCoins, setCoinsRet, nValueRet))
+                return true;
+        }
+        setCoinsRet.clear();
+        nValueRet = 0;
+    }
+
     vector<COutput> vCoinsNoCoinbase, vCoinsWithCoinbase;
     AvailableCoins(vCoinsNoCoinbase, true, coinControl, false, false, txLockTime);
     AvailableCoins(vCoinsWithCoinbase, true, coinControl, false, true, txLockTime);
@@ -4266,6 +4550,9 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         return nLoadWalletRet;
     fFirstRunRet = !vchDefaultKey.IsValid();
 
+    // Transactions may have been read before the keys that make their outputs ours
+    RebuildCoinsByValue();
+
     uiInterface.LoadWallet(this);
 
     return DB_LOAD_OK;
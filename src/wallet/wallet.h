@@ -80,6 +80,8 @@ extern unsigned int WITNESS_CACHE_SIZE;
 
 //! Size of HD seed in bytes
 static const size_t HD_WALLET_SEED_LENGTH = 32;
+//! Number of blocks read ahead during a rescan so their Sapling outputs can be trial decrypted together
+static const unsigned int WALLET_RESCAN_BATCH_BLOCKS = 16;
 
 class CBlockIndex;
 class CCoinControl;
@@ -325,6 +327,16 @@ public:
 typedef std::map<JSOutPoint, SproutNoteData> mapSproutNoteData_t;
 typedef std::map<SaplingOutPoint, SaplingNoteData> mapSaplingNoteData_t;
 
+/** Sapling output that decrypted under one of the wallet's incoming viewing keys. */
+struct SaplingTrialDecryption
+{
+    libzcash::SaplingIncomingViewingKey ivk;
+    // Recipient address, only set when ivk belongs to a full viewing key in the wallet
+    boost::optional<libzcash::SaplingPaymentAddress> address;
+};
+
+typedef std::map<SaplingOutPoint, SaplingTrialDecryption> SaplingTrialDecryptions;
+
 /** Decrypted note, its location in a transaction, and number of confirmations. */
 struct CSproutNotePlaintextEntry
 {
@@ -628,6 +640,9 @@ public:
     std::string ToString() const;
 };
 
+//! Wallet outputs keyed by value, see CWallet::setCoinsByValue
+typedef std::set<std::pair<CAmount, COutPoint> > CoinsByValue;
+
 
 
 
@@ -779,6 +794,15 @@ private:
     TxNullifiers mapTxSproutNullifiers;
     TxNullifiers mapTxSaplingNullifiers;
 
+    /**
+     * Outputs of wallet transactions that pay to us, ordered by value. An output
+     * leaves the index once a transaction spending it is in the active chain, so the index
+     * holds every unspent output plus the few whose spends are still pending.
+     */
+    CoinsByValue setCoinsByValue;
+    //! Bumped whenever an entry of setCoinsByValue is refreshed, lets users of the index notice changes
+    uint64_t nCoinsByValueUpdates;
+
     void AddToTransparentSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSproutSpends(const uint256& nullifier, const uint256& wtxid);
     void AddToSaplingSpends(const uint256& nullifier, const uint256& wtxid);
@@ -796,6 +820,9 @@ public:
     void ClearNoteWitnessCache();
 
 protected:
+    void UpdateCoinByValue(const COutPoint& outpoint);
+    void UpdateCoinsByValue(const CWalletTx& wtx);
+
     /**
      * pindex is the new tip being connected.
      */
@@ -919,6 +946,7 @@ public:
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
         nWitnessCacheSize = 0;
+        nCoinsByValueUpdates = 0;
     }
 
     /**
@@ -994,6 +1022,11 @@ public:
     bool CanSupportFeature(enum WalletFeature wf) { AssertLockHeld(cs_wallet); return nWalletMaxVersion >= wf; }
 
     void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed=true, const CCoinControl *coinControl = NULL, bool fIncludeZeroValue=false, bool fIncludeCoinBase=true, int64_t txLockTime = 0L) const;
+    bool AddAvailableCoin(std::vector<COutput>& vCoins, const CWalletTx* pcoin, unsigned int i, bool fOnlyConfirmed=true, const CCoinControl *coinControl = NULL, bool fIncludeZeroValue=false, bool fIncludeCoinBase=true, int64_t txLockTime = 0L) const;
+    void AvailableCoinsNearValue(std::vector<COutput>& vCoins, const CAmount& nTargetValue, int nConfMine, int nConfTheirs, bool fIncludeCoinBase=true, int64_t txLockTime = 0L) const;
+    void RebuildCoinsByValue();
+    const CoinsByValue& GetCoinsByValue() const { AssertLockHeld(cs_wallet); return setCoinsByValue; }
+    uint64_t GetCoinsByValueUpdates() const { AssertLockHeld(cs_wallet); return nCoinsByValueUpdates; }
     bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
 
     bool IsSpent(const uint256& hash, unsigned int n) const;
@@ -1139,7 +1172,7 @@ public:
     void EraseFromWallet(const uint256 &hash);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     void RescanWallet();
-    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
+    bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate, const SaplingTrialDecryptions* pdecrypted = NULL);
     void WitnessNoteCommitment(
          std::vector<uint256> commitments,
          std::vector<boost::optional<SproutWitness>>& witnesses,
@@ -1183,7 +1216,8 @@ public:
         const uint256& hSig,
         uint8_t n) const;
     mapSproutNoteData_t FindMySproutNotes(const CTransaction& tx) const;
-    std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> FindMySaplingNotes(const CTransaction& tx) const;
+    std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> FindMySaplingNotes(const CTransaction& tx, const SaplingTrialDecryptions* pdecrypted = NULL) const;
+    SaplingTrialDecryptions TrialDecryptSaplingOutputs(const std::vector<const CTransaction*>& vtx, int nThreads = 1) const;
     bool IsSproutNullifierFromMe(const uint256& nullifier) const;
     bool IsSaplingNullifierFromMe(const uint256& nullifier) const;
 
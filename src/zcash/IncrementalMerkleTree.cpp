@@ -1,3 +1,4 @@
+#include <map>
 #include <stdexcept>
 
 #include <boost/foreach.hpp>
@@ -348,6 +349,70 @@ void IncrementalWitness<Depth, Hash>::append(Hash obj) {
     }
 }
 
+template<size_t Depth, typename Hash>
+void IncrementalWitness<Depth, Hash>::append_batch(const std::vector<IncrementalWitness<Depth, Hash>*>& witnesses,
+                                                   uint64_t next,
+                                                   const std::vector<Hash>& objs) {
+    // A witness of position p < next is filling the uncle subtree at the level
+    // of the highest bit in which p and next differ. Witnesses at the same level
+    // hold the same cursor and complete the same subtrees from here on, so only
+    // one of them appends and the others copy its result.
+    struct Leader {
+        IncrementalWitness* witness;
+        size_t filled_before;
+    };
+    std::map<size_t, Leader> leaders;
+    std::vector<std::pair<IncrementalWitness*, size_t>> followers;
+
+    if (objs.empty()) {
+        return;
+    }
+
+    BOOST_FOREACH(IncrementalWitness* witness, witnesses) {
+        uint64_t position = witness->position();
+        if (position >= next) {
+            // Not a witness of this tree state, append to it as append() would
+            BOOST_FOREACH(const Hash& obj, objs) {
+                witness->append(obj);
+            }
+            continue;
+        }
+        size_t level = 0;
+        for (uint64_t diff = (position ^ next) >> 1; diff; diff >>= 1) {
+            level++;
+        }
+
+        auto it = leaders.find(level);
+        if (it == leaders.end()) {
+            leaders[level] = Leader {witness, witness->filled.size()};
+        } else if (witness->cursor == it->second.witness->cursor &&
+                   (!witness->cursor || witness->cursor_depth == it->second.witness->cursor_depth)) {
+            followers.push_back(std::make_pair(witness, level));
+        } else {
+            // Not in step with the tree, keep the witness to itself
+            BOOST_FOREACH(const Hash& obj, objs) {
+                witness->append(obj);
+            }
+        }
+    }
+
+    for (auto& leader : leaders) {
+        BOOST_FOREACH(const Hash& obj, objs) {
+            leader.second.witness->append(obj);
+        }
+    }
+
+    for (auto& follower : followers) {
+        const Leader& leader = leaders[follower.second];
+        IncrementalWitness* witness = follower.first;
+        witness->filled.insert(witness->filled.end(),
+                               leader.witness->filled.begin() + leader.filled_before,
+                               leader.witness->filled.end());
+        witness->cursor = leader.witness->cursor;
+        witness->cursor_depth = leader.witness->cursor_depth;
+    }
+}
+
 template class IncrementalMerkleTree<INCREMENTAL_MERKLE_TREE_DEPTH, SHA256Compress>;
 template class IncrementalMerkleTree<INCREMENTAL_MERKLE_TREE_DEPTH_TESTING, SHA256Compress>;
 
@@ -180,6 +180,14 @@ public:
 
     void append(Hash obj);
 
+    // Appends the same objects to every witness. The witnesses must all follow
+    // a tree whose next leaf is at position `next`; witnesses filling the same
+    // uncle subtree share its hashes, so each subtree is hashed once per batch.
+    // A witness that does not (a stale cache) is appended to one object at a time.
+    static void append_batch(const std::vector<IncrementalWitness*>& witnesses,
+                             uint64_t next,
+                             const std::vector<Hash>& objs);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -10,6 +10,8 @@
 #include "init.h"
 #include "primitives/transaction.h"
 #include "base58.h"
+#include "cc/CCPayments.h"
+#include "cc/CCPrices.h"
 #include "crypto/equihash.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -19,6 +21,8 @@
 #include "miner.h"
 #include "pow.h"
 #include "rpc/server.h"
+#include "script/cc.h"
+#include "script/serverchecker.h"
 #include "script/sign.h"
 #include "sodium.h"
 #include "streams.h"
@@ -33,6 +37,8 @@
 #include "zcash/Note.hpp"
 #include "librustzcash.h"
 
+extern void mpz_set_lli(mpz_t rop, long long op);
+
 using namespace libzcash;
 // This method is based on Shutdown from init.cpp
 void pre_wallet_load()
@@ -297,6 +303,71 @@ double benchmark_try_decrypt_notes(size_t nAddrs)
     return timer_stop(tv_start);
 }
 
+// Output with an encrypted note to the address; nothing that reads it here checks the proof
+static OutputDescription FakeSaplingOutput(const libzcash::SaplingPaymentAddress& address)
+{
+    libzcash::SaplingNote note(address, 10);
+    libzcash::SaplingNotePlaintext pt(note, {});
+    auto enc = pt.encrypt(note.pk_d);
+    OutputDescription od;
+    od.cm = note.cm().get();
+    od.ephemeralKey = enc->second.get_epk();
+    od.encCiphertext = enc->first;
+    return od;
+}
+
+double benchmark_try_decrypt_sapling_notes(size_t nAddrs, int nThreads)
+{
+    CWallet wallet;
+    auto m = libzcash::SaplingExtendedSpendingKey::Master(HDSeed::Random());
+    for (int i = 0; i < nAddrs; i++) {
+        auto sk = m.Derive(i | ZIP32_HARDENED_KEY_LIMIT);
+        wallet.AddSaplingZKey(sk, sk.DefaultAddress());
+    }
+
+    // A block worth of outputs to someone else
+    auto recipient = libzcash::SaplingSpendingKey::random().default_address();
+    CMutableTransaction mtx;
+    for (int i = 0; i < 100; i++) {
+        mtx.vShieldedOutput.push_back(FakeSaplingOutput(recipient));
+    }
+    CTransaction tx(mtx);
+    std::vector<const CTransaction*> vtx(1, &tx);
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    auto decrypted = wallet.TrialDecryptSaplingOutputs(vtx, nThreads);
+    assert(decrypted.empty());
+    return timer_stop(tv_start);
+}
+
+// Transaction paying the wallet one Sprout and one Sapling note
+static CWalletTx ReceiveSproutAndSapling(CWallet& wallet,
+                                         const libzcash::SproutSpendingKey& sk,
+                                         const libzcash::SaplingSpendingKey& saplingSk)
+{
+    auto sproutTx = GetValidReceive(*pzcashParams, sk, 10, true);
+    auto note = GetNote(*pzcashParams, sk, sproutTx, 0, 1);
+    auto nullifier = note.nullifier(sk);
+
+    CMutableTransaction mtx(sproutTx);
+    mtx.vShieldedOutput.push_back(FakeSaplingOutput(saplingSk.default_address()));
+    CWalletTx wtx(&wallet, mtx);
+
+    mapSproutNoteData_t noteData;
+    JSOutPoint jsoutpt {wtx.GetHash(), 0, 1};
+    SproutNoteData nd {sk.address(), nullifier};
+    noteData[jsoutpt] = nd;
+
+    mapSaplingNoteData_t saplingNoteData;
+    SaplingOutPoint outPoint {wtx.GetHash(), 0};
+    saplingNoteData[outPoint] = SaplingNoteData(saplingSk.full_viewing_key().in_viewing_key());
+
+    wtx.SetSproutNoteData(noteData);
+    wtx.SetSaplingNoteData(saplingNoteData);
+    return wtx;
+}
+
 double benchmark_increment_note_witnesses(size_t nTxs)
 {
     CWallet wallet;
@@ -305,20 +376,12 @@ double benchmark_increment_note_witnesses(size_t nTxs)
 
     auto sk = libzcash::SproutSpendingKey::random();
     wallet.AddSproutSpendingKey(sk);
+    auto saplingSk = libzcash::SaplingSpendingKey::random();
 
     // First block
     CBlock block1;
     for (int i = 0; i < nTxs; i++) {
-        auto wtx = GetValidReceive(*pzcashParams, sk, 10, true);
-        auto note = GetNote(*pzcashParams, sk, wtx, 0, 1);
-        auto nullifier = note.nullifier(sk);
-
-        mapSproutNoteData_t noteData;
-        JSOutPoint jsoutpt {wtx.GetHash(), 0, 1};
-        SproutNoteData nd {sk.address(), nullifier};
-        noteData[jsoutpt] = nd;
-
-        wtx.SetSproutNoteData(noteData);
+        auto wtx = ReceiveSproutAndSapling(wallet, sk, saplingSk);
         wallet.AddToWallet(wtx, true, NULL);
         block1.vtx.push_back(wtx);
     }
@@ -332,16 +395,7 @@ double benchmark_increment_note_witnesses(size_t nTxs)
     CBlock block2;
     block2.hashPrevBlock = block1.GetHash();
     {
-        auto wtx = GetValidReceive(*pzcashParams, sk, 10, true);
-        auto note = GetNote(*pzcashParams, sk, wtx, 0, 1);
-        auto nullifier = note.nullifier(sk);
-
-        mapSproutNoteData_t noteData;
-        JSOutPoint jsoutpt {wtx.GetHash(), 0, 1};
-        SproutNoteData nd {sk.address(), nullifier};
-        noteData[jsoutpt] = nd;
-
-        wtx.SetSproutNoteData(noteData);
+        auto wtx = ReceiveSproutAndSapling(wallet, sk, saplingSk);
         wallet.AddToWallet(wtx, true, NULL);
         block2.vtx.push_back(wtx);
     }
@@ -630,3 +684,160 @@ double benchmark_verify_sapling_output()
     }
     return timer_stop(tv_start);
 }
+
+// deterministic price series spread over many magnitudes, like the ones prices_synthetic_tests uses
+static int32_t benchmark_priceget(int64_t *buf64, int32_t ind, int32_t height, int32_t numblocks)
+{
+    memset(buf64, 0, sizeof(*buf64) * PRICES_MAXDATAPOINTS * numblocks);
+    uint64_t x = (uint64_t)(ind * 2654435761u) ^ ((uint64_t)height * 40503u);
+    buf64[2] = (int64_t)((x % 1000003) + 1) << ((ind + height) % 24);
+    return PRICES_MAXDATAPOINTS;
+}
+
+// evaluates nExprs synthetic price expressions at 20 heights, compiled or with the gmp reference evaluator
+double benchmark_synthetic_prices(size_t nExprs, bool fCompiled)
+{
+    static const uint16_t ops[] = { PRICES_MULT, PRICES_DIV, PRICES_MDD, PRICES_MMD, PRICES_MMM, PRICES_DDD };
+    std::vector<std::vector<uint16_t> > vecs(nExprs);
+    std::vector<CPricesSynthetic> compiled(nExprs);
+    for (size_t i = 0; i < nExprs; i++) {
+        uint16_t op = ops[GetRand(sizeof(ops) / sizeof(ops[0]))];
+        vecs[i].push_back(GetRand(8) + 4);
+        vecs[i].push_back(GetRand(8) + 4);
+        if (op != PRICES_MULT && op != PRICES_DIV)
+            vecs[i].push_back(GetRand(8) + 4);
+        vecs[i].push_back(op);
+        vecs[i].push_back(PRICES_WEIGHT | (GetRand(100) + 1));
+        prices_syntheticcompile(compiled[i], vecs[i]);
+    }
+
+    int64_t sum = 0;
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (int32_t height = 0; height < 20; height++) {
+        for (size_t i = 0; i < nExprs; i++) {
+            if (fCompiled)
+                sum += prices_syntheticeval(compiled[i], height, benchmark_priceget);
+            else
+                sum += prices_syntheticprice_mpz(vecs[i], height, benchmark_priceget);
+        }
+    }
+    double t = timer_stop(tv_start);
+    LogPrint("bench", "synthetic prices checksum %lld\n", (long long)sum);
+    return t;
+}
+
+// decodes nInputs signed fulfillments of secp256k1, eval and preimage conditions under 1 of n thresholds,
+// with the single pass decoder or asn1c
+double benchmark_fulfillment_decode(size_t nInputs, bool fAsn1)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    uint256 msg = GetRandHash();
+    std::vector<std::vector<unsigned char> > ffills;
+    for (size_t i = 0; i < nInputs; i++) {
+        std::vector<CC*> v;
+        for (int j = 0, n = 1 + GetRand(4); j < n; j++) {
+            std::vector<CC*> w;
+            w.push_back(CCNewSecp256k1(key.GetPubKey()));
+            w.push_back(CCNewEval(std::vector<unsigned char>(1 + GetRand(40), j)));
+            w.push_back(CCNewPreimage(std::vector<unsigned char>(GetRand(40), j)));
+            v.push_back(CCNewThreshold(1 + GetRand(3), w));
+        }
+        CC *cond = CCNewThreshold(1, v);
+        cc_signTreeSecp256k1Msg32(cond, key.begin(), msg.begin());
+        unsigned char buf[10000];
+        size_t len = cc_fulfillmentBinary(cond, buf, sizeof(buf));
+        cc_free(cond);
+        ffills.push_back(std::vector<unsigned char>(buf, buf + len));
+    }
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (auto &ffill : ffills) {
+        CC *cond = fAsn1 ? cc_readFulfillmentBinaryAsn1(ffill.data(), ffill.size(), 0) : cc_readFulfillmentBinary(ffill.data(), ffill.size());
+        if (!cond)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "fulfillment should decode");
+        cc_free(cond);
+    }
+    return timer_stop(tv_start);
+}
+
+// verifies a 16 of 18 secp256k1 crypto-condition nVerifies times, with the signatures cached at the
+// first verify or checked every time
+double benchmark_cc_signatures(size_t nVerifies, bool fCached)
+{
+    std::vector<CKey> keys(18);
+    std::vector<CC*> ccs;
+    for (CKey &key : keys) {
+        key.MakeNewKey(true);
+        ccs.push_back(CCNewSecp256k1(key.GetPubKey()));
+    }
+    CC *cond = CCNewThreshold(16, ccs);
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    uint256 sighash = SignatureHash(CCPubKey(cond), mtx, 0, SIGHASH_ALL, 0, 0);
+    for (CKey &key : keys)
+        cc_signTreeSecp256k1Msg32(cond, key.begin(), sighash.begin());
+    CScript scriptSig = CCSig(cond), scriptPubKey = CCPubKey(cond);
+    cc_free(cond);
+
+    CTransaction tx(mtx);
+    PrecomputedTransactionData txdata(tx);
+    ServerTransactionSignatureChecker checker(&tx, 0, 0, fCached, 0, 1, NULL, txdata);
+    ScriptError error;
+    if (fCached && !VerifyScript(scriptSig, scriptPubKey, 0, checker, 0, &error))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "crypto-condition should verify");
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    for (size_t i = 0; i < nVerifies; i++) {
+        if (!VerifyScript(scriptSig, scriptPubKey, 0, checker, 0, &error))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "crypto-condition should verify");
+    }
+    return timer_stop(tv_start);
+}
+
+// computes the shares of one payments release to nAllocations, in 128 bits or with gmp
+double benchmark_payments_allocations(size_t nAllocations, bool fGmp)
+{
+    std::vector<int64_t> allocations;
+    unsigned __int128 total = 0;
+    while (allocations.size() < nAllocations) {
+        allocations.push_back((int64_t)GetRand(1000000) * COIN + 1);
+        total += (uint64_t)allocations.back();
+    }
+    int64_t amount = 12345 * COIN, sum = 0, share;
+
+    struct timeval tv_start;
+    timer_start(tv_start);
+    if (fGmp) {
+        mpz_t mpzTotal, value, tmp;
+        mpz_init(mpzTotal);
+        mpz_init(value);
+        mpz_init(tmp);
+        for (int64_t allocation : allocations) {
+            mpz_set_lli(tmp, allocation);
+            mpz_add(mpzTotal, mpzTotal, tmp);
+        }
+        for (int64_t allocation : allocations) {
+            mpz_set_lli(value, allocation);
+            mpz_set_lli(tmp, amount);
+            mpz_mul(value, value, tmp);
+            mpz_tdiv_q(value, value, mpzTotal);
+            sum += mpz_get_si(value);
+        }
+        mpz_clear(mpzTotal);
+        mpz_clear(value);
+        mpz_clear(tmp);
+    } else {
+        for (int64_t allocation : allocations) {
+            payments_allocationshare(allocation, amount, total, share);
+            sum += share;
+        }
+    }
+    double t = timer_stop(tv_start);
+    LogPrint("bench", "payments allocations checksum %lld\n", (long long)sum);
+    return t;
+}
@@ -14,6 +14,7 @@ extern double benchmark_verify_joinsplit(const JSDescription &joinsplit);
 extern double benchmark_verify_equihash();
 extern double benchmark_large_tx(size_t nInputs);
 extern double benchmark_try_decrypt_notes(size_t nAddrs);
+extern double benchmark_try_decrypt_sapling_notes(size_t nAddrs, int nThreads);
 extern double benchmark_increment_note_witnesses(size_t nTxs);
 extern double benchmark_connectblock_slow();
 extern double benchmark_sendtoaddress(CAmount amount);
@@ -23,5 +24,9 @@ extern double benchmark_create_sapling_spend();
 extern double benchmark_create_sapling_output();
 extern double benchmark_verify_sapling_spend();
 extern double benchmark_verify_sapling_output();
+extern double benchmark_synthetic_prices(size_t nExprs, bool fCompiled);
+extern double benchmark_fulfillment_decode(size_t nInputs, bool fAsn1);
+extern double benchmark_cc_signatures(size_t nVerifies, bool fCached);
+extern double benchmark_payments_allocations(size_t nAllocations, bool fGmp);
 
 #endif
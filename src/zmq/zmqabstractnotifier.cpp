@@ -25,3 +25,8 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyChainTip(const CBlockIndex * /*pindex*/, const CBlock * /*pblock*/, bool /*added*/)
+{
+    return true;
+}
@@ -5,6 +5,7 @@
 #include "zmqpublishnotifier.h"
 #include "main.h"
 #include "util.h"
+#include "cc/CCinclude.h"
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -13,6 +14,7 @@ static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
 static const char *MSG_CHECKEDBLOCK = "checkedblock";
+static const char *MSG_CCEVENT   = "ccevent";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -204,3 +206,41 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishCCEventNotifier::NotifyChainTip(const CBlockIndex *pindex, const CBlock *pblock, bool added)
+{
+    BOOST_FOREACH(const CTransaction &tx, pblock->vtx)
+    {
+        // txids of the cc outputs this tx spends
+        std::vector<uint256> vRelated;
+        BOOST_FOREACH(const CTxIn &txin, tx.vin)
+        {
+            if (IsCCInput(txin.scriptSig) && std::find(vRelated.begin(), vRelated.end(), txin.prevout.hash) == vRelated.end())
+                vRelated.push_back(txin.prevout.hash);
+        }
+
+        // one event per contract instance and funcid found in the cc outputs
+        std::set<std::pair<uint256, uint16_t> > setSent;
+        for (int32_t n = 0; n < tx.vout.size(); n++)
+        {
+            if (!tx.vout[n].scriptPubKey.IsPayToCryptoCondition())
+                continue;
+            uint8_t evalcode, funcid, version;
+            uint256 creationId;
+            if (!CCDecodeTxVout(tx, n, evalcode, funcid, version, creationId))
+                continue;
+            if (!setSent.insert(std::make_pair(creationId, (uint16_t)((evalcode << 8) | funcid))).second)
+                continue;
+
+            std::string topic = strprintf("%s%02x%02x", MSG_CCEVENT, evalcode, funcid);
+            LogPrint("zmq", "zmq: Publish %s %s %s\n", topic, tx.GetHash().GetHex(), added ? "connected" : "disconnected");
+
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss << (uint8_t)added << (int32_t)pindex->GetHeight() << pindex->GetBlockHash() << tx.GetHash();
+            ss << evalcode << funcid << version << creationId << vRelated;
+            if (!SendMessage(topic.c_str(), &(*ss.begin()), ss.size()))
+                return false;
+        }
+    }
+    return true;
+}
@@ -58,4 +58,15 @@ public:
     bool NotifyBlock(const CBlock &block);
 };
 
+/** Publishes the cc transactions of connected and disconnected blocks.
+ * The topic is "ccevent" followed by the evalcode and funcid in hex, so
+ * subscribers filter by evalcode ("cceventf2") or evalcode and funcid
+ * ("cceventf263") and the publisher only sends what is subscribed.
+ */
+class CZMQPublishCCEventNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyChainTip(const CBlockIndex *pindex, const CBlock *pblock, bool added);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H